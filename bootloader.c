@@ -15,9 +15,618 @@
 #include "main.h"
 #include "hexfile.h"
 #include "serial_comm.h"
+#include "net_comm.h"
 #include "spi_spidev_comm.h"
 #include "spi_Arduino_comm.h"
 #include "misc.h"
+#include "logger.h"
+#include "fault.h"
+#include "memtrack.h"
+
+
+/// number of write retries before a device is dropped from gang
+#define GANG_RETRY   3
+
+/// number of retries of a failed read/write frame (single device via UART)
+#define FRAME_RETRY  3
+
+/// max. number of bytes sent for resync, completes any pending BSL field (max. 1+256+1 for data)
+#define RESYNC_LEN   260
+
+/// state of a pending BSL field while constructing resync bytes, see bsl_resyncFill()
+#define FILL_IDLE       0     //< no field pending
+#define FILL_SUM        1     //< address or data bytes, then checksum
+#define FILL_LEN_DATA   2     //< number of bytes of write data
+#define FILL_LEN_COUNT  3     //< number of bytes to read, then complement
+
+/// max. time to wait for NACK during resync [ms]
+#define RESYNC_POLL  10
+
+// state of gang programming (shared TX line, separate RX port per device)
+static int      s_gangNum = 0;                  //< number of gang devices (0=single device)
+static HANDLE   s_gangPort[GANG_MAX];           //< RX port per device. Port of device 0 is also shared TX
+static bool     s_gangActive[GANG_MAX];         //< device is still active, i.e. not dropped
+static bool     s_gangFailed[GANG_MAX];         //< device failed in current write frame
+static bool     s_gangFrame = false;            //< within write frame -> retry instead of drop
+static int      s_gangRetry = 0;                //< retries of current write frame
+static char     s_gangRx[GANG_MAX][1000];       //< receive buffer per device
+static uint32_t s_gangTimeout = 0;              //< current receive timeout [ms] (0=g_timing.timeout)
+
+// data EEPROM of connected device, resolved on first EEPROM write, see bsl_eepromLayout()
+static eepromLayout_t s_eeprom = {0, 0, 0};    //< data EEPROM range and block size (block=0: unknown)
+static bool     s_eepromKnown = false;          //< EEPROM layout is resolved
+static uint8_t  s_family = 0;                   //< family from bsl_getInfo()
+static int      s_flashsize = 0;                //< density class from bsl_getInfo() [kB]
+
+/// data EEPROM layout per family and flash size, see RM0016, RM0031 and datasheets
+static const struct {
+  uint8_t         family;                       //< STM8S or STM8L
+  int             flashsize;                    //< actual flash size [kB]
+  eepromLayout_t  eeprom;                       //< EEPROM range and block size
+} s_deviceTable[] = {
+  {STM8S,   8, {0x4000, 0x427F,  64}},          //< low density, e.g. STM8S003/103/903: 640B
+  {STM8S,  16, {0x4000, 0x43FF, 128}},          //< medium density, e.g. STM8S105x4: 1kB
+  {STM8S,  32, {0x4000, 0x43FF, 128}},          //< medium/high density, e.g. STM8S105x6, STM8S207x6: 1kB
+  {STM8S,  64, {0x4000, 0x45FF, 128}},          //< high density, e.g. STM8S207x8: 1.5kB
+  {STM8S, 128, {0x4000, 0x47FF, 128}},          //< high density, e.g. STM8S207xB, STM8S208xB: 2kB
+  {STM8L,   8, {0x1000, 0x10FF,  64}},          //< low density, e.g. STM8L151x3: 256B
+  {STM8L,  16, {0x1000, 0x13FF, 128}},          //< medium density, e.g. STM8L151x4: 1kB
+  {STM8L,  32, {0x1000, 0x13FF, 128}},          //< medium density, e.g. STM8L151x6: 1kB
+  {STM8L,  64, {0x1000, 0x17FF, 128}}           //< high density, e.g. STM8L152x8: 2kB
+};
+
+
+
+/**
+  \fn void bsl_gangSetup(int numPorts, HANDLE *ptrPorts)
+
+  \param[in]  numPorts       number of devices (0 or 1=single device)
+  \param[in]  ptrPorts       RX port handles of devices. Port 0 is also used as shared TX line
+
+  enable gang programming. Frames are sent once via the shared TX line and the responses of all
+  devices are collected from their RX ports. Devices with a deviating response are dropped
+  (or retried for write frames) and are ignored afterwards.
+*/
+void bsl_gangSetup(int numPorts, HANDLE *ptrPorts) {
+
+  int  k;
+
+  // check number of devices
+  if (numPorts > GANG_MAX)
+    Error("in 'bsl_gangSetup()': too many devices (%d, max %d)", numPorts, GANG_MAX);
+
+  // single device -> no gang
+  s_gangNum = (numPorts > 1) ? numPorts : 0;
+  for (k=0; k<s_gangNum; k++) {
+    s_gangPort[k]   = ptrPorts[k];
+    s_gangActive[k] = true;
+    s_gangFailed[k] = false;
+  }
+
+} // bsl_gangSetup
+
+
+
+/**
+  \fn int bsl_gangStatus(bool *active)
+
+  \param[out] active         device is still active (size numPorts of bsl_gangSetup()). May be NULL
+
+  \return number of active devices
+
+  get number of remaining gang devices, i.e. which have not been dropped due to errors
+*/
+int bsl_gangStatus(bool *active) {
+
+  int  k, num = 0;
+
+  for (k=0; k<s_gangNum; k++) {
+    if (active != NULL)
+      active[k] = s_gangActive[k];
+    if (s_gangActive[k])
+      num++;
+  }
+
+  return(num);
+
+} // bsl_gangStatus
+
+
+
+/**
+  \fn void bsl_flush(HANDLE ptrPort)
+
+  \param[in]  ptrPort        handle to communication port
+
+  purge input buffer of port, or of all RX ports in gang mode
+*/
+static void bsl_flush(HANDLE ptrPort) {
+
+  int  k;
+
+  flush_port(ptrPort);
+  for (k=1; k<s_gangNum; k++)
+    flush_port(s_gangPort[k]);
+
+} // bsl_flush
+
+
+
+/**
+  \fn void bsl_timeout(HANDLE ptrPort, uint32_t timeout)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  timeout        receive timeout [ms]
+
+  set receive timeout of port, or of all RX ports in gang mode
+*/
+static void bsl_timeout(HANDLE ptrPort, uint32_t timeout) {
+
+  int  k;
+
+  set_timeout(ptrPort, timeout);
+  for (k=1; k<s_gangNum; k++)
+    set_timeout(s_gangPort[k], timeout);
+  s_gangTimeout = (timeout != g_timing.timeout) ? timeout : 0;
+
+} // bsl_timeout
+
+
+
+/**
+  \fn uint32_t bsl_gangRead(HANDLE ptrPort, uint32_t lenRx, char *Rx, uint64_t deadline)
+
+  \param[in]  ptrPort        handle to RX port of gang device
+  \param[in]  lenRx          number of bytes to receive
+  \param[out] Rx             array containing bytes received
+  \param[in]  deadline       time until which to wait for the response, see millis() [ms]
+
+  \return number of received bytes
+
+  receive response of a gang device until complete or deadline. As all devices respond in parallel,
+  the caller uses one deadline for all devices, i.e. devices w/o response add no timeout each.
+*/
+static uint32_t bsl_gangRead(HANDLE ptrPort, uint32_t lenRx, char *Rx, uint64_t deadline) {
+
+  uint32_t  len = 0;
+  uint64_t  now;
+
+  // wait for data until deadline
+  while ((len < lenRx) && ((now = millis()) < deadline))
+    len += read_port(ptrPort, lenRx - len, Rx + len, (uint32_t) (deadline - now));
+
+  // take data already received, e.g. if deadline has passed for previous devices
+  if (len < lenRx)
+    len += read_port(ptrPort, lenRx - len, Rx + len, 0);
+
+  return(len);
+
+} // bsl_gangRead
+
+
+
+/**
+  \fn uint32_t bsl_receive(HANDLE ptrPort, uint8_t uartMode, uint32_t lenRx, char *Rx)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  lenRx          number of bytes to receive
+  \param[out] Rx             array containing bytes received
+
+  \return number of received bytes
+
+  receive bootloader response via UART. In gang mode receive from all active devices and return
+  the response with the most votes among complete ACK responses. Devices with a different response
+  are marked failed within a write frame, else dropped.
+*/
+static uint32_t bsl_receive(HANDLE ptrPort, uint8_t uartMode, uint32_t lenRx, char *Rx) {
+
+  uint32_t  len[GANG_MAX];
+  uint64_t  deadline;
+  int       k, j, ref, votes, maxVotes;
+
+  // single device, optionally with injected faults
+  if (s_gangNum == 0)
+    return(fault_inject(lenRx, Rx, receive_port(ptrPort, uartMode, lenRx, Rx)));
+
+  // devices reply in parallel and OS buffers the data -> read sequentially with common deadline (gang requires duplex mode)
+  deadline = millis() + ((s_gangTimeout != 0) ? s_gangTimeout : g_timing.timeout);
+  for (k=0; k<s_gangNum; k++) {
+    len[k] = 0;
+    if (s_gangActive[k])
+      len[k] = bsl_gangRead(s_gangPort[k], lenRx, s_gangRx[k], deadline);
+  }
+
+  // reference is complete ACK response with most votes. If none, use first active device
+  ref = -1;
+  maxVotes = 0;
+  for (k=0; k<s_gangNum; k++) {
+    if ((!s_gangActive[k]) || (len[k] != lenRx) || (s_gangRx[k][0] != ACK))
+      continue;
+    votes = 0;
+    for (j=0; j<s_gangNum; j++) {
+      if ((s_gangActive[j]) && (len[j] == len[k]) && (!memcmp(s_gangRx[j], s_gangRx[k], len[k])))
+        votes++;
+    }
+    if (votes > maxVotes) {
+      maxVotes = votes;
+      ref = k;
+    }
+  }
+  for (k=0; (k<s_gangNum) && (ref<0); k++) {
+    if (s_gangActive[k])
+      ref = k;
+  }
+  if (ref < 0)
+    Error("in 'bsl_receive()': all gang devices failed");
+
+  // devices with deviating response failed
+  for (k=0; k<s_gangNum; k++) {
+    if ((s_gangActive[k]) && ((len[k] != len[ref]) || (memcmp(s_gangRx[k], s_gangRx[ref], len[ref])))) {
+      if (s_gangFrame)
+        s_gangFailed[k] = true;
+      else
+        s_gangActive[k] = false;
+    }
+  }
+
+  // return reference response
+  memcpy(Rx, s_gangRx[ref], len[ref]);
+  return(len[ref]);
+
+} // bsl_receive
+
+
+
+/**
+  \fn bool bsl_gangRetry(HANDLE ptrPort, uint64_t addr, uint8_t verbose)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  addr           address of current write frame (for output)
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  \return true if write frame has to be repeated
+
+  check if a gang device failed in the current write frame. As the TX line is shared, a retry
+  broadcasts the frame again and devices which already acknowledged re-write identical data.
+  After GANG_RETRY failed attempts the device is dropped.
+*/
+static bool bsl_gangRetry(HANDLE ptrPort, uint64_t addr, uint8_t verbose) {
+
+  bool  failed = false;
+  int   k;
+
+  // check for failed devices
+  for (k=0; k<s_gangNum; k++)
+    failed |= (s_gangActive[k] && s_gangFailed[k]);
+  if (!failed) {
+    s_gangRetry = 0;
+    return(false);
+  }
+
+  // discard stray responses of failed devices
+  SLEEP(g_timing.flushDelay);
+  bsl_flush(ptrPort);
+
+  // repeat frame
+  if (s_gangRetry < GANG_RETRY) {
+    s_gangRetry++;
+    for (k=0; k<s_gangNum; k++)
+      s_gangFailed[k] = false;
+    return(true);
+  }
+
+  // max. retries exceeded -> drop failed devices
+  for (k=0; k<s_gangNum; k++) {
+    if ((s_gangActive[k]) && (s_gangFailed[k])) {
+      s_gangActive[k] = false;
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("\n  gang device %d dropped at 0x%" PRIx64 "\n", k, addr);
+    }
+    s_gangFailed[k] = false;
+  }
+  s_gangRetry = 0;
+  return(false);
+
+} // bsl_gangRetry
+
+
+
+/**
+  \fn uint8_t bsl_gangSync(HANDLE ptrPort, uint8_t verbose)
+
+  \param[in]  ptrPort        handle to shared TX port
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  \return synchronization status (0=ok, 1=fail)
+
+  synchronize all gang devices via UART. SYNCH is repeated until all devices have responded.
+  Devices already synchronized respond with NACK. Devices w/o response are dropped. Per attempt
+  all devices share a short deadline, i.e. a dead device costs max. syncRetry * GANG_SYNC_TIMEOUT
+  in total, independent of the number of devices.
+*/
+static uint8_t bsl_gangSync(HANDLE ptrPort, uint8_t verbose) {
+
+  bool      synced[GANG_MAX];
+  char      Tx[1], Rx[1];
+  int       k, count, numSynced;
+  uint64_t  deadline;
+
+  // print message
+  if (verbose >= SILENT)
+    printf("  synchronize ... ");
+  fflush(stdout);
+
+  // purge UART input buffers
+  bsl_flush(ptrPort);
+
+  // send SYNCH until all active devices have responded with ACK or NACK
+  Tx[0] = SYNCH;
+  for (k=0; k<s_gangNum; k++)
+    synced[k] = false;
+  numSynced = 0;
+  count = 0;
+  do {
+
+    // send command via shared TX
+    if (send_port(ptrPort, 0, 1, Tx) != 1)
+      Error("in 'bsl_sync()': sending command failed");
+
+    // receive responses until common deadline
+    deadline = millis() + ((g_timing.timeout < GANG_SYNC_TIMEOUT) ? g_timing.timeout : GANG_SYNC_TIMEOUT);
+    for (k=0; k<s_gangNum; k++) {
+      if ((s_gangActive[k]) && (!synced[k]) && (bsl_gangRead(s_gangPort[k], 1, Rx, deadline) == 1) && ((Rx[0] == ACK) || (Rx[0] == NACK))) {
+        synced[k] = true;
+        numSynced++;
+      }
+    }
+
+    // increase retry counter
+    count++;
+
+    // avoid flooding the STM8
+    SLEEP(g_timing.syncDelay);
+
+  } while ((count < (int) g_timing.syncRetry) && (numSynced < bsl_gangStatus(NULL)));
+
+  // drop devices w/o response
+  for (k=0; k<s_gangNum; k++)
+    s_gangActive[k] &= synced[k];
+  if (numSynced == 0)
+    Error("in 'bsl_sync()': no response from BSL");
+
+  // print message
+  if (verbose == SILENT)
+    printf("done\n");
+  else if (verbose > SILENT)
+    printf("done (%d of %d devices)\n", numSynced, s_gangNum);
+  fflush(stdout);
+
+  // purge PC input buffers
+  bsl_flush(ptrPort);
+  SLEEP(g_timing.flushDelay);   // seems to be required for some reason
+
+  // return success
+  return(0);
+
+} // bsl_gangSync
+
+
+
+/**
+  \fn int bsl_resyncFill(const uint8_t *frame, int lenFrame, char *fill, int maxFill)
+
+  \param[in]  frame      read or write frame as sent: command, address, number of bytes (and data, checksum)
+  \param[in]  lenFrame   length of frame [B]
+  \param[out] fill       bytes to send for completing a pending field
+  \param[in]  maxFill    size of fill buffer
+
+  \return number of fill bytes
+
+  construct bytes which complete the field the BSL may still wait for with a checksum error.
+  For each point where the BSL may have stopped receiving the frame, the pending field is
+  tracked, and each fill byte is chosen such that none of these fields gets a valid checksum.
+  A constant fill (e.g. 0xFE) would complete an address field with valid checksum, if only
+  the leading 0x00 was received. Fill bytes are never a command complement, i.e. they can't
+  form a command. A NACK is only guaranteed if the BSL received a prefix of the frame. For
+  bytes corrupted on the line the fill completes a field with valid checksum with ~1/256.
+*/
+static int bsl_resyncFill(const uint8_t *frame, int lenFrame, char *fill, int maxFill) {
+
+  uint8_t   phase[RESYNC_LEN], sum[RESYNC_LEN];   // per stop point: state and checksum of pending field
+  int       left[RESYNC_LEN];                     // per stop point: bytes until checksum
+  int       t, i, k, numOpen;
+  int       v;
+
+  // pending field for each stop point t, i.e. BSL received frame[0..t-1]
+  for (t=0; t<=lenFrame; t++) {
+    phase[t] = FILL_IDLE;
+    sum[t]   = 0;
+    left[t]  = 0;
+
+    // address (4B) + checksum
+    if ((t >= 2) && (t < 7)) {
+      phase[t] = FILL_SUM;
+      for (k=2; k<t; k++)
+        sum[t] ^= frame[k];
+      left[t] = 4 - (t-2);
+    }
+
+    // number of bytes not yet received
+    else if ((t == 7) && (t < lenFrame))
+      phase[t] = (frame[0] == WRITE) ? FILL_LEN_DATA : FILL_LEN_COUNT;
+
+    // write: data + checksum, read: complement of number of bytes
+    else if ((t > 7) && (t < lenFrame)) {
+      phase[t] = FILL_SUM;
+      if (frame[0] == WRITE) {
+        for (k=7; k<t; k++)
+          sum[t] ^= frame[k];
+        left[t] = ((int) frame[7] + 1) - (t-8);
+      }
+      else
+        sum[t] = frame[7] ^ 0xFF;
+    }
+
+  } // loop over stop points
+
+  // construct fill until all pending fields are completed
+  for (i=0; i<maxFill; i++) {
+
+    // all fields completed -> done
+    numOpen = 0;
+    for (t=0; t<=lenFrame; t++)
+      numOpen += (phase[t] != FILL_IDLE);
+    if (numOpen == 0)
+      break;
+
+    // find byte which is no command complement and gives checksum error for all fields expecting a checksum
+    for (v=1; v<256; v++) {
+      if ((v == (GET ^ 0xFF)) || (v == (READ ^ 0xFF)) || (v == (GO ^ 0xFF)) || (v == (WRITE ^ 0xFF)) || (v == (ERASE ^ 0xFF)))
+        continue;
+      for (t=0; t<=lenFrame; t++) {
+        if ((phase[t] == FILL_SUM) && (left[t] == 0) && (sum[t] == v))
+          break;
+      }
+      if (t > lenFrame)
+        break;
+    }
+    fill[i] = (char) v;
+
+    // advance all pending fields
+    for (t=0; t<=lenFrame; t++) {
+      if (phase[t] == FILL_SUM) {
+        if (left[t] == 0)
+          phase[t] = FILL_IDLE;           // checksum error -> NACK
+        else {
+          sum[t] ^= v;
+          left[t]--;
+        }
+      }
+      else if (phase[t] == FILL_LEN_DATA) {
+        phase[t] = FILL_SUM;
+        sum[t]   = v;
+        left[t]  = v + 1;
+      }
+      else if (phase[t] == FILL_LEN_COUNT) {
+        phase[t] = FILL_SUM;
+        sum[t]   = v ^ 0xFF;
+        left[t]  = 0;
+      }
+    } // loop over stop points
+
+  } // loop over fill
+
+  return(i);
+
+} // bsl_resyncFill
+
+
+
+/**
+  \fn bool bsl_recover(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t cmd, uint64_t addr, const uint16_t *data, int lenData, int *numFail)
+
+  \param[in]     ptrPort        handle to communication port
+  \param[in]     physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]     uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]     cmd            command of failed frame (READ or WRITE)
+  \param[in]     addr           address of failed frame
+  \param[in]     data           write data (HB indicates defined), or NULL for READ
+  \param[in]     lenData        number of bytes to read or write
+  \param[in,out] numFail        number of failed attempts of current frame
+
+  \return true if BSL is resynchronized and frame can be repeated
+
+  recover from a failed read/write frame, e.g. due to noise on the line. The BSL may still wait
+  for the rest of an address or data field. Therefore send fill bytes which give a checksum
+  error for the pending field (see bsl_resyncFill()), and discard the NACKs. Then align to the start
+  of a command with single bytes until a NACK is received. Not supported for SPI, gang programming
+  and 2-wire reply mode.
+*/
+static bool bsl_recover(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t cmd, uint64_t addr, const uint16_t *data, int lenData, int *numFail) {
+
+  char      Tx[RESYNC_LEN], Rx[1000];
+  uint8_t   frame[RESYNC_LEN];
+  uint32_t  len, i;
+  int       k, lenFrame, lenFill;
+
+  // check if recovery is possible
+  if ((physInterface != UART) || (s_gangNum > 0) || (uartMode == 2) || (*numFail >= FRAME_RETRY))
+    return(false);
+  (*numFail)++;
+
+  // reconstruct frame as sent
+  frame[0] = cmd;
+  frame[1] = cmd ^ 0xFF;
+  frame[2] = (uint8_t) (addr >> 24);
+  frame[3] = (uint8_t) (addr >> 16);
+  frame[4] = (uint8_t) (addr >> 8);
+  frame[5] = (uint8_t) (addr);
+  frame[6] = frame[2] ^ frame[3] ^ frame[4] ^ frame[5];
+  frame[7] = (uint8_t) (lenData - 1);
+  lenFrame = 8;
+  if (cmd == WRITE) {
+    for (k=0; k<lenData; k++)
+      frame[lenFrame++] = (uint8_t) data[k];
+    frame[lenFrame] = 0;
+    for (k=7; k<lenFrame; k++)
+      frame[lenFrame] ^= frame[k];
+    lenFrame++;
+  }
+  else
+    frame[lenFrame++] = frame[7] ^ 0xFF;
+
+  // complete pending field with checksum error and discard responses
+  lenFill = bsl_resyncFill(frame, lenFrame, Tx, RESYNC_LEN);
+  send_port(ptrPort, uartMode, lenFill, Tx);
+  while (read_port(ptrPort, sizeof(Rx), Rx, RESYNC_POLL) > 0);
+
+  // BSL may hold 1st byte of a command -> send single bytes until NACK
+  for (k=0; k<2; k++) {
+    send_port(ptrPort, uartMode, 1, Tx);
+    len = read_port(ptrPort, sizeof(Rx), Rx, RESYNC_POLL);
+    for (i=0; i<len; i++) {
+      if (Rx[i] == NACK) {
+        bsl_flush(ptrPort);
+        return(true);
+      }
+    }
+  }
+
+  // BSL doesn't respond
+  return(false);
+
+} // bsl_recover
+
+
+
+/**
+  \fn bool bsl_pipeSafe(const char *tail, int len)
+
+  \param[in] tail   frame parts sent together with the command
+  \param[in] len    number of bytes in tail
+
+  \return true if the tail may be sent w/o waiting for the command ACK
+
+  check if bytes sent ahead of an ACK are harmless if the BSL NACKs the command or
+  address, e.g. for a read-protected device or an address beyond the memory. The BSL
+  then interprets the remaining bytes as new commands. Therefore a tail must not contain
+  a command byte followed by its complement for WRITE, ERASE or GO at any position.
+*/
+bool bsl_pipeSafe(const char *tail, int len) {
+
+  int      i;
+  uint8_t  cmd;
+
+  for (i=0; i<len-1; i++) {
+    cmd = (uint8_t) tail[i];
+    if (((cmd == WRITE) || (cmd == ERASE) || (cmd == GO)) && ((uint8_t) tail[i+1] == (uint8_t) (cmd ^ 0xFF)))
+      return(false);
+  }
+  return(true);
+
+} // bsl_pipeSafe
+
 
 
 /**
@@ -37,6 +646,17 @@ uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose) {
   int   lenTx, lenRx, len;
   char  Tx[1000], Rx[1000];
 
+  // gang programming via shared TX line
+  if ((s_gangNum > 0) && (physInterface == UART)) {
+    uint8_t  result;
+
+    log_event("sync", LOG_START, 0, 0, 0, 0);
+    result = bsl_gangSync(ptrPort, verbose);
+    log_event("sync", LOG_END, 0, 0, 0, 0);
+    return(result);
+  }
+  log_event("sync", LOG_START, 0, 0, 0, 0);
+
   // print message
   if (verbose >= SILENT)
     printf("  synchronize ... ");
@@ -52,7 +672,7 @@ uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose) {
 
   // purge UART input buffer
   if (physInterface == UART)
-    flush_port(ptrPort);
+    bsl_flush(ptrPort);
 
 
   // construct SYNC command. Note: SYNC has even parity -> works in all UART modes
@@ -93,9 +713,9 @@ uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose) {
     count++;
 
     // avoid flooding the STM8
-    SLEEP(10);
+    SLEEP(g_timing.syncDelay);
 
-  } while ((count<50) && ((len!=lenRx) || ((Rx[0]!=ACK) && (Rx[0]!=NACK))));
+  } while ((count<(int) g_timing.syncRetry) && ((len!=lenRx) || ((Rx[0]!=ACK) && (Rx[0]!=NACK))));
 
   // check if ok
   if ((len==lenRx) && (Rx[0]==ACK)) {
@@ -115,10 +735,11 @@ uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose) {
   else
     Error("in 'bsl_sync()': no response from BSL");
   fflush(stdout);
+  log_event("sync", LOG_END, 0, 0, 0, count-1);
 
   // purge PC input buffer
-  flush_port(ptrPort);
-  SLEEP(50);              // seems to be required for some reason
+  bsl_flush(ptrPort);
+  SLEEP(g_timing.flushDelay);   // seems to be required for some reason
 
   // return success
   return(0);
@@ -150,7 +771,7 @@ uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose) {
   fflush(stdout);
 
   // reduce timeout for faster check
-  set_timeout(ptrPort, 100);
+  bsl_timeout(ptrPort, 100);
 
   // detect UART mode
   set_parity(ptrPort, 2);
@@ -160,7 +781,7 @@ uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose) {
     len = send_port(ptrPort, 0, lenTx, Tx);
     len = receive_port(ptrPort, 0, lenRx, Rx);
     //printf("\nmode 1: %d  0x%02x\n", len, (uint8_t) (Rx[0]));
-    SLEEP(10);
+    SLEEP(g_timing.syncDelay);
   } while (len==0);
 
   // tested empirically...
@@ -180,11 +801,11 @@ uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose) {
     Error("in 'bsl_getUartMode()': cannot determine UART mode");
 
   // revert timeout
-  set_timeout(ptrPort, TIMEOUT);
+  bsl_timeout(ptrPort, g_timing.timeout);
 
   // purge PC input buffer
-  flush_port(ptrPort);
-  SLEEP(50);              // seems to be required for some reason
+  bsl_flush(ptrPort);
+  SLEEP(g_timing.flushDelay);   // seems to be required for some reason
 
   // print message
   if (verbose == CHATTY) {
@@ -241,8 +862,8 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
 
 
   // purge input buffer
-  flush_port(ptrPort);
-  SLEEP(50);              // seems to be required for some reason
+  bsl_flush(ptrPort);
+  SLEEP(g_timing.flushDelay);   // seems to be required for some reason
 
 
   /////////
@@ -251,7 +872,7 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
 
   // reduce timeout for faster check
   if (physInterface == UART) {
-    set_timeout(ptrPort, 200);
+    bsl_timeout(ptrPort, 200);
   }
 
   // check address of EEPROM. STM8L starts at 0x1000, STM8S starts at 0x4000
@@ -288,9 +909,15 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
     printf("flash size: %d\n", (int) (*flashsize));
   #endif
 
+  // EEPROM layout is only resolved if EEPROM is written, see bsl_eepromLayout()
+  s_family      = *family;
+  s_flashsize   = *flashsize;
+  s_eepromKnown = false;
+  memset(&s_eeprom, 0, sizeof(s_eeprom));
+
   // restore timeout to avoid timeouts during flash operation
   if (physInterface == UART) {
-    set_timeout(ptrPort, TIMEOUT);
+    bsl_timeout(ptrPort, g_timing.timeout);
   }
 
 
@@ -318,7 +945,7 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
@@ -388,6 +1015,86 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
 
 
 
+/**
+  \fn void bsl_eepromLayout(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  addrStart      first address of write range
+  \param[in]  addrStop       last address of write range
+
+  resolve data EEPROM layout of the device identified by bsl_getInfo() from the device table, if
+  the address range may contain EEPROM of this family. The density classes of bsl_getInfo() contain
+  several flash sizes with different EEPROM sizes, which requires one more READ. This is done once
+  per device and only for EEPROM writes, i.e. other sessions have no extra round-trip.
+*/
+static void bsl_eepromLayout(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop) {
+
+  uint64_t  start = UINT64_MAX, stop = 0;
+  int       i, flashActual;
+
+  // already resolved
+  if (s_eepromKnown)
+    return;
+
+  // skip if range can't contain EEPROM of this family
+  for (i=0; i<(int) (sizeof(s_deviceTable)/sizeof(s_deviceTable[0])); i++) {
+    if (s_deviceTable[i].family != s_family)
+      continue;
+    if (s_deviceTable[i].eeprom.start < start)
+      start = s_deviceTable[i].eeprom.start;
+    if (s_deviceTable[i].eeprom.stop > stop)
+      stop = s_deviceTable[i].eeprom.stop;
+  }
+  if ((addrStart > stop) || (addrStop < start))
+    return;
+
+  // density classes contain several flash sizes -> check actual size. Reduce timeout for faster check
+  if (physInterface == UART)
+    bsl_timeout(ptrPort, 200);
+  flashActual = s_flashsize;
+  if ((s_flashsize == 32) && (bsl_memCheck(ptrPort, physInterface, uartMode, 0x017FFF, SILENT)))
+    flashActual = 64;
+  else if ((s_flashsize == 8) && (bsl_memCheck(ptrPort, physInterface, uartMode, 0x00BFFF, SILENT)))
+    flashActual = 16;
+  if (physInterface == UART)
+    bsl_timeout(ptrPort, g_timing.timeout);
+
+  // get data EEPROM layout from device table. Unknown device -> no EEPROM optimizations
+  memset(&s_eeprom, 0, sizeof(s_eeprom));
+  for (i=0; i<(int) (sizeof(s_deviceTable)/sizeof(s_deviceTable[0])); i++) {
+    if ((s_deviceTable[i].family == s_family) && (s_deviceTable[i].flashsize == flashActual))
+      s_eeprom = s_deviceTable[i].eeprom;
+  }
+  s_eepromKnown = true;
+
+} // bsl_eepromLayout
+
+
+
+/**
+  \fn void bsl_getEeprom(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, eepromLayout_t *eeprom)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  addrStart      first address of write range
+  \param[in]  addrStop       last address of write range
+  \param[out] eeprom         data EEPROM layout of device (block=0: unknown or not in range)
+
+  get data EEPROM layout of the device identified by the last call of bsl_getInfo(),
+  e.g. to keep it per session for asynchronous operations. See bsl_eepromLayout().
+*/
+void bsl_getEeprom(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, eepromLayout_t *eeprom) {
+
+  bsl_eepromLayout(ptrPort, physInterface, uartMode, addrStart, addrStop);
+  *eeprom = s_eeprom;
+
+} // bsl_getEeprom
+
+
+
 /**
   \fn uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, uint16_t *imageBuf, uint8_t verbose)
 
@@ -408,6 +1115,10 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
   int       i, lenTx, lenRx, len;
   char      Tx[1000], Rx[1000];
   uint64_t  addr, addrStep, numBytes, countBytes;
+  int       numFail = 0;          // failed attempts of current frame
+  bool      pipelined;            // send complete frame w/o waiting for ACKs (network port)
+  bool      pipeFrame;            // current frame is pipelined
+  uint32_t  numRetry = 0;         // total number of repeated frames
 
   // get number of bytes to read
   numBytes = addrStop - addrStart + 1;
@@ -415,23 +1126,23 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
   // print message
   if (verbose == SILENT) {
     if (numBytes > 1024)
-      printf("  read %1.1fkB ", (float) numBytes/1024.0);
+      log_printf("  read %1.1fkB ", (float) numBytes/1024.0);
     else
-      printf("  read %dB ", (int) numBytes);
+      log_printf("  read %dB ", (int) numBytes);
   }
   else if (verbose == INFORM) {
     if (numBytes > 1024)
-      printf("  read %1.1fkB ", (float) numBytes/1024.0);
+      log_printf("  read %1.1fkB ", (float) numBytes/1024.0);
     else
-      printf("  read %dB ", (int) numBytes);
+      log_printf("  read %dB ", (int) numBytes);
   }
   else if (verbose == CHATTY) {
     if (numBytes > 1024)
-      printf("  read %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (float) numBytes/1024.0, addrStart, addrStop);
+      log_printf("  read %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (float) numBytes/1024.0, addrStart, addrStop);
     else
-      printf("  read %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (int) numBytes, addrStart, addrStop);
+      log_printf("  read %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (int) numBytes, addrStart, addrStop);
   }
-  fflush(stdout);
+  log_event("read", LOG_START, 0, numBytes, addrStart, 0);
 
   // simple checks of scan window
   if (addrStart > addrStop)
@@ -453,15 +1164,20 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
   for (i=addrStart; i<=addrStop; i++)
     imageBuf[i] = 0;
 
+  // for network port with "?pipe" send each frame in one segment to save round-trips. Not for 1-wire (echo) or reply mode
+  pipelined = (physInterface == UART) && (uartMode == 0) && (s_gangNum == 0) && (net_pipelined(ptrPort));
+
 
   // loop over addresses in <=256B steps
   countBytes = 0;
   addrStep = 256;
+  fault_arm(true);
   for (addr=addrStart; addr<=addrStop; addr+=addrStep) {
 
     // if addr too close to end of range reduce stepsize
     if (addr+256 > addrStop)
       addrStep = addrStop - addr + 1;
+    fault_frame_begin();
 
 
     /////
@@ -474,6 +1190,22 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
     Tx[1] = (Tx[0] ^ 0xFF);
     lenRx = 1;
 
+    // pipelined: append address and number of bytes, ACKs are received one after another below.
+    // Only if the appended bytes can't be mistaken for a modifying command after a NACK
+    pipeFrame = false;
+    if (pipelined) {
+      Tx[2] = (char) (addr >> 24);
+      Tx[3] = (char) (addr >> 16);
+      Tx[4] = (char) (addr >> 8);
+      Tx[5] = (char) (addr);
+      Tx[6] = (Tx[2] ^ Tx[3] ^ Tx[4] ^ Tx[5]);
+      Tx[7] = addrStep-1;
+      Tx[8] = (Tx[7] ^ 0xFF);
+      pipeFrame = bsl_pipeSafe(Tx+2, 7);
+      if (pipeFrame)
+        lenTx = 9;
+    }
+
     // send command
     if (physInterface == UART)
       len = send_port(ptrPort, uartMode, lenTx, Tx);
@@ -488,19 +1220,23 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
 
     // receive response
     if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
+      len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
     else if (physInterface == SPI_ARDUINO)
       len = receive_spi_Arduino(ptrPort, lenRx, Rx);
     #if defined(USE_SPIDEV)
       else if (physInterface == SPI_SPIDEV)
         len = receive_spi_spidev(ptrPort, lenRx, Rx);
     #endif
-    if (len != lenRx)
-      Error("in 'bsl_memRead()': ACK1 timeout");
-
-    // check acknowledge
-    if (Rx[0]!=ACK)
+    if ((len != lenRx) || (Rx[0] != ACK)) {
+      if (bsl_recover(ptrPort, physInterface, uartMode, READ, addr, NULL, addrStep, &numFail)) {
+        addr -= addrStep;
+        numRetry++;
+        continue;
+      }
+      if (len != lenRx)
+        Error("in 'bsl_memRead()': ACK1 timeout");
       Error("in 'bsl_memRead()': ACK1 failure (expect 0x%02x, received 0x%02x)", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    }
 
 
     /////
@@ -516,8 +1252,10 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
     Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
     lenRx = 1;
 
-    // send command
-    if (physInterface == UART)
+    // send command. Pipelined frame was already sent with command
+    if (pipeFrame)
+      len = lenTx;
+    else if (physInterface == UART)
       len = send_port(ptrPort, uartMode, lenTx, Tx);
     else if (physInterface == SPI_ARDUINO)
       len = send_spi_Arduino(ptrPort, lenTx, Tx);
@@ -530,19 +1268,23 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
 
     // receive response
     if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
+      len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
     else if (physInterface == SPI_ARDUINO)
       len = receive_spi_Arduino(ptrPort, lenRx, Rx);
     #if defined(USE_SPIDEV)
       else if (physInterface == SPI_SPIDEV)
         len = receive_spi_spidev(ptrPort, lenRx, Rx);
     #endif
-    if (len != lenRx)
-      Error("in 'bsl_memRead()': ACK2 timeout (expect %d, received %d)", lenRx, len);
-
-    // check acknowledge
-    if (Rx[0]!=ACK)
+    if ((len != lenRx) || (Rx[0] != ACK)) {
+      if (bsl_recover(ptrPort, physInterface, uartMode, READ, addr, NULL, addrStep, &numFail)) {
+        addr -= addrStep;
+        numRetry++;
+        continue;
+      }
+      if (len != lenRx)
+        Error("in 'bsl_memRead()': ACK2 timeout (expect %d, received %d)", lenRx, len);
       Error("in 'bsl_memRead()': ACK2 failure (expect 0x%02x, received 0x%02x)", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    }
 
 
     /////
@@ -555,8 +1297,10 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
     Tx[1] = (Tx[0] ^ 0xFF);
     lenRx = addrStep + 1;
 
-    // send command
-    if (physInterface == UART)
+    // send command. Pipelined frame was already sent with command
+    if (pipeFrame)
+      len = lenTx;
+    else if (physInterface == UART)
       len = send_port(ptrPort, uartMode, lenTx, Tx);
     else if (physInterface == SPI_ARDUINO)
       len = send_spi_Arduino(ptrPort, lenTx, Tx);
@@ -570,7 +1314,7 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
 
     // receive response
     if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
+      len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
     else if (physInterface == SPI_ARDUINO)
       len = receive_spi_Arduino(ptrPort, lenRx, Rx);
     #if defined(USE_SPIDEV)
@@ -579,12 +1323,16 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
         //printf("0x%02x  0x%02x  0x%02x\n", (uint8_t) (Rx[0]), (uint8_t) (Rx[1]), (uint8_t) (Rx[2])); fflush(stdout); getchar();
       }
     #endif
-    if (len != lenRx)
-      Error("in 'bsl_memRead()': data timeout (expect %d, received %d)", lenRx, len);
-
-    // check acknowledge
-    if (Rx[0]!=ACK)
+    if ((len != lenRx) || (Rx[0] != ACK)) {
+      if (bsl_recover(ptrPort, physInterface, uartMode, READ, addr, NULL, addrStep, &numFail)) {
+        addr -= addrStep;
+        numRetry++;
+        continue;
+      }
+      if (len != lenRx)
+        Error("in 'bsl_memRead()': data timeout (expect %d, received %d)", lenRx, len);
       Error("in 'bsl_memRead()': ACK3 failure (expect 0x%02x, received 0x%02x)", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    }
 
     // copy data to buffer. Set HB to indicate data read
     for (i=1; i<lenRx; i++) {
@@ -592,48 +1340,50 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uin
       //printf("%d 0x%02x\n", i, (uint8_t) (Rx[i])); fflush(stdout); getchar();
       countBytes++;
     }
-
-    // print progress
-    if ((countBytes % 1024) == 0) {
-      if (verbose == SILENT) {
-        printf(".");
-        if ((countBytes % (10*1024)) == 0)
-          printf(" ");
-      }
-      else if (verbose == INFORM) {
-        if (numBytes > 1024)
-          printf("%c  read %1.1fkB / %1.1fkB ", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0);
-        else
-          printf("%c  read %dB / %dB ", '\r', (int) countBytes, (int) numBytes);
-      }
-      else if (verbose == CHATTY) {
-        if (numBytes > 1024)
-          printf("%c  read %1.1fkB / %1.1fkB from 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0, addrStart, addrStop);
-        else
-          printf("%c  read %dB / %dB from 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (int) countBytes, (int) numBytes, addrStart, addrStop);
-      }
-      fflush(stdout);
+    numFail = 0;
+    fault_frame_end();
+
+    // print progress. Dots per kB, progress line rate limited by time
+    if ((verbose == SILENT) && ((countBytes % 1024) == 0)) {
+      log_printf(".");
+      if ((countBytes % (10*1024)) == 0)
+        log_printf(" ");
     }
+    else if (verbose == INFORM) {
+      if (numBytes > 1024)
+        log_progress("%c  read %1.1fkB / %1.1fkB ", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0);
+      else
+        log_progress("%c  read %dB / %dB ", '\r', (int) countBytes, (int) numBytes);
+    }
+    else if (verbose == CHATTY) {
+      if (numBytes > 1024)
+        log_progress("%c  read %1.1fkB / %1.1fkB from 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0, addrStart, addrStop);
+      else
+        log_progress("%c  read %dB / %dB from 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (int) countBytes, (int) numBytes, addrStart, addrStop);
+    }
+    log_event("read", LOG_PROGRESS, countBytes, numBytes, addr, numRetry);
 
   } // loop over address range
+  fault_arm(false);
 
 
   // print message
   if (verbose == SILENT)
-    printf(" done\n");
+    log_printf(" done\n");
   else if (verbose == INFORM) {
     if (numBytes > 1024)
-      printf("%c  read %1.1fkB / %1.1fkB ... done   \n", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0);
+      log_printf("%c  read %1.1fkB / %1.1fkB ... done   \n", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0);
     else
-      printf("%c  read %dB / %dB ... done   \n", '\r', (int) countBytes, (int) numBytes);
+      log_printf("%c  read %dB / %dB ... done   \n", '\r', (int) countBytes, (int) numBytes);
   }
   else if (verbose == CHATTY) {
     if (numBytes > 1024)
-      printf("%c  read %1.1fkB / %1.1fkB from 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0, addrStart, addrStop);
+      log_printf("%c  read %1.1fkB / %1.1fkB from 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (float) countBytes/1024.0, (float) numBytes/1024.0, addrStart, addrStop);
     else
-      printf("%c  read %dB / %dB from 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (int) countBytes, (int) numBytes, addrStart, addrStop);
+      log_printf("%c  read %dB / %dB from 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (int) countBytes, (int) numBytes, addrStart, addrStop);
   }
-  fflush(stdout);
+  log_flush();        // keep order with following direct output
+  log_event("read", LOG_END, countBytes, numBytes, addrStop, numRetry);
 
   // avoid compiler warnings
   return(0);
@@ -695,7 +1445,7 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
@@ -737,7 +1487,7 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
@@ -777,7 +1527,7 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
@@ -838,6 +1588,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
       printf("  erase flash sector %d @ 0x%" PRIx64 " ... ", (int) sector, addr);
   }
   fflush(stdout);
+  log_event("erase", LOG_START, 0, PFLASH_BLOCKSIZE, addr, 0);
 
 
 
@@ -878,7 +1629,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
@@ -898,7 +1649,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
   /////
 
   // increase timeout for long erase
-  set_timeout(ptrPort, 1200);
+  bsl_timeout(ptrPort, 1200);
 
   // construct pattern
   lenTx = 3;
@@ -925,7 +1676,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO) {
     SLEEP(40);                              // wait >30ms*(N=0+1) for sector erase before requesting response (see UM0560, SPI timing)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
@@ -947,7 +1698,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
   tStop = millis();
 
   // restore timeout
-  set_timeout(ptrPort, TIMEOUT);
+  bsl_timeout(ptrPort, g_timing.timeout);
 
 
   // print message
@@ -958,6 +1709,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
     printf("done, time %dms\n", (int)(tStop-tStart));
   }
   fflush(stdout);
+  log_event("erase", LOG_END, PFLASH_BLOCKSIZE, PFLASH_BLOCKSIZE, addr, 0);
 
   // avoid compiler warnings
   return(0);
@@ -992,6 +1744,7 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
     printf("  flash mass erase ... ");
   }
   fflush(stdout);
+  log_event("erase", LOG_START, 0, 0, PFLASH_START, 0);
 
 
   // init receive buffer
@@ -1027,7 +1780,7 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
@@ -1047,7 +1800,7 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
   /////
 
   // increase timeout for long erase. Measured 3.3s for 128kB STM8 -> set to 4s
-  set_timeout(ptrPort, 4000);
+  bsl_timeout(ptrPort, 4000);
 
   // construct pattern
   lenTx = 2;
@@ -1073,7 +1826,7 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO) {
     SLEEP(1100);                              // wait >30ms*(N=32+1) for sector erase before requesting response (see UM0560, SPI timing)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
@@ -1095,7 +1848,7 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
   tStop = millis();
 
   // restore timeout
-  set_timeout(ptrPort, TIMEOUT);
+  bsl_timeout(ptrPort, g_timing.timeout);
 
 
   // print message
@@ -1106,6 +1859,7 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
     printf("done, time %1.1fs\n", (float)(tStop-tStart)/1000.0);
   }
   fflush(stdout);
+  log_event("erase", LOG_END, 0, 0, PFLASH_START, 0);
 
   // avoid compiler warnings
   return(0);
@@ -1114,54 +1868,200 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
 
 
 
+/**
+  \fn int bsl_planEeprom(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint64_t *addrStart, uint64_t *addrStop, int *numBlocks)
+
+  \param[in]     ptrPort        handle to communication port
+  \param[in]     physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]     uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in,out] imageBuf       memory image of data to write (16-bit array. HB!=0 indicates content)
+  \param[in,out] addrStart      first address to write to, is aligned to block start if required
+  \param[in,out] addrStop       last address to write to, is aligned to block end if required
+  \param[out]    numBlocks      number of EEPROM blocks containing data
+
+  \return number of EEPROM blocks to write
+
+  plan write of data EEPROM. The EEPROM range of the image is read in one pass and compared.
+  Unchanged blocks are removed from the image, and changed blocks are padded with the current
+  content. Each changed block is then programmed in one block operation (~6ms) instead of
+  byte-wise (~6ms per byte). Not used for gang programming, as the content may differ between devices.
+*/
+static int bsl_planEeprom(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint64_t *addrStart, uint64_t *addrStop, int *numBlocks) {
+
+  uint16_t         *tmpBuf;                            // current EEPROM content
+  uint64_t         addr, addrBlock, start, stop, numData;
+  bool             changed;
+  int              numChanged = 0;
+
+  // EEPROM unknown or not in address range
+  *numBlocks = 0;
+  if ((s_eeprom.block == 0) || (*addrStart > s_eeprom.stop) || (*addrStop < s_eeprom.start))
+    return(0);
+
+  // get EEPROM data in image
+  start = (*addrStart < s_eeprom.start) ? s_eeprom.start : *addrStart;
+  stop  = (*addrStop  > s_eeprom.stop)  ? s_eeprom.stop  : *addrStop;
+  get_image_size(imageBuf, start, stop, &start, &stop, &numData);
+  if (numData == 0)
+    return(0);
+
+  // read all affected blocks in one pass
+  start -= (start - s_eeprom.start) % s_eeprom.block;
+  stop  += s_eeprom.block - 1 - ((stop - s_eeprom.start) % s_eeprom.block);
+  if (!(tmpBuf = calloc(stop+1, sizeof(*tmpBuf))))
+    Error("in 'bsl_planEeprom()': cannot allocate buffer");
+  bsl_memRead(ptrPort, physInterface, uartMode, start, stop, tmpBuf, MUTE);
+
+  // compare blocks. Remove unchanged blocks, pad changed blocks
+  for (addrBlock=start; addrBlock<=stop; addrBlock+=s_eeprom.block) {
+    changed = false;
+    numData = 0;
+    for (addr=addrBlock; addr<addrBlock+s_eeprom.block; addr++) {
+      if (imageBuf[addr] & 0xFF00) {
+        numData++;
+        changed |= (((imageBuf[addr] ^ tmpBuf[addr]) & 0xFF) != 0);
+      }
+    }
+    if (numData == 0)
+      continue;
+    (*numBlocks)++;
+    for (addr=addrBlock; addr<addrBlock+s_eeprom.block; addr++) {
+      if (!changed)
+        imageBuf[addr] = 0x0000;
+      else if (!(imageBuf[addr] & 0xFF00))
+        imageBuf[addr] = tmpBuf[addr] | 0xFF00;
+    }
+    if (changed)
+      numChanged++;
+  }
+  free(tmpBuf);
+
+  // extend address range to complete blocks
+  if (start < *addrStart)
+    *addrStart = start;
+  if (stop > *addrStop)
+    *addrStop = stop;
+
+  return(numChanged);
+
+} // bsl_planEeprom
+
+
+
+/**
+  \fn uint32_t bsl_progTime(const eepromLayout_t *eeprom, uint64_t addr, int len)
+
+  \param[in]  eeprom         data EEPROM layout of device
+  \param[in]  addr           start address of WRITE
+  \param[in]  len            number of bytes in WRITE
+
+  \return max. programming time incl. margin [ms]
+
+  estimate time the BSL requires for programming a WRITE, before it responds. Complete and aligned
+  flash or EEPROM blocks use fast block mode, partial blocks and option bytes are programmed byte-wise.
+  RAM is immediate.
+*/
+uint32_t bsl_progTime(const eepromLayout_t *eeprom, uint64_t addr, int len) {
+
+  uint64_t  blockSize;
+
+  // option bytes are always programmed byte-wise
+  if ((addr >= OPT_START) && (addr <= OPT_STOP))
+    return(TPROG_BLOCK + len * TPROG_BYTE);
+
+  // get block size of memory
+  if (addr >= PFLASH_START)
+    blockSize = WRITE_BLOCKSIZE;
+  else if ((eeprom->block != 0) && (addr >= eeprom->start) && (addr <= eeprom->stop))
+    blockSize = eeprom->block;
+  else
+    return(0);
+
+  // complete aligned block -> fast block mode
+  if (((addr % blockSize) == 0) && (len == (int) blockSize))
+    return(TPROG_BLOCK);
+
+  // partial block in flash not aligned to block (see UM0560, SPI timing)
+  if ((addr >= PFLASH_START) && (addr % blockSize))
+    return(TPROG_UNALIGNED);
+
+  // partial block -> byte-wise
+  return(TPROG_BLOCK + len * TPROG_BYTE);
+
+} // bsl_progTime
+
+
+
 /**
   \fn uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose)
 
   \param[in]  ptrPort        handle to communication port
   \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
   \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
-  \param[out] imageBuf       memory image of data to write (16-bit array. HB!=0 indicates content)
+  \param[in]  imageBuf       memory image of data to write (16-bit array. HB!=0 indicates content)
   \param[in]  addrStart      first address to write to
   \param[in]  addrStop       last address to write to
   \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
 
   \return communication status (0=ok, 1=fail)
 
-  upload data to microcontroller memory via WRITE command
+  upload data to microcontroller memory via WRITE command. EEPROM comparison is applied
+  to a private copy, i.e. imageBuf is not changed.
 */
 uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose) {
 
   uint64_t         numData, countBytes, countBlock;    // size of memory image
+  uint32_t         numRetry = 0;                       // total number of repeated frames
+  int              numFail = 0;                        // failed attempts of current frame
   const uint64_t   maxBlock = 128;                      // max. length of write block
   char             Tx[1000], Rx[1000];                  // communication buffers
   int              lenTx, lenRx, len;                   // frame lengths
   uint8_t          chk;                                 // frame checksum
-  int              i, j;
-
+  int              i, j, numEeprom = 0, numEepromChanged = 0;
+  uint64_t         blockSize;                           // block size of memory (flash or EEPROM)
+  uint32_t         tProg;                               // max. programming time of block [ms]
+  uint16_t         *writeBuf = imageBuf;                // image to write. Private copy if EEPROM is compared
+
+
+  // get EEPROM layout on first EEPROM write
+  bsl_eepromLayout(ptrPort, physInterface, uartMode, addrStart, addrStop);
+
+  // compare data EEPROM and pad changed EEPROM blocks with current content for block write.
+  // Work on a private copy (incl. space for padding the last block) to keep the caller's image
+  if (s_gangNum == 0) {
+    if (!(writeBuf = calloc(addrStop + WRITE_BLOCKSIZE + 1, sizeof(*writeBuf))))
+      Error("in 'bsl_memWrite()': cannot allocate buffer");
+    memcpy(writeBuf+addrStart, imageBuf+addrStart, (addrStop-addrStart+1)*sizeof(*writeBuf));
+    numEepromChanged = bsl_planEeprom(ptrPort, physInterface, uartMode, writeBuf, &addrStart, &addrStop, &numEeprom);
+  }
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    if (numEeprom > 0)
+      log_printf("  compare EEPROM ... done (%d of %d blocks changed)\n", numEepromChanged, numEeprom);
+  }
 
   // update min/max addresses and number of bytes to write (HB!=0x00) for printout
-  get_image_size(imageBuf, addrStart, addrStop, &addrStart, &addrStop, &numData);
+  get_image_size(writeBuf, addrStart, addrStop, &addrStart, &addrStop, &numData);
 
   // print message
   if (verbose == SILENT) {
     if (numData > 1024)
-      printf("  write %1.1fkB ", (float) numData/1024.0);
+      log_printf("  write %1.1fkB ", (float) numData/1024.0);
     else
-      printf("  write %dB ", (int) numData);
+      log_printf("  write %dB ", (int) numData);
   }
   else if (verbose == INFORM) {
     if (numData > 1024)
-      printf("  write %1.1fkB ", (float) numData/1024.0);
+      log_printf("  write %1.1fkB ", (float) numData/1024.0);
     else
-      printf("  write %dB ", (int) numData);
+      log_printf("  write %dB ", (int) numData);
   }
   else if (verbose == CHATTY) {
     if (numData > 1024)
-      printf("  write %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (float) numData/1024.0, addrStart, addrStop);
+      log_printf("  write %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (float) numData/1024.0, addrStart, addrStop);
     else
-      printf("  write %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (int) numData, addrStart, addrStop);
+      log_printf("  write %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ", (int) numData, addrStart, addrStop);
   }
-  fflush(stdout);
+  log_event("write", LOG_START, 0, numData, addrStart, 0);
 
   // init receive buffer
   for (i=0; i<1000; i++)
@@ -1171,16 +2071,20 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
   if (!ptrPort)
     Error("in 'bsl_memWrite()': port not open");
 
+  // WRITE is never pipelined via network port ("?pipe"), because after a NACK the BSL would
+  // interpret address or data as new commands
 
   // loop over specified address range
   // Write only defined bytes (HB!=0x00) and align to 128 to minimize write time (see UM0560 section 3.4)
   countBytes = 0;
   countBlock = 0;
+  s_gangFrame = true;
+  fault_arm(true);
   uint64_t addr = addrStart;
   while (addr <= addrStop) {
 
     // find next data byte (=start address of next block)
-    while (((imageBuf[addr] & 0xFF00) == 0) && (addr <= addrStop))
+    while (((writeBuf[addr] & 0xFF00) == 0) && (addr <= addrStop))
       addr++;
     uint64_t addrBlock = addr;
 
@@ -1188,11 +2092,16 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
     if (addr > addrStop)
       break;
 
-    // set length of next data block: max 128B and align with 128 for speed (see UM0560 section 3.4)
+    // set length of next data block: max 128B and align with flash/EEPROM block for speed (see UM0560 section 3.4)
+    blockSize = maxBlock;
+    if ((s_eeprom.block != 0) && (addr >= s_eeprom.start) && (addr <= s_eeprom.stop))
+      blockSize = s_eeprom.block;
     int lenBlock = 1;
-    while ((lenBlock < maxBlock) && ((addr+lenBlock) <= addrStop) && (imageBuf[addr+lenBlock] & 0xFF00) && ((addr+lenBlock) % maxBlock)) {
+    while ((lenBlock < blockSize) && ((addr+lenBlock) <= addrStop) && (writeBuf[addr+lenBlock] & 0xFF00) && ((addr+lenBlock) % blockSize)) {
       lenBlock++;
     }
+    tProg = bsl_progTime(&s_eeprom, addrBlock, lenBlock);
+    fault_frame_begin();
     //printf("0x%04x   0x%04x   %d\n", addrBlock, addrBlock+lenBlock-1, lenBlock);
 
     /////
@@ -1219,19 +2128,22 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
 
     // receive response
     if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
+      len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
     else if (physInterface == SPI_ARDUINO)
       len = receive_spi_Arduino(ptrPort, lenRx, Rx);
     #if defined(USE_SPIDEV)
       else if (physInterface == SPI_SPIDEV)
         len = receive_spi_spidev(ptrPort, lenRx, Rx);
     #endif
-    if (len != lenRx)
-      Error("in 'bsl_memWrite()': ACK1 timeout (expect %d, received %d)", lenRx, len);
-
-    // check acknowledge
-    if (Rx[0]!=ACK)
+    if ((len != lenRx) || (Rx[0] != ACK)) {
+      if (bsl_recover(ptrPort, physInterface, uartMode, WRITE, addrBlock, writeBuf+addrBlock, lenBlock, &numFail)) {
+        numRetry++;
+        continue;
+      }
+      if (len != lenRx)
+        Error("in 'bsl_memWrite()': ACK1 timeout (expect %d, received %d)", lenRx, len);
       Error("in 'bsl_memWrite()': ACK1 failure (expect 0x%02x, received 0x%02x)", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    }
 
 
     /////
@@ -1262,19 +2174,22 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
 
     // receive response
     if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
+      len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
     else if (physInterface == SPI_ARDUINO)
       len = receive_spi_Arduino(ptrPort, lenRx, Rx);
     #if defined(USE_SPIDEV)
       else if (physInterface == SPI_SPIDEV)
         len = receive_spi_spidev(ptrPort, lenRx, Rx);
     #endif
-    if (len != lenRx)
-      Error("in 'bsl_memWrite()': ACK2 timeout (expect %d, received %d)", lenRx, len);
-
-    // check acknowledge
-    if (Rx[0]!=ACK)
+    if ((len != lenRx) || (Rx[0] != ACK)) {
+      if (bsl_recover(ptrPort, physInterface, uartMode, WRITE, addrBlock, writeBuf+addrBlock, lenBlock, &numFail)) {
+        numRetry++;
+        continue;
+      }
+      if (len != lenRx)
+        Error("in 'bsl_memWrite()': ACK2 timeout (expect %d, received %d)", lenRx, len);
       Error("in 'bsl_memWrite()': ACK2 failure (expect 0x%02x, received 0x%02x)", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    }
 
 
     /////
@@ -1286,7 +2201,7 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
     Tx[lenTx++] = lenBlock-1;     // -1 from BSL
     chk         = lenBlock-1;
     for (j=0; j<lenBlock; j++) {
-      Tx[lenTx] = (uint8_t) (imageBuf[addrBlock+j] & 0x00FF);  // only LB, HB indicates "defined"
+      Tx[lenTx] = (uint8_t) (writeBuf[addrBlock+j] & 0x00FF);  // only LB, HB indicates "defined"
       chk ^= Tx[lenTx];
       lenTx++;
       countBytes++;
@@ -1295,7 +2210,7 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
     lenRx = 1;
 
 
-    // send command
+    // send data
     if (physInterface == UART)
       len = send_port(ptrPort, uartMode, lenTx, Tx);
     else if (physInterface == SPI_ARDUINO)
@@ -1308,74 +2223,92 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
       Error("in 'bsl_memWrite()': sending data failed (expect %d, sent %d)", lenTx, len);
 
 
-    // receive response
-    if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    // receive response. For long programming time extend UART timeout temporarily
+    if (physInterface == UART) {
+      if (tProg + 100 > g_timing.timeout)
+        bsl_timeout(ptrPort, g_timing.timeout + tProg);
+      len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
+      if (tProg + 100 > g_timing.timeout)
+        bsl_timeout(ptrPort, g_timing.timeout);
+    }
     else if (physInterface == SPI_ARDUINO) {
-      if ((addrBlock >= PFLASH_START) && (addrBlock % 128))  // wait for flash write finished before requesting response (see UM0560, SPI timing)
-        SLEEP(1200);                               // for not 128-aligned data wait >1.1s
-      else
-        SLEEP(20);                                 // for 128-aligned data wait >8.5ms
+      SLEEP(tProg > TPROG_BLOCK ? tProg : TPROG_BLOCK);  // wait for write finished before requesting response (see UM0560, SPI timing)
       len = receive_spi_Arduino(ptrPort, lenRx, Rx);
     }
     #if defined(USE_SPIDEV)
       else if (physInterface == SPI_SPIDEV) {
-        if ((addrTmp >= 0x8000) && (addrTmp % 128))  // wait for flash write finished before requesting response (see UM0560, SPI timing)
-          SLEEP(1200);                               // for not 128-aligned data wait >1.1s
-        else
-          SLEEP(20);                                 // for 128-aligned data wait >8.5ms
+        SLEEP(tProg > TPROG_BLOCK ? tProg : TPROG_BLOCK);  // wait for write finished before requesting response (see UM0560, SPI timing)
         len = receive_spi_spidev(ptrPort, lenRx, Rx);
       }
     #endif
-    if (len != lenRx)
-      Error("in 'bsl_memWrite()': ACK3 timeout (expect %d, received %d)", lenRx, len);
-
-    // check acknowledge
-    if (Rx[0]!=ACK)
+    if ((len != lenRx) || (Rx[0] != ACK)) {
+      if (bsl_recover(ptrPort, physInterface, uartMode, WRITE, addrBlock, writeBuf+addrBlock, lenBlock, &numFail)) {
+        countBytes -= lenBlock;
+        numRetry++;
+        continue;
+      }
+      if (len != lenRx)
+        Error("in 'bsl_memWrite()': ACK3 timeout (expect %d, received %d)", lenRx, len);
       Error("in 'bsl_memWrite()': ACK3 failure (expect 0x%02x, received 0x%02x)", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    }
 
-    // print progress
-    if (((++countBlock) % 8) == 0) {
-      if (verbose == SILENT) {
-        printf(".");
-        if ((countBlock % (10*8)) == 0)
-          printf(" ");
-      }
-      else if (verbose == INFORM) {
-        if (numData > 1024)
-          printf("%c  write %1.1fkB / %1.1fkB ", '\r', (float) countBytes/1024.0, (float) numData/1024.0);
-        else
-          printf("%c  write %dB / %dB ", '\r', (int) countBytes, (int) numData);
-      }
-      else if (verbose == CHATTY) {
-        if (numData > 1024)
-          printf("%c  write %1.1fkB / %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (float) countBytes/1024.0, (float) numData/1024.0, addrStart, addrStop);
-        else
-          printf("%c  write %dB / %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (int) countBytes, (int) numData, addrStart, addrStop);
-      }
-      fflush(stdout);
+    // gang programming: repeat frame if a device failed, else go on with remaining devices
+    if ((s_gangNum > 0) && (bsl_gangRetry(ptrPort, addrBlock, verbose))) {
+      countBytes -= lenBlock;
+      numRetry++;
+      continue;
+    }
+    numFail = 0;
+    fault_frame_end();
+
+    // print progress. Dots per 8 blocks, progress line rate limited by time
+    if ((verbose == SILENT) && (((++countBlock) % 8) == 0)) {
+      log_printf(".");
+      if ((countBlock % (10*8)) == 0)
+        log_printf(" ");
     }
+    else if (verbose == INFORM) {
+      if (numData > 1024)
+        log_progress("%c  write %1.1fkB / %1.1fkB ", '\r', (float) countBytes/1024.0, (float) numData/1024.0);
+      else
+        log_progress("%c  write %dB / %dB ", '\r', (int) countBytes, (int) numData);
+    }
+    else if (verbose == CHATTY) {
+      if (numData > 1024)
+        log_progress("%c  write %1.1fkB / %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (float) countBytes/1024.0, (float) numData/1024.0, addrStart, addrStop);
+      else
+        log_progress("%c  write %dB / %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ", '\r', (int) countBytes, (int) numData, addrStart, addrStop);
+    }
+    log_event("write", LOG_PROGRESS, countBytes, numData, addrBlock, numRetry);
 
     // go to next potential block
     addr += lenBlock;
 
   } // loop over address range
+  s_gangFrame = false;
+  fault_arm(false);
 
   // print message
   if (verbose == SILENT)
-    printf(" done\n");
+    log_printf(" done\n");
   else if (verbose == INFORM) {
     if (numData > 1024)
-      printf("%c  write %1.1fkB / %1.1fkB ... done   \n", '\r', (float) countBytes/1024.0, (float) numData/1024.0);
+      log_printf("%c  write %1.1fkB / %1.1fkB ... done   \n", '\r', (float) countBytes/1024.0, (float) numData/1024.0);
     else
-      printf("%c  write %dB / %dB ... done   \n", '\r', (int) countBytes, (int) numData);
+      log_printf("%c  write %dB / %dB ... done   \n", '\r', (int) countBytes, (int) numData);
   }
   else if (verbose == CHATTY) {
     if (numData > 1024)
-      printf("%c  write %1.1fkB / %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (float) countBytes/1024.0, (float) numData/1024.0, addrStart, addrStop);
+      log_printf("%c  write %1.1fkB / %1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (float) countBytes/1024.0, (float) numData/1024.0, addrStart, addrStop);
     else
-      printf("%c  write %dB / %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (int) countBytes, (int) numData, addrStart, addrStop);
+      log_printf("%c  write %dB / %dB in 0x%" PRIx64 " to 0x%" PRIx64 " ... done   \n", '\r', (int) countBytes, (int) numData, addrStart, addrStop);
   }
+  log_flush();        // keep order with following direct output
+  log_event("write", LOG_END, countBytes, numData, addrStop, numRetry);
+
+  // release private copy of image
+  if (writeBuf != imageBuf)
+    free(writeBuf);
 
   // avoid compiler warnings
   return(0);
@@ -1401,11 +2334,10 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ui
 */
 uint8_t bsl_memVerify(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose) {
 
-  // allocate and clear temporary RAM buffer (>1MByte requires dynamic allocation)
+  // allocate and clear temporary RAM buffer (>1MByte requires dynamic allocation). With memory budget only up to last address
   uint16_t  *tmpImageBuf;            // RAM image buffer (high byte != 0 indicates value is set)
-  if (!(tmpImageBuf = malloc(LENIMAGEBUF * sizeof(*tmpImageBuf))))
-    Error("Cannot allocate image buffer, try reducing LENIMAGEBUF");
-  memset(tmpImageBuf, 0, LENIMAGEBUF * sizeof(*tmpImageBuf));
+  mem_check_need("verify", (addrStop - addrStart + 1) * sizeof(*tmpImageBuf));
+  tmpImageBuf = mem_alloc(MEM_VERIFY, (mem_sparse() ? (addrStop + 1) : LENIMAGEBUF) * sizeof(*tmpImageBuf));
 
 
   // loop over image and read all consecutive data blocks. Skip undefined data to avoid illegal read.
@@ -1455,7 +2387,8 @@ uint8_t bsl_memVerify(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, u
   fflush(stdout);
 
   // release temporary RAM buffer
-  free(tmpImageBuf);
+  mem_free(tmpImageBuf);
+  mem_check("verify");
 
   // avoid compiler warnings
   return(0);
@@ -1465,19 +2398,172 @@ uint8_t bsl_memVerify(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, u
 
 
 /**
-  \fn uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addr, uint8_t verbose)
+  \fn uint64_t bsl_optionPair(uint64_t addr, uint8_t family)
+
+  \param[in]  addr           address in option area
+  \param[in]  family         device family (STM8S or STM8L)
+
+  \return address of complement byte, or addr if byte has no complement
+
+  get complement of option byte. Only STM8S has complement bytes: OPTx/NOPTx in 0x4801-0x4810 and
+  OPTBL/NOPTBL in 0x487E-0x487F (see RM0016). STM8L option bytes have no complement (see RM0031)
+*/
+static uint64_t bsl_optionPair(uint64_t addr, uint8_t family) {
+
+  if (family != STM8S)
+    return(addr);
+  if ((addr >= OPT_START+0x01) && (addr <= OPT_START+0x10))
+    return((addr & 0x01) ? (addr + 1) : (addr - 1));
+  else if (addr == OPT_STOP-1)
+    return(OPT_STOP);
+  else if (addr == OPT_STOP)
+    return(OPT_STOP-1);
+  return(addr);
+
+} // bsl_optionPair
+
+
+
+/**
+  \fn uint8_t bsl_optionWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint8_t family, bool verify, uint8_t verbose)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  imageBuf       memory image with option bytes to set (16-bit array. HB!=0 indicates content)
+  \param[in]  family         device family (STM8S or STM8L) for complement pairs
+  \param[in]  verify         verify option bytes after write
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  \return communication status (0=ok, 1=fail)
+
+  set option bytes with minimal number of write cycles. The option area is read in one READ and
+  only bytes which differ are written. For complement pairs (OPTx/NOPTx) a missing value is
+  derived from its partner in a private copy, and both bytes are written together. Contiguous
+  bytes are combined into one WRITE, which waits for the end of programming. Finally the area is
+  verified with one READ. If all option bytes are already set, only one READ is required.
+*/
+uint8_t bsl_optionWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint8_t family, bool verify, uint8_t verbose) {
+
+  uint16_t  *setBuf, *optBuf, *writeBuf; // requested, read-back and write images of option area
+  uint64_t  addr, addrPair, addrStart, addrStop, numData;
+  int       numBytes, numWrites;
+
+  // print message
+  if (verbose != MUTE)
+    printf("  set option bytes ... ");
+  fflush(stdout);
+
+  // check that only option bytes are specified
+  get_image_size(imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+  if ((numData > 0) && (addrStart < OPT_START))
+    Error("in 'bsl_optionWrite()': address 0x%" PRIx64 " outside option bytes (0x%04x - 0x%04x)", addrStart, OPT_START, OPT_STOP);
+  if ((numData > 0) && (addrStop > OPT_STOP))
+    Error("in 'bsl_optionWrite()': address 0x%" PRIx64 " outside option bytes (0x%04x - 0x%04x)", addrStop, OPT_START, OPT_STOP);
+
+  // allocate and clear temporary images of option area (indexed by address)
+  setBuf   = calloc(OPT_STOP+1, sizeof(*setBuf));
+  optBuf   = calloc(OPT_STOP+1, sizeof(*optBuf));
+  writeBuf = calloc(OPT_STOP+1, sizeof(*writeBuf));
+  if ((setBuf == NULL) || (optBuf == NULL) || (writeBuf == NULL))
+    Error("in 'bsl_optionWrite()': cannot allocate buffer");
+
+  // copy requested option bytes, the image of the caller remains unchanged
+  memcpy(setBuf+OPT_START, imageBuf+OPT_START, (OPT_STOP-OPT_START+1) * sizeof(*setBuf));
+
+  // complete complement pairs
+  for (addr=OPT_START; addr<=OPT_STOP; addr++) {
+    addrPair = bsl_optionPair(addr, family);
+    if (addrPair <= addr)
+      continue;
+    if ((setBuf[addr] & 0xFF00) && (!(setBuf[addrPair] & 0xFF00)))
+      setBuf[addrPair] = 0xFF00 | (~setBuf[addr] & 0xFF);
+    else if ((!(setBuf[addr] & 0xFF00)) && (setBuf[addrPair] & 0xFF00))
+      setBuf[addr] = 0xFF00 | (~setBuf[addrPair] & 0xFF);
+    else if ((setBuf[addr] & 0xFF00) && (((setBuf[addr] ^ setBuf[addrPair]) & 0xFF) != 0xFF))
+      Error("in 'bsl_optionWrite()': 0x%04x and 0x%04x are no complement pair (0x%02x, 0x%02x)", (int) addr, (int) addrPair, (uint8_t) setBuf[addr], (uint8_t) setBuf[addrPair]);
+  }
+
+  // read complete option area in one READ
+  bsl_memRead(ptrPort, physInterface, uartMode, OPT_START, OPT_STOP, optBuf, MUTE);
+
+  // mark bytes which differ. For complement pairs write both bytes together
+  numBytes = 0;
+  for (addr=OPT_START; addr<=OPT_STOP; addr++) {
+    if ((setBuf[addr] & 0xFF00) && ((setBuf[addr] & 0xFF) != (optBuf[addr] & 0xFF))) {
+      addrPair = bsl_optionPair(addr, family);
+      writeBuf[addr]     = setBuf[addr];
+      writeBuf[addrPair] = setBuf[addrPair];
+    }
+  }
+
+  // count bytes and WRITE commands (option area fits in one 128B block -> 1 WRITE per contiguous range)
+  numWrites = 0;
+  for (addr=OPT_START; addr<=OPT_STOP; addr++) {
+    if (writeBuf[addr] & 0xFF00) {
+      numBytes++;
+      if (!(writeBuf[addr-1] & 0xFF00))
+        numWrites++;
+    }
+  }
+
+  // nothing to do -> done
+  if (numBytes == 0) {
+    if (verbose != MUTE)
+      printf("done (unchanged)\n");
+    fflush(stdout);
+    free(setBuf);
+    free(optBuf);
+    free(writeBuf);
+    return(0);
+  }
+
+  // write differing bytes
+  bsl_memWrite(ptrPort, physInterface, uartMode, writeBuf, OPT_START, OPT_STOP, MUTE);
+
+  // verify all specified option bytes in one READ
+  if (verify) {
+    memset(optBuf, 0, (OPT_STOP+1) * sizeof(*optBuf));
+    bsl_memRead(ptrPort, physInterface, uartMode, OPT_START, OPT_STOP, optBuf, MUTE);
+    for (addr=OPT_START; addr<=OPT_STOP; addr++) {
+      if ((setBuf[addr] & 0xFF00) && ((setBuf[addr] & 0xFF) != (optBuf[addr] & 0xFF)))
+        Error("verify failed at address 0x%" PRIx64 " (0x%02x vs 0x%02x)", addr, (uint8_t) (setBuf[addr]&0xFF), (uint8_t) (optBuf[addr]&0xFF));
+    }
+  }
+
+  // print message
+  if (verbose != MUTE)
+    printf("done (%dB in %d writes%s)\n", numBytes, numWrites, (verify ? ", verified" : ""));
+  fflush(stdout);
+
+  // release temporary buffers
+  free(setBuf);
+  free(optBuf);
+  free(writeBuf);
+
+  // avoid compiler warnings
+  return(0);
+
+} // bsl_optionWrite
+
+
+
+/**
+  \fn uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addr, uint64_t *timeAck, uint8_t verbose)
 
   \param[in]  ptrPort        handle to communication port
   \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
   \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
   \param[in]  addr           address to jump to
+  \param[out] timeAck        time of final ACK from micros(), i.e. start of application [us] (NULL=skip)
   \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
 
   \return communication status (0=ok, 1=fail)
 
-  jump to address and continue code execution. Generally RAM or flash starting address
+  jump to address and continue code execution. Generally RAM or flash starting address.
+  The BSL jumps directly after sending the final ACK, which is therefore the reference for boot time
 */
-uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addr, uint8_t verbose) {
+uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addr, uint64_t *timeAck, uint8_t verbose) {
 
   int       i;
   int       lenTx, lenRx, len;
@@ -1523,7 +2609,7 @@ uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
@@ -1565,13 +2651,15 @@ uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint
 
   // receive response
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+    len = bsl_receive(ptrPort, uartMode, lenRx, Rx);
   else if (physInterface == SPI_ARDUINO)
     len = receive_spi_Arduino(ptrPort, lenRx, Rx);
   #if defined(USE_SPIDEV)
     else if (physInterface == SPI_SPIDEV)
       len = receive_spi_spidev(ptrPort, lenRx, Rx);
   #endif
+  if (timeAck != NULL)
+    *timeAck = micros();
   if (len != lenRx)
     Error("in 'bsl_jumpTo()': ACK2 timeout (expect %d, received %d)", lenRx, len);
 
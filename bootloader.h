@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "serial_comm.h"
 
 
@@ -42,17 +43,45 @@
 
 #define PFLASH_START      0x8000    //< starting address of flash (same for all STM8 devices)
 #define PFLASH_BLOCKSIZE  1024      //< size of flash block for erase or block write (same for all STM8 devices)
+#define WRITE_BLOCKSIZE   128       //< max. length of WRITE. Aligned blocks are programmed in fast block mode
+
+#define TPROG_BLOCK       20        //< max. time for programming a complete aligned flash/EEPROM block incl. margin [ms]
+#define TPROG_BYTE        6         //< time for programming one byte of a partial block [ms]
+#define TPROG_UNALIGNED   1200      //< max. time for programming a not aligned flash block [ms]
+
+#define OPT_START         0x4800    //< first address of option bytes
+#define OPT_STOP          0x487F    //< last address of option bytes
+
+#define GANG_MAX          16        //< max. number of devices for gang programming
+#define GANG_SYNC_TIMEOUT 50        //< max. time for responses of all gang devices per sync attempt [ms]
+
+
+/// data EEPROM layout of a device, see bsl_getInfo()
+typedef struct {
+  uint64_t  start;          ///< first address of data EEPROM
+  uint64_t  stop;           ///< last address of data EEPROM
+  uint64_t  block;          ///< EEPROM block size (0=unknown)
+} eepromLayout_t;
 
 
 /// synchronize to microcontroller BSL
 uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose);
 
+/// enable gang programming via shared TX line and one RX port per device
+void bsl_gangSetup(int numPorts, HANDLE *ptrPorts);
+
+/// get number of remaining gang devices
+int bsl_gangStatus(bool *active);
+
 /// determine UART mode
 uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose);
 
 /// get microcontroller type and BSL version
 uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int *flashsize, uint8_t *vers, uint8_t *family, uint8_t verbose);
 
+/// get data EEPROM layout of device identified by last bsl_getInfo()
+void bsl_getEeprom(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, eepromLayout_t *eeprom);
+
 /// read from microcontroller memory
 uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, uint16_t *imageBuf, uint8_t verbose);
 
@@ -68,11 +97,20 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMo
 /// upload to microcontroller flash or RAM
 uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose);
 
+/// check if frame parts may be sent ahead of the command ACK (pipelining)
+bool bsl_pipeSafe(const char *tail, int len);
+
+/// estimate max. programming time of a WRITE [ms]
+uint32_t bsl_progTime(const eepromLayout_t *eeprom, uint64_t addr, int len);
+
 /// verify microcontroller memory content vs. or RAM image
 uint8_t bsl_memVerify(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose);
 
+/// set option bytes with minimal number of write cycles
+uint8_t bsl_optionWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, uint8_t family, bool verify, uint8_t verbose);
+
 /// jump to flash or RAM
-uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addr, uint8_t verbose);
+uint8_t bsl_jumpTo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addr, uint64_t *timeAck, uint8_t verbose);
 
 #endif // _BOOTLOADER_H_
 
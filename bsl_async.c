@@ -0,0 +1,686 @@
+/**
+  \file bsl_async.c
+
+  \author G. Icking-Konert
+  \date 2019-03-09
+  \version 0.1
+
+  \brief implementation of asynchronous bootloader routines
+
+  implementation of non-blocking routines for writing, verifying and reading
+  memory via the UART bootloader, for embedding stm8gal in an event loop.
+  Each WRITE/READ frame passes the states command -> address -> data, each
+  waiting for the BSL response. Responses are read w/o blocking, timeouts are
+  checked against a deadline, so many sessions can be served by one thread.
+  For pipelined network ports ("?pipe") command, address and number of bytes
+  of a READ are sent at once. WRITE is sent step by step.
+  Blocks are aligned to 128B for fast block programming. Unlike bsl_memWrite()
+  partial blocks are not padded and EEPROM blocks are not compared, and a
+  failed frame isn't repeated, i.e. after failure re-synchronize via bsl_sync().
+  bsl_async_upload() is a blocking driver for the command line (option -A),
+  which serves one session from a select() loop.
+  The session routines never call Error(), failures are reported via callback.
+  Only bsl_async_upload() and the blocking setup routines terminate on errors.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#if defined(__APPLE__) || defined(__unix__)
+  #include <sys/select.h>
+#endif
+#include "bsl_async.h"
+#include "bootloader.h"
+#include "hexfile.h"
+#include "net_comm.h"
+#include "main.h"
+#include "misc.h"
+#include "logger.h"
+
+
+/// type of operation
+typedef enum {
+  OP_WRITE = 0,               //< upload image
+  OP_VERIFY,                  //< compare image with memory
+  OP_READ                     //< read memory to image
+} asyncOp_t;
+
+/// state of protocol, i.e. response the session waits for
+typedef enum {
+  ST_IDLE = 0,                //< no operation running
+  ST_ACK_CMD,                 //< ACK for command
+  ST_ACK_ADDR,                //< ACK for address
+  ST_ACK_DATA                 //< ACK for data (WRITE) or ACK + data (READ)
+} asyncState_t;
+
+/// state of session
+struct bslSession_s {
+  HANDLE          port;             //< port with synchronized BSL
+  bool            pipelined;        //< send command and address at once (network port)
+  bool            pipeFrame;        //< current frame is pipelined
+  eepromLayout_t  eeprom;           //< data EEPROM layout of device, for programming time
+  asyncOp_t       op;               //< running or last operation
+  asyncState_t    state;            //< protocol state
+  const uint16_t  *image;           //< image to write or verify
+  uint16_t        *readBuf;         //< image to read to
+  uint64_t        addrNext;         //< start address of next frame
+  uint64_t        addrStop;         //< last address of operation
+  uint64_t        addrFrame;        //< start address of current frame
+  int             lenFrame;         //< number of data bytes in current frame
+  char            txAddr[5];        //< address part of current frame
+  char            txData[WRITE_BLOCKSIZE+2];  //< data part of current frame
+  int             lenData;          //< length of data part
+  char            rx[260];          //< response of BSL
+  uint32_t        lenRx;            //< received bytes of response
+  uint32_t        lenExpect;        //< expected length of response
+  uint64_t        deadline;         //< timeout for response [ms]
+  uint64_t        done;             //< processed bytes
+  uint64_t        total;            //< bytes to process
+  bslCallback_t   callback;         //< completion callback
+  void            *user;            //< user data for callback
+};
+
+/// result of operation run by bsl_async_upload()
+typedef struct {
+  bool              finished;       //< callback was called
+  bslAsyncStatus_t  status;         //< result of operation
+  uint64_t          addr;           //< address of failure
+} asyncResult_t;
+
+
+
+/**
+  \fn void async_complete(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr)
+
+  \param[in] session    session
+  \param[in] status     result of operation
+  \param[in] addr       address of failure
+
+  finish operation and call callback. The callback may start a new operation.
+*/
+static void async_complete(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr) {
+
+  session->state = ST_IDLE;
+  if (session->callback != NULL)
+    session->callback(session, status, addr, session->user);
+
+} // async_complete
+
+
+
+/**
+  \fn void async_expect(bslSession_t *session, asyncState_t state, uint32_t lenExpect, uint32_t timeout)
+
+  \param[in] session    session
+  \param[in] state      new protocol state
+  \param[in] lenExpect  length of expected response
+  \param[in] timeout    max. time for response [ms]
+
+  wait for next response.
+*/
+static void async_expect(bslSession_t *session, asyncState_t state, uint32_t lenExpect, uint32_t timeout) {
+
+  session->state     = state;
+  session->lenRx     = 0;
+  session->lenExpect = lenExpect;
+  session->deadline  = millis() + timeout;
+
+} // async_expect
+
+
+
+/**
+  \fn void async_next(bslSession_t *session)
+
+  \param[in] session    session
+
+  find and send next frame, or complete operation if done.
+*/
+static void async_next(bslSession_t *session) {
+
+  char      Tx[2 + 5 + WRITE_BLOCKSIZE + 2];
+  int       lenTx, i, lenMax;
+  uint64_t  addr = session->addrNext;
+  uint8_t   chk;
+
+  // find next frame. Write and verify only defined bytes, aligned to 128B for write
+  if (session->op != OP_READ) {
+    while ((addr <= session->addrStop) && (!(session->image[addr] & 0xFF00)))
+      addr++;
+  }
+  if (addr > session->addrStop) {
+    async_complete(session, BSL_ASYNC_OK, session->addrStop);
+    return;
+  }
+  lenMax = (session->op == OP_WRITE) ? WRITE_BLOCKSIZE : 256;
+  session->lenFrame = 1;
+  while ((session->lenFrame < lenMax) && ((addr + session->lenFrame) <= session->addrStop)) {
+    if ((session->op != OP_READ) && (!(session->image[addr + session->lenFrame] & 0xFF00)))
+      break;
+    if ((session->op == OP_WRITE) && (((addr + session->lenFrame) % WRITE_BLOCKSIZE) == 0))
+      break;
+    session->lenFrame++;
+  }
+  session->addrFrame = addr;
+  session->addrNext  = addr + session->lenFrame;
+
+  // construct address + checksum (XOR over address)
+  session->txAddr[0] = (char) (addr >> 24);
+  session->txAddr[1] = (char) (addr >> 16);
+  session->txAddr[2] = (char) (addr >> 8);
+  session->txAddr[3] = (char) (addr);
+  session->txAddr[4] = (session->txAddr[0] ^ session->txAddr[1] ^ session->txAddr[2] ^ session->txAddr[3]);
+
+  // construct number of bytes (+ data) + checksum
+  session->lenData = 0;
+  session->txData[session->lenData++] = session->lenFrame - 1;     // -1 from BSL
+  if (session->op == OP_WRITE) {
+    chk = session->lenFrame - 1;
+    for (i=0; i<session->lenFrame; i++) {
+      session->txData[session->lenData] = (uint8_t) (session->image[addr+i] & 0x00FF);
+      chk ^= session->txData[session->lenData++];
+    }
+    session->txData[session->lenData++] = chk;
+  }
+  else
+    session->txData[session->lenData++] = (session->txData[0] ^ 0xFF);
+
+  // send command. Pipelined READ: append address and number of bytes, if harmless after a NACK
+  lenTx = 0;
+  Tx[lenTx++] = (session->op == OP_WRITE) ? WRITE : READ;
+  Tx[lenTx++] = (Tx[0] ^ 0xFF);
+  session->pipeFrame = false;
+  if ((session->pipelined) && (session->op != OP_WRITE)) {
+    memcpy(Tx+lenTx, session->txAddr, 5);
+    memcpy(Tx+lenTx+5, session->txData, session->lenData);
+    session->pipeFrame = bsl_pipeSafe(Tx+lenTx, 5+session->lenData);
+    if (session->pipeFrame)
+      lenTx += 5+session->lenData;
+  }
+  if (send_port(session->port, 0, lenTx, Tx) != (uint32_t) lenTx) {
+    async_complete(session, BSL_ASYNC_PORT, addr);
+    return;
+  }
+  async_expect(session, ST_ACK_CMD, 1, g_timing.timeout);
+
+} // async_next
+
+
+
+/**
+  \fn bool async_start(bslSession_t *session, asyncOp_t op, const uint16_t *image, uint16_t *readBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user)
+
+  \param[in] session    session
+  \param[in] op         type of operation
+  \param[in] image      image to write or verify
+  \param[in] readBuf    image to read to
+  \param[in] addrStart  first address
+  \param[in] addrStop   last address
+  \param[in] callback   completion callback
+  \param[in] user       user data for callback
+
+  \return false if an operation is already running or range is invalid
+
+  start operation and send first frame. If there is no data, the callback is called immediately.
+*/
+static bool async_start(bslSession_t *session, asyncOp_t op, const uint16_t *image, uint16_t *readBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user) {
+
+  uint64_t  addr;
+
+  if ((session == NULL) || (session->state != ST_IDLE) || (addrStart > addrStop) || (addrStop >= LENIMAGEBUF))
+    return(false);
+
+  // init operation
+  session->op       = op;
+  session->image    = image;
+  session->readBuf  = readBuf;
+  session->addrNext = addrStart;
+  session->addrStop = addrStop;
+  session->callback = callback;
+  session->user     = user;
+  session->done     = 0;
+  session->total    = 0;
+  if (op == OP_READ) {
+    session->total = addrStop - addrStart + 1;
+    for (addr=addrStart; addr<=addrStop; addr++)
+      readBuf[addr] = 0;
+  }
+  else {
+    for (addr=addrStart; addr<=addrStop; addr++) {
+      if (image[addr] & 0xFF00)
+        session->total++;
+    }
+  }
+
+  // send first frame
+  async_next(session);
+  return(true);
+
+} // async_start
+
+
+
+/**
+  \fn void async_result(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr, void *user)
+
+  \param[in] session    session
+  \param[in] status     result of operation
+  \param[in] addr       address of failure
+  \param[in] user       result of type asyncResult_t
+
+  completion callback of bsl_async_upload(). Store result for the event loop.
+*/
+static void async_result(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr, void *user) {
+
+  asyncResult_t  *result = (asyncResult_t*) user;
+
+  (void) session;
+  result->finished = true;
+  result->status   = status;
+  result->addr     = addr;
+
+} // async_result
+
+
+
+/**
+  \fn void async_run(bslSession_t *session, asyncOp_t op, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose)
+
+  \param[in] session    session
+  \param[in] op         OP_WRITE or OP_VERIFY
+  \param[in] imageBuf   memory image. Only defined bytes (HB!=0) are processed
+  \param[in] addrStart  first address
+  \param[in] addrStop   last address
+  \param[in] verbose    verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  run operation to completion. Wait for port input or the next timeout via select()
+  (Windows: poll every 1ms) and advance the session. Exit on failure.
+*/
+static void async_run(bslSession_t *session, asyncOp_t op, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose) {
+
+  const char     *phase = (op == OP_WRITE) ? "write" : "verify";
+  asyncResult_t  result = {false, BSL_ASYNC_OK, 0};
+  uint64_t       done, total;
+  int32_t        timeout;
+  #if defined(__APPLE__) || defined(__unix__)
+    fd_set          fdr;
+    struct timeval  tv;
+  #endif
+
+  // start operation. Callback is called immediately if there is no data
+  if (!async_start(session, op, imageBuf, NULL, addrStart, addrStop, async_result, &result))
+    Error("in 'bsl_async_upload()': cannot start %s", phase);
+  bsl_async_progress(session, &done, &total);
+  if (total > 1024)
+    log_printf("  %s %1.1fkB (async) ", phase, (float) total/1024.0);
+  else
+    log_printf("  %s %dB (async) ", phase, (int) total);
+  log_event(phase, LOG_START, 0, total, addrStart, 0);
+
+  // event loop: advance session, then wait for response or timeout
+  while (!result.finished) {
+    timeout = bsl_async_process(session);
+    if ((result.finished) || (timeout < 0))
+      break;
+    #if defined(__APPLE__) || defined(__unix__)
+      FD_ZERO(&fdr);
+      FD_SET(bsl_async_fd(session), &fdr);
+      tv.tv_sec  = timeout / 1000;
+      tv.tv_usec = (timeout % 1000) * 1000;
+      select(bsl_async_fd(session) + 1, &fdr, NULL, NULL, &tv);
+    #else
+      SLEEP(1);
+    #endif
+
+    // print progress
+    bsl_async_progress(session, &done, &total);
+    if ((verbose == INFORM) || (verbose == CHATTY)) {
+      if (total > 1024)
+        log_progress("%c  %s %1.1fkB / %1.1fkB (async) ", '\r', phase, (float) done/1024.0, (float) total/1024.0);
+      else
+        log_progress("%c  %s %dB / %dB (async) ", '\r', phase, (int) done, (int) total);
+    }
+    log_event(phase, LOG_PROGRESS, done, total, addrStart, 0);
+
+  } // event loop
+
+  // check result
+  if (result.status == BSL_ASYNC_VERIFY)
+    Error("in 'bsl_async_upload()': verify failed at address 0x%" PRIx64, result.addr);
+  else if (result.status == BSL_ASYNC_TIMEOUT)
+    Error("in 'bsl_async_upload()': %s timeout at address 0x%" PRIx64, phase, result.addr);
+  else if (result.status == BSL_ASYNC_NACK)
+    Error("in 'bsl_async_upload()': %s NACK at address 0x%" PRIx64, phase, result.addr);
+  else if (result.status != BSL_ASYNC_OK)
+    Error("in 'bsl_async_upload()': %s failed at address 0x%" PRIx64 " (status %d)", phase, result.addr, (int) result.status);
+
+  // print message
+  bsl_async_progress(session, &done, &total);
+  if (verbose == SILENT)
+    log_printf("done\n");
+  else if (total > 1024)
+    log_printf("%c  %s %1.1fkB / %1.1fkB (async) ... done   \n", '\r', phase, (float) done/1024.0, (float) total/1024.0);
+  else
+    log_printf("%c  %s %dB / %dB (async) ... done   \n", '\r', phase, (int) done, (int) total);
+  log_event(phase, LOG_END, done, total, addrStop, 0);
+
+} // async_run
+
+
+
+/**
+  \fn bslSession_t *bsl_async_open(HANDLE ptrPort, uint8_t uartMode, const eepromLayout_t *eeprom)
+
+  \param[in] ptrPort    handle to port with synchronized BSL
+  \param[in] uartMode   UART bootloader mode, only 0=duplex is supported
+  \param[in] eeprom     data EEPROM layout of the device on this port, see bsl_getEeprom()
+
+  \return new session, or NULL on failure
+
+  create session for asynchronous operations. Timeouts are taken from g_timing. The EEPROM layout
+  is copied to the session, so sessions for different devices don't share the layout of the last
+  bsl_getInfo().
+*/
+bslSession_t *bsl_async_open(HANDLE ptrPort, uint8_t uartMode, const eepromLayout_t *eeprom) {
+
+  bslSession_t  *session;
+
+  if ((!ptrPort) || (uartMode != 0) || (eeprom == NULL))
+    return(NULL);
+  if (!(session = calloc(1, sizeof(*session))))
+    return(NULL);
+  session->port      = ptrPort;
+  session->pipelined = net_pipelined(ptrPort);
+  session->eeprom    = *eeprom;
+  session->state     = ST_IDLE;
+  return(session);
+
+} // bsl_async_open
+
+
+
+/**
+  \fn void bsl_async_close(bslSession_t *session)
+
+  \param[in] session    session
+
+  release session. A running operation is completed with BSL_ASYNC_ABORT. The port is not closed.
+*/
+void bsl_async_close(bslSession_t *session) {
+
+  if (session == NULL)
+    return;
+  if (session->state != ST_IDLE)
+    async_complete(session, BSL_ASYNC_ABORT, session->addrFrame);
+  free(session);
+
+} // bsl_async_close
+
+
+
+/**
+  \fn int bsl_async_fd(bslSession_t *session)
+
+  \param[in] session    session
+
+  \return file descriptor to poll for input, or -1 if not available (Windows)
+
+  get file descriptor of port for use in poll()/select() of an event loop.
+*/
+int bsl_async_fd(bslSession_t *session) {
+
+  if (session == NULL)
+    return(-1);
+#if defined(WIN32) || defined(WIN64)
+  return(-1);
+#else
+  return((int) session->port);
+#endif
+
+} // bsl_async_fd
+
+
+
+/**
+  \fn bool bsl_async_busy(bslSession_t *session)
+
+  \param[in] session    session
+
+  \return true if an operation is running
+
+  check if session is running an operation.
+*/
+bool bsl_async_busy(bslSession_t *session) {
+
+  return((session != NULL) && (session->state != ST_IDLE));
+
+} // bsl_async_busy
+
+
+
+/**
+  \fn bool bsl_async_start_write(bslSession_t *session, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user)
+
+  \param[in] session    session
+  \param[in] imageBuf   memory image. Only defined bytes (HB!=0) are written
+  \param[in] addrStart  first address to write
+  \param[in] addrStop   last address to write
+  \param[in] callback   called on completion
+  \param[in] user       user data for callback
+
+  \return false if an operation is already running or range is invalid
+
+  start uploading memory image range. Flash write/erase routines must be active.
+*/
+bool bsl_async_start_write(bslSession_t *session, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user) {
+
+  return(async_start(session, OP_WRITE, imageBuf, NULL, addrStart, addrStop, callback, user));
+
+} // bsl_async_start_write
+
+
+
+/**
+  \fn bool bsl_async_start_verify(bslSession_t *session, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user)
+
+  \param[in] session    session
+  \param[in] imageBuf   memory image. Only defined bytes (HB!=0) are compared
+  \param[in] addrStart  first address to verify
+  \param[in] addrStop   last address to verify
+  \param[in] callback   called on completion. On mismatch with address of first difference
+  \param[in] user       user data for callback
+
+  \return false if an operation is already running or range is invalid
+
+  start comparing memory image range with device memory.
+*/
+bool bsl_async_start_verify(bslSession_t *session, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user) {
+
+  return(async_start(session, OP_VERIFY, imageBuf, NULL, addrStart, addrStop, callback, user));
+
+} // bsl_async_start_verify
+
+
+
+/**
+  \fn bool bsl_async_start_read(bslSession_t *session, uint64_t addrStart, uint64_t addrStop, uint16_t *imageBuf, bslCallback_t callback, void *user)
+
+  \param[in]  session    session
+  \param[in]  addrStart  first address to read
+  \param[in]  addrStop   last address to read
+  \param[out] imageBuf   memory image. Read bytes are marked as defined (HB=0xFF)
+  \param[in]  callback   called on completion
+  \param[in]  user       user data for callback
+
+  \return false if an operation is already running or range is invalid
+
+  start reading device memory range into image.
+*/
+bool bsl_async_start_read(bslSession_t *session, uint64_t addrStart, uint64_t addrStop, uint16_t *imageBuf, bslCallback_t callback, void *user) {
+
+  return(async_start(session, OP_READ, NULL, imageBuf, addrStart, addrStop, callback, user));
+
+} // bsl_async_start_read
+
+
+
+/**
+  \fn int32_t bsl_async_process(bslSession_t *session)
+
+  \param[in] session    session
+
+  \return time until next timeout [ms], or -1 if idle
+
+  process received responses w/o blocking and advance protocol. Call when the
+  port fd is readable or the returned time has elapsed. Callbacks are called
+  from here.
+*/
+int32_t bsl_async_process(bslSession_t *session) {
+
+  uint32_t  lenRx;
+  uint64_t  now;
+  int       i;
+
+  if (session == NULL)
+    return(-1);
+
+  // consume available responses. Only request bytes of current response
+  while (session->state != ST_IDLE) {
+    lenRx = read_port(session->port, session->lenExpect - session->lenRx, session->rx + session->lenRx, 0);
+    if (lenRx == 0)
+      break;
+    session->lenRx += lenRx;
+    if (session->lenRx < session->lenExpect)
+      continue;
+
+    // check ACK
+    if (session->rx[0] != ACK) {
+      async_complete(session, BSL_ASYNC_NACK, session->addrFrame);
+      continue;
+    }
+
+    // advance protocol
+    switch (session->state) {
+
+      // command acknowledged -> send address
+      case ST_ACK_CMD:
+        if ((!session->pipeFrame) && (send_port(session->port, 0, 5, session->txAddr) != 5)) {
+          async_complete(session, BSL_ASYNC_PORT, session->addrFrame);
+          break;
+        }
+        async_expect(session, ST_ACK_ADDR, 1, g_timing.timeout);
+        break;
+
+      // address acknowledged -> send data (WRITE) or number of bytes (READ)
+      case ST_ACK_ADDR:
+        if ((!session->pipeFrame) && (send_port(session->port, 0, session->lenData, session->txData) != (uint32_t) session->lenData)) {
+          async_complete(session, BSL_ASYNC_PORT, session->addrFrame);
+          break;
+        }
+        if (session->op == OP_WRITE)
+          async_expect(session, ST_ACK_DATA, 1, g_timing.timeout + bsl_progTime(&session->eeprom, session->addrFrame, session->lenFrame));
+        else
+          async_expect(session, ST_ACK_DATA, 1 + session->lenFrame, g_timing.timeout);
+        break;
+
+      // frame completed -> store or compare data, then next frame
+      case ST_ACK_DATA:
+        if (session->op == OP_READ) {
+          for (i=0; i<session->lenFrame; i++)
+            session->readBuf[session->addrFrame + i] = ((uint16_t) (uint8_t) session->rx[1+i]) | 0xFF00;
+        }
+        else if (session->op == OP_VERIFY) {
+          for (i=0; i<session->lenFrame; i++) {
+            if ((uint8_t) (session->image[session->addrFrame + i] & 0x00FF) != (uint8_t) session->rx[1+i])
+              break;
+          }
+          if (i < session->lenFrame) {
+            async_complete(session, BSL_ASYNC_VERIFY, session->addrFrame + i);
+            break;
+          }
+        }
+        session->done += session->lenFrame;
+        async_next(session);
+        break;
+
+      default:
+        break;
+
+    } // switch (state)
+
+  } // while (state != IDLE)
+
+  // check timeout of pending response
+  if (session->state == ST_IDLE)
+    return(-1);
+  now = millis();
+  if (now >= session->deadline) {
+    async_complete(session, BSL_ASYNC_TIMEOUT, session->addrFrame);
+    if (session->state == ST_IDLE)
+      return(-1);
+    now = millis();
+  }
+  return((int32_t) (session->deadline - now));
+
+} // bsl_async_process
+
+
+
+/**
+  \fn void bsl_async_progress(bslSession_t *session, uint64_t *done, uint64_t *total)
+
+  \param[in]  session    session
+  \param[out] done       processed bytes of running or last operation
+  \param[out] total      total bytes of running or last operation
+
+  get progress of operation.
+*/
+void bsl_async_progress(bslSession_t *session, uint64_t *done, uint64_t *total) {
+
+  *done  = (session != NULL) ? session->done  : 0;
+  *total = (session != NULL) ? session->total : 0;
+
+} // bsl_async_progress
+
+
+
+/**
+  \fn void bsl_async_upload(HANDLE ptrPort, uint8_t uartMode, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bool verify, uint8_t verbose)
+
+  \param[in] ptrPort    handle to port with synchronized BSL
+  \param[in] uartMode   UART bootloader mode, only 0=duplex is supported
+  \param[in] imageBuf   memory image. Only defined bytes (HB!=0) are written
+  \param[in] addrStart  first address to write
+  \param[in] addrStop   last address to write
+  \param[in] verify     verify memory after upload
+  \param[in] verbose    verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  upload and optionally verify memory image via an asynchronous session on the device identified by
+  the last bsl_getInfo(). Blocks until done and exits on failure. Used for option -A.
+*/
+void bsl_async_upload(HANDLE ptrPort, uint8_t uartMode, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bool verify, uint8_t verbose) {
+
+  bslSession_t    *session;
+  eepromLayout_t  eeprom;
+
+  // open session with EEPROM layout of connected device
+  bsl_getEeprom(ptrPort, UART, uartMode, addrStart, addrStop, &eeprom);
+  if (!(session = bsl_async_open(ptrPort, uartMode, &eeprom)))
+    Error("in 'bsl_async_upload()': cannot open session (UART duplex mode only)");
+
+  // upload and verify
+  async_run(session, OP_WRITE, imageBuf, addrStart, addrStop, verbose);
+  if (verify)
+    async_run(session, OP_VERIFY, imageBuf, addrStart, addrStop, verbose);
+
+  // release session
+  bsl_async_close(session);
+
+} // bsl_async_upload
+
+
+// end of file
@@ -0,0 +1,83 @@
+/**
+  \file bsl_async.h
+
+  \author G. Icking-Konert
+  \date 2019-03-09
+  \version 0.1
+
+  \brief declaration of asynchronous bootloader routines
+
+  declaration of non-blocking routines for writing, verifying and reading
+  memory via the UART bootloader, for embedding stm8gal in an event loop.
+  Each session is a protocol state machine on a synchronized port. The
+  caller waits for the port to become readable (see bsl_async_fd()) or for
+  the returned timeout, then calls bsl_async_process(). Completion is
+  signalled via callback. bsl_async_upload() is a blocking driver on top.
+  Only failures of a running operation are reported via callback. Errors
+  in setup (init_port(), bsl_sync(), bsl_getInfo(), bsl_getEeprom()) and
+  in bsl_async_upload() call Error(), which terminates the process, i.e.
+  an embedding application gets no callback for them.
+*/
+
+// for including file only once
+#ifndef _BSL_ASYNC_H_
+#define _BSL_ASYNC_H_
+
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_comm.h"
+#include "bootloader.h"
+
+
+/// result of asynchronous operation
+typedef enum {
+  BSL_ASYNC_OK = 0,         ///< operation completed
+  BSL_ASYNC_TIMEOUT,        ///< no or incomplete response from BSL
+  BSL_ASYNC_NACK,           ///< response was not ACK
+  BSL_ASYNC_VERIFY,         ///< read data differs from image
+  BSL_ASYNC_PORT,           ///< sending to port failed
+  BSL_ASYNC_ABORT           ///< session was closed during operation
+} bslAsyncStatus_t;
+
+/// handle of asynchronous session
+typedef struct bslSession_s bslSession_t;
+
+/// completion callback. addr is the start address of the failed frame, or the mismatch for BSL_ASYNC_VERIFY
+typedef void (*bslCallback_t)(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr, void *user);
+
+
+/// create session on port with synchronized BSL and EEPROM layout of the device. Only UART duplex mode is supported. Returns NULL on failure
+bslSession_t  *bsl_async_open(HANDLE ptrPort, uint8_t uartMode, const eepromLayout_t *eeprom);
+
+/// release session. A running operation is completed with BSL_ASYNC_ABORT
+void      bsl_async_close(bslSession_t *session);
+
+/// get file descriptor to poll for readability (Posix), or -1 if not supported (Win32)
+int       bsl_async_fd(bslSession_t *session);
+
+/// check if an operation is running
+bool      bsl_async_busy(bslSession_t *session);
+
+/// start upload of defined bytes in image range. Image must be valid until completion
+bool      bsl_async_start_write(bslSession_t *session, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user);
+
+/// start comparing defined bytes in image range with memory. Image must be valid until completion
+bool      bsl_async_start_verify(bslSession_t *session, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bslCallback_t callback, void *user);
+
+/// start reading memory range into image. Image must be valid until completion
+bool      bsl_async_start_read(bslSession_t *session, uint64_t addrStart, uint64_t addrStop, uint16_t *imageBuf, bslCallback_t callback, void *user);
+
+/// advance state machine w/o blocking. Returns time until next timeout [ms], or -1 if idle
+int32_t   bsl_async_process(bslSession_t *session);
+
+/// get progress of running or last operation [B]
+void      bsl_async_progress(bslSession_t *session, uint64_t *done, uint64_t *total);
+
+/// upload and optionally verify image via asynchronous session. Blocks until done, exits on failure
+void      bsl_async_upload(HANDLE ptrPort, uint8_t uartMode, const uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, bool verify, uint8_t verbose);
+
+#endif // _BSL_ASYNC_H_
+
+// end of file
@@ -0,0 +1,392 @@
+/**
+  \file checksum.c
+
+  \author G. Icking-Konert
+  \date 2018-12-14
+  \version 0.1
+
+  \brief implementation of checksum routines
+
+  implementation of routines for calculating CRC16/CRC32 checksums over memory image
+  ranges and for stamping the result into the image before upload.
+  CRCs are calculated table-driven with 8 bytes per step (slice-by-8). If available,
+  the CRC32 instructions of ARMv8 (CRC-32) or SSE4.2 (CRC-32C) are used.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#if defined(__ARM_FEATURE_CRC32)
+  #include <arm_acle.h>       // ARMv8 CRC-32 instructions
+#endif
+#if defined(__SSE4_2__)
+  #include <nmmintrin.h>      // SSE4.2 CRC-32C instructions
+#endif
+#include "checksum.h"
+#include "hexfile.h"
+#include "main.h"
+#include "misc.h"
+
+
+// lookup tables for slice-by-8. Built on demand for the last used parameter set
+static uint32_t     s_table[8][256];
+static crcConfig_t  s_tableConfig;
+static bool         s_tableValid = false;
+
+
+
+/**
+   \fn uint32_t crc_reflect(uint32_t value, uint8_t width)
+
+   \param[in]  value      value to mirror
+   \param[in]  width      number of bits to mirror
+
+   \return mirrored value
+
+   mirror lower width bits of value, i.e. bit 0 <-> bit width-1
+*/
+static uint32_t crc_reflect(uint32_t value, uint8_t width) {
+
+  uint32_t  result = 0;
+  int       i;
+
+  for (i=0; i<width; i++) {
+    if (value & (1UL << i))
+      result |= 1UL << (width-1-i);
+  }
+
+  return(result);
+
+} // crc_reflect
+
+
+
+/**
+   \fn void crc_init_table(const crcConfig_t *config)
+
+   \param[in]  config     CRC parameter set
+
+   build slice-by-8 lookup tables for parameter set. Reflected CRCs use a LSB-first register,
+   normal CRCs a MSB-first register aligned to bit 31, i.e. all widths share the same code.
+*/
+static void crc_init_table(const crcConfig_t *config) {
+
+  uint32_t  poly, crc;
+  int       i, j, k;
+
+  // tables already valid
+  if ((s_tableValid) && (!memcmp(&s_tableConfig, config, sizeof(*config))))
+    return;
+
+  // basic table (1 byte per step)
+  if (config->reflect) {
+    poly = crc_reflect(config->poly, config->width);
+    for (i=0; i<256; i++) {
+      crc = (uint32_t) i;
+      for (j=0; j<8; j++)
+        crc = (crc & 1) ? ((crc >> 1) ^ poly) : (crc >> 1);
+      s_table[0][i] = crc;
+    }
+  }
+  else {
+    poly = config->poly << (32 - config->width);
+    for (i=0; i<256; i++) {
+      crc = ((uint32_t) i) << 24;
+      for (j=0; j<8; j++)
+        crc = (crc & 0x80000000) ? ((crc << 1) ^ poly) : (crc << 1);
+      s_table[0][i] = crc;
+    }
+  }
+
+  // derived tables for slice-by-8
+  for (k=1; k<8; k++) {
+    for (i=0; i<256; i++) {
+      crc = s_table[k-1][i];
+      if (config->reflect)
+        s_table[k][i] = (crc >> 8) ^ s_table[0][crc & 0xFF];
+      else
+        s_table[k][i] = (crc << 8) ^ s_table[0][crc >> 24];
+    }
+  }
+
+  // remember parameter set
+  memcpy(&s_tableConfig, config, sizeof(*config));
+  s_tableValid = true;
+
+} // crc_init_table
+
+
+
+/**
+   \fn uint32_t crc_update(const crcConfig_t *config, uint32_t crc, const uint8_t *data, uint64_t len)
+
+   \param[in]  config     CRC parameter set
+   \param[in]  crc        current CRC register (internal representation)
+   \param[in]  data       data to add
+   \param[in]  len        number of bytes
+
+   \return updated CRC register (internal representation)
+
+   add data to CRC register, 8 bytes per step via slice-by-8 tables or CRC instructions
+*/
+static uint32_t crc_update(const crcConfig_t *config, uint32_t crc, const uint8_t *data, uint64_t len) {
+
+  // use ARMv8 instructions for standard CRC-32
+  #if defined(__ARM_FEATURE_CRC32)
+    if ((config->width == 32) && (config->poly == 0x04C11DB7) && (config->reflect)) {
+      for (; len>=8; len-=8, data+=8) {
+        uint64_t  val;
+        memcpy(&val, data, 8);
+        crc = __crc32d(crc, val);
+      }
+      for (; len>0; len--)
+        crc = __crc32b(crc, *data++);
+      return(crc);
+    }
+  #endif
+
+  // use SSE4.2 instructions for CRC-32C (Castagnoli)
+  #if defined(__SSE4_2__)
+    if ((config->width == 32) && (config->poly == 0x1EDC6F41) && (config->reflect)) {
+      for (; len>=8; len-=8, data+=8) {
+        uint64_t  val;
+        memcpy(&val, data, 8);
+        crc = (uint32_t) _mm_crc32_u64(crc, val);
+      }
+      for (; len>0; len--)
+        crc = _mm_crc32_u8(crc, *data++);
+      return(crc);
+    }
+  #endif
+
+  // build lookup tables
+  crc_init_table(config);
+
+  // reflected CRC (LSB-first register)
+  if (config->reflect) {
+    for (; len>=8; len-=8, data+=8) {
+      crc ^= ((uint32_t) data[0]) | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+      crc  = s_table[7][crc & 0xFF] ^ s_table[6][(crc >> 8) & 0xFF] ^ s_table[5][(crc >> 16) & 0xFF] ^ s_table[4][crc >> 24] ^
+             s_table[3][data[4]]    ^ s_table[2][data[5]]           ^ s_table[1][data[6]]            ^ s_table[0][data[7]];
+    }
+    for (; len>0; len--)
+      crc = (crc >> 8) ^ s_table[0][(crc ^ *data++) & 0xFF];
+  }
+
+  // normal CRC (MSB-first register aligned to bit 31)
+  else {
+    for (; len>=8; len-=8, data+=8) {
+      crc ^= ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) | ((uint32_t) data[2] << 8) | ((uint32_t) data[3]);
+      crc  = s_table[7][crc >> 24] ^ s_table[6][(crc >> 16) & 0xFF] ^ s_table[5][(crc >> 8) & 0xFF] ^ s_table[4][crc & 0xFF] ^
+             s_table[3][data[4]]   ^ s_table[2][data[5]]            ^ s_table[1][data[6]]           ^ s_table[0][data[7]];
+    }
+    for (; len>0; len--)
+      crc = (crc << 8) ^ s_table[0][(crc >> 24) ^ *data++];
+  }
+
+  return(crc);
+
+} // crc_update
+
+
+
+/**
+   \fn uint32_t crc_start(const crcConfig_t *config)
+
+   \param[in]  config     CRC parameter set
+
+   \return initial CRC register (internal representation)
+
+   convert initial value to internal register representation
+*/
+static uint32_t crc_start(const crcConfig_t *config) {
+
+  if (config->reflect)
+    return(crc_reflect(config->init, config->width));
+  else
+    return(config->init << (32 - config->width));
+
+} // crc_start
+
+
+
+/**
+   \fn uint32_t crc_finish(const crcConfig_t *config, uint32_t crc)
+
+   \param[in]  config     CRC parameter set
+   \param[in]  crc        CRC register (internal representation)
+
+   \return final CRC value
+
+   convert internal register to CRC value and apply final XOR
+*/
+static uint32_t crc_finish(const crcConfig_t *config, uint32_t crc) {
+
+  uint32_t  mask = (config->width == 32) ? 0xFFFFFFFF : ((1UL << config->width) - 1);
+
+  if (!config->reflect)
+    crc >>= (32 - config->width);
+
+  return((crc ^ config->xorOut) & mask);
+
+} // crc_finish
+
+
+
+/**
+   \fn void crc_get_config(const char *type, crcConfig_t *config)
+
+   \param[in]  type       CRC type as "crc16[-le][:poly[:init[:xorOut[:reflect]]]]" or same for crc32 (values as hex)
+   \param[out] config     CRC parameter set
+
+   get CRC parameters from type string. Defaults are CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF,
+   not reflected) and CRC-32 (poly 0x04C11DB7, init/xorOut 0xFFFFFFFF, reflected). By default the
+   result is stored big-endian like STM8 data, suffix "-le" selects little-endian.
+*/
+void crc_get_config(const char *type, crcConfig_t *config) {
+
+  char      name[STRLEN];
+  char      *p;
+  uint32_t  val[4];
+  int       num;
+
+  // split name and optional parameters
+  strncpy(name, type, STRLEN-1);
+  name[STRLEN-1] = '\0';
+  p = strchr(name, ':');
+  if (p != NULL)
+    *(p++) = '\0';
+
+  // get width and default parameters
+  memset(config, 0, sizeof(*config));
+  config->bigEndian = true;
+  if ((!strcmp(name, "crc16")) || (!strcmp(name, "crc16-le"))) {
+    config->width     = 16;
+    config->poly      = 0x1021;
+    config->init      = 0xFFFF;
+    config->xorOut    = 0x0000;
+    config->reflect   = false;
+  }
+  else if ((!strcmp(name, "crc32")) || (!strcmp(name, "crc32-le"))) {
+    config->width     = 32;
+    config->poly      = 0x04C11DB7;
+    config->init      = 0xFFFFFFFF;
+    config->xorOut    = 0xFFFFFFFF;
+    config->reflect   = true;
+  }
+  else
+    Error("unsupported checksum type '%s' (crc16, crc32, optionally with suffix '-le')", type);
+  if (strstr(name, "-le") != NULL)
+    config->bigEndian = false;
+
+  // optional custom parameters poly:init:xorOut:reflect
+  if (p != NULL) {
+    num = sscanf(p, "%" SCNx32 ":%" SCNx32 ":%" SCNx32 ":%" SCNx32, &(val[0]), &(val[1]), &(val[2]), &(val[3]));
+    if (num < 1)
+      Error("cannot read checksum parameters in '%s'", type);
+    if (num >= 1) config->poly    = val[0];
+    if (num >= 2) config->init    = val[1];
+    if (num >= 3) config->xorOut  = val[2];
+    if (num >= 4) config->reflect = (val[3] != 0);
+  }
+
+  // check parameters against width
+  if ((config->width == 16) && ((config->poly > 0xFFFF) || (config->init > 0xFFFF) || (config->xorOut > 0xFFFF)))
+    Error("checksum parameters in '%s' exceed 16 bit", type);
+
+} // crc_get_config
+
+
+
+/**
+   \fn uint32_t crc_calc(const crcConfig_t *config, const uint8_t *data, uint64_t len)
+
+   \param[in]  config     CRC parameter set
+   \param[in]  data       data buffer
+   \param[in]  len        number of bytes
+
+   \return CRC value
+
+   calculate CRC over byte buffer
+*/
+uint32_t crc_calc(const crcConfig_t *config, const uint8_t *data, uint64_t len) {
+
+  return(crc_finish(config, crc_update(config, crc_start(config), data, len)));
+
+} // crc_calc
+
+
+
+/**
+   \fn void crc_stamp_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint64_t addrCrc, const crcConfig_t *config, uint8_t verbose)
+
+   \param      imageBuf     memory image containing data. HB!=0 indicates content
+   \param[in]  addrStart    first address of CRC range
+   \param[in]  addrStop     last address of CRC range
+   \param[in]  addrCrc      address to store CRC to
+   \param[in]  config       CRC parameter set
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   calculate CRC over memory image range and store result in image with configured endianness.
+   Undefined data counts as 0x00 (erased STM8 flash), use fill_image() for other padding values.
+*/
+void crc_stamp_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint64_t addrCrc, const crcConfig_t *config, uint8_t verbose) {
+
+  uint8_t   buf[4096];         // data chunk without status byte
+  uint64_t  addr, len, i;
+  uint32_t  crc;
+  int       numBytes;
+
+  // print message
+  if (verbose == INFORM)
+    printf("  stamp CRC%d ... ", (int) config->width);
+  else if (verbose == CHATTY)
+    printf("  stamp CRC%d (poly 0x%" PRIx32 ") ... ", (int) config->width, config->poly);
+  fflush(stdout);
+
+  // simple checks of windows
+  numBytes = config->width / 8;
+  if (addrStart > addrStop)
+    Error("start address 0x%" PRIx64 " higher than end address 0x%" PRIx64, addrStart, addrStop);
+  if (addrStop > (uint64_t) LENIMAGEBUF)
+    Error("end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, addrStop, LENIMAGEBUF);
+  if (addrCrc+numBytes-1 > (uint64_t) LENIMAGEBUF)
+    Error("CRC address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, addrCrc, LENIMAGEBUF);
+  if ((addrCrc+numBytes-1 >= addrStart) && (addrCrc <= addrStop))
+    Error("CRC address 0x%" PRIx64 " overlaps CRC range 0x%" PRIx64 " - 0x%" PRIx64, addrCrc, addrStart, addrStop);
+
+  // calculate CRC over range in chunks
+  crc = crc_start(config);
+  for (addr=addrStart; addr<=addrStop; addr+=len) {
+    len = addrStop - addr + 1;
+    if (len > sizeof(buf))
+      len = sizeof(buf);
+    for (i=0; i<len; i++)
+      buf[i] = (uint8_t) (imageBuf[addr+i] & 0x00FF);
+    crc = crc_update(config, crc, buf, len);
+  }
+  crc = crc_finish(config, crc);
+
+  // store CRC to image with configured byte order
+  for (i=0; i<(uint64_t) numBytes; i++) {
+    if (config->bigEndian)
+      imageBuf[addrCrc+i] = 0xFF00 | ((crc >> (8*(numBytes-1-i))) & 0xFF);
+    else
+      imageBuf[addrCrc+i] = 0xFF00 | ((crc >> (8*i)) & 0xFF);
+  }
+
+  // print message
+  if (verbose == INFORM)
+    printf("done (0x%0*" PRIx32 ")\n", 2*numBytes, crc);
+  else if (verbose == CHATTY)
+    printf("done, 0x%0*" PRIx32 " over 0x%" PRIx64 " - 0x%" PRIx64 " stored %s-endian to 0x%" PRIx64 "\n",
+      2*numBytes, crc, addrStart, addrStop, (config->bigEndian ? "big" : "little"), addrCrc);
+  fflush(stdout);
+
+} // crc_stamp_image
+
+
+// end of file
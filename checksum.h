@@ -0,0 +1,46 @@
+/**
+  \file checksum.h
+
+  \author G. Icking-Konert
+  \date 2018-12-14
+  \version 0.1
+
+  \brief declaration of checksum routines
+
+  declaration of routines for calculating CRC16/CRC32 checksums over memory image
+  ranges and for stamping the result into the image before upload.
+*/
+
+// for including file only once
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/// CRC parameter set (Rocksoft model)
+typedef struct {
+  uint8_t   width;          ///< CRC width in bits (16 or 32)
+  uint32_t  poly;           ///< polynomial in normal (MSB-first) notation
+  uint32_t  init;           ///< initial register value
+  uint32_t  xorOut;         ///< final XOR value
+  bool      reflect;        ///< reflect input bytes and result (LSB-first algorithm)
+  bool      bigEndian;      ///< store result big-endian (STM8 native) or little-endian
+} crcConfig_t;
+
+
+/// get CRC parameters from type string, e.g. "crc16", "crc32-le" or "crc16:8005:0:0:1"
+void      crc_get_config(const char *type, crcConfig_t *config);
+
+/// calculate CRC over byte buffer
+uint32_t  crc_calc(const crcConfig_t *config, const uint8_t *data, uint64_t len);
+
+/// calculate CRC over memory image range and store result in image
+void      crc_stamp_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint64_t addrCrc, const crcConfig_t *config, uint8_t verbose);
+
+#endif // _CHECKSUM_H_
+
+// end of file
@@ -0,0 +1,793 @@
+/**
+  \file farm.c
+
+  \author G. Icking-Konert
+  \date 2019-03-16
+  \version 0.1
+
+  \brief implementation of device farm scheduler
+
+  implementation of routines for running a list of heterogeneous jobs (port,
+  image, operations) on a pool of workers, e.g. for burn-in racks.
+  Each job is executed by a separate stm8gal process with output to a log
+  file per port, because the protocol routines keep per-port state and
+  terminate the process on errors. The parent process is a single-threaded
+  scheduler for a limited number of process slots ("workers"). Jobs of a port
+  run in file order. Each worker has a deque of ports, which initially are
+  distributed round-robin. An idle worker takes the next job of the first idle
+  port from the front of its own deque. If none is runnable, it steals the
+  last idle port from the back of the deque of the worker with most pending
+  jobs, and keeps this port for its following jobs. Input images (-w, -D, -o) of the jobs and of the common options
+  are parsed once and shared via a cache of S19 files.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#if defined(WIN32)
+  #include <windows.h>        // for CreateProcess()
+#else
+  #include <unistd.h>         // for fork(), execvp()
+  #include <fcntl.h>          // for open()
+  #include <sys/types.h>
+  #include <sys/wait.h>       // for waitpid()
+#endif
+#include "farm.h"
+#include "bootloader.h"
+#include "hexfile.h"
+#include "memtrack.h"
+#include "main.h"
+#include "misc.h"
+
+
+/// max. number of arguments per job
+#define FARM_MAXARG       100
+
+
+/// state of job
+typedef enum {
+  JOB_PENDING = 0,            //< waiting for port and worker
+  JOB_RUNNING,                //< executed by worker
+  JOB_DONE                    //< finished
+} jobState_t;
+
+/// job, i.e. one stm8gal run on a port
+typedef struct {
+  int         line;           //< line in job file
+  int         slot;           //< index of port
+  int         argc;           //< number of arguments w/o port
+  char        **argv;         //< arguments w/o port
+  jobState_t  state;          //< state of job
+  int         worker;         //< executing worker
+  bool        stolen;         //< executed by other than home worker
+  int         exitCode;       //< return code of process
+  uint64_t    timeReady;      //< port became free for job [ms]
+  uint64_t    timeStart;      //< start of execution [ms]
+  uint64_t    timeStop;       //< end of execution [ms]
+} farmJob_t;
+
+/// slot, i.e. port with its queue of jobs
+typedef struct {
+  char        port[STRLEN];   //< name of port
+  char        log[STRLEN];    //< log file for output of jobs
+  int         owner;          //< worker whose deque contains port
+  bool        busy;           //< job is running on port
+  int         numJobs;        //< number of jobs
+  int         numPending;     //< number of pending jobs
+  int         numFailed;      //< number of failed jobs
+  uint64_t    timeBusy;       //< sum of execution times [ms]
+  uint64_t    waitSum;        //< sum of queue wait times [ms]
+  uint64_t    waitMax;        //< max. queue wait time [ms]
+} farmSlot_t;
+
+/// worker, i.e. one running process
+typedef struct {
+  int         job;            //< running job (-1=idle)
+  #if defined(WIN32)
+    HANDLE    process;        //< handle of process
+  #else
+    pid_t     pid;            //< process ID
+  #endif
+  uint64_t    timeBusy;       //< sum of execution times [ms]
+  int         *deque;         //< own ports. Owner takes from front, other workers steal from back
+  int         numDeque;       //< number of ports in deque
+} farmWorker_t;
+
+/// cached input image
+typedef struct {
+  char        key[2*STRLEN];  //< file name and address offset
+  char        name[STRLEN];   //< name of cache file
+} farmImage_t;
+
+
+// global variables
+static farmJob_t    *s_farmJob = NULL;              //< list of jobs in file order
+static int          s_numJob = 0;                   //< number of jobs
+static farmSlot_t   *s_farmSlot = NULL;             //< list of ports
+static int          s_numSlot = 0;                  //< number of ports
+static farmWorker_t s_farmWorker[FARM_MAXWORKER];   //< pool of workers
+static int          s_numWorker = 0;                //< number of workers
+static farmImage_t  *s_farmImage = NULL;            //< cached input images
+static int          s_numImage = 0;                 //< number of cached images
+
+
+
+/**
+  \fn char *farm_strdup(const char *str)
+
+  \param[in] str      string to copy
+
+  \return allocated copy of string
+
+  copy string to heap, terminate on failure.
+*/
+static char *farm_strdup(const char *str) {
+
+  char  *copy;
+
+  if (!(copy = malloc(strlen(str)+1)))
+    Error("in 'farm_strdup()': cannot allocate string");
+  strcpy(copy, str);
+  return(copy);
+
+} // farm_strdup
+
+
+
+/**
+  \fn void farm_load(const char *jobFile)
+
+  \param[in] jobFile      name of job file
+
+  read job file. Each line contains the port followed by stm8gal options for this job,
+  e.g. "/dev/ttyUSB0  -w app.s19 -j 0x8000". Jobs on the same port are executed in file order.
+*/
+static void farm_load(const char *jobFile) {
+
+  FILE        *fp;
+  char        line[1000];
+  char        *token[FARM_MAXARG];
+  int         num, numLine = 0, k, i;
+  farmJob_t   *job;
+
+  // open job file
+  if (!(fp = fopen(jobFile, "r")))
+    Error("in 'farm_load()': cannot open job file '%s'", jobFile);
+
+  // read jobs
+  while (fgets(line, sizeof(line), fp)) {
+    numLine++;
+    if ((num = split_args(line, token, FARM_MAXARG)) == 0)
+      continue;
+    if (token[0][0] == '-')
+      Error("in 'farm_load()': missing port in line %d of '%s'", numLine, jobFile);
+
+    // find port or add new slot
+    for (k=0; k<s_numSlot; k++) {
+      if (!strcmp(s_farmSlot[k].port, token[0]))
+        break;
+    }
+    if (k == s_numSlot) {
+      if (!(s_farmSlot = realloc(s_farmSlot, (s_numSlot+1) * sizeof(*s_farmSlot))))
+        Error("in 'farm_load()': cannot allocate port list");
+      memset(&(s_farmSlot[k]), 0, sizeof(*s_farmSlot));
+      strncpy(s_farmSlot[k].port, token[0], STRLEN-1);
+      snprintf(s_farmSlot[k].log, STRLEN, "%s.%d.log", jobFile, k);
+      s_numSlot++;
+    }
+    s_farmSlot[k].numJobs++;
+    s_farmSlot[k].numPending++;
+
+    // add job
+    if (!(s_farmJob = realloc(s_farmJob, (s_numJob+1) * sizeof(*s_farmJob))))
+      Error("in 'farm_load()': cannot allocate job list");
+    job = &(s_farmJob[s_numJob++]);
+    memset(job, 0, sizeof(*job));
+    job->line = numLine;
+    job->slot = k;
+    job->argc = num - 1;
+    if (!(job->argv = calloc(num, sizeof(*(job->argv)))))
+      Error("in 'farm_load()': cannot allocate job arguments");
+    for (i=1; i<num; i++)
+      job->argv[i-1] = farm_strdup(token[i]);
+
+  } // while lines
+
+  // close job file
+  fclose(fp);
+  if (s_numJob == 0)
+    Error("in 'farm_load()': no jobs in '%s'", jobFile);
+
+} // farm_load
+
+
+
+/**
+  \fn void farm_cache(int *argc, char **argv, const char *where, uint16_t **imageBuf, uint8_t verbose)
+
+  \param[in,out] argc       number of arguments
+  \param[in,out] argv       arguments (allocated strings), file names are replaced
+  \param[in]     where      origin of arguments for messages, e.g. "line 3"
+  \param[in,out] imageBuf   image buffer, is allocated on first use
+  \param[in]     verbose    verbosity level
+
+  parse each input image (-w, -D, -o) once and store it as S19 file in the temp directory.
+  The arguments are changed to use the cached file, which is quick to import, contains absolute
+  addresses and already fails on invalid files before any job is started.
+*/
+static void farm_cache(int *argc, char **argv, const char *where, uint16_t **imageBuf, uint8_t verbose) {
+
+  char          dirTemp[STRLEN/2], name[STRLEN], key[2*STRLEN];
+  fileFormat_t  format;
+  uint64_t      addrBin, addrStart, addrStop, numData;
+  int           i, k, lenArg, pid;
+  bool          isWrite;
+
+  // get temp directory
+  #if defined(WIN32)
+    GetTempPathA(sizeof(dirTemp), dirTemp);
+    pid = (int) GetCurrentProcessId();
+  #else
+    strncpy(dirTemp, getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp", sizeof(dirTemp)-2);
+    dirTemp[sizeof(dirTemp)-2] = '\0';
+    strcat(dirTemp, "/");
+    pid = (int) getpid();
+  #endif
+
+  // loop over input images
+  for (i=0; i<*argc; i++) {
+    isWrite = ((!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "-write-file")));
+    if ((!isWrite) && (strcmp(argv[i], "-D")) && (strcmp(argv[i], "-delta-base")) && (strcmp(argv[i], "-o")) && (strcmp(argv[i], "-option-file")))
+      continue;
+
+    // get file name and address offset for binary file. Binary option file starts at option area
+    if (i+1 >= *argc)
+      Error("in 'farm_cache()': missing file name in %s", where);
+    format = get_file_format(argv[i+1], name);
+    if (!strcmp(name, "-"))
+      Error("in 'farm_cache()': stdin not supported in farm mode (%s)", where);
+    if (format == FORMAT_PLAN) {
+      i++;        // image of plan (-n) is loaded by job
+      continue;
+    }
+    addrBin = 0;
+    lenArg  = 1;
+    if (format == FORMAT_BIN) {
+      if (isWrite) {
+        if (i+2 >= *argc)
+          Error("in 'farm_cache()': missing address for binary file in %s", where);
+        sscanf(argv[i+2], "%" SCNx64, &addrBin);
+        lenArg = 2;
+      }
+      else if ((!strcmp(argv[i], "-o")) || (!strcmp(argv[i], "-option-file")))
+        addrBin = OPT_START;
+      else {
+        i++;        // binary base image is rejected by job
+        continue;
+      }
+    }
+    snprintf(key, sizeof(key), "%s@%" PRIx64, argv[i+1], addrBin);
+
+    // parse image only once
+    for (k=0; k<s_numImage; k++) {
+      if (!strcmp(s_farmImage[k].key, key))
+        break;
+    }
+    if (k == s_numImage) {
+      if (!(s_farmImage = realloc(s_farmImage, (s_numImage+1) * sizeof(*s_farmImage))))
+        Error("in 'farm_cache()': cannot allocate image cache");
+      strcpy(s_farmImage[k].key, key);
+      snprintf(s_farmImage[k].name, STRLEN, "%sstm8gal_farm_%d_%d.s19", dirTemp, pid, k);
+      s_numImage++;
+      if (*imageBuf == NULL)
+        *imageBuf = mem_alloc(MEM_IMAGE, (LENIMAGEBUF + 1) * sizeof(**imageBuf));
+      else
+        *imageBuf = mem_clear(*imageBuf);
+      import_file(name, format, addrBin, *imageBuf, MUTE);
+      get_image_size(*imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+      if (numData == 0)
+        Error("in 'farm_cache()': no data in '%s' (%s)", name, where);
+      export_s19(s_farmImage[k].name, *imageBuf, MUTE);
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("  cache image '%s' (%1.1fkB in 0x%" PRIx64 " to 0x%" PRIx64 ")\n", name, (float) numData / 1024.0, addrStart, addrStop);
+      if (verbose == CHATTY)
+        printf("    as '%s'\n", s_farmImage[k].name);
+      fflush(stdout);
+    }
+
+    // use cached image. Drop address offset of binary file
+    free(argv[i+1]);
+    argv[i+1] = farm_strdup(s_farmImage[k].name);
+    if (lenArg == 2) {
+      free(argv[i+2]);
+      memmove(&(argv[i+2]), &(argv[i+3]), (*argc - (i+3)) * sizeof(*argv));
+      (*argc)--;
+    }
+    i++;
+
+  } // loop over arguments
+
+} // farm_cache
+
+
+
+/**
+  \fn int farm_first(int slot)
+
+  \param[in]  slot        index of port
+
+  \return index of first pending job of port, or -1 if none
+
+  get next job of a port. Jobs of a port are executed in file order.
+*/
+static int farm_first(int slot) {
+
+  int   j;
+
+  for (j=0; j<s_numJob; j++) {
+    if ((s_farmJob[j].slot == slot) && (s_farmJob[j].state == JOB_PENDING))
+      return(j);
+  }
+  return(-1);
+
+} // farm_first
+
+
+
+/**
+  \fn int farm_pick(int worker, bool *stolen)
+
+  \param[in]  worker      index of idle worker
+  \param[out] stolen      job is stolen from other worker
+
+  \return index of job to start, or -1 if none is runnable
+
+  select next job for worker. Ports are runnable if idle with pending jobs. The worker takes
+  the first runnable port from the front of its own deque and moves it to the back, i.e. its
+  ports are served round-robin. If none is runnable, the last runnable port is stolen from the
+  back of the deque of the worker with most runnable jobs, and moved to the back of the own deque.
+*/
+static int farm_pick(int worker, bool *stolen) {
+
+  farmWorker_t  *own = &(s_farmWorker[worker]);
+  farmWorker_t  *victim;
+  int           i, k, w, best, load, maxLoad;
+
+  // take first runnable port from own deque and rotate it to the back
+  *stolen = false;
+  for (i=0; i<own->numDeque; i++) {
+    k = own->deque[i];
+    if ((s_farmSlot[k].busy) || (s_farmSlot[k].numPending == 0))
+      continue;
+    memmove(own->deque+i, own->deque+i+1, (own->numDeque-i-1) * sizeof(*(own->deque)));
+    own->deque[own->numDeque-1] = k;
+    return(farm_first(k));
+  }
+
+  // find worker with most runnable jobs
+  best    = -1;
+  maxLoad = 0;
+  for (w=0; w<s_numWorker; w++) {
+    if (w == worker)
+      continue;
+    load = 0;
+    for (i=0; i<s_farmWorker[w].numDeque; i++) {
+      k = s_farmWorker[w].deque[i];
+      if (!s_farmSlot[k].busy)
+        load += s_farmSlot[k].numPending;
+    }
+    if (load > maxLoad) {
+      maxLoad = load;
+      best    = w;
+    }
+  }
+  if (best < 0)
+    return(-1);
+
+  // steal last runnable port from back of its deque, port stays with this worker
+  victim = &(s_farmWorker[best]);
+  for (i=victim->numDeque-1; i>=0; i--) {
+    k = victim->deque[i];
+    if ((s_farmSlot[k].busy) || (s_farmSlot[k].numPending == 0))
+      continue;
+    memmove(victim->deque+i, victim->deque+i+1, (victim->numDeque-i-1) * sizeof(*(victim->deque)));
+    victim->numDeque--;
+    own->deque[own->numDeque++] = k;
+    s_farmSlot[k].owner = worker;
+    *stolen = true;
+    return(farm_first(k));
+  }
+  return(-1);
+
+} // farm_pick
+
+
+
+/**
+  \fn void farm_start(int worker, int idxJob, const char *appPath, int numCommon, char **common, uint8_t verbose)
+
+  \param[in] worker       index of idle worker
+  \param[in] idxJob       index of job
+  \param[in] appPath      path of stm8gal executable
+  \param[in] numCommon    number of common options
+  \param[in] common       common options for all jobs
+  \param[in] verbose      verbosity level
+
+  start job as separate process. Output is appended to the log file of the port.
+*/
+static void farm_start(int worker, int idxJob, const char *appPath, int numCommon, char **common, uint8_t verbose) {
+
+  farmJob_t   *job  = &(s_farmJob[idxJob]);
+  farmSlot_t  *slot = &(s_farmSlot[job->slot]);
+  char        **args;
+  FILE        *fp;
+  int         num = 0, i;
+
+  // assemble arguments: <app> -B <common options> -p <port> <job options>
+  if (!(args = calloc(numCommon + job->argc + 5, sizeof(*args))))
+    Error("in 'farm_start()': cannot allocate arguments");
+  args[num++] = (char*) appPath;
+  args[num++] = "-B";
+  for (i=0; i<numCommon; i++)
+    args[num++] = common[i];
+  args[num++] = "-p";
+  args[num++] = slot->port;
+  for (i=0; i<job->argc; i++)
+    args[num++] = job->argv[i];
+  args[num] = NULL;
+
+  // write header to log
+  if ((fp = fopen(slot->log, "a"))) {
+    fprintf(fp, "\n### job %d (line %d), worker %d:", idxJob+1, job->line, worker+1);
+    for (i=1; i<num; i++)
+      fprintf(fp, " %s", args[i]);
+    fprintf(fp, "\n");
+    fclose(fp);
+  }
+  fflush(stdout);
+  fflush(stderr);
+
+  // start process with output to log
+  #if defined(WIN32)
+  {
+    char                  cmd[8192];
+    SECURITY_ATTRIBUTES   sa = {sizeof(sa), NULL, TRUE};
+    STARTUPINFOA          si;
+    PROCESS_INFORMATION   pi;
+    HANDLE                hLog;
+
+    cmd[0] = '\0';
+    for (i=0; i<num; i++) {
+      if (strlen(cmd) + strlen(args[i]) + 4 >= sizeof(cmd))
+        Error("in 'farm_start()': command line too long (line %d)", job->line);
+      strcat(cmd, "\"");
+      strcat(cmd, args[i]);
+      strcat(cmd, "\" ");
+    }
+    hLog = CreateFileA(slot->log, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    ZeroMemory(&si, sizeof(si));
+    si.cb         = sizeof(si);
+    si.dwFlags    = STARTF_USESTDHANDLES;
+    si.hStdInput  = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = hLog;
+    si.hStdError  = hLog;
+    if (!CreateProcessA(appPath, cmd, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi))
+      Error("in 'farm_start()': cannot start worker (error %d)", (int) GetLastError());
+    CloseHandle(pi.hThread);
+    if (hLog != INVALID_HANDLE_VALUE)
+      CloseHandle(hLog);
+    s_farmWorker[worker].process = pi.hProcess;
+  }
+  #else
+  {
+    pid_t   pid;
+    int     fd;
+
+    if ((pid = fork()) < 0)
+      Error("in 'farm_start()': cannot start worker (%s)", strerror(errno));
+    if (pid == 0) {
+      if ((fd = open(slot->log, O_WRONLY | O_CREAT | O_APPEND, 0644)) >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+      }
+      execvp(appPath, args);
+      _exit(127);
+    }
+    s_farmWorker[worker].pid = pid;
+  }
+  #endif
+  free(args);
+
+  // update state
+  job->state     = JOB_RUNNING;
+  job->worker    = worker;
+  job->timeStart = millis();
+  slot->busy     = true;
+  slot->numPending--;
+  s_farmWorker[worker].job = idxJob;
+
+  // print message
+  if (verbose == CHATTY)
+    printf("  job %d (line %d) on '%s' started by worker %d%s\n", idxJob+1, job->line, slot->port, worker+1, (job->stolen ? " (stolen)" : ""));
+  fflush(stdout);
+
+} // farm_start
+
+
+
+/**
+  \fn int farm_wait(int *exitCode)
+
+  \param[out] exitCode    return code of finished process
+
+  \return index of worker whose job finished
+
+  wait until any running job has finished.
+*/
+static int farm_wait(int *exitCode) {
+
+  int   w;
+
+  #if defined(WIN32)
+    HANDLE  handle[FARM_MAXWORKER];
+    int     idx[FARM_MAXWORKER];
+    int     num = 0;
+    DWORD   result, code;
+
+    for (w=0; w<s_numWorker; w++) {
+      if (s_farmWorker[w].job >= 0) {
+        handle[num] = s_farmWorker[w].process;
+        idx[num++]  = w;
+      }
+    }
+    result = WaitForMultipleObjects(num, handle, FALSE, INFINITE);
+    if ((result < WAIT_OBJECT_0) || (result >= WAIT_OBJECT_0 + num))
+      Error("in 'farm_wait()': wait failed (error %d)", (int) GetLastError());
+    w = idx[result - WAIT_OBJECT_0];
+    GetExitCodeProcess(s_farmWorker[w].process, &code);
+    CloseHandle(s_farmWorker[w].process);
+    *exitCode = (int) code;
+    return(w);
+
+  #else
+    pid_t   pid;
+    int     status;
+
+    while (1) {
+      pid = waitpid(-1, &status, 0);
+      if ((pid < 0) && (errno == EINTR))
+        continue;
+      if (pid < 0)
+        Error("in 'farm_wait()': wait failed (%s)", strerror(errno));
+      for (w=0; w<s_numWorker; w++) {
+        if ((s_farmWorker[w].job >= 0) && (s_farmWorker[w].pid == pid)) {
+          *exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+          return(w);
+        }
+      }
+    }
+  #endif
+
+} // farm_wait
+
+
+
+/**
+  \fn int farm_run(const char *appPath, int numCommon, char **common, const char *jobFile, int numWorkers, uint8_t verbose)
+
+  \param[in] appPath      path of stm8gal executable (argv[0])
+  \param[in] numCommon    number of common options
+  \param[in] common       common options for all jobs, e.g. verbosity or reset method
+  \param[in] jobFile      name of job file
+  \param[in] numWorkers   max. number of jobs running in parallel
+  \param[in] verbose      verbosity level
+
+  \return number of failed jobs
+
+  run all jobs of job file on pool of workers and report utilization per port and queue wait times.
+*/
+int farm_run(const char *appPath, int numCommon, char **common, const char *jobFile, int numWorkers, uint8_t verbose) {
+
+  char        app[STRLEN], where[50];
+  char        **commonCache;
+  uint16_t    *imageBuf = NULL;
+  farmJob_t   *job;
+  farmSlot_t  *slot;
+  FILE        *fp;
+  uint64_t    timeStart, timeTotal, timeBusy, wait, waitSum, waitMax;
+  int         numDone, numFailed, numSteals, numRunning;
+  int         j, k, w, code;
+  bool        stolen;
+
+  // check number of workers
+  if ((numWorkers < 1) || (numWorkers > FARM_MAXWORKER))
+    Error("in 'farm_run()': number of workers must be 1..%d (is %d)", FARM_MAXWORKER, numWorkers);
+
+  // get path of executable
+  #if defined(WIN32)
+    GetModuleFileNameA(NULL, app, STRLEN);
+  #else
+    strncpy(app, appPath, STRLEN-1);
+    app[STRLEN-1] = '\0';
+  #endif
+
+  // read jobs and parse input images of common options and jobs once
+  farm_load(jobFile);
+  if (!(commonCache = calloc(numCommon + 1, sizeof(*commonCache))))
+    Error("in 'farm_run()': cannot allocate common options");
+  for (k=0; k<numCommon; k++)
+    commonCache[k] = farm_strdup(common[k]);
+  farm_cache(&numCommon, commonCache, "command line", &imageBuf, verbose);
+  for (j=0; j<s_numJob; j++) {
+    snprintf(where, sizeof(where), "line %d", s_farmJob[j].line);
+    farm_cache(&(s_farmJob[j].argc), s_farmJob[j].argv, where, &imageBuf, verbose);
+  }
+  mem_free(imageBuf);
+
+  // more workers than ports are never busy
+  s_numWorker = (numWorkers < s_numSlot) ? numWorkers : s_numSlot;
+  for (w=0; w<s_numWorker; w++) {
+    s_farmWorker[w].job = -1;
+    s_farmWorker[w].timeBusy = 0;
+    s_farmWorker[w].numDeque = 0;
+    if (!(s_farmWorker[w].deque = calloc(s_numSlot, sizeof(*(s_farmWorker[w].deque)))))
+      Error("in 'farm_run()': cannot allocate deque of worker");
+  }
+
+  // distribute ports round-robin to deques of workers and clear logs
+  for (k=0; k<s_numSlot; k++) {
+    w = k % s_numWorker;
+    s_farmSlot[k].owner = w;
+    s_farmWorker[w].deque[s_farmWorker[w].numDeque++] = k;
+    if ((fp = fopen(s_farmSlot[k].log, "w")))
+      fclose(fp);
+  }
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  farm: %d jobs on %d ports, %d workers\n", s_numJob, s_numSlot, s_numWorker);
+  fflush(stdout);
+
+  // first job of each port is ready immediately
+  timeStart = millis();
+  for (k=0; k<s_numSlot; k++) {
+    for (j=0; j<s_numJob; j++) {
+      if (s_farmJob[j].slot == k) {
+        s_farmJob[j].timeReady = timeStart;
+        break;
+      }
+    }
+  }
+
+  // run jobs until all are done
+  numDone    = 0;
+  numFailed  = 0;
+  numSteals  = 0;
+  numRunning = 0;
+  while (numDone < s_numJob) {
+
+    // start jobs on idle workers
+    for (w=0; w<s_numWorker; w++) {
+      if (s_farmWorker[w].job >= 0)
+        continue;
+      if ((j = farm_pick(w, &stolen)) < 0)
+        continue;
+      s_farmJob[j].stolen = stolen;
+      numSteals += (int) stolen;
+      farm_start(w, j, app, numCommon, commonCache, verbose);
+      numRunning++;
+    }
+    if (numRunning == 0)
+      Error("in 'farm_run()': no runnable job");
+
+    // wait for next finished job
+    w    = farm_wait(&code);
+    j    = s_farmWorker[w].job;
+    job  = &(s_farmJob[j]);
+    slot = &(s_farmSlot[job->slot]);
+    job->timeStop = millis();
+    job->exitCode = code;
+    job->state    = JOB_DONE;
+    numRunning--;
+    numDone++;
+    s_farmWorker[w].job = -1;
+    s_farmWorker[w].timeBusy += job->timeStop - job->timeStart;
+
+    // update port statistics
+    wait = job->timeStart - job->timeReady;
+    slot->busy      = false;
+    slot->timeBusy += job->timeStop - job->timeStart;
+    slot->waitSum  += wait;
+    if (wait > slot->waitMax)
+      slot->waitMax = wait;
+    if (code != 0) {
+      slot->numFailed++;
+      numFailed++;
+    }
+
+    // next job of port is ready now
+    for (k=j+1; k<s_numJob; k++) {
+      if ((s_farmJob[k].slot == job->slot) && (s_farmJob[k].state == JOB_PENDING)) {
+        s_farmJob[k].timeReady = job->timeStop;
+        break;
+      }
+    }
+
+    // print message
+    if ((verbose == INFORM) || (verbose == CHATTY)) {
+      if (code == 0)
+        printf("  job %d (line %d) on '%s' ok (%1.1fs)\n", j+1, job->line, slot->port, (float) (job->timeStop - job->timeStart) / 1000.0);
+      else
+        printf("  job %d (line %d) on '%s' failed with code %d (%1.1fs), see '%s'\n", j+1, job->line, slot->port, code, (float) (job->timeStop - job->timeStart) / 1000.0, slot->log);
+    }
+    fflush(stdout);
+
+  } // while jobs pending
+  timeTotal = millis() - timeStart;
+  if (timeTotal == 0)
+    timeTotal = 1;
+
+  // report per port and aggregate utilization
+  if (verbose != MUTE) {
+    printf("  farm: %d jobs ok, %d failed in %1.1fs, %d stolen\n", s_numJob - numFailed, numFailed, (float) timeTotal / 1000.0, numSteals);
+    timeBusy = 0;
+    waitSum  = 0;
+    waitMax  = 0;
+    for (k=0; k<s_numSlot; k++) {
+      slot = &(s_farmSlot[k]);
+      timeBusy += slot->timeBusy;
+      waitSum  += slot->waitSum;
+      if (slot->waitMax > waitMax)
+        waitMax = slot->waitMax;
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("    port '%s': %d jobs, %d failed, busy %1.1fs (%d%%), wait avg %1.1fs max %1.1fs\n", slot->port, slot->numJobs, slot->numFailed,
+          (float) slot->timeBusy / 1000.0, (int) (100 * slot->timeBusy / timeTotal),
+          (float) slot->waitSum / 1000.0 / (float) slot->numJobs, (float) slot->waitMax / 1000.0);
+    }
+    if (verbose == CHATTY) {
+      for (w=0; w<s_numWorker; w++)
+        printf("    worker %d: busy %1.1fs (%d%%)\n", w+1, (float) s_farmWorker[w].timeBusy / 1000.0, (int) (100 * s_farmWorker[w].timeBusy / timeTotal));
+    }
+    printf("  utilization: ports %d%%, workers %d%%, queue wait avg %1.1fs max %1.1fs\n",
+      (int) (100 * timeBusy / (timeTotal * s_numSlot)), (int) (100 * timeBusy / (timeTotal * s_numWorker)),
+      (float) waitSum / 1000.0 / (float) s_numJob, (float) waitMax / 1000.0);
+    fflush(stdout);
+  }
+
+  // remove cached images and release lists
+  for (k=0; k<s_numImage; k++)
+    remove(s_farmImage[k].name);
+  for (j=0; j<s_numJob; j++) {
+    for (k=0; k<s_farmJob[j].argc; k++)
+      free(s_farmJob[j].argv[k]);
+    free(s_farmJob[j].argv);
+  }
+  for (k=0; k<numCommon; k++)
+    free(commonCache[k]);
+  free(commonCache);
+  for (w=0; w<s_numWorker; w++) {
+    free(s_farmWorker[w].deque);
+    s_farmWorker[w].deque = NULL;
+  }
+  free(s_farmImage);
+  free(s_farmJob);
+  free(s_farmSlot);
+  s_farmImage = NULL;
+  s_farmJob   = NULL;
+  s_farmSlot  = NULL;
+  s_numImage  = 0;
+  s_numJob    = 0;
+  s_numSlot   = 0;
+
+  return(numFailed);
+
+} // farm_run
+
+
+// end of file
@@ -0,0 +1,34 @@
+/**
+  \file farm.h
+
+  \author G. Icking-Konert
+  \date 2019-03-16
+  \version 0.1
+
+  \brief declaration of device farm scheduler
+
+  declaration of routines for running a list of heterogeneous jobs (port,
+  image, operations) on a pool of workers, e.g. for burn-in racks. Each job
+  is executed by a separate stm8gal process, jobs on the same port are
+  serialized. Input images are parsed once and shared via a cache.
+*/
+
+// for including file only once
+#ifndef _FARM_H_
+#define _FARM_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// max. number of worker processes
+#define FARM_MAXWORKER    64
+
+
+/// run jobs from file on pool of workers with common options. Returns number of failed jobs
+int   farm_run(const char *appPath, int numCommon, char **common, const char *jobFile, int numWorkers, uint8_t verbose);
+
+#endif // _FARM_H_
+
+// end of file
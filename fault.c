@@ -0,0 +1,291 @@
+/**
+  \file fault.c
+
+  \author G. Icking-Konert
+  \date 2019-02-16
+  \version 0.1
+
+  \brief implementation of fault injection routines
+
+  implementation of routines for injecting faults into bootloader responses at
+  configurable rates, e.g. for testing and tuning of retry and resync paths
+  against a device or simulator. Faults are applied to the received data, the
+  device itself is not affected. The time lost per fault is measured from the
+  start of the failed frame until the start of the successful retry.
+  Only compiled if USE_FAULT is defined, see Makefile.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "fault.h"
+#include "bootloader.h"
+#include "main.h"
+#include "misc.h"
+
+#if defined(USE_FAULT)
+
+/// default delay of delayed responses [ms]
+#define FAULT_DELAY_DEFAULT   20
+
+
+// global variables
+static const char *s_faultName[FAULT_NUM] = {"drop", "corrupt", "nack", "delay", "busy", "desync"};
+static double      s_faultRate[FAULT_NUM];         //< probability of fault per response
+static uint32_t    s_faultDelay = FAULT_DELAY_DEFAULT;  //< delay of delayed responses [ms]
+static bool        s_faultActive = false;          //< any fault rate > 0
+static bool        s_faultArmed = false;           //< injection enabled for current frames
+static uint32_t    s_faultCount[FAULT_NUM];        //< number of injected faults per class
+static uint64_t    s_faultLost[FAULT_NUM];         //< time lost per class [us]
+static int         s_faultPending = -1;            //< class of first fault in current frame (-1=none)
+static uint64_t    s_faultFirst = 0;               //< start of first attempt of current frame [us]
+static uint64_t    s_faultAttempt = 0;             //< start of current attempt [us]
+static uint64_t    s_faultSeed = 1;                //< state of random generator
+
+
+
+/**
+  \fn double fault_random(void)
+
+  \return uniform random number in [0;1)
+
+  reproducible random generator (xorshift64*), independent of rand()
+*/
+static double fault_random(void) {
+
+  s_faultSeed ^= s_faultSeed >> 12;
+  s_faultSeed ^= s_faultSeed << 25;
+  s_faultSeed ^= s_faultSeed >> 27;
+  return((double) ((s_faultSeed * 0x2545F4914F6CDD1DULL) >> 11) / (double) (1ULL << 53));
+
+} // fault_random
+
+
+
+/**
+  \fn void fault_setup(const char *spec)
+
+  \param[in]  spec     comma separated list of 'class=rate', rate is probability per response.
+                       Classes: drop, corrupt, nack, delay, busy, desync. For delay optional ':ms'.
+                       Optional 'seed=n' for reproducible runs
+
+  set fault rates from string, e.g. "drop=0.01,nack=0.02,delay=0.05:20,seed=1"
+*/
+void fault_setup(const char *spec) {
+
+  char      buf[STRLEN], *item, *value;
+  int       k;
+  double    rate;
+  unsigned long long seed;
+
+  // reset configuration
+  for (k=0; k<FAULT_NUM; k++) {
+    s_faultRate[k]  = 0.0;
+    s_faultCount[k] = 0;
+    s_faultLost[k]  = 0;
+  }
+  s_faultActive = false;
+
+  // parse list of 'class=rate'
+  strncpy(buf, spec, STRLEN-1);
+  buf[STRLEN-1] = '\0';
+  for (item = strtok(buf, ","); item != NULL; item = strtok(NULL, ",")) {
+    if ((value = strchr(item, '=')) == NULL)
+      Error("fault spec '%s': expect 'class=rate'", item);
+    *(value++) = '\0';
+
+    // random seed
+    if (!strcmp(item, "seed")) {
+      if ((sscanf(value, "%llu", &seed) != 1) || (seed == 0))
+        Error("fault spec: invalid seed '%s'", value);
+      s_faultSeed = (uint64_t) seed;
+      continue;
+    }
+
+    // fault rate and optional delay
+    for (k=0; (k<FAULT_NUM) && (strcmp(item, s_faultName[k])); k++);
+    if (k == FAULT_NUM)
+      Error("fault spec: unknown class '%s' (drop, corrupt, nack, delay, busy, desync)", item);
+    if ((sscanf(value, "%lf", &rate) != 1) || (rate < 0.0) || (rate > 1.0))
+      Error("fault spec: invalid rate '%s' for '%s' (0..1)", value, item);
+    if ((k == FAULT_DELAY) && (strchr(value, ':') != NULL))
+      sscanf(strchr(value, ':')+1, "%" SCNu32, &s_faultDelay);
+    s_faultRate[k] = rate;
+    if (rate > 0.0)
+      s_faultActive = true;
+  }
+
+} // fault_setup
+
+
+
+/**
+  \fn bool fault_active(void)
+
+  \return fault injection is configured
+*/
+bool fault_active(void) {
+
+  return(s_faultActive);
+
+} // fault_active
+
+
+
+/**
+  \fn void fault_arm(bool enable)
+
+  \param[in]  enable   enable injection
+
+  enable or disable injection, e.g. only for data frames which can be repeated
+*/
+void fault_arm(bool enable) {
+
+  s_faultArmed   = (enable && s_faultActive);
+  s_faultPending = -1;
+
+} // fault_arm
+
+
+
+/**
+  \fn void fault_frame_begin(void)
+
+  mark start of a frame attempt for time accounting
+*/
+void fault_frame_begin(void) {
+
+  if (!s_faultArmed)
+    return;
+  s_faultAttempt = micros();
+  if (s_faultPending < 0)
+    s_faultFirst = s_faultAttempt;
+
+} // fault_frame_begin
+
+
+
+/**
+  \fn void fault_frame_end(void)
+
+  mark successful end of a frame. Time from start of first attempt to start of the
+  successful attempt is added to the class of the first fault in this frame
+*/
+void fault_frame_end(void) {
+
+  if ((!s_faultArmed) || (s_faultPending < 0))
+    return;
+  s_faultLost[s_faultPending] += s_faultAttempt - s_faultFirst;
+  s_faultPending = -1;
+
+} // fault_frame_end
+
+
+
+/**
+  \fn uint32_t fault_inject(uint32_t lenRx, char *Rx, uint32_t len)
+
+  \param[in]     lenRx   number of expected bytes
+  \param[in,out] Rx      received bytes
+  \param[in]     len     number of received bytes
+
+  \return number of received bytes after fault injection
+
+  inject at most one fault into received response. Waiting for a timeout is emulated by SLEEP().
+  Only the ACK byte is corrupted, as the READ data has no checksum.
+*/
+uint32_t fault_inject(uint32_t lenRx, char *Rx, uint32_t len) {
+
+  double  r, sum;
+  int     k;
+
+  // only complete responses
+  if ((!s_faultArmed) || (len != lenRx) || (len == 0))
+    return(len);
+
+  // select fault class
+  r = fault_random();
+  sum = 0.0;
+  for (k=0; k<FAULT_NUM; k++) {
+    sum += s_faultRate[k];
+    if (r < sum)
+      break;
+  }
+  if (k == FAULT_NUM)
+    return(len);
+  s_faultCount[k]++;
+
+  // delay is no retry -> account directly
+  if ((k == FAULT_DELAY) && (s_faultDelay < g_timing.timeout)) {
+    SLEEP(s_faultDelay);
+    s_faultLost[k] += 1000L * s_faultDelay;
+    return(len);
+  }
+
+  // remember first fault of frame for time accounting
+  if (s_faultPending < 0)
+    s_faultPending = k;
+
+  // apply fault
+  switch (k) {
+    case FAULT_DROP:
+      SLEEP(g_timing.timeout);      // host waits for missing byte
+      return(len-1);
+    case FAULT_CORRUPT:
+      Rx[0] ^= (char) (1 << (int) (fault_random() * 8.0));
+      return(len);
+    case FAULT_NACK:
+      Rx[0] = NACK;
+      return(len);
+    case FAULT_BUSY:
+      Rx[0] = BUSY;
+      return(len);
+    default:                        // desync or delay beyond timeout
+      SLEEP(g_timing.timeout);
+      return(0);
+  }
+
+} // fault_inject
+
+
+
+/**
+  \fn void fault_report(uint8_t verbose)
+
+  \param[in]  verbose  verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  print number of injected faults and time lost per fault class
+*/
+void fault_report(uint8_t verbose) {
+
+  int       k;
+  uint32_t  numTotal = 0;
+  uint64_t  lostTotal = 0;
+
+  if ((!s_faultActive) || (verbose == MUTE))
+    return;
+
+  for (k=0; k<FAULT_NUM; k++) {
+    numTotal  += s_faultCount[k];
+    lostTotal += s_faultLost[k];
+  }
+  printf("  injected %d faults, lost %1.1fms\n", (int) numTotal, (float) lostTotal / 1000.0);
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    for (k=0; k<FAULT_NUM; k++) {
+      if (s_faultCount[k] == 0)
+        continue;
+      printf("    %-8s %4d x, lost %8.1fms, avg %6.1fms\n", s_faultName[k], (int) s_faultCount[k],
+        (float) s_faultLost[k] / 1000.0, (float) s_faultLost[k] / 1000.0 / (float) s_faultCount[k]);
+    }
+  }
+  fflush(stdout);
+
+} // fault_report
+
+#endif // USE_FAULT
+
+
+// end of file
@@ -0,0 +1,75 @@
+/**
+  \file fault.h
+
+  \author G. Icking-Konert
+  \date 2019-02-16
+  \version 0.1
+
+  \brief declaration of fault injection routines
+
+  declaration of routines for injecting faults into bootloader responses at
+  configurable rates, e.g. for testing and tuning of retry and resync paths.
+  The time lost to each fault class is measured and reported. Only available
+  if built with USE_FAULT, else the hooks compile to nothing.
+*/
+
+// for including file only once
+#ifndef _FAULT_H_
+#define _FAULT_H_
+
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#if defined(USE_FAULT)
+
+/// classes of injected faults
+typedef enum {
+  FAULT_DROP = 0,           ///< one byte of response lost -> timeout
+  FAULT_CORRUPT,            ///< bit error in ACK byte
+  FAULT_NACK,               ///< ACK replaced by NACK
+  FAULT_DELAY,              ///< response delayed
+  FAULT_BUSY,               ///< ACK replaced by BUSY
+  FAULT_DESYNC,             ///< response lost and input discarded until timeout
+  FAULT_NUM                 ///< number of fault classes
+} faultClass_t;
+
+
+/// set fault rates from string, e.g. "drop=0.01,nack=0.02,delay=0.05:20,seed=1"
+void      fault_setup(const char *spec);
+
+/// check if fault injection is active
+bool      fault_active(void);
+
+/// enable or disable injection, e.g. only for data frames which can be repeated
+void      fault_arm(bool enable);
+
+/// mark start of a frame attempt for time accounting
+void      fault_frame_begin(void);
+
+/// mark successful end of a frame, add time of failed attempts to pending fault
+void      fault_frame_end(void);
+
+/// inject faults into received response. Returns new number of received bytes
+uint32_t  fault_inject(uint32_t lenRx, char *Rx, uint32_t len);
+
+/// print statistics of injected faults and time lost
+void      fault_report(uint8_t verbose);
+
+#else // USE_FAULT
+
+// w/o fault injection the hooks have no effect
+#define   fault_active()                  false
+#define   fault_arm(enable)
+#define   fault_frame_begin()
+#define   fault_frame_end()
+#define   fault_inject(lenRx, Rx, len)    (len)
+#define   fault_report(verbose)
+
+#endif // USE_FAULT
+
+#endif // _FAULT_H_
+
+// end of file
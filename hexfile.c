@@ -21,7 +21,27 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(WIN32)
+  #include <io.h>
+  #include <fcntl.h>
+#endif
+#if defined(WIN32)
+  #include <windows.h>        // for CreateThread()
+#else
+  #include <pthread.h>        // for parallel import of files
+#endif
+#if defined(USE_ZLIB)
+  #include <zlib.h>           // for gzip compressed files
+#endif
+#if defined(USE_LZMA)
+  #include <lzma.h>           // for xz compressed files
+#endif
 #include "hexfile.h"
+#include "logger.h"
+#include "memtrack.h"
+#include "plan.h"
 #include "main.h"
 #include "misc.h"
 
@@ -63,19 +83,63 @@ char *get_line(char **buf, char *line) {
 
 
 
+/// compression of input file
+typedef enum {COMPRESS_NONE=0, COMPRESS_GZIP, COMPRESS_XZ} compression_t;
+
+/// input file, decompressed chunk by chunk on read
+typedef struct {
+  FILE            *fp;                // file to read from
+  bool            flagStdin;          // file is stdin, i.e. don't close
+  const char      *filename;          // name of file for error messages
+  compression_t   compression;        // compression detected from magic number
+  uint8_t         head[6];            // magic number read for detecting compression
+  size_t          posHead;            // next byte of magic number to return (uncompressed file)
+  size_t          lenHead;            // bytes of magic number not yet returned (uncompressed file)
+  bool            end;                // end of data reached
+  #if defined(USE_ZLIB)
+    z_stream      gz;                 // gzip decompressor
+    int           gzResult;           // result of last inflate()
+  #endif
+  #if defined(USE_LZMA)
+    lzma_stream   xz;                 // xz decompressor
+    lzma_action   xzAction;           // LZMA_RUN, or LZMA_FINISH after EOF
+  #endif
+  uint8_t         inBuf[64*1024];     // chunk of compressed data
+} inFile_t;
+
+/// input of converters. Memory buffer, optionally refilled from file for streamed import
+typedef struct {
+  char            *buf;               // data buffer, terminated by '\0' after len
+  uint64_t        size;               // size of buffer w/o terminator
+  uint64_t        len;                // number of valid bytes in buffer
+  char            *p;                 // read position in buffer
+  inFile_t        *file;              // file to refill buffer from (NULL=buffer only)
+} inSource_t;
+
+// converters reading from buffer or streamed file, see below
+static void convert_s19_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose);
+static void convert_ihx_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose);
+static void convert_txt_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose);
+static void convert_bin_source(inSource_t *src, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose);
+
+
+
 /**
-   \fn void load_file(const char *filename, char *fileBuf, uint64_t *lenFileBuf, uint8_t verbose)
+   \fn void infile_open(inFile_t *in, const char *filename, uint8_t verbose)
 
-   \param[in]  filename     name of file to read
-   \param[out] fileBuf      memory buffer containing file content
-   \param[out] lenFileBuf   size of data [B] read from file
+   \param[out] in           input file
+   \param[in]  filename     name of file to read ("-" for stdin)
    \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
 
-   read file from file to memory buffer. Don't interpret (is done in separate routine)
+   open file and detect compression by magic number. Files compressed with gzip (USE_ZLIB)
+   or xz (USE_LZMA) are decompressed on the fly by infile_read().
 */
-void load_file(const char *filename, char *fileBuf, uint64_t *lenFileBuf, uint8_t verbose) {
+static void infile_open(inFile_t *in, const char *filename, uint8_t verbose) {
 
-  FILE      *fp;
+  // filename "-" reads from stdin, e.g. for piping from a build tool
+  memset(in, 0, sizeof(*in));
+  in->filename  = filename;
+  in->flagStdin = (strcmp(filename, "-") == 0);
 
   // strip path from filename for readability
   #if defined(WIN32)
@@ -83,7 +147,9 @@ void load_file(const char *filename, char *fileBuf, uint64_t *lenFileBuf, uint8_
   #else
     const char *shortname = strrchr(filename, '/');
   #endif
-  if (!shortname)
+  if (in->flagStdin)
+    shortname = "stdin";
+  else if (!shortname)
     shortname = filename;
   else
     shortname++;
@@ -94,61 +160,927 @@ void load_file(const char *filename, char *fileBuf, uint64_t *lenFileBuf, uint8_
   fflush(stdout);
 
   // open file to read
-  if (!(fp = fopen(filename, "rb")))
+  if (in->flagStdin) {
+    in->fp = stdin;
+    #if defined(WIN32)
+      _setmode(_fileno(stdin), _O_BINARY);
+    #endif
+  }
+  else if (!(in->fp = fopen(filename, "rb")))
     Error("Failed to open file %s", filename);
 
-  // get filesize
-  fseek(fp, 0, SEEK_END);
-  (*lenFileBuf) = ftell(fp);
-  fseek(fp, 0, SEEK_SET);
+  // read magic number to detect compressed files
+  in->lenHead = fread(in->head, 1, sizeof(in->head), in->fp);
+
+  // gzip compressed file. 15+32 = max window with automatic gzip/zlib header detection
+  if ((in->lenHead >= 2) && (in->head[0] == 0x1F) && (in->head[1] == 0x8B)) {
+    #if defined(USE_ZLIB)
+      if (inflateInit2(&(in->gz), 15+32) != Z_OK)
+        Error("Failed to init gzip decompression for file %s", filename);
+      memcpy(in->inBuf, in->head, in->lenHead);
+      in->gz.next_in  = in->inBuf;
+      in->gz.avail_in = in->lenHead;
+      in->gzResult    = Z_OK;
+      in->lenHead     = 0;
+      in->compression = COMPRESS_GZIP;
+    #else
+      Error("File %s is gzip compressed, build with USE_ZLIB for support", filename);
+    #endif
+  }
+
+  // xz compressed file
+  else if ((in->lenHead == 6) && (!memcmp(in->head, "\xFD" "7zXZ\x00", 6))) {
+    #if defined(USE_LZMA)
+      lzma_stream  strm = LZMA_STREAM_INIT;
+      in->xz = strm;
+      if (lzma_stream_decoder(&(in->xz), UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+        Error("Failed to init xz decompression for file %s", filename);
+      memcpy(in->inBuf, in->head, in->lenHead);
+      in->xz.next_in  = in->inBuf;
+      in->xz.avail_in = in->lenHead;
+      in->xzAction    = LZMA_RUN;
+      in->lenHead     = 0;
+      in->compression = COMPRESS_XZ;
+    #else
+      Error("File %s is xz compressed, build with USE_LZMA for support", filename);
+    #endif
+  }
 
-  // check file size vs. buffer
-  if ((*lenFileBuf) > LENFILEBUF)
-    Error("File %s exceeded buffer size (%ld vs %ld)", (*lenFileBuf), LENFILEBUF);
+} // infile_open
+
+
+
+/**
+   \fn uint64_t infile_read(inFile_t *in, char *buf, uint64_t len)
+
+   \param[in,out] in        input file
+   \param[out]    buf       buffer for (decompressed) data
+   \param[in]     len       max. number of bytes to read
+
+   \return number of bytes read, 0 at end of file
+
+   read next chunk of data from file. Compressed files are decompressed only as far as
+   required to fill the buffer, i.e. the decompressed size is not limited by a buffer.
+   Concatenated gzip members and xz streams are supported.
+*/
+static uint64_t infile_read(inFile_t *in, char *buf, uint64_t len) {
+
+  uint64_t  num = 0;
+
+  // end of data already reached
+  if ((in->end) || (len == 0))
+    return(0);
+
+  // gzip compressed file
+  #if defined(USE_ZLIB)
+  if (in->compression == COMPRESS_GZIP) {
+
+    in->gz.next_out  = (Bytef*) buf;
+    in->gz.avail_out = len;
+    while (in->gz.avail_out > 0) {
+
+      // refill input buffer. On EOF the last member must be complete
+      if (in->gz.avail_in == 0) {
+        in->gz.next_in  = in->inBuf;
+        in->gz.avail_in = fread(in->inBuf, 1, sizeof(in->inBuf), in->fp);
+        if (in->gz.avail_in == 0) {
+          if (ferror(in->fp))
+            Error("Failed to read file %s", in->filename);
+          if (in->gzResult != Z_STREAM_END)
+            Error("File %s is truncated", in->filename);
+          in->end = true;
+          break;
+        }
+      }
+
+      // decompress available data
+      in->gzResult = inflate(&(in->gz), Z_NO_FLUSH);
+      if ((in->gzResult != Z_OK) && (in->gzResult != Z_STREAM_END) && (in->gzResult != Z_BUF_ERROR))
+        Error("Failed to decompress file %s (code %d)", in->filename, in->gzResult);
+
+      // end of gzip member -> continue with next member, if any
+      if (in->gzResult == Z_STREAM_END)
+        inflateReset(&(in->gz));
+
+    } // loop until buffer full
+    return(len - in->gz.avail_out);
+
+  } // gzip
+  #endif // USE_ZLIB
+
+  // xz compressed file
+  #if defined(USE_LZMA)
+  if (in->compression == COMPRESS_XZ) {
 
-  // init memory image to zero
-  memset(fileBuf, 0, LENFILEBUF * sizeof(*fileBuf));
+    lzma_ret  result;
 
-  // read file to buffer
-  fread(fileBuf, (*lenFileBuf), 1, fp);
+    in->xz.next_out  = (uint8_t*) buf;
+    in->xz.avail_out = len;
+    while (in->xz.avail_out > 0) {
+
+      // refill input buffer. On EOF finish stream
+      if ((in->xz.avail_in == 0) && (in->xzAction == LZMA_RUN)) {
+        in->xz.next_in  = in->inBuf;
+        in->xz.avail_in = fread(in->inBuf, 1, sizeof(in->inBuf), in->fp);
+        if (in->xz.avail_in == 0) {
+          if (ferror(in->fp))
+            Error("Failed to read file %s", in->filename);
+          in->xzAction = LZMA_FINISH;
+        }
+      }
+
+      // decompress available data
+      result = lzma_code(&(in->xz), in->xzAction);
+      if (result == LZMA_STREAM_END) {
+        in->end = true;
+        break;
+      }
+      if (result != LZMA_OK)
+        Error("Failed to decompress file %s (code %d)", in->filename, (int) result);
+
+    } // loop until buffer full
+    return(len - in->xz.avail_out);
+
+  } // xz
+  #endif // USE_LZMA
+
+  // uncompressed file -> first return magic number, then read from file
+  if (in->lenHead > 0) {
+    num = (len < in->lenHead) ? len : in->lenHead;
+    memcpy(buf, in->head + in->posHead, num);
+    in->posHead += num;
+    in->lenHead -= num;
+  }
+  num += fread(buf+num, 1, len-num, in->fp);
+  if (ferror(in->fp))
+    Error("Failed to read file %s", in->filename);
+  if (num == 0)
+    in->end = true;
+  return(num);
+
+} // infile_read
+
+
+
+/**
+   \fn void infile_close(inFile_t *in)
+
+   \param[in,out] in        input file
+
+   release decompressor and close file
+*/
+static void infile_close(inFile_t *in) {
+
+  // release decompressor
+  #if defined(USE_ZLIB)
+    if (in->compression == COMPRESS_GZIP)
+      inflateEnd(&(in->gz));
+  #endif
+  #if defined(USE_LZMA)
+    if (in->compression == COMPRESS_XZ)
+      lzma_end(&(in->xz));
+  #endif
 
   // close file again
-  fclose(fp);
+  if (!in->flagStdin)
+    fclose(in->fp);
+
+} // infile_close
+
+
+
+/**
+   \fn void load_done(uint64_t lenFile, bool streamed, uint8_t verbose)
+
+   \param[in]  lenFile      size of data [B] read from file
+   \param[in]  streamed     file is decompressed while converting, i.e. size is not yet known
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   print result of loading file
+*/
+static void load_done(uint64_t lenFile, bool streamed, uint8_t verbose) {
 
   // print message
   if ((verbose == SILENT) || (verbose == INFORM)){
     printf("done\n");
   }
   else if (verbose == CHATTY) {
-    if ((*lenFileBuf)>1024*1024)
-      printf("done (%1.1fMB)\n", (float) (*lenFileBuf)/1024.0/1024.0);
-    else if ((*lenFileBuf)>1024)
-      printf("done (%1.1fkB)\n", (float) (*lenFileBuf)/1024.0);
-    else if ((*lenFileBuf)>0)
-      printf("done (%dB)\n", (int) (*lenFileBuf));
+    if (streamed)
+      printf("done (streamed)\n");
+    else if (lenFile>1024*1024)
+      printf("done (%1.1fMB)\n", (float) lenFile/1024.0/1024.0);
+    else if (lenFile>1024)
+      printf("done (%1.1fkB)\n", (float) lenFile/1024.0);
+    else if (lenFile>0)
+      printf("done (%dB)\n", (int) lenFile);
     else
       printf("done, no data read\n");
   }
   fflush(stdout);
 
+} // load_done
+
+
+
+/**
+   \fn void load_file(const char *filename, char *fileBuf, uint64_t *lenFileBuf, uint8_t verbose)
+
+   \param[in]  filename     name of file to read ("-" for stdin)
+   \param[out] fileBuf      memory buffer containing file content (size LENFILEBUF+1)
+   \param[out] lenFileBuf   size of data [B] read from file
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   read file from file to memory buffer. Don't interpret (is done in separate routine).
+   File is read in chunks until EOF, i.e. no seek is required and pipes or stdin are supported.
+   Files compressed with gzip (USE_ZLIB) or xz (USE_LZMA) are detected by their magic number
+   and decompressed directly into the memory buffer.
+*/
+void load_file(const char *filename, char *fileBuf, uint64_t *lenFileBuf, uint8_t verbose) {
+
+  inFile_t  *in;
+  uint64_t  lenChunk;
+  char      dummy;
+
+  // open file and detect compression
+  in = mem_alloc(MEM_FILE, sizeof(*in));
+  infile_open(in, filename, verbose);
+
+  // read file to buffer in chunks until EOF. Don't use fseek/ftell for size, which fails for pipes
+  (*lenFileBuf) = 0;
+  while ((*lenFileBuf) < LENFILEBUF) {
+    lenChunk = infile_read(in, fileBuf+(*lenFileBuf), LENFILEBUF-(*lenFileBuf));
+    if (lenChunk == 0)
+      break;
+    (*lenFileBuf) += lenChunk;
+  }
+
+  // check file size vs. buffer
+  if (((*lenFileBuf) == LENFILEBUF) && (infile_read(in, &dummy, 1) != 0))
+    Error("File %s exceeded buffer size (%dMB)", filename, (int) (LENFILEBUF/1024L/1024L));
+
+  // terminate buffer for line parsers (buffer has size LENFILEBUF+1)
+  fileBuf[(*lenFileBuf)] = '\0';
+
+  // close file again
+  infile_close(in);
+  mem_free(in);
+
+  // print message
+  load_done(*lenFileBuf, false, verbose);
+
 } // load_file
 
 
 
 /**
-   \fn void convert_s19(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose)
+   \fn bool source_fill(inSource_t *src)
 
-   \param[in]  fileBuf      memory buffer to read from
-   \param[in]  lenFileBuf   length of memory buffer
+   \param[in,out] src       input of converter
+
+   \return true if data was appended
+
+   move unread data to start of buffer and append next chunk from file. Buffers w/o file are not changed.
+*/
+static bool source_fill(inSource_t *src) {
+
+  uint64_t  lenRest, num;
+
+  // buffer only
+  if (src->file == NULL)
+    return(false);
+
+  // move unread data to start of buffer
+  lenRest = src->len - (uint64_t) (src->p - src->buf);
+  memmove(src->buf, src->p, lenRest);
+  src->p   = src->buf;
+  src->len = lenRest;
+
+  // append next chunk and terminate for line parsers (buffer has size+1)
+  num = infile_read(src->file, src->buf + src->len, src->size - src->len);
+  src->len += num;
+  src->buf[src->len] = '\0';
+
+  return(num > 0);
+
+} // source_fill
+
+
+
+/**
+   \fn void source_all(inSource_t *src)
+
+   \param[in,out] src       input of converter
+
+   read remainder of file to buffer, e.g. for ELF which requires random access. Buffer size is
+   doubled as required up to LENFILEBUF, i.e. it only grows to the actual (decompressed) file size.
+*/
+static void source_all(inSource_t *src) {
+
+  char      *buf, dummy;
+  uint64_t  size, num;
+
+  // buffer only
+  if (src->file == NULL)
+    return;
+
+  // read until EOF
+  while (1) {
+
+    // buffer full -> double buffer size
+    if (src->len == src->size) {
+      if (src->size >= LENFILEBUF) {
+        if (infile_read(src->file, &dummy, 1) != 0)
+          Error("File %s exceeded buffer size (%dMB)", src->file->filename, (int) (LENFILEBUF/1024L/1024L));
+        break;
+      }
+      size = 2 * src->size;
+      if (size > LENFILEBUF)
+        size = LENFILEBUF;
+      buf = mem_alloc(MEM_FILE, size + 1);
+      memcpy(buf, src->buf, src->len);
+      src->p = buf + (src->p - src->buf);
+      mem_free(src->buf);
+      src->buf  = buf;
+      src->size = size;
+    }
+
+    // read next chunk
+    num = infile_read(src->file, src->buf + src->len, src->size - src->len);
+    if (num == 0)
+      break;
+    src->len += num;
+
+  } // loop until EOF
+
+  // terminate buffer. All data is in buffer now
+  src->buf[src->len] = '\0';
+  src->file = NULL;
+
+} // source_all
+
+
+
+/**
+   \fn char *source_line(inSource_t *src, char *line)
+
+   \param[in,out] src       input of converter
+   \param[out]    line      line read (size 1000)
+
+   \return line, or NULL at end of data
+
+   read next line like get_line(). For streamed import the buffer is refilled until it contains
+   a complete line, i.e. lines may be split between chunks.
+*/
+static char *source_line(inSource_t *src, char *line) {
+
+  // streamed import -> refill buffer until it contains a complete line. Buffer is terminated
+  if (src->file != NULL) {
+
+    // skip line breaks, e.g. CR+LF split between chunks
+    while (1) {
+      while ((*(src->p) == '\n') || (*(src->p) == '\r'))
+        (src->p)++;
+      if (strpbrk(src->p, "\r\n") != NULL)
+        break;
+      if (!source_fill(src))
+        break;
+    }
+
+    // check line length vs. line buffer of converters
+    if (strcspn(src->p, "\r\n") >= 1000)
+      Error("File %s contains line with >1000 characters", src->file->filename);
+
+  } // streamed import
+
+  // on end of data terminate
+  if ((uint64_t) (src->p - src->buf) >= src->len)
+    return(NULL);
+
+  // get next line
+  return(get_line(&(src->p), line));
+
+} // source_line
+
+
+
+/**
+   \fn fileFormat_t get_file_format(const char *name, char *filename)
+
+   \param[in]  name         file name as given on commandline, optionally with format prefix, e.g. "s19:-"
+   \param[out] filename     file name without format prefix (has to be large enough)
+
+   \return file format, or FORMAT_UNKNOWN if it has to be detected from content
+
+   get import format from an optional prefix "fmt:" (s19, hex, ihx, txt, bin, elf), else from file extension.
+   Prefix "plan:" references an image of the loaded plan by index, see plan_load().
+*/
+fileFormat_t get_file_format(const char *name, char *filename) {
+
+  fileFormat_t  format = FORMAT_UNKNOWN;
+  int           lenPrefix = 4;
+
+  // check for format prefix. Only accept known formats to avoid confusion with drive letters, e.g. "C:\"
+  if (!strncmp(name, "s19:", 4))
+    format = FORMAT_S19;
+  else if ((!strncmp(name, "hex:", 4)) || (!strncmp(name, "ihx:", 4)))
+    format = FORMAT_IHX;
+  else if (!strncmp(name, "txt:", 4))
+    format = FORMAT_TXT;
+  else if (!strncmp(name, "bin:", 4))
+    format = FORMAT_BIN;
+  else if (!strncmp(name, "elf:", 4))
+    format = FORMAT_ELF;
+  else if (!strncmp(name, "plan:", 5)) {
+    format = FORMAT_PLAN;
+    lenPrefix = 5;
+  }
+
+  // copy name w/o prefix
+  if (format != FORMAT_UNKNOWN)
+    name += lenPrefix;
+  strncpy(filename, name, STRLEN-1);
+  filename[STRLEN-1] = '\0';
+
+  // w/o prefix derive format from file extension
+  if (format == FORMAT_UNKNOWN) {
+    if (strstr(filename, ".s19") != NULL)
+      format = FORMAT_S19;
+    else if ((strstr(filename, ".hex") != NULL) || (strstr(filename, ".ihx") != NULL))
+      format = FORMAT_IHX;
+    else if (strstr(filename, ".txt") != NULL)
+      format = FORMAT_TXT;
+    else if (strstr(filename, ".bin") != NULL)
+      format = FORMAT_BIN;
+    else if ((strstr(filename, ".elf") != NULL) || (strstr(filename, ".sm8") != NULL))
+      format = FORMAT_ELF;
+  }
+
+  // return format
+  return(format);
+
+} // get_file_format
+
+
+
+/**
+   \fn uint64_t get_file_size(const char *filename)
+
+   \param[in]  filename     name of file ("-" for stdin)
+
+   \return size of (decompressed) file [B], or 0 if unknown
+
+   get size of file content without reading it, e.g. for checking the memory budget. For gzip
+   the size is taken from the trailer of the last member (modulo 4GB), for xz from the index of
+   the last stream (USE_LZMA). Size of pipes or stdin is unknown.
+*/
+static uint64_t get_file_size(const char *filename) {
+
+  struct stat  info;
+  FILE         *fp;
+  uint8_t      magic[6], tail[12];
+  uint64_t     size;
+
+  // only regular files
+  if ((!strcmp(filename, "-")) || (stat(filename, &info) != 0) || ((info.st_mode & S_IFMT) != S_IFREG))
+    return(0);
+  if (!(fp = fopen(filename, "rb")))
+    return(0);
+  size = (uint64_t) info.st_size;
+
+  // gzip compressed file -> size (modulo 4GB) in last 4 bytes (LSB first)
+  if ((fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) && (magic[0] == 0x1F) && (magic[1] == 0x8B)) {
+    size = 0;
+    if ((fseek(fp, -4, SEEK_END) == 0) && (fread(tail, 1, 4, fp) == 4))
+      size = (uint64_t) tail[0] | ((uint64_t) tail[1] << 8) | ((uint64_t) tail[2] << 16) | ((uint64_t) tail[3] << 24);
+  }
+
+  // xz compressed file -> sum of uncompressed sizes in index, which precedes the 12B stream footer
+  else if (!memcmp(magic, "\xFD" "7zXZ\x00", 6)) {
+    size = 0;
+    #if defined(USE_LZMA)
+      uint64_t     lenIndex, memLimit = UINT64_MAX;
+      uint8_t      *index;
+      size_t       pos = 0;
+      lzma_index   *idx;
+      if ((fseek(fp, -12, SEEK_END) == 0) && (fread(tail, 1, 12, fp) == 12) && (tail[10] == 'Y') && (tail[11] == 'Z')) {
+        lenIndex = ((uint64_t) tail[4] | ((uint64_t) tail[5] << 8) | ((uint64_t) tail[6] << 16) | ((uint64_t) tail[7] << 24)) + 1;
+        lenIndex *= 4;
+        if ((lenIndex <= LENCHUNKBUF) && (fseek(fp, -(long) (12 + lenIndex), SEEK_END) == 0) && ((index = malloc(lenIndex)) != NULL)) {
+          if ((fread(index, 1, lenIndex, fp) == lenIndex) && (lzma_index_buffer_decode(&idx, &memLimit, NULL, index, &pos, lenIndex) == LZMA_OK)) {
+            size = lzma_index_uncompressed_size(idx);
+            lzma_index_end(idx, NULL);
+          }
+          free(index);
+        }
+      }
+    #endif // USE_LZMA
+  }
+
+  fclose(fp);
+  return(size);
+
+} // get_file_size
+
+
+
+/**
+   \fn void import_file(const char *filename, fileFormat_t format, uint64_t addrBin, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in]  filename     name of file to read ("-" for stdin)
+   \param[in]  format       file format. For FORMAT_UNKNOWN detect S19, IHX or ELF from content
+   \param[in]  addrBin      address offset for binary import
+   \param[out] imageBuf     RAM image of file. HB!=0 indicates content
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   read file chunk by chunk into the converter, i.e. the file is never held in memory completely.
+   Compressed files are decompressed on the fly. ELF files require random access and are read completely.
+   With memory budget the resident memory is estimated from the (decompressed) file size and format,
+   and checked before buffers are allocated.
+*/
+void import_file(const char *filename, fileFormat_t format, uint64_t addrBin, uint16_t *imageBuf, uint8_t verbose) {
+
+  inFile_t    *in;                 // input file, optionally decompressed
+  inSource_t  src;                 // input of converter
+  char        *fileBuf;            // RAM buffer for (start of) input file
+  uint64_t    lenFile;             // length of data in fileBuf
+  bool        streamed;            // convert while reading file
+  uint64_t    need;                // estimated memory for import
+
+  // image of compiled plan is already resolved
+  if (format == FORMAT_PLAN) {
+    plan_image(filename, imageBuf, verbose);
+    return;
+  }
+
+  // with memory budget estimate memory before allocating buffers. Image needs 2B per data byte, and
+  // text formats need at least 2 characters per data byte. ELF is read completely (incl. buffer growth)
+  if (mem_sparse()) {
+    lenFile = get_file_size(filename);
+    need    = LENCHUNKBUF + sizeof(inFile_t);
+    if (format == FORMAT_BIN)
+      need += 2 * lenFile;
+    else if (format == FORMAT_ELF)
+      need += 4 * lenFile;
+    else
+      need += lenFile;
+    mem_check_need(filename, need);
+  }
+
+  // open file and detect compression
+  in = mem_alloc(MEM_FILE, sizeof(*in));
+  infile_open(in, filename, verbose);
+
+  // read 1st chunk of (decompressed) file. +1 for terminator
+  src.size = LENCHUNKBUF;
+  src.buf  = mem_alloc(MEM_FILE, (src.size + 1) * sizeof(*(src.buf)));
+  src.p    = src.buf;
+  src.len  = 0;
+  src.file = in;
+  source_fill(&src);
+  fileBuf  = src.buf;
+  lenFile  = src.len;
+
+  // for unknown format (e.g. stdin w/o prefix) check first character
+  if (format == FORMAT_UNKNOWN) {
+    if ((lenFile > 1) && (fileBuf[0] == 'S') && (isdigit((int) fileBuf[1])))
+      format = FORMAT_S19;
+    else if ((lenFile > 0) && (fileBuf[0] == ':'))
+      format = FORMAT_IHX;
+    else if ((lenFile > 3) && (!memcmp(fileBuf, "\x7F" "ELF", 4)))
+      format = FORMAT_ELF;
+  }
+
+  // text or binary file -> read (and decompress) while converting. ELF requires complete file
+  streamed = (format != FORMAT_ELF);
+  if (!streamed)
+    source_all(&src);
+  load_done(src.len, streamed, verbose);
+
+  // convert to memory image, depending on file type
+  if (format == FORMAT_S19)           // Motorola S-record format
+    convert_s19_source(&src, imageBuf, verbose);
+  else if (format == FORMAT_IHX)      // Intel HEX-format
+    convert_ihx_source(&src, imageBuf, verbose);
+  else if (format == FORMAT_TXT)      // text table (Addr / Data)
+    convert_txt_source(&src, imageBuf, verbose);
+  else if (format == FORMAT_BIN)      // binary file
+    convert_bin_source(&src, addrBin, imageBuf, verbose);
+  else if (format == FORMAT_ELF)      // ELF executable
+    convert_elf(src.buf, src.len, imageBuf, verbose);
+  else
+    Error("Input file %s has unsupported format (*.s19, *.hex, *.ihx, *.txt, *.bin, *.elf, or prefix 'fmt:')", filename);
+
+  // close file and release intermediate buffers
+  infile_close(in);
+  mem_free(in);
+  mem_free(src.buf);
+  mem_check("import");
+
+} // import_file
+
+
+
+/// parameters and result of a single file import for import_files()
+typedef struct {
+  const char    *filename;        // name of file to read ("-" for stdin)
+  fileFormat_t  format;           // file format, see import_file()
+  uint64_t      addrBin;          // address offset for binary import
+  uint16_t      *imageBuf;        // private memory image of file
+} importJob_t;
+
+
+
+/// handle of background import, see import_files_start()
+struct importTask_s {
+  int           numFiles;         // number of files to import
+  char          **filenames;      // names of files to read ("-" for stdin)
+  fileFormat_t  *formats;         // file formats, see import_file()
+  uint64_t      *addrBin;         // address offsets for binary import
+  uint16_t      *imageBuf;        // resulting memory image
+  #if defined(WIN32)
+    HANDLE      thread;           // import thread (NULL if not started)
+  #else
+    pthread_t   thread;           // import thread
+    bool        started;          // thread was started
+  #endif
+};
+
+
+
+/**
+   \fn void *import_worker(void *arg)
+
+   \param[in]  arg          pointer to import job (importJob_t)
+
+   \return always NULL
+
+   thread function for import_files(). Import single file into private memory image.
+   Errors terminate the program via Error(), like in the sequential import.
+*/
+static void *import_worker(void *arg) {
+
+  importJob_t  *job = (importJob_t*) arg;
+
+  // import w/o output to avoid interleaved messages
+  import_file(job->filename, job->format, job->addrBin, job->imageBuf, MUTE);
+
+  return(NULL);
+
+} // import_worker
+
+
+
+/**
+   \fn void *import_task_worker(void *arg)
+
+   \param[in]  arg          pointer to background import (importTask_t)
+
+   \return always NULL
+
+   thread function for import_files_start(). Import single file or merge several files w/o output.
+*/
+static void *import_task_worker(void *arg) {
+
+  importTask_t  *task = (importTask_t*) arg;
+
+  if (task->numFiles == 1)
+    import_file(task->filenames[0], task->formats[0], task->addrBin[0], task->imageBuf, MUTE);
+  else
+    import_files(task->numFiles, task->filenames, task->formats, task->addrBin, task->imageBuf, MUTE);
+
+  return(NULL);
+
+} // import_task_worker
+
+
+#if defined(WIN32)
+/// wrappers for thread functions with Windows thread signature
+static DWORD WINAPI import_worker_win(LPVOID arg) {
+  import_worker(arg);
+  return(0);
+}
+static DWORD WINAPI import_task_worker_win(LPVOID arg) {
+  import_task_worker(arg);
+  return(0);
+}
+#endif
+
+
+
+/**
+   \fn void import_files(int numFiles, char **filenames, fileFormat_t *formats, uint64_t *addrBin, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in]  numFiles     number of files to import
+   \param[in]  filenames    names of files to read ("-" for stdin)
+   \param[in]  formats      file formats, see import_file()
+   \param[in]  addrBin      address offsets for binary import
+   \param[out] imageBuf     merged RAM image of all files. HB!=0 indicates content
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   read and convert all files in parallel (one thread per file) into private memory images, then
+   merge them in the specified order into imageBuf. Overlapping data with different values
+   is treated as error, overlapping identical data is accepted.
+*/
+void import_files(int numFiles, char **filenames, fileFormat_t *formats, uint64_t *addrBin, uint16_t *imageBuf, uint8_t verbose) {
+
+  importJob_t  *jobs;              // import jobs, one per file
+  uint64_t     addr, addrStart, addrStop, numData, numOverlap;
+  int          i, j;
+  #if defined(WIN32)
+    HANDLE     *threads;
+  #else
+    pthread_t  *threads;
+    bool       *started;
+  #endif
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  load and merge %d files ... ", numFiles);
+  fflush(stdout);
+
+  // allocate jobs and private images. Only pages actually used are mapped
+  if (!(jobs = calloc(numFiles, sizeof(*jobs))))
+    Error("Cannot allocate import jobs");
+  for (i=0; i<numFiles; i++) {
+    jobs[i].filename = filenames[i];
+    jobs[i].format   = formats[i];
+    jobs[i].addrBin  = addrBin[i];
+    jobs[i].imageBuf = mem_alloc(MEM_IMAGE, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+  }
+
+  // import files in parallel. If thread creation fails, import sequentially
+  if (!(threads = calloc(numFiles, sizeof(*threads))))
+    Error("Cannot allocate import threads");
+  #if defined(WIN32)
+    for (i=0; i<numFiles; i++) {
+      threads[i] = CreateThread(NULL, 0, import_worker_win, &(jobs[i]), 0, NULL);
+      if (threads[i] == NULL)
+        import_worker(&(jobs[i]));
+    }
+    for (i=0; i<numFiles; i++) {
+      if (threads[i] != NULL) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+      }
+    }
+  #else
+    if (!(started = calloc(numFiles, sizeof(*started))))
+      Error("Cannot allocate import threads");
+    for (i=0; i<numFiles; i++) {
+      started[i] = (pthread_create(&(threads[i]), NULL, import_worker, &(jobs[i])) == 0);
+      if (!started[i])
+        import_worker(&(jobs[i]));
+    }
+    for (i=0; i<numFiles; i++) {
+      if (started[i])
+        pthread_join(threads[i], NULL);
+    }
+    free(started);
+  #endif
+  free(threads);
+
+  // merge private images in specified order and check for conflicts
+  numOverlap = 0;
+  for (i=0; i<numFiles; i++) {
+
+    // get data range of file
+    get_image_size(jobs[i].imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+    if (verbose == CHATTY) {
+      if (numData > 0)
+        printf("\n    file '%s': %1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64, filenames[i], (float) numData/1024.0, addrStart, addrStop);
+      else
+        printf("\n    file '%s': no data", filenames[i]);
+    }
+    if (numData == 0)
+      continue;
+
+    // copy data to merged image
+    for (addr=addrStart; addr<=addrStop; addr++) {
+      if (!(jobs[i].imageBuf[addr] & 0xFF00))
+        continue;
+      if (imageBuf[addr] & 0xFF00) {
+        if ((imageBuf[addr] & 0x00FF) != (jobs[i].imageBuf[addr] & 0x00FF)) {
+          for (j=0; (j<i) && (!(jobs[j].imageBuf[addr] & 0xFF00)); j++);
+          Error("conflict at address 0x%" PRIx64 ": '%s' (0x%02x) vs. '%s' (0x%02x)", addr,
+            filenames[j], (int) (imageBuf[addr] & 0x00FF), filenames[i], (int) (jobs[i].imageBuf[addr] & 0x00FF));
+        }
+        numOverlap++;
+      }
+      imageBuf[addr] = jobs[i].imageBuf[addr];
+    }
+
+  } // loop over files
+
+  // release private images
+  for (i=0; i<numFiles; i++)
+    mem_free(jobs[i].imageBuf);
+  free(jobs);
+  mem_check("merge");
+
+  // print message
+  get_image_size(imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    if (verbose == CHATTY)
+      printf("\n  ");
+    if (numData > 0)
+      printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64, (float) numData/1024.0, addrStart, addrStop);
+    else
+      printf("done (no data");
+    if (numOverlap > 0)
+      printf(", %" PRIu64 "B identical overlap", numOverlap);
+    printf(")\n");
+  }
+  fflush(stdout);
+
+} // import_files
+
+
+
+/**
+   \fn importTask_t *import_files_start(int numFiles, char **filenames, fileFormat_t *formats, uint64_t *addrBin, uint16_t *imageBuf)
+
+   \param[in]  numFiles     number of files to import
+   \param[in]  filenames    names of files to read ("-" for stdin)
+   \param[in]  formats      file formats, see import_file()
+   \param[in]  addrBin      address offsets for binary import
+   \param[out] imageBuf     RAM image of file(s), valid after import_files_wait(). HB!=0 indicates content
+
+   \return handle of background import for import_files_wait()
+
+   start import of single file or merge of several files (see import_files()) in background, e.g. to
+   overlap file parsing with device reset and synchronization. Arrays must remain valid until
+   import_files_wait(). If no thread can be created, the import is done immediately.
+*/
+importTask_t *import_files_start(int numFiles, char **filenames, fileFormat_t *formats, uint64_t *addrBin, uint16_t *imageBuf) {
+
+  importTask_t  *task;
+
+  // store parameters for worker thread
+  if (!(task = calloc(1, sizeof(*task))))
+    Error("Cannot allocate import task");
+  task->numFiles  = numFiles;
+  task->filenames = filenames;
+  task->formats   = formats;
+  task->addrBin   = addrBin;
+  task->imageBuf  = imageBuf;
+
+  // start import thread. On failure import sequentially
+  #if defined(WIN32)
+    task->thread = CreateThread(NULL, 0, import_task_worker_win, task, 0, NULL);
+    if (task->thread == NULL)
+      import_task_worker(task);
+  #else
+    task->started = (pthread_create(&(task->thread), NULL, import_task_worker, task) == 0);
+    if (!task->started)
+      import_task_worker(task);
+  #endif
+
+  return(task);
+
+} // import_files_start
+
+
+
+/**
+   \fn void import_files_wait(importTask_t *task)
+
+   \param[in]  task         handle from import_files_start(). Is released
+
+   wait until background import is finished and release handle
+*/
+void import_files_wait(importTask_t *task) {
+
+  // wait for import thread
+  #if defined(WIN32)
+    if (task->thread != NULL) {
+      WaitForSingleObject(task->thread, INFINITE);
+      CloseHandle(task->thread);
+    }
+  #else
+    if (task->started)
+      pthread_join(task->thread, NULL);
+  #endif
+
+  // release handle
+  free(task);
+
+} // import_files_wait
+
+
+
+/**
+   \fn void convert_s19_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in,out] src      input of converter (buffer or streamed file)
    \param[out] imageBuf     RAM image of file. HB!=0 indicates content
    \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
 
    convert memory buffer containing s19 hexfile to memory image. For description of
    Motorola S19 file format see http://en.wikipedia.org/wiki/SREC_(file_format)
 */
-void convert_s19(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose) {
+static void convert_s19_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose) {
 
-  char      line[1000], tmp[1000], *p;
+  char      line[1000], tmp[1000];
   uint64_t  linecount, idx;
   uint8_t   type, len, chkRead, chkCalc;
   uint64_t  addr, addrStart, addrStop, numData;
@@ -156,25 +1088,19 @@ void convert_s19(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t
 
   // print message
   if (verbose == INFORM)
-    printf("  convert S19 ... ");
+    log_printf("  convert S19 ... ");
   else if (verbose == CHATTY)
-    printf("  convert Motorola S19 file ... ");
-  fflush(stdout);
+    log_printf("  convert Motorola S19 file ... ");
 
 
   //////
   // import data to memory with syntax check
   //////
-  p          = fileBuf;
   linecount  = 0;
   numData    = 0;
   addrStart  = 0xFFFFFFFFFFFFFFFF;
   addrStop   = 0x0000000000000000;
-  while ((uint64_t) (p-fileBuf) < lenFileBuf) {
-
-    // get next line. On EOF terminate
-    if (!get_line(&p, line))
-      break;
+  while (source_line(src, line) != NULL) {
 
     // increase line counter
     linecount++;
@@ -246,38 +1172,57 @@ void convert_s19(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t
 
   // print message
   if (verbose == INFORM) {
-    printf("done\n");
+    log_printf("done\n");
   }
   else if (verbose == CHATTY) {
     if (numData>1024*1024)
-      printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
     else if (numData>1024)
-      printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
     else if (numData>0)
-      printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
+      log_printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
     else
-      printf("done, no data\n");
+      log_printf("done, no data\n");
   }
-  fflush(stdout);
+  log_flush();        // keep order with following direct output
 
-} // convert_s19
+} // convert_s19_source
 
 
 
 /**
-   \fn void convert_ihx(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose)
+   \fn void convert_s19(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose)
 
    \param[in]  fileBuf      memory buffer to read from
    \param[in]  lenFileBuf   length of memory buffer
    \param[out] imageBuf     RAM image of file. HB!=0 indicates content
    \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
 
+   convert memory buffer containing s19 hexfile to memory image, see convert_s19_source()
+*/
+void convert_s19(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose) {
+
+  inSource_t  src = {fileBuf, lenFileBuf, lenFileBuf, fileBuf, NULL};
+
+  convert_s19_source(&src, imageBuf, verbose);
+
+} // convert_s19
+
+
+
+/**
+   \fn void convert_ihx_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in,out] src      input of converter (buffer or streamed file)
+   \param[out] imageBuf     RAM image of file. HB!=0 indicates content
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
    convert memory buffer containing intel hexfile to memory buffer. For description of
    Intel hex file format see http://en.wikipedia.org/wiki/Intel_HEX
 */
-void convert_ihx(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose) {
+static void convert_ihx_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose) {
 
-  char      line[1000], tmp[1000], *p;
+  char      line[1000], tmp[1000];
   uint64_t  linecount, idx;
   uint8_t   type, len, chkRead, chkCalc;
   uint64_t  addr, addrStart, addrStop, numData;
@@ -289,26 +1234,20 @@ void convert_ihx(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t
 
   // print message
   if (verbose == INFORM)
-    printf("  convert IHX ... ");
+    log_printf("  convert IHX ... ");
   else if (verbose == CHATTY)
-    printf("  convert Intel HEX file ... ");
-  fflush(stdout);
+    log_printf("  convert Intel HEX file ... ");
 
 
   //////
   // import data to memory with syntax check
   //////
-  p          = fileBuf;
   linecount  = 0;
   numData    = 0;
   addrStart  = 0xFFFFFFFFFFFFFFFF;
   addrStop   = 0x0000000000000000;
   addrOffset = 0x0000000000000000;
-  while ((uint64_t) (p-fileBuf) < lenFileBuf) {
-
-    // get next line. On EOF terminate
-    if (!get_line(&p, line))
-      break;
+  while (source_line(src, line) != NULL) {
 
     // increase line counter
     linecount++;
@@ -413,39 +1352,58 @@ void convert_ihx(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t
 
   // print message
   if (verbose == INFORM) {
-    printf("done\n");
+    log_printf("done\n");
   }
   else if (verbose == CHATTY) {
     if (numData>1024*1024)
-      printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
     else if (numData>1024)
-      printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
     else if (numData>0)
-      printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
+      log_printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
     else
-      printf("done, no data\n");
+      log_printf("done, no data\n");
   }
-  fflush(stdout);
+  log_flush();        // keep order with following direct output
 
-} // convert_ihx
+} // convert_ihx_source
 
 
 
 /**
-   \fn void convert_txt(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose)
+   \fn void convert_ihx(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose)
 
    \param[in]  fileBuf      memory buffer to read from
    \param[in]  lenFileBuf   length of memory buffer
    \param[out] imageBuf     RAM image of file. HB!=0 indicates content
    \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
 
+   convert memory buffer containing intel hexfile to memory buffer, see convert_ihx_source()
+*/
+void convert_ihx(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose) {
+
+  inSource_t  src = {fileBuf, lenFileBuf, lenFileBuf, fileBuf, NULL};
+
+  convert_ihx_source(&src, imageBuf, verbose);
+
+} // convert_ihx
+
+
+
+/**
+   \fn void convert_txt_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in,out] src      input of converter (buffer or streamed file)
+   \param[out] imageBuf     RAM image of file. HB!=0 indicates content
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
    convert memory buffer containing plain table (address / value) to memory buffer.
    Address and value may be decimal (plain numberst) or hexadecimal (starting with '0x').
    Lines starting with '#' are ignored. No syntax check is performed.
 */
-void convert_txt(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose) {
+static void convert_txt_source(inSource_t *src, uint16_t *imageBuf, uint8_t verbose) {
 
-  char      line[1000], *p;
+  char      line[1000];
   uint64_t  linecount;
   char      sAddr[1000], sValue[1000];
   uint64_t  addr, addrStart, addrStop, numData;
@@ -453,25 +1411,19 @@ void convert_txt(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t
 
   // print message
   if (verbose == INFORM)
-    printf("  convert table ... ");
+    log_printf("  convert table ... ");
   else if (verbose == CHATTY)
-    printf("  convert ASCII table file ... ");
-  fflush(stdout);
+    log_printf("  convert ASCII table file ... ");
 
 
   //////
   // import data to memory with syntax check
   //////
-  p          = fileBuf;
   linecount  = 0;
   numData    = 0;
   addrStart  = 0xFFFFFFFFFFFFFFFF;
   addrStop   = 0x0000000000000000;
-  while ((uint64_t) (p-fileBuf) < lenFileBuf) {
-
-    // get next line. On EOF terminate
-    if (!get_line(&p, line))
-      break;
+  while (source_line(src, line) != NULL) {
 
     // increase line counter
     linecount++;
@@ -566,81 +1518,238 @@ void convert_txt(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t
 
   // print message
   if (verbose == INFORM) {
-    printf("done\n");
+    log_printf("done\n");
   }
   else if (verbose == CHATTY) {
     if (numData>1024*1024)
-      printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
     else if (numData>1024)
-      printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
     else if (numData>0)
-      printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
+      log_printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
     else
-      printf("done, no data\n");
+      log_printf("done, no data\n");
   }
-  fflush(stdout);
+  log_flush();        // keep order with following direct output
 
-} // convert_txt
+} // convert_txt_source
 
 
 
 /**
-   \fn void convert_bin(char *fileBuf, uint64_t lenFileBuf, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose)
+   \fn void convert_txt(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose)
 
    \param[in]  fileBuf      memory buffer to read from
    \param[in]  lenFileBuf   length of memory buffer
+   \param[out] imageBuf     RAM image of file. HB!=0 indicates content
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   convert memory buffer containing plain table (address / value) to memory buffer, see convert_txt_source()
+*/
+void convert_txt(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose) {
+
+  inSource_t  src = {fileBuf, lenFileBuf, lenFileBuf, fileBuf, NULL};
+
+  convert_txt_source(&src, imageBuf, verbose);
+
+} // convert_txt
+
+
+
+/**
+   \fn void convert_bin_source(inSource_t *src, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in,out] src      input of converter (buffer or streamed file)
    \param[in]  addrStart    address offset for binary import
    \param[out] imageBuf     RAM image of file. HB!=0 indicates content
    \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
 
    convert memory buffer containing binary data to memory image. Binary data contains no absolute addresses,
-   just data. Therefor a starting address must also be provided.
+   just data. Therefor a starting address must also be provided. Streamed files are copied chunk by chunk.
 */
-void convert_bin(char *fileBuf, uint64_t lenFileBuf, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose) {
+static void convert_bin_source(inSource_t *src, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose) {
 
-  uint64_t  addrStop, numData;
+  uint64_t  addrStop, numData, lenChunk;
   uint64_t  i;
 
   // print message
   if (verbose == INFORM)
-    printf("  convert binary ... ");
+    log_printf("  convert binary ... ");
   else if (verbose == CHATTY)
-    printf("  convert binary data ... ");
-  fflush(stdout);
+    log_printf("  convert binary data ... ");
 
-  // calculate number of bytes and last address
-  numData  = lenFileBuf;
-  addrStop = addrStart + numData;
+  // copy buffer content, for streamed file chunk by chunk
+  numData = 0;
+  do {
 
-  // check for buffer overflow
-  if (addrStop > (uint64_t) (LENIMAGEBUF-1L))
-    Error("Binary file conversion: buffer size exceeded (%dMB vs %dMB)", (int) (addrStop/1024L/1024L), (int) (LENIMAGEBUF/1024L/1024L));
+    // calculate number of bytes and last address
+    lenChunk = src->len - (uint64_t) (src->p - src->buf);
+    addrStop = addrStart + numData + lenChunk;
 
-  // copy data and mark as set (HB=0xFF)
-  for (i=0; i<numData; i++) {
-    imageBuf[addrStart+i] = ((uint16_t) fileBuf[i]) | 0xFF00;
-  }
+    // check for buffer overflow
+    if (addrStop > (uint64_t) (LENIMAGEBUF-1L))
+      Error("Binary file conversion: buffer size exceeded (%dMB vs %dMB)", (int) (addrStop/1024L/1024L), (int) (LENIMAGEBUF/1024L/1024L));
+
+    // copy data and mark as set (HB=0xFF)
+    for (i=0; i<lenChunk; i++) {
+      imageBuf[addrStart+numData+i] = ((uint16_t) src->p[i]) | 0xFF00;
+    }
+    numData += lenChunk;
+    src->p  += lenChunk;
+
+  } while (source_fill(src));
+  addrStop = addrStart + numData;
 
   // print message
   if (verbose == INFORM) {
-    printf("done\n");
+    log_printf("done\n");
   }
   else if (verbose == CHATTY) {
     if (numData>1024*1024)
-      printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0/1024.0, addrStart, addrStop);
     else if (numData>1024)
-      printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
+      log_printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
     else if (numData>0)
-      printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
+      log_printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (int) numData, addrStart, addrStop);
     else
-      printf("done, no data\n");
+      log_printf("done, no data\n");
   }
-  fflush(stdout);
+  log_flush();        // keep order with following direct output
+
+} // convert_bin_source
+
+
+
+/**
+   \fn void convert_bin(char *fileBuf, uint64_t lenFileBuf, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in]  fileBuf      memory buffer to read from
+   \param[in]  lenFileBuf   length of memory buffer
+   \param[in]  addrStart    address offset for binary import
+   \param[out] imageBuf     RAM image of file. HB!=0 indicates content
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   convert memory buffer containing binary data to memory image, see convert_bin_source()
+*/
+void convert_bin(char *fileBuf, uint64_t lenFileBuf, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose) {
+
+  inSource_t  src = {fileBuf, lenFileBuf, lenFileBuf, fileBuf, NULL};
+
+  convert_bin_source(&src, addrStart, imageBuf, verbose);
 
 } // convert_bin
 
 
 
+/**
+   \fn void convert_elf(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose)
+
+   \param[in]  fileBuf      memory buffer to read from
+   \param[in]  lenFileBuf   length of memory buffer
+   \param[out] imageBuf     RAM image of file. HB!=0 indicates content
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   convert memory buffer containing ELF32 executable to memory image. Only the loadable
+   program headers (PT_LOAD) are used, and their file content is copied to the physical
+   (=load) address. No text decoding is required, and section headers are ignored.
+   For description of ELF format see https://en.wikipedia.org/wiki/Executable_and_Linkable_Format
+*/
+void convert_elf(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose) {
+
+  uint8_t   *buf = (uint8_t*) fileBuf;
+  bool      bigEndian;
+  uint32_t  phOff, phEntSize, phNum, idxSeg;
+  uint32_t  type, offset, paddr, filesz;
+  uint64_t  addrStart, addrStop, numData, numSeg, i;
+
+  // print message
+  if (verbose == INFORM)
+    log_printf("  convert ELF ... ");
+  else if (verbose == CHATTY)
+    log_printf("  convert ELF executable ... ");
+
+  // check ELF header: magic, 32-bit class, byte order
+  if ((lenFileBuf < 52) || (buf[0] != 0x7F) || (buf[1] != 'E') || (buf[2] != 'L') || (buf[3] != 'F'))
+    Error("ELF file: invalid header");
+  if (buf[4] != 1)
+    Error("ELF file: only 32-bit ELF supported (class %d)", (int) buf[4]);
+  if ((buf[5] != 1) && (buf[5] != 2))
+    Error("ELF file: unknown byte order %d", (int) buf[5]);
+  bigEndian = (buf[5] == 2);
+
+  // read field from header or program header table in file byte order
+  #define ELF_READ16(p)  (bigEndian ? (((uint32_t) (p)[0] << 8) | (p)[1]) : (((uint32_t) (p)[1] << 8) | (p)[0]))
+  #define ELF_READ32(p)  (bigEndian ? (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8) | (p)[3]) : \
+                                      (((uint32_t) (p)[3] << 24) | ((uint32_t) (p)[2] << 16) | ((uint32_t) (p)[1] << 8) | (p)[0]))
+
+  // get program header table
+  phOff     = ELF_READ32(buf+28);
+  phEntSize = ELF_READ16(buf+42);
+  phNum     = ELF_READ16(buf+44);
+  if ((phNum > 0) && ((phEntSize < 32) || ((uint64_t) phOff + (uint64_t) phNum*phEntSize > lenFileBuf)))
+    Error("ELF file: invalid program header table");
+
+
+  //////
+  // copy loadable segments to memory image
+  //////
+  numData    = 0;
+  numSeg     = 0;
+  addrStart  = 0xFFFFFFFFFFFFFFFF;
+  addrStop   = 0x0000000000000000;
+  for (idxSeg=0; idxSeg<phNum; idxSeg++) {
+
+    uint8_t *ph = buf + phOff + idxSeg*phEntSize;
+
+    // only loadable segments with file content (skip e.g. .bss)
+    type   = ELF_READ32(ph+0);
+    offset = ELF_READ32(ph+4);
+    paddr  = ELF_READ32(ph+12);
+    filesz = ELF_READ32(ph+16);
+    if ((type != 1) || (filesz == 0))
+      continue;
+
+    // check file and buffer limits
+    if ((uint64_t) offset + filesz > lenFileBuf)
+      Error("ELF file: segment %d exceeds file size", (int) idxSeg);
+    if ((uint64_t) paddr + filesz > (uint64_t) (LENIMAGEBUF-1L))
+      Error("ELF file: segment %d exceeds buffer size (%dMB vs %dMB)", (int) idxSeg, (int) (((uint64_t) paddr+filesz)/1024L/1024L), (int) (LENIMAGEBUF/1024L/1024L));
+
+    // copy segment data and mark as set (HB=0xFF)
+    for (i=0; i<filesz; i++)
+      imageBuf[paddr+i] = ((uint16_t) buf[offset+i]) | 0xFF00;
+
+    // for printout store min/max address and size
+    if (paddr < addrStart)               addrStart = paddr;
+    if (paddr+filesz-1 > addrStop)       addrStop  = paddr+filesz-1;
+    numData += filesz;
+    numSeg++;
+
+  } // loop over program headers
+
+  #undef ELF_READ16
+  #undef ELF_READ32
+
+  // print message
+  if (verbose == INFORM) {
+    log_printf("done\n");
+  }
+  else if (verbose == CHATTY) {
+    if (numData>1024*1024)
+      log_printf("done (%1.1fMB in 0x%" PRIx64 " - 0x%" PRIx64 ", %d segments)\n", (float) numData/1024.0/1024.0, addrStart, addrStop, (int) numSeg);
+    else if (numData>1024)
+      log_printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ", %d segments)\n", (float) numData/1024.0, addrStart, addrStop, (int) numSeg);
+    else if (numData>0)
+      log_printf("done (%dB in 0x%" PRIx64 " - 0x%" PRIx64 ", %d segments)\n", (int) numData, addrStart, addrStop, (int) numSeg);
+    else
+      log_printf("done, no data\n");
+  }
+  log_flush();        // keep order with following direct output
+
+} // convert_elf
+
+
+
 /**
    \fn void get_image_size(uint16_t *imageBuf, uint64_t scanStart, uint64_t scanStop, uint64_t *addrStart, uint64_t *addrStop, uint64_t *numData)
 
@@ -684,6 +1793,70 @@ void get_image_size(uint16_t *imageBuf, uint64_t scanStart, uint64_t scanStop, u
 
 
 
+/**
+   \fn void set_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t numEntries, uint16_t value)
+
+   \param      imageBuf     memory image. HB!=0 indicates content
+   \param[in]  addrStart    first address to set
+   \param[in]  numEntries   number of entries to set
+   \param[in]  value        entry value incl. status in HB
+
+   Set image entries in bulk. As memset() only supports byte patterns, the first entry is set
+   and then duplicated with memcpy() of doubling size.
+*/
+static void set_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t numEntries, uint16_t value) {
+
+  uint64_t  numDone, numCopy;
+
+  // nothing to do
+  if (numEntries == 0)
+    return;
+
+  // clear entries
+  if (value == 0x0000) {
+    memset((void*) &(imageBuf[addrStart]), 0, numEntries*sizeof(*imageBuf));
+    return;
+  }
+
+  // set first entry, then duplicate already set block
+  imageBuf[addrStart] = value;
+  numDone = 1;
+  while (numDone < numEntries) {
+    numCopy = (numDone < numEntries-numDone) ? numDone : numEntries-numDone;
+    memcpy((void*) &(imageBuf[addrStart+numDone]), (void*) &(imageBuf[addrStart]), numCopy*sizeof(*imageBuf));
+    numDone += numCopy;
+  }
+
+} // set_image
+
+
+
+/**
+   \fn uint64_t count_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop)
+
+   \param[in]  imageBuf     memory image. HB!=0 indicates content
+   \param[in]  addrStart    first address to check
+   \param[in]  addrStop     last address to check
+
+   \return number of defined entries in window
+
+   Count defined entries in window. Only used for verbose output.
+*/
+static uint64_t count_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop) {
+
+  uint64_t  addr, numData = 0;
+
+  for (addr=addrStart; addr<=addrStop; addr++) {
+    if (imageBuf[addr] & 0xFF00)
+      numData++;
+  }
+
+  return(numData);
+
+} // count_image
+
+
+
 /**
    \fn void fill_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t value, uint8_t verbose)
 
@@ -693,11 +1866,12 @@ void get_image_size(uint16_t *imageBuf, uint64_t scanStart, uint64_t scanStop, u
    \param[in]  value        value to write
    \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
 
-   Fill memory image in specified window with specified value and set status to "defined" (HB=0xFF)
+   Fill gaps in memory image within specified window with specified value and set status to "defined" (HB=0xFF).
+   Existing data is maintained. Each gap is filled in bulk.
 */
 void fill_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t value, uint8_t verbose) {
 
-  uint64_t  addr, numFilled;
+  uint64_t  addr, addrGap, numFilled;
 
   // print message
   if (verbose == INFORM)
@@ -714,12 +1888,25 @@ void fill_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8
   if (addrStop > (uint64_t) LENIMAGEBUF)
     Error("end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, addrStop, LENIMAGEBUF);
 
-  // loop over memory image and clear all data outside specified clipping window
+  // loop over gaps in memory image and fill each gap at once
   numFilled = 0;
-  for (addr = addrStart; addr <= addrStop; addr++) {
-    numFilled++;                                      // count filled bytes for output below
-    imageBuf[addr] = ((uint16_t) value) | 0xFF00;     // HB=0x00 indicates data undefined, LB contains data
-  }
+  addr = addrStart;
+  while (addr <= addrStop) {
+
+    // skip defined data
+    if (imageBuf[addr] & 0xFF00) {
+      addr++;
+      continue;
+    }
+
+    // find end of gap and fill it
+    addrGap = addr;
+    while ((addr <= addrStop) && (!(imageBuf[addr] & 0xFF00)))
+      addr++;
+    set_image(imageBuf, addrGap, addr-addrGap, ((uint16_t) value) | 0xFF00);
+    numFilled += addr-addrGap;                        // count filled bytes for output below
+
+  } // loop over gaps
 
   // print message
   if (verbose == INFORM) {
@@ -753,7 +1940,7 @@ void fill_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8
 */
 void clip_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose) {
 
-  uint64_t  addr, numCleared;
+  uint64_t  numCleared;
 
   // print message
   if (verbose == INFORM)
@@ -770,16 +1957,19 @@ void clip_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8
   if (addrStop > (uint64_t) LENIMAGEBUF)
     Error("end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, addrStop, LENIMAGEBUF);
 
-  // loop over memory image and clear all data outside specified clipping window
+  // count deleted bytes for output below
   numCleared = 0;
-  for (addr = 0; addr < (uint64_t)LENIMAGEBUF; addr++) {
-    if ((addr < addrStart) || (addr > addrStop)) {
-      if (imageBuf[addr] & 0xFF00)
-         numCleared++;                 // count deleted bytes for output below
-      imageBuf[addr] = 0x0000;         // HB=0x00 indicates data undefined, LB contains data
-    }
+  if (verbose == CHATTY) {
+    if (addrStart > 0)
+      numCleared += count_image(imageBuf, 0, addrStart-1);
+    if (addrStop < (uint64_t) LENIMAGEBUF)
+      numCleared += count_image(imageBuf, addrStop+1, LENIMAGEBUF);
   }
 
+  // clear all data below and above specified clipping window
+  set_image(imageBuf, 0, addrStart, 0x0000);
+  set_image(imageBuf, addrStop+1, (uint64_t) LENIMAGEBUF-addrStop, 0x0000);
+
   // print message
   if (verbose == INFORM) {
     printf("done\n");
@@ -812,7 +2002,7 @@ void clip_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8
 */
 void cut_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t verbose) {
 
-  uint64_t  addr, numCleared;
+  uint64_t  numCleared;
 
   // print message
   if (verbose == INFORM)
@@ -827,17 +2017,15 @@ void cut_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_
   if (addrStart > (uint64_t) LENIMAGEBUF)
     Error("start address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, addrStart, LENIMAGEBUF);
   if (addrStop > (uint64_t) LENIMAGEBUF)
-    Error("end address 0x%" PRIx64 " exceeds buffer size 0x" PRIx64, addrStop, LENIMAGEBUF);
+    Error("end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, addrStop, LENIMAGEBUF);
 
-  // loop over memory image and clear all data inside specified window
+  // count deleted bytes for output below
   numCleared = 0;
-  for (addr=0; addr<(uint64_t)LENIMAGEBUF; addr++) {
-    if ((addr >= addrStart) && (addr <= addrStop)) {
-      if (imageBuf[addr] & 0xFF00)
-         numCleared++;                 // count deleted bytes for output below
-      imageBuf[addr] = 0x0000;         // HB=0x00 indicates data undefined, LB contains data
-    }
-  }
+  if (verbose == CHATTY)
+    numCleared = count_image(imageBuf, addrStart, addrStop);
+
+  // clear all data inside specified window
+  set_image(imageBuf, addrStart, addrStop-addrStart+1, 0x0000);
 
   // print message
   if (verbose == INFORM) {
@@ -872,7 +2060,7 @@ void cut_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_
 */
 void copy_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, uint64_t destinationStart, uint8_t verbose) {
 
-  uint64_t  numCopied, i;
+  uint64_t  numCopied;
 
   // print message
   if (verbose == INFORM)
@@ -890,18 +2078,16 @@ void copy_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, u
     Error("source end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, sourceStop, LENIMAGEBUF);
   if (destinationStart > (uint64_t) LENIMAGEBUF)
     Error("destination start address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, destinationStart, LENIMAGEBUF);
-  if (destinationStart+(sourceStop-sourceStart+1) > (uint64_t) LENIMAGEBUF)
-    Error("destination end address 0x%" PRIx64 " exceeds buffer size 0x" PRIx64, destinationStart+(sourceStop-sourceStart+1), LENIMAGEBUF);
+  if (destinationStart+(sourceStop-sourceStart) > (uint64_t) LENIMAGEBUF)
+    Error("destination end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, destinationStart+(sourceStop-sourceStart), LENIMAGEBUF);
 
-  // get number of data to copy (HB!=0x00)
+  // get number of data to copy (HB!=0x00) for output below
   numCopied = 0;
-  for (i=sourceStart; i<=sourceStop; i++) {
-    if (imageBuf[i] & 0xFF00)
-      numCopied++;
-  }
+  if (verbose == CHATTY)
+    numCopied = count_image(imageBuf, sourceStart, sourceStop);
 
-  // copy data within image
-  memcpy((void*) &(imageBuf[destinationStart]), (void*) &(imageBuf[sourceStart]), (sourceStop-sourceStart+1)*sizeof(*imageBuf));
+  // copy data within image. Use memmove() for overlapping windows
+  memmove((void*) &(imageBuf[destinationStart]), (void*) &(imageBuf[sourceStart]), (sourceStop-sourceStart+1)*sizeof(*imageBuf));
 
 
   // print message
@@ -937,8 +2123,7 @@ void copy_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, u
 */
 void move_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, uint64_t destinationStart, uint8_t verbose) {
 
-  uint64_t  numMoved, i;
-  uint16_t  *tmpImageBuf;   // temporary buffer
+  uint64_t  numMoved, destinationStop;
 
   // print message
   if (verbose == INFORM)
@@ -956,31 +2141,25 @@ void move_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, u
     Error("source end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, sourceStop, LENIMAGEBUF);
   if (destinationStart > (uint64_t) LENIMAGEBUF)
     Error("destination start address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, destinationStart, LENIMAGEBUF);
-  if (destinationStart+(sourceStop-sourceStart+1) > (uint64_t) LENIMAGEBUF)
-    Error("destination end address 0x%" PRIx64 " exceeds buffer size 0x" PRIx64, destinationStart+(sourceStop-sourceStart+1), LENIMAGEBUF);
+  if (destinationStart+(sourceStop-sourceStart) > (uint64_t) LENIMAGEBUF)
+    Error("destination end address 0x%" PRIx64 " exceeds buffer size 0x%" PRIx64, destinationStart+(sourceStop-sourceStart), LENIMAGEBUF);
+  destinationStop = destinationStart + (sourceStop-sourceStart);
 
-  // get number of data to move (HB!=0x00)
+  // get number of data to move (HB!=0x00) for output below
   numMoved = 0;
-  for (i=sourceStart; i<=sourceStop; i++) {
-    if (imageBuf[i] & 0xFF00)
-      numMoved++;
-  }
-
-  // allocate temporary buffer (required for overlapping windows
-  if (!(tmpImageBuf = malloc(LENIMAGEBUF * sizeof(*tmpImageBuf))))
-    Error("Cannot allocate image buffer, try reducing LENIMAGEBUF");
-
-  // copy data from image to temporary buffer
-  memcpy((void*) &(tmpImageBuf[sourceStart]), (void*) &(imageBuf[sourceStart]), (sourceStop-sourceStart+1)*sizeof(*imageBuf));
-
-  // remove old data from image
-  cut_image(imageBuf, sourceStart, sourceStop, MUTE);
+  if (verbose == CHATTY)
+    numMoved = count_image(imageBuf, sourceStart, sourceStop);
 
-  // copy data from temporary buffer to image
-  memcpy((void*) &(imageBuf[destinationStart]), (void*) &(tmpImageBuf[sourceStart]), (sourceStop-sourceStart+1)*sizeof(*imageBuf));
+  // move data within image. memmove() supports overlapping windows, i.e. no temporary buffer required
+  memmove((void*) &(imageBuf[destinationStart]), (void*) &(imageBuf[sourceStart]), (sourceStop-sourceStart+1)*sizeof(*imageBuf));
 
-  // release temporary buffer again
-  free(tmpImageBuf);
+  // remove old data from image, except for overlap with destination window
+  if ((destinationStop < sourceStart) || (destinationStart > sourceStop))
+    set_image(imageBuf, sourceStart, sourceStop-sourceStart+1, 0x0000);
+  else if (destinationStart > sourceStart)
+    set_image(imageBuf, sourceStart, destinationStart-sourceStart, 0x0000);
+  else if (destinationStart < sourceStart)
+    set_image(imageBuf, destinationStop+1, sourceStop-destinationStop, 0x0000);
 
   // print message
   if (verbose == INFORM) {
@@ -988,7 +2167,7 @@ void move_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, u
   }
   else if (verbose == CHATTY) {
     if (numMoved>1024*1024)
-      printf("done, moved %1.1fkB from 0x%" PRIx64 " - 0x%" PRIx64 " to 0x%" PRIx64 "\n", (float) numMoved/1024.0/1024.0, sourceStart, sourceStop, destinationStart);
+      printf("done, moved %1.1fMB from 0x%" PRIx64 " - 0x%" PRIx64 " to 0x%" PRIx64 "\n", (float) numMoved/1024.0/1024.0, sourceStart, sourceStop, destinationStart);
     else if (numMoved>1024)
       printf("done, moved %1.1fkB from 0x%" PRIx64 " - 0x%" PRIx64 " to 0x%" PRIx64 "\n", (float) numMoved/1024.0, sourceStart, sourceStop, destinationStart);
     else if (numMoved>0)
@@ -1002,6 +2181,162 @@ void move_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, u
 
 
 
+/**
+   \fn uint64_t diff_image(uint16_t *imageBuf, uint16_t *baseBuf, uint64_t lenBlock, uint8_t verbose)
+
+   \param      imageBuf     memory image containing new data. HB!=0 indicates content
+   \param[in]  baseBuf      memory image of data known to be on device (base of delta)
+   \param[in]  lenBlock     size of write block, e.g. 128B for flash
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   \return number of changed blocks
+
+   Reduce memory image to the blocks which differ from the base image. Unchanged blocks are removed
+   from the image, and gaps in changed blocks are filled from the base image, so that changed
+   blocks are written completely.
+*/
+uint64_t diff_image(uint16_t *imageBuf, uint16_t *baseBuf, uint64_t lenBlock, uint8_t verbose) {
+
+  uint64_t  addrStart, addrStop, numData, addr, addrBlock;
+  uint64_t  numBlocks, numChanged, numBytes;
+  bool      changed;
+
+  // print message
+  if (verbose == INFORM)
+    printf("  delta to base image ... ");
+  else if (verbose == CHATTY)
+    printf("  delta of memory image to base image ... ");
+  fflush(stdout);
+
+  // get range of new data
+  get_image_size(imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+
+  // loop over blocks of new data
+  numBlocks  = 0;
+  numChanged = 0;
+  numBytes   = 0;
+  for (addrBlock=addrStart-(addrStart % lenBlock); (numData > 0) && (addrBlock <= addrStop); addrBlock += lenBlock) {
+
+    // check if new data differs from base within block
+    changed = false;
+    for (addr=addrBlock; (addr<addrBlock+lenBlock) && (addr <= LENIMAGEBUF) && (!changed); addr++) {
+      if ((imageBuf[addr] & 0xFF00) && ((!(baseBuf[addr] & 0xFF00)) || ((imageBuf[addr] ^ baseBuf[addr]) & 0xFF)))
+        changed = true;
+    }
+    if ((changed) || (count_image(imageBuf, addrBlock, ((addrBlock+lenBlock-1 < LENIMAGEBUF) ? addrBlock+lenBlock-1 : LENIMAGEBUF)) > 0))
+      numBlocks++;
+
+    // unchanged block -> remove. Changed block -> fill gaps from base to write complete block
+    for (addr=addrBlock; (addr<addrBlock+lenBlock) && (addr <= LENIMAGEBUF); addr++) {
+      if (!changed)
+        imageBuf[addr] = 0x0000;
+      else if (!(imageBuf[addr] & 0xFF00))
+        imageBuf[addr] = baseBuf[addr];
+      if (imageBuf[addr] & 0xFF00)
+        numBytes++;
+    }
+    if (changed)
+      numChanged++;
+
+  } // loop over blocks
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    if (numBytes>1024)
+      printf("done (%d of %d blocks changed, %1.1fkB)\n", (int) numChanged, (int) numBlocks, (float) numBytes/1024.0);
+    else
+      printf("done (%d of %d blocks changed, %dB)\n", (int) numChanged, (int) numBlocks, (int) numBytes);
+  }
+  fflush(stdout);
+
+  return(numChanged);
+
+} // diff_image
+
+
+
+/**
+   \fn void transform_image(uint16_t *imageBuf, int numOps, imageOp_t *ops, uint8_t verbose)
+
+   \param      imageBuf     memory image containing data. HB!=0 indicates content
+   \param[in]  numOps       number of operations in pipeline
+   \param[in]  ops          operations to apply in specified order
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   Apply pipeline of image operations (fill, clip, cut, copy, move, CRC) to memory image
+*/
+void transform_image(uint16_t *imageBuf, int numOps, imageOp_t *ops, uint8_t verbose) {
+
+  int   i;
+
+  for (i=0; i<numOps; i++) {
+    if (ops[i].type == IMAGE_FILL)
+      fill_image(imageBuf, ops[i].addrStart, ops[i].addrStop, (uint8_t) ops[i].param, verbose);
+    else if (ops[i].type == IMAGE_CLIP)
+      clip_image(imageBuf, ops[i].addrStart, ops[i].addrStop, verbose);
+    else if (ops[i].type == IMAGE_CUT)
+      cut_image(imageBuf, ops[i].addrStart, ops[i].addrStop, verbose);
+    else if (ops[i].type == IMAGE_COPY)
+      copy_image(imageBuf, ops[i].addrStart, ops[i].addrStop, ops[i].param, verbose);
+    else if (ops[i].type == IMAGE_MOVE)
+      move_image(imageBuf, ops[i].addrStart, ops[i].addrStop, ops[i].param, verbose);
+    else if (ops[i].type == IMAGE_CRC)
+      crc_stamp_image(imageBuf, ops[i].addrStart, ops[i].addrStop, ops[i].param, &(ops[i].crc), verbose);
+  }
+
+} // transform_image
+
+
+
+/**
+   \fn int get_image_op(char **args, imageOp_t *op)
+
+   \param[in]  args         commandline arguments, starting with option. Number of parameters must be checked by caller
+   \param[out] op           image operation
+
+   \return number of parameters of option, or 0 if option is no image operation
+
+   get image operation (-f, -c, -x, -C, -m, -k) with parameters from commandline arguments
+*/
+int get_image_op(char **args, imageOp_t *op) {
+
+  // get type of operation
+  if ((!strcmp(args[0], "-f")) || (!strcmp(args[0], "-fill")))
+    op->type = IMAGE_FILL;
+  else if ((!strcmp(args[0], "-c")) || (!strcmp(args[0], "-clip")))
+    op->type = IMAGE_CLIP;
+  else if ((!strcmp(args[0], "-x")) || (!strcmp(args[0], "-cut")))
+    op->type = IMAGE_CUT;
+  else if ((!strcmp(args[0], "-C")) || (!strcmp(args[0], "-copy")))
+    op->type = IMAGE_COPY;
+  else if ((!strcmp(args[0], "-m")) || (!strcmp(args[0], "-move")))
+    op->type = IMAGE_MOVE;
+  else if ((!strcmp(args[0], "-k")) || (!strcmp(args[0], "-checksum")))
+    op->type = IMAGE_CRC;
+  else
+    return(0);
+
+  // CRC: type, address window and CRC address
+  if (op->type == IMAGE_CRC) {
+    crc_get_config(args[1], &(op->crc));
+    sscanf(args[2], "%" SCNx64, &(op->addrStart));
+    sscanf(args[3], "%" SCNx64, &(op->addrStop));
+    sscanf(args[4], "%" SCNx64, &(op->param));
+    return(4);
+  }
+
+  // address window and optional value or destination address
+  sscanf(args[1], "%" SCNx64, &(op->addrStart));
+  sscanf(args[2], "%" SCNx64, &(op->addrStop));
+  if ((op->type == IMAGE_CLIP) || (op->type == IMAGE_CUT))
+    return(2);
+  sscanf(args[3], "%" SCNx64, &(op->param));
+  return(3);
+
+} // get_image_op
+
+
+
 /**
    \fn void export_s19(char *filename, uint16_t *imageBuf, uint8_t verbose)
 
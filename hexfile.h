@@ -8,7 +8,7 @@
    \brief declaration of routines for HEX, S19 and table files
    
    declaration of routines for importing and exporting Motorola S19 and Intel HEX files, 
-   as well as plain ASCII tables.  
+   as well as plain ASCII tables. ELF executables can be imported.  
    (format descriptions under http://en.wikipedia.org/wiki/SREC_(file_format) or
    http://www.keil.com/support/docs/1584.htm). 
 */
@@ -17,19 +17,59 @@
 #ifndef _HEXFILE_H_
 #define _HEXFILE_H_
 
+// include files
+#include "checksum.h"
+
 /// buffer size [B] for files
 #define  LENFILEBUF   50*1024*1024
 
+/// buffer size [B] for streamed import of files
+#define  LENCHUNKBUF  1024*1024
+
 /// buffer size [B] for memory image
 #define  LENIMAGEBUF  50*1024*1024
 
 
+/// supported import file formats
+typedef enum {FORMAT_UNKNOWN=0, FORMAT_S19, FORMAT_IHX, FORMAT_TXT, FORMAT_BIN, FORMAT_ELF, FORMAT_PLAN} fileFormat_t;
+
+/// supported image operations
+typedef enum {IMAGE_FILL=0, IMAGE_CLIP, IMAGE_CUT, IMAGE_COPY, IMAGE_MOVE, IMAGE_CRC} imageOpType_t;
+
+/// handle of background import, see import_files_start()
+typedef struct importTask_s importTask_t;
+
+/// single image operation for transform_image()
+typedef struct {
+  imageOpType_t  type;        ///< type of operation
+  uint64_t       addrStart;   ///< first address of window
+  uint64_t       addrStop;    ///< last address of window
+  uint64_t       param;       ///< fill value, destination address or CRC address
+  crcConfig_t    crc;         ///< CRC parameters (only IMAGE_CRC)
+} imageOp_t;
+
+
 /// read next line from RAM buffer
 char  *get_line(char **buf, char *line);
 
 /// read file into memory buffer
 void  load_file(const char *filename, char *fileBuf, uint64_t *lenFileBuf, uint8_t verbose);
 
+/// get import format from "fmt:" prefix or file extension
+fileFormat_t  get_file_format(const char *name, char *filename);
+
+/// read file and convert to memory image
+void  import_file(const char *filename, fileFormat_t format, uint64_t addrBin, uint16_t *imageBuf, uint8_t verbose);
+
+/// read files in parallel and merge to single memory image with conflict check
+void  import_files(int numFiles, char **filenames, fileFormat_t *formats, uint64_t *addrBin, uint16_t *imageBuf, uint8_t verbose);
+
+/// start import of file(s) in background thread
+importTask_t  *import_files_start(int numFiles, char **filenames, fileFormat_t *formats, uint64_t *addrBin, uint16_t *imageBuf);
+
+/// wait for end of background import
+void  import_files_wait(importTask_t *task);
+
 /// convert Motorola s19 format in memory buffer to memory image
 void  convert_s19(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose);
 
@@ -43,10 +83,14 @@ void  convert_txt(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_
 void  convert_bin(char *fileBuf, uint64_t lenFileBuf, uint64_t addrStart, uint16_t *imageBuf, uint8_t verbose);
 
 
+/// convert ELF32 executable in memory buffer to memory image
+void  convert_elf(char *fileBuf, uint64_t lenFileBuf, uint16_t *imageBuf, uint8_t verbose);
+
+
 /// get min/max address and number of data bytes in memory image
 void  get_image_size(uint16_t *imageBuf, uint64_t scanStart, uint64_t scanStop, uint64_t *addrStart, uint64_t *addrStop, uint64_t *numData);
 
-/// fill data in memory image with fixed value
+/// fill gaps in memory image with fixed value
 void  fill_image(uint16_t *imageBuf, uint64_t addrStart, uint64_t addrStop, uint8_t value, uint8_t verbose);
 
 /// clip memory image to specified window
@@ -61,6 +105,15 @@ void  copy_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop,
 /// move data in memory image to new address
 void  move_image(uint16_t *imageBuf, uint64_t sourceStart, uint64_t sourceStop, uint64_t destinationStart, uint8_t verbose);
 
+/// reduce memory image to blocks which differ from base image
+uint64_t  diff_image(uint16_t *imageBuf, uint16_t *baseBuf, uint64_t lenBlock, uint8_t verbose);
+
+/// get image operation from commandline arguments. Returns number of parameters, or 0 if no image operation
+int   get_image_op(char **args, imageOp_t *op);
+
+/// apply pipeline of image operations
+void  transform_image(uint16_t *imageBuf, int numOps, imageOp_t *ops, uint8_t verbose);
+
 
 /// export RAM image to file in Motorola s19 format
 void  export_s19(char *filename, uint16_t *imageBuf, uint8_t verbose);
@@ -0,0 +1,465 @@
+/**
+  \file logger.c
+
+  \author G. Icking-Konert
+  \date 2019-02-09
+  \version 0.1
+
+  \brief implementation of asynchronous console logger
+
+  implementation of routines for console output from time critical routines.
+  Messages are formatted into a buffer on the stack of the calling thread and
+  copied to a ring buffer, which is printed and flushed by a background writer
+  thread. The caller only blocks if the ring buffer is full. Progress messages
+  are additionally rate limited by time.
+  Optionally progress events are written as JSON lines to a separate file
+  descriptor for station software, using non-blocking I/O.
+  Other output still uses printf(), therefore call log_flush() before returning
+  from a routine using the logger to keep the order of messages.
+*/
+
+// condition variables require Windows Vista or newer. Define before any include
+#if defined(WIN32) && (!defined(_WIN32_WINNT) || (_WIN32_WINNT < 0x0600))
+  #undef  _WIN32_WINNT
+  #define _WIN32_WINNT  0x0600
+#endif
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#if defined(WIN32)
+  #include <windows.h>        // for CreateThread(), critical section and condition variable
+  #include <io.h>             // for _write(), _get_osfhandle()
+#else
+  #include <pthread.h>        // for writer thread
+  #include <unistd.h>         // for write()
+  #include <fcntl.h>          // for non-blocking I/O
+  #include <signal.h>         // for ignoring SIGPIPE
+#endif
+#include "logger.h"
+#include "main.h"
+#include "misc.h"
+
+
+/// size of ring buffer [B]
+#define LOG_BUFSIZE     65536
+
+/// max. length of a single message [B]
+#define LOG_MSGLEN      1000
+
+/// size of buffer for events not yet accepted by reader [B]
+#define LOG_EVENTBUF    4096
+
+
+// system specific mutex and condition variable
+#if defined(WIN32)
+  typedef CRITICAL_SECTION    logMutex_t;
+  typedef CONDITION_VARIABLE  logCond_t;
+  #define MUTEX_INIT(m)       InitializeCriticalSection(m)
+  #define MUTEX_LOCK(m)       EnterCriticalSection(m)
+  #define MUTEX_UNLOCK(m)     LeaveCriticalSection(m)
+  #define COND_INIT(c)        InitializeConditionVariable(c)
+  #define COND_WAIT(c, m)     SleepConditionVariableCS(c, m, INFINITE)
+  #define COND_SIGNAL(c)      WakeAllConditionVariable(c)
+#else
+  typedef pthread_mutex_t     logMutex_t;
+  typedef pthread_cond_t      logCond_t;
+  #define MUTEX_INIT(m)       pthread_mutex_init(m, NULL)
+  #define MUTEX_LOCK(m)       pthread_mutex_lock(m)
+  #define MUTEX_UNLOCK(m)     pthread_mutex_unlock(m)
+  #define COND_INIT(c)        pthread_cond_init(c, NULL)
+  #define COND_WAIT(c, m)     pthread_cond_wait(c, m)
+  #define COND_SIGNAL(c)      pthread_cond_broadcast(c)
+#endif
+
+
+// global variables
+static bool        s_logActive = false;      //< writer thread is running
+static char        s_logBuf[LOG_BUFSIZE];    //< ring buffer with pending output
+static uint32_t    s_logHead = 0;            //< write index of ring buffer (total bytes)
+static uint32_t    s_logTail = 0;            //< read index of ring buffer (total bytes)
+static bool        s_logBusy = false;        //< writer is printing data already removed from ring
+static uint64_t    s_logProgress = 0;        //< time of last progress message [us]
+static logMutex_t  s_logMutex;               //< protects above ring buffer state
+static logCond_t   s_logData;                //< signal: data was added
+static logCond_t   s_logSpace;               //< signal: data was removed or printed
+
+static int         s_evFd = -1;                    //< file descriptor for progress events (-1=none)
+static uint64_t    s_evInterval = 0;               //< min. time between progress events [us]
+static uint64_t    s_evLast = 0;                   //< time of last progress event [us]
+static uint64_t    s_evStart = 0;                  //< start time of current phase [us]
+static char        s_evBuf[LOG_EVENTBUF];          //< events not yet accepted by reader
+static uint32_t    s_evLen = 0;                    //< number of bytes in s_evBuf
+
+
+
+/**
+  \fn void *log_writer(void *arg)
+
+  \param[in]  arg     not used
+
+  \return never returns
+
+  writer thread: print pending data and flush console
+*/
+static void *log_writer(void *arg) {
+
+  char      buf[LOG_BUFSIZE];
+  uint32_t  len, idx;
+
+  (void) arg;
+
+  MUTEX_LOCK(&s_logMutex);
+  while (1) {
+
+    // wait for data
+    while (s_logHead == s_logTail)
+      COND_WAIT(&s_logData, &s_logMutex);
+
+    // move all pending data out of ring (may wrap around)
+    len = s_logHead - s_logTail;
+    idx = s_logTail % LOG_BUFSIZE;
+    if (idx + len <= LOG_BUFSIZE)
+      memcpy(buf, s_logBuf + idx, len);
+    else {
+      memcpy(buf, s_logBuf + idx, LOG_BUFSIZE - idx);
+      memcpy(buf + LOG_BUFSIZE - idx, s_logBuf, len - (LOG_BUFSIZE - idx));
+    }
+    s_logTail += len;
+    s_logBusy  = true;
+    COND_SIGNAL(&s_logSpace);
+    MUTEX_UNLOCK(&s_logMutex);
+
+    // print w/o lock. This may block for slow consoles
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+
+    // signal completion, e.g. for log_flush()
+    MUTEX_LOCK(&s_logMutex);
+    s_logBusy = false;
+    COND_SIGNAL(&s_logSpace);
+
+  } // while (1)
+
+  return(NULL);
+
+} // log_writer
+
+
+#if defined(WIN32)
+/// wrapper for thread function with Windows thread signature
+static DWORD WINAPI log_writer_win(LPVOID arg) {
+  log_writer(arg);
+  return(0);
+}
+#endif
+
+
+
+/**
+  \fn void log_write(const char *format, va_list vargs)
+
+  \param[in]  format   format string as for printf()
+  \param[in]  vargs    arguments for format string
+
+  format message into local buffer of calling thread and append to ring buffer.
+  If the logger isn't active, print directly
+*/
+static void log_write(const char *format, va_list vargs) {
+
+  char      msg[LOG_MSGLEN];
+  int       len;
+  uint32_t  idx, num;
+
+  // format message in local buffer
+  len = vsnprintf(msg, LOG_MSGLEN, format, vargs);
+  if (len <= 0)
+    return;
+  if (len >= LOG_MSGLEN)
+    len = LOG_MSGLEN-1;
+
+  // logger not active -> print directly
+  if (!s_logActive) {
+    fwrite(msg, 1, len, stdout);
+    fflush(stdout);
+    return;
+  }
+
+  // copy to ring buffer. Only wait if buffer is full
+  MUTEX_LOCK(&s_logMutex);
+  while ((LOG_BUFSIZE - (s_logHead - s_logTail)) < (uint32_t) len)
+    COND_WAIT(&s_logSpace, &s_logMutex);
+  idx = s_logHead % LOG_BUFSIZE;
+  num = ((idx + len) <= LOG_BUFSIZE) ? (uint32_t) len : (LOG_BUFSIZE - idx);
+  memcpy(s_logBuf + idx, msg, num);
+  memcpy(s_logBuf, msg + num, len - num);
+  s_logHead += len;
+  COND_SIGNAL(&s_logData);
+  MUTEX_UNLOCK(&s_logMutex);
+
+} // log_write
+
+
+
+/**
+  \fn void log_init(void)
+
+  start background writer thread. Before, messages are printed directly
+*/
+void log_init(void) {
+
+  #if defined(WIN32)
+    HANDLE     thread;
+  #else
+    pthread_t  thread;
+  #endif
+
+  // only start once
+  if (s_logActive)
+    return;
+
+  // init synchronization
+  MUTEX_INIT(&s_logMutex);
+  COND_INIT(&s_logData);
+  COND_INIT(&s_logSpace);
+
+  // start detached writer thread. Is terminated on exit
+  #if defined(WIN32)
+    if ((thread = CreateThread(NULL, 0, log_writer_win, NULL, 0, NULL)) == NULL)
+      Error("in 'log_init()': cannot start writer thread");
+    CloseHandle(thread);
+  #else
+    if (pthread_create(&thread, NULL, log_writer, NULL) != 0)
+      Error("in 'log_init()': cannot start writer thread");
+    pthread_detach(thread);
+  #endif
+  s_logActive = true;
+
+} // log_init
+
+
+
+/**
+  \fn void log_printf(const char *format, ...)
+
+  \param[in]  format   format string as for printf()
+
+  print message via writer thread. Like for printf(), the verbosity level
+  (MUTE, SILENT, INFORM, CHATTY) is checked by the caller
+*/
+void log_printf(const char *format, ...) {
+
+  va_list  vargs;
+
+  va_start(vargs, format);
+  log_write(format, vargs);
+  va_end(vargs);
+
+} // log_printf
+
+
+
+/**
+  \fn void log_progress(const char *format, ...)
+
+  \param[in]  format   format string as for printf()
+
+  print progress message via writer thread, but skip if last progress message was
+  printed less than LOG_PROGRESS_INTERVAL ago. I.e. update rate depends on time,
+  not on transfer speed. Final message should be printed via log_printf()
+*/
+void log_progress(const char *format, ...) {
+
+  va_list   vargs;
+  uint64_t  tNow;
+
+  tNow = micros();
+  if ((s_logProgress != 0) && ((tNow - s_logProgress) < 1000L * LOG_PROGRESS_INTERVAL))
+    return;
+  s_logProgress = tNow;
+  va_start(vargs, format);
+  log_write(format, vargs);
+  va_end(vargs);
+
+} // log_progress
+
+
+
+/**
+  \fn void log_flush(void)
+
+  wait until all pending messages are printed, e.g. prior to direct output via printf()
+*/
+void log_flush(void) {
+
+  if (!s_logActive)
+    return;
+  MUTEX_LOCK(&s_logMutex);
+  while ((s_logHead != s_logTail) || (s_logBusy))
+    COND_WAIT(&s_logSpace, &s_logMutex);
+  MUTEX_UNLOCK(&s_logMutex);
+
+} // log_flush
+
+
+
+/**
+  \fn void log_event_send(void)
+
+  write as much of pending events as reader accepts w/o blocking. On error,
+  e.g. reader closed, the channel is closed
+*/
+static void log_event_send(void) {
+
+  int  len;
+
+  if ((s_evFd < 0) || (s_evLen == 0))
+    return;
+
+  #if defined(WIN32)
+    len = _write(s_evFd, s_evBuf, s_evLen);
+  #else
+    len = write(s_evFd, s_evBuf, s_evLen);
+  #endif
+
+  // reader busy -> retry with next event
+  if (len < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+      s_evFd  = -1;
+      s_evLen = 0;
+    }
+    return;
+  }
+
+  // remove written data, keep remainder of partial line
+  memmove(s_evBuf, s_evBuf + len, s_evLen - len);
+  s_evLen -= len;
+
+} // log_event_send
+
+
+
+/**
+  \fn void log_event_open(int fd, uint32_t rate)
+
+  \param[in]  fd      file descriptor opened by caller, e.g. pipe to station software
+  \param[in]  rate    max. rate of progress events [Hz] (0=no limit)
+
+  open machine-readable progress channel. Events are written as JSON lines with
+  non-blocking I/O, so a slow reader doesn't throttle the upload
+*/
+void log_event_open(int fd, uint32_t rate) {
+
+  // set descriptor to non-blocking
+  #if defined(WIN32)
+    HANDLE  handle;
+    DWORD   mode = PIPE_READMODE_BYTE | PIPE_NOWAIT;
+
+    if ((handle = (HANDLE) _get_osfhandle(fd)) == INVALID_HANDLE_VALUE)
+      Error("in 'log_event_open()': invalid file descriptor %d", fd);
+    SetNamedPipeHandleState(handle, &mode, NULL, NULL);   // fails for files, which don't block anyway
+  #else
+    int  flags;
+
+    if ((flags = fcntl(fd, F_GETFL)) == -1)
+      Error("in 'log_event_open()': invalid file descriptor %d", fd);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);         // closed reader -> error code instead of termination
+  #endif
+
+  s_evFd       = fd;
+  s_evInterval = (rate > 0) ? (1000000L / rate) : 0;
+  s_evLen      = 0;
+
+} // log_event_open
+
+
+
+/**
+  \fn void log_event(const char *phase, logEvent_t type, uint64_t done, uint64_t total, uint64_t addr, uint32_t retries)
+
+  \param[in]  phase    name of phase, e.g. "write"
+  \param[in]  type     type of event (start, progress, end)
+  \param[in]  done     number of bytes done
+  \param[in]  total    total number of bytes in phase
+  \param[in]  addr     current address
+  \param[in]  retries  number of retries in phase
+
+  emit progress event as JSON line, e.g.
+  {"t":1.234567,"phase":"write","event":"progress","done":1024,"total":4096,"addr":33792,"eta":3.70,"retries":0}.
+  Progress events are rate limited and skipped if previous events are still pending.
+  Start and end events are queued, unless queue is full. Never blocks
+*/
+void log_event(const char *phase, logEvent_t type, uint64_t done, uint64_t total, uint64_t addr, uint32_t retries) {
+
+  char      msg[LOG_MSGLEN], eta[30];
+  uint64_t  tNow;
+  int       len;
+  const char *name[] = {"start", "progress", "end"};
+
+  // channel not open
+  if (s_evFd < 0)
+    return;
+
+  // rate limit progress events and skip if reader is behind
+  tNow = micros();
+  if (type == LOG_PROGRESS) {
+    log_event_send();
+    if ((s_evLen > 0) || ((tNow - s_evLast) < s_evInterval))
+      return;
+    s_evLast = tNow;
+  }
+  else if (type == LOG_START)
+    s_evStart = tNow;
+
+  // estimate remaining time of phase from average rate
+  if ((type == LOG_PROGRESS) && (done > 0) && (total >= done))
+    sprintf(eta, "%1.2f", (float) (tNow - s_evStart) * (float) (total - done) / (float) done / 1e6);
+  else if (type == LOG_END)
+    sprintf(eta, "0");
+  else
+    sprintf(eta, "null");
+
+  // format event
+  len = snprintf(msg, LOG_MSGLEN, "{\"t\":%1.6f,\"phase\":\"%s\",\"event\":\"%s\",\"done\":%" PRIu64 ",\"total\":%" PRIu64 ",\"addr\":%" PRIu64 ",\"eta\":%s,\"retries\":%u}\n",
+    (double) tNow / 1e6, phase, name[type], done, total, addr, eta, (unsigned int) retries);
+  if ((len <= 0) || (len >= LOG_MSGLEN))
+    return;
+
+  // queue and write w/o blocking
+  if (s_evLen + len > LOG_EVENTBUF)
+    return;
+  memcpy(s_evBuf + s_evLen, msg, len);
+  s_evLen += len;
+  log_event_send();
+
+} // log_event
+
+
+
+/**
+  \fn void log_event_close(void)
+
+  try to write pending events for max. 1s, e.g. prior to exit. Then close channel
+*/
+void log_event_close(void) {
+
+  int  i;
+
+  for (i=0; (i<1000) && (s_evFd >= 0) && (s_evLen > 0); i++) {
+    log_event_send();
+    if (s_evLen > 0)
+      SLEEP(1);
+  }
+  s_evFd = -1;
+
+} // log_event_close
+
+
+// end of file
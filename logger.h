@@ -0,0 +1,59 @@
+/**
+  \file logger.h
+
+  \author G. Icking-Konert
+  \date 2019-02-09
+  \version 0.1
+
+  \brief declaration of asynchronous console logger
+
+  declaration of routines for console output from time critical routines.
+  Messages are formatted by the calling thread and printed by a background
+  writer thread, so a slow console or pipe doesn't stall the protocol.
+*/
+
+// for including file only once
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// min. time between progress updates [ms]
+#define LOG_PROGRESS_INTERVAL   200
+
+
+/// type of machine-readable progress event
+typedef enum {
+  LOG_START = 0,            ///< start of phase, e.g. write
+  LOG_PROGRESS,             ///< progress within phase, rate limited
+  LOG_END                   ///< end of phase
+} logEvent_t;
+
+
+/// start background writer thread. Before, messages are printed directly
+void  log_init(void);
+
+/// print message via writer thread. Verbosity is checked by caller as for printf()
+void  log_printf(const char *format, ...);
+
+/// print progress message via writer thread, but skip if last progress was printed less than LOG_PROGRESS_INTERVAL ago
+void  log_progress(const char *format, ...);
+
+/// wait until all pending messages are printed, e.g. prior to direct output via printf()
+void  log_flush(void);
+
+/// open machine-readable progress channel (JSON lines) on file descriptor with max. progress rate [Hz]
+void  log_event_open(int fd, uint32_t rate);
+
+/// emit progress event. Never blocks, progress events are skipped if reader is slow
+void  log_event(const char *phase, logEvent_t type, uint64_t done, uint64_t total, uint64_t addr, uint32_t retries);
+
+/// try to write pending events for max. 1s, e.g. prior to exit
+void  log_event_close(void);
+
+#endif // _LOGGER_H_
+
+// end of file
@@ -63,7 +63,15 @@
 #include "spi_spidev_comm.h"
 #include "spi_Arduino_comm.h"
 #include "bootloader.h"
+#include "bsl_async.h"
 #include "hexfile.h"
+#include "timing.h"
+#include "monitor.h"
+#include "logger.h"
+#include "fault.h"
+#include "memtrack.h"
+#include "farm.h"
+#include "plan.h"
 #include "version.h"
 
 
@@ -84,6 +92,252 @@
 #define  STRLEN   1000
 
 
+/**
+   \fn void reset_STM8(const char *portname, int resetSTM8, int verbose, bool prompt)
+
+   \param[in]  portname     name of communication port
+   \param[in]  resetSTM8    reset method: 0=skip, 1=manual, 2=DTR line (RS232), 3=send 'Re5eT!' @ 115.2kBaud, 4=Arduino pin 8, 5=Raspi pin 12, 6=RTS line (RS232)
+   \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+   \param[in]  prompt       for manual reset wait for <return>
+
+   reset STM8 to start bootloader. Is called prior to opening port, except for reset via Arduino,
+   which is done after opening the Arduino port.
+*/
+static void reset_STM8(const char *portname, int resetSTM8, int verbose, bool prompt) {
+
+  HANDLE    ptrPort = 0;          // handle to communication port
+  int       i;
+
+  // skip reset of STM8
+  if (resetSTM8 == 0) {
+
+  }
+
+  // manually reset STM8
+  else if (resetSTM8 == 1) {
+    if (prompt) {
+      printf("  reset STM8 and press <return>");
+      fflush(stdout);
+      fflush(stdin);
+      getchar();
+    }
+    else {
+      printf("  reset STM8 now\n");
+      fflush(stdout);
+    }
+  }
+
+  // HW reset STM8 using DTR line (USB/RS232)
+  else if (resetSTM8 == 2) {
+    if (verbose != MUTE)
+      printf("  reset via DTR ... ");
+    fflush(stdout);
+    ptrPort = init_port(portname, 115200, 100, 8, 0, 1, 0, 0);
+    pulse_DTR(ptrPort, 10);
+    close_port(&ptrPort);
+    if (verbose != MUTE)
+      printf("ok\n");
+    fflush(stdout);
+    SLEEP(g_timing.resetDelay);       // allow BSL to initialize
+  }
+
+  // SW reset STM8 via command 'Re5eT!' at 115.2kBaud with (8,0,1) (requires respective STM8 SW)
+  else if (resetSTM8 == 3) {
+    char buf[10] = "Re5eT!";          // reset command (same as in STM8 SW!)
+    if (verbose != MUTE)
+      printf("  reset via UART command ... ");
+    fflush(stdout);
+    ptrPort = init_port(portname, 115200, 100, 8, 0, 1, 0, 0);
+    for (i=0; i<6; i++) {
+      send_port(ptrPort, 0, 1, buf+i);   // send reset command bytewise to account for possible slow handling on STM8 side
+      SLEEP(10);
+    }
+    close_port(&ptrPort);
+    if (verbose != MUTE)
+      printf("ok\n");
+    fflush(stdout);
+    SLEEP(g_timing.resetDelay);       // allow BSL to initialize
+  }
+
+  // HW reset STM8 using Arduino pin 8 -> delay until Arduino port is open
+  else if (resetSTM8 == 4) {
+
+    // dummy
+
+  }
+
+  // HW reset STM8 using header pin 12 (only Raspberry Pi!)
+  #if defined(__ARMEL__) && defined(USE_WIRING)
+    else if (resetSTM8 == 5) {
+      if (verbose != MUTE)
+        printf("  reset via Raspi pin 12 ... ");
+      fflush(stdout);
+      pulse_GPIO(12, 20);
+      if (verbose != MUTE)
+        printf("ok\n");
+      fflush(stdout);
+      SLEEP(g_timing.resetDelay);     // allow BSL to initialize
+    }
+  #endif // __ARMEL__ && USE_WIRING
+
+  // HW reset STM8 using RTS line (USB/RS232)
+    else if(resetSTM8 == 6)
+    {
+        if(verbose != MUTE)
+            printf("  reset via RTS ... ");
+        fflush(stdout);
+        ptrPort = init_port(portname, 115200, 100, 8, 0, 1, 0, 0);
+        pulse_RTS(ptrPort, 10);
+        close_port(&ptrPort);
+        if(verbose != MUTE)
+            printf("ok\n");
+        fflush(stdout);
+        SLEEP(g_timing.resetDelay); // allow BSL to initialize
+    }
+
+  // unknown reset method -> error
+  else {
+    #ifdef __ARMEL__
+      Error("reset method %d not supported (0=skip, 1=manual, 2=DTR line (RS232), 3=send 'Re5eT!' @ 115.2kBaud, 4=Arduino pin 8, 5=Raspi pin 12, 6=RTS line (RS232))", resetSTM8);
+    #else
+      Error("reset method %d not supported (0=skip, 1=manual, 2=DTR line (RS232), 3=send 'Re5eT!' @ 115.2kBaud, 4=Arduino pin 8, 6=RTS line (RS232))", resetSTM8);
+    #endif
+  }
+
+} // reset_STM8
+
+
+
+/**
+   \fn bool probe_fixture(const char *portname, int resetSTM8, uint8_t uartMode, uint32_t baudrate, int numTries)
+
+   \param[in]  portname     name of communication port
+   \param[in]  resetSTM8    automatic hardware reset method, see reset_STM8()
+   \param[in]  uartMode     UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+   \param[in]  baudrate     UART baudrate to check
+   \param[in]  numTries     number of reset, sync and READ cycles, which must all succeed
+
+   \return true if bootloader was reset, synchronized and read correctly in all cycles, else false
+
+   check if fixture works reliably with given baudrate and current g_timing. Used for calibration
+*/
+static bool probe_fixture(const char *portname, int resetSTM8, uint8_t uartMode, uint32_t baudrate, int numTries) {
+
+  HANDLE    ptrPort;
+  bool      ok = true;
+  int       i;
+
+  for (i=0; (i<numTries) && ok; i++) {
+    reset_STM8(portname, resetSTM8, MUTE, false);
+    ptrPort = init_port(portname, baudrate, g_timing.timeout, 8, 0, 1, 0, 0);
+    SLEEP(g_timing.portDelay);
+    flush_port(ptrPort);
+    ok = (timing_probe_sync(ptrPort) && timing_probe_read(ptrPort, uartMode));
+    close_port(&ptrPort);
+  }
+
+  return(ok);
+
+} // probe_fixture
+
+
+
+/**
+   \fn bool check_base(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *baseBuf, int numOps, imageOp_t *imageOps, uint8_t verbose)
+
+   \param[in]  ptrPort        handle to communication port
+   \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+   \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+   \param[in]  baseBuf        memory image of base for delta upload, incl. checksum stamps
+   \param[in]  numOps         number of image operations
+   \param[in]  imageOps       pipeline of image operations, which was applied to base image
+   \param[in]  verbose        verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+   \return true if base image is on device, else false
+
+   check if base image for delta upload is on device via its checksum stamps (-k). Only the stamps
+   are read from the device and compared with the stamps of the base image, i.e. a few bytes instead
+   of the complete base. This requires that the stamps cover all data of the base image, else the
+   base can't be identified and the full image is uploaded.
+*/
+static bool check_base(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *baseBuf, int numOps, imageOp_t *imageOps, uint8_t verbose) {
+
+  uint64_t  addrStart, addrStop, numData, addr, numUncovered;
+  uint16_t  *tmpBuf;
+  int       i, numStamps, numBytes;
+  bool      same = true;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  check base image on device ... ");
+  fflush(stdout);
+
+  // get range of base image
+  get_image_size(baseBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+  if (numData == 0)
+    Error("base image is empty");
+
+  // count base data not covered by a CRC range or stamp
+  numStamps    = 0;
+  numUncovered = 0;
+  for (addr=addrStart; addr<=addrStop; addr++) {
+    if (!(baseBuf[addr] & 0xFF00))
+      continue;
+    for (i=0; i<numOps; i++) {
+      if (imageOps[i].type != IMAGE_CRC)
+        continue;
+      numBytes = imageOps[i].crc.width / 8;
+      if ((addr >= imageOps[i].addrStart) && (addr <= imageOps[i].addrStop))
+        break;
+      if ((addr >= imageOps[i].param) && (addr < imageOps[i].param + numBytes))
+        break;
+    }
+    if (i == numOps)
+      numUncovered++;
+  }
+  for (i=0; i<numOps; i++)
+    numStamps += (imageOps[i].type == IMAGE_CRC);
+
+  // base can't be identified -> full upload
+  if ((numStamps == 0) || (numUncovered > 0)) {
+    if ((verbose == INFORM) || (verbose == CHATTY)) {
+      if (numStamps == 0)
+        printf("done (no checksum stamp -> full upload)\n");
+      else
+        printf("done (%" PRIu64 "B not covered by checksum -> full upload)\n", numUncovered);
+    }
+    fflush(stdout);
+    return(false);
+  }
+
+  // read stamps from device and compare with base image
+  if (!(tmpBuf = calloc(addrStop+1, sizeof(*tmpBuf))))
+    Error("Cannot allocate image buffer");
+  for (i=0; (i<numOps) && (same); i++) {
+    if (imageOps[i].type != IMAGE_CRC)
+      continue;
+    numBytes = imageOps[i].crc.width / 8;
+    bsl_memRead(ptrPort, physInterface, uartMode, imageOps[i].param, imageOps[i].param+numBytes-1, tmpBuf, MUTE);
+    for (addr=imageOps[i].param; addr<imageOps[i].param+numBytes; addr++) {
+      if ((baseBuf[addr] ^ tmpBuf[addr]) & 0xFF) {
+        same = false;
+        break;
+      }
+    }
+  }
+  free(tmpBuf);
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (%d %s, %s)\n", numStamps, (numStamps == 1 ? "checksum" : "checksums"), (same ? "match" : "no match -> full upload"));
+  fflush(stdout);
+
+  return(same);
+
+} // check_base
+
+
+
 /**
    \fn int main(int argc, char *argv[])
 
@@ -110,6 +364,48 @@ int main(int argc, char ** argv) {
   bool      verifyUpload;         // verify memory after upload
   uint64_t  jumpAddr;             // address to jump to before exit program
   bool      printHelp;            // flag for printing help page
+  bool      useStdin;             // input file is read from stdin -> no prompts via stdin
+  bool      mergeFiles;           // load all input files in parallel and upload merged image once
+  int       numMerge;             // number of input files for merging
+  char      **mergeNames;         // names of input files for merging
+  fileFormat_t  *mergeFormats;    // formats of input files for merging
+  uint64_t  *mergeAddr;           // address offsets of binary input files for merging
+  int       numOps;               // number of image operations applied to input files
+  imageOp_t *imageOps;            // pipeline of image operations (fill, clip, cut, copy, move, CRC)
+  uint16_t  *preloadBuf;          // RAM image of first input file(s), loaded during reset and sync
+  uint16_t  *baseBuf;             // RAM image known to be on device -> upload only changed blocks (NULL=full upload)
+  importTask_t  *preloadTask;     // background import of first input file(s)
+  bool      baudrateSet;          // baudrate was specified -> ignore baudrate from timing profile
+  bool      tuneTiming;           // calibrate timing of fixture and store to profile
+  bool      realTime;             // run protocol with real-time priority and locked memory
+  bool      asyncUpload;          // upload and verify -w files via asynchronous session
+  int       numGang;              // number of gang devices, i.e. additional RX ports + 1 (0=single device)
+  char      gangNames[GANG_MAX][STRLEN];  // names of gang RX ports. [0] is shared TX port
+  HANDLE    gangPorts[GANG_MAX];  // handles of gang RX ports. [0] is shared TX port
+  bool      gangActive[GANG_MAX]; // gang device is still active
+  bool      profileLoaded;        // timing was loaded from profile
+  timing_t  profileTiming;        // timing from profile, applied after device check
+  bool      monitorPort;          // capture application output after jump
+  int       monitorBaud;          // baudrate of application (0=keep bootloader baudrate)
+  int       monitorTime;          // max. monitor time [s] (0=until pattern received)
+  char      matchPass[STRLEN];    // pattern indicating application pass ("" = none)
+  char      matchFail[STRLEN];    // pattern indicating application fail ("" = none)
+  int       progressFd;           // file descriptor for machine-readable progress events (-1=none)
+  int       progressRate;         // max. rate of progress events [Hz]
+  bool      bootTime;             // measure time from jump to first byte and signature
+  char      bootSign[STRLEN];     // signature sent by application when ready
+  int       lenBootSign;          // length of signature
+  int       bootTimeout;          // max. time to wait for signature [ms]
+  uint64_t  timeJump;             // time of jump to application [us]
+  char      profile[STRLEN];      // name of timing profile
+  char      deviceId[STRLEN];     // device identifier for timing profile
+  uint16_t  *swapBuf;             // for exchanging image buffers
+  char      farmFile[STRLEN];     // job file for device farm ("" = single run)
+  int       farmWorkers;          // number of parallel jobs in farm mode
+  int       numCommon;            // number of options common to all farm jobs
+  char      **common;             // options common to all farm jobs
+  char      recipeFile[STRLEN];   // recipe to compile ("" = no compilation)
+  char      planFile[STRLEN];     // name of compiled plan
   int       i, j;                 // generic variables
   char      tmp[STRLEN];          // misc buffer
   uint64_t  addrStart, addrStop, numData;  // image data range
@@ -123,6 +419,7 @@ int main(int argc, char ** argv) {
   // initialize global variables
   g_pauseOnExit         = false;  // no wait for <return> before terminating (dummy)
   g_backgroundOperation = false;  // assume foreground application
+  timing_init();                  // worst-case timing, may be tuned via profile
 
   // initialize default arguments
   portname[0]    = '\0';          // no default port name
@@ -132,6 +429,25 @@ int main(int argc, char ** argv) {
   verbose        = INFORM;        // verbosity level medium
   resetSTM8      = 1;             // manual reset of STM8
   verifyUpload   = true;          // verify memory content after upload
+  useStdin       = false;         // by default no input via stdin
+  mergeFiles     = false;         // by default upload input files sequentially
+  baudrateSet    = false;         // by default use baudrate from timing profile, if available
+  tuneTiming     = false;         // by default don't calibrate timing
+  realTime       = false;         // by default use normal scheduling
+  asyncUpload    = false;         // by default upload via blocking bsl_memWrite()
+  numGang        = 0;             // by default single device
+  monitorPort    = false;         // by default close port after jump
+  monitorBaud    = 0;             // by default monitor with bootloader baudrate
+  monitorTime    = 0;             // by default monitor until pattern received
+  matchPass[0]   = '\0';          // no pass pattern
+  matchFail[0]   = '\0';          // no fail pattern
+  bootTime       = false;         // by default don't measure boot time
+  progressFd     = -1;            // by default no progress events
+  farmFile[0]    = '\0';          // by default no device farm
+  farmWorkers    = 1;             // by default one job at a time
+  recipeFile[0]  = '\0';          // by default no recipe compilation
+  profileLoaded  = false;         // no timing profile loaded yet
+  timing_default_file(profile);   // default timing profile in home directory
   jumpAddr       = PFLASH_START;  // by default jump to start of P-flash (see bootloader.h)
 
 
@@ -150,14 +466,57 @@ int main(int argc, char ** argv) {
   // initialize time-keeping (1st call stores launch time)
   micros();
 
+  // start background console output for time critical routines
+  log_init();
+
   // get app name & version, and change console title
   get_app_name(argv[0], VERSION, appname, version);
 
 
+  ////////
+  // replace compiled plan by its options and image references 'plan:n'. Only one plan per run.
+  // For device farm keep option, as images are only loaded in the job processes. Just check plan
+  ////////
+  for (i=1; i<argc; i++) {
+    if (((!strcmp(argv[i], "-n")) || (!strcmp(argv[i], "-plan"))) && (i+1<argc)) {
+      bool  farm = false;
+      for (j=1; j<argc; j++) {
+        if ((!strcmp(argv[j], "-B")) || (!strcmp(argv[j], "-background")))
+          g_backgroundOperation = true;     // avoid prompt on invalid plan in background operation
+        if ((!strcmp(argv[j], "-a")) || (!strcmp(argv[j], "-farm")))
+          farm = true;
+        if ((j > i) && ((!strcmp(argv[j], "-n")) || (!strcmp(argv[j], "-plan"))))
+          Error("only one plan (-n) per run supported");
+      }
+      if (farm) {
+        int   numArgs = argc;
+        char  **args  = argv;
+        plan_load(argv[i+1], i, &numArgs, &args);
+      }
+      else
+        plan_load(argv[i+1], i, &argc, &argv);
+      break;
+    }
+  }
+
+
   /////////////////
   // 1st pass of commandline arguments: set global parameters, no upload/download/erase yet
   /////////////////
 
+  // allocate lists of input files for optional merging (at most argc)
+  numMerge     = 0;
+  mergeNames   = calloc(argc, sizeof(*mergeNames));
+  mergeFormats = calloc(argc, sizeof(*mergeFormats));
+  mergeAddr    = calloc(argc, sizeof(*mergeAddr));
+  if ((mergeNames == NULL) || (mergeFormats == NULL) || (mergeAddr == NULL))
+    Error("Cannot allocate input file list");
+
+  // allocate pipeline of image operations (at most argc)
+  numOps = 0;
+  if (!(imageOps = calloc(argc, sizeof(*imageOps))))
+    Error("Cannot allocate image operations");
+
   printHelp = false;
   for (i=1; i<argc; i++) {
 
@@ -265,8 +624,10 @@ int main(int argc, char ** argv) {
     else if ((!strcmp(argv[i], "-b")) || (!strcmp(argv[i], "-baudrate"))) {
 
       // get communication baudrate
-      if (i+1<argc)
+      if (i+1<argc) {
         sscanf(argv[++i],"%d",&baudrate);
+        baudrateSet = true;
+      }
       else {
         printHelp = true;
         break;
@@ -281,6 +642,183 @@ int main(int argc, char ** argv) {
     } // no-verify
 
 
+    // calibrate timing of fixture and store to profile
+    else if ((!strcmp(argv[i], "-T")) || (!strcmp(argv[i], "-tune-timing"))) {
+      tuneTiming = true;
+    } // tune-timing
+
+
+    // real-time scheduling and memory locking
+    else if ((!strcmp(argv[i], "-t")) || (!strcmp(argv[i], "-realtime"))) {
+      realTime = true;
+    } // realtime
+
+
+    // upload via asynchronous session
+    else if ((!strcmp(argv[i], "-A")) || (!strcmp(argv[i], "-async"))) {
+      asyncUpload = true;
+    } // async
+
+
+    // additional RX port for gang programming via shared TX line
+    else if ((!strcmp(argv[i], "-G")) || (!strcmp(argv[i], "-gang-rx"))) {
+      if (i+1<argc) {
+        if (numGang == 0)
+          numGang = 1;
+        if (numGang >= GANG_MAX)
+          Error("too many gang devices (max %d)", GANG_MAX);
+        strncpy(gangNames[numGang++], argv[++i], STRLEN-1);
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // gang-rx
+
+
+    // monitor application output after jump
+    else if ((!strcmp(argv[i], "-L")) || (!strcmp(argv[i], "-monitor"))) {
+      if (i+2<argc) {
+        monitorPort = true;
+        sscanf(argv[++i], "%d", &monitorBaud);
+        sscanf(argv[++i], "%d", &monitorTime);
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // monitor
+
+
+    // pass/fail patterns for monitor ("-" = none)
+    else if ((!strcmp(argv[i], "-X")) || (!strcmp(argv[i], "-match"))) {
+      if (i+2<argc) {
+        i++;
+        monitor_unescape(strcmp(argv[i], "-") ? argv[i] : "", matchPass);
+        i++;
+        monitor_unescape(strcmp(argv[i], "-") ? argv[i] : "", matchFail);
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // match
+
+
+    // inject faults into BSL responses, e.g. for tuning retry paths
+    #if defined(USE_FAULT)
+      else if ((!strcmp(argv[i], "-I")) || (!strcmp(argv[i], "-inject-faults"))) {
+        if (i+1<argc)
+          fault_setup(argv[++i]);
+        else {
+          printHelp = true;
+          break;
+        }
+      } // inject-faults
+    #endif // USE_FAULT
+
+
+    // memory budget, selects sparse buffers
+    else if ((!strcmp(argv[i], "-Z")) || (!strcmp(argv[i], "-mem-budget"))) {
+      if (i+1<argc) {
+        float  budget = 0.0;
+        sscanf(argv[++i], "%f", &budget);
+        if (budget <= 0.0)
+          Error("invalid memory budget (%s MB)", argv[i]);
+        mem_budget((uint64_t) (budget * 1024.0 * 1024.0));
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // mem-budget
+
+
+    // machine-readable progress events
+    else if ((!strcmp(argv[i], "-F")) || (!strcmp(argv[i], "-progress-fd"))) {
+      if (i+2<argc) {
+        sscanf(argv[++i], "%d", &progressFd);
+        sscanf(argv[++i], "%d", &progressRate);
+        if ((progressFd < 0) || (progressRate < 0))
+          Error("invalid progress channel (fd %d, rate %dHz)", progressFd, progressRate);
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // progress-fd
+
+
+    // measure boot time of application after jump
+    else if ((!strcmp(argv[i], "-g")) || (!strcmp(argv[i], "-boot-time"))) {
+      if (i+2<argc) {
+        bootTime = true;
+        lenBootSign = monitor_unescape(argv[++i], bootSign);
+        if (lenBootSign == 0)
+          Error("empty boot signature");
+        sscanf(argv[++i], "%d", &bootTimeout);
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // boot-time
+
+
+    // name of timing profile
+    else if ((!strcmp(argv[i], "-P")) || (!strcmp(argv[i], "-profile"))) {
+      if (i+1<argc)
+        strncpy(profile, argv[++i], STRLEN-1);
+      else {
+        printHelp = true;
+        break;
+      }
+    } // profile
+
+
+    // load all input files in parallel and upload merged image once
+    else if ((!strcmp(argv[i], "-M")) || (!strcmp(argv[i], "-merge-files"))) {
+      mergeFiles = true;
+    } // merge-files
+
+
+    // compile recipe to binary plan
+    else if ((!strcmp(argv[i], "-y")) || (!strcmp(argv[i], "-compile-plan"))) {
+      if (i+2<argc) {
+        strncpy(recipeFile, argv[++i], STRLEN-1);
+        strncpy(planFile, argv[++i], STRLEN-1);
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // compile-plan
+
+
+    // compiled plan is only left on commandline for device farm jobs, see above
+    else if ((!strcmp(argv[i], "-n")) || (!strcmp(argv[i], "-plan"))) {
+      if (i+1<argc)
+        i++;
+      else {
+        printHelp = true;
+        break;
+      }
+    } // plan
+
+
+    // run jobs from file on pool of workers
+    else if ((!strcmp(argv[i], "-a")) || (!strcmp(argv[i], "-farm"))) {
+      if (i+2<argc) {
+        strncpy(farmFile, argv[++i], STRLEN-1);
+        sscanf(argv[++i], "%d", &farmWorkers);
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // farm
+
+
     // jump adress before program termination (-1 or 0xFFFFFFFF == skip jump)
     else if ((!strcmp(argv[i], "-j")) || (!strcmp(argv[i], "-jump-addr"))) {
 
@@ -298,19 +836,30 @@ int main(int argc, char ** argv) {
     } // jump-address
 
 
-    // skip file upload. Just check parameter number
+    // skip file upload. Just check parameter number and store file for optional merging
     else if ((!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "-write-file"))) {
 
       // get file name
       if (i+1<argc) {
-        if (strstr(argv[++i], ".bin") != NULL) {  // for binary file skip additionaly address
+        fileFormat_t format = get_file_format(argv[++i], tmp);
+        if (!strcmp(tmp, "-")) {                  // stdin can only be read once
+          if (useStdin)
+            Error("stdin can only be used for one input file");
+          useStdin = true;
+        }
+        if (format == FORMAT_BIN) {               // for binary file skip additionaly address
           if (i+1<argc)
-            i+=1;
+            sscanf(argv[++i], "%" SCNx64, &(mergeAddr[numMerge]));
           else {
             printHelp = true;
             break;
           }
         }
+        if (!(mergeNames[numMerge] = malloc(strlen(tmp)+1)))
+          Error("Cannot allocate input file list");
+        strcpy(mergeNames[numMerge], tmp);
+        mergeFormats[numMerge] = format;
+        numMerge++;
       }
       else {
         printHelp = true;
@@ -320,6 +869,41 @@ int main(int argc, char ** argv) {
     } // write
 
 
+    // skip base image for delta upload. Just check parameter number
+    else if ((!strcmp(argv[i], "-D")) || (!strcmp(argv[i], "-delta-base"))) {
+      if (i+1<argc) {
+        if (get_file_format(argv[++i], tmp) == FORMAT_BIN)
+          Error("binary file not supported as base image");
+        if (!strcmp(tmp, "-")) {                  // stdin can only be read once
+          if (useStdin)
+            Error("stdin can only be used for one input file");
+          useStdin = true;
+        }
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // delta-base
+
+
+    // skip option bytes file. Just check parameter number
+    else if ((!strcmp(argv[i], "-o")) || (!strcmp(argv[i], "-option-file"))) {
+      if (i+1<argc) {
+        get_file_format(argv[++i], tmp);
+        if (!strcmp(tmp, "-")) {                  // stdin can only be read once
+          if (useStdin)
+            Error("stdin can only be used for one input file");
+          useStdin = true;
+        }
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // option-file
+
+
     // skip writing single value. Just check parameter number
     else if ((!strcmp(argv[i], "-W")) || (!strcmp(argv[i], "-write-byte"))) {
       if (i+2<argc)
@@ -359,6 +943,45 @@ int main(int argc, char ** argv) {
     } // erase-full
 
 
+    // skip image operations with 2 parameters. Just check parameter number
+    else if ((!strcmp(argv[i], "-c")) || (!strcmp(argv[i], "-clip")) ||
+             (!strcmp(argv[i], "-x")) || (!strcmp(argv[i], "-cut"))) {
+      if (i+2<argc)
+        i+=2;
+      else {
+        printHelp = true;
+        break;
+      }
+    } // clip, cut
+
+
+    // skip image operations with 3 parameters. Just check parameter number
+    else if ((!strcmp(argv[i], "-f")) || (!strcmp(argv[i], "-fill")) ||
+             (!strcmp(argv[i], "-C")) || (!strcmp(argv[i], "-copy")) ||
+             (!strcmp(argv[i], "-m")) || (!strcmp(argv[i], "-move"))) {
+      if (i+3<argc)
+        i+=3;
+      else {
+        printHelp = true;
+        break;
+      }
+    } // fill, copy, move
+
+
+    // check checksum type and parameter number
+    else if ((!strcmp(argv[i], "-k")) || (!strcmp(argv[i], "-checksum"))) {
+      if (i+4<argc) {
+        crcConfig_t config;
+        crc_get_config(argv[i+1], &config);
+        i+=4;
+      }
+      else {
+        printHelp = true;
+        break;
+      }
+    } // checksum
+
+
     // else print help
     else {
       printHelp = true;
@@ -395,21 +1018,52 @@ int main(int argc, char ** argv) {
       printf("    -i/-interface [line]            communication interface: 0=UART, 1=SPI via Arduino (default: UART)\n");
     #endif
     printf("    -u/-uart-mode [mode]            UART mode: 0=duplex, 1=1-wire, 2=2-wire reply, other=auto-detect (default: auto-detect)\n");
-    printf("    -p/-port [name]                 communication port (default: list available ports)\n");
+    printf("    -p/-port [name]                 communication port, or 'tcp://host:port' / 'rfc2217://host:port' for serial device server. Suffix '?pipe' pipelines READ only (default: list available ports)\n");
     printf("    -b/-baudrate [speed]            communication baudrate in Baud (default: 115200)\n");
     printf("    -V/-no-verify                   don't verify code in flash after upload (default: verify)\n");
+    printf("    -T/-tune-timing                 measure fastest reliable timing of port and device, store to profile and exit\n");
+    printf("    -t/-realtime                    run protocol with real-time priority and locked memory, report wake-up latency\n");
+    printf("    -A/-async                       upload and verify files (-w) via asynchronous session (UART duplex, single device)\n");
+    printf("    -G/-gang-rx [port]              gang programming: -p is shared TX (and RX of 1st device), add RX port of further device\n");
+    printf("    -y/-compile-plan [recipe plan]  compile recipe (options in text file) to binary plan with resolved images and exit\n");
+    printf("    -n/-plan [file]                 run compiled plan, i.e. insert its options here. Following options take precedence\n");
+    printf("    -a/-farm [file workers]         run jobs from file ('port options' per line) on parallel workers, other options apply to all jobs\n");
+    printf("                                    output of jobs is stored to '<file>.<n>.log' per port\n");
+    printf("    -P/-profile [file]              timing profile, is used automatically if it exists (default: ~/%s)\n", TIMING_PROFILE);
     printf("    -j/-jump-addr [address]         jump address before exit of %s, or -1 for skip (default: flash)\n", appname);
-    printf("    -w/-write-file [file [addr]]    upload file from PC to uController. For binary file (*.bin) with address offset (as hex)\n");
+    printf("    -L/-monitor [baud sec]          after jump print application output with timestamps. baud=0: keep, sec=0: until match\n");
+    printf("    -X/-match [pass fail]           stop monitor on pass or fail string ('-' for none). Exit code 1 on fail or timeout\n");
+    #if defined(USE_FAULT)
+      printf("    -I/-inject-faults [spec]        inject faults into read/write responses and report time lost, e.g. 'drop=0.01,nack=0.02,delay=0.05:20'\n");
+    #endif
+    printf("                                    classes: drop, corrupt, nack, delay[:ms], busy, desync. Optional 'seed=n'\n");
+    printf("    -Z/-mem-budget [MB]             stay within memory budget using sparse buffers, or fail early. Report peak memory\n");
+    printf("    -F/-progress-fd [fd Hz]         write progress as JSON lines to open file descriptor, max. rate in Hz (0=no limit)\n");
+    printf("    -g/-boot-time [sign ms]         measure time from jump to first byte and to signature string (e.g. 'ready\\n') in us\n");
+    printf("    -w/-write-file [file [addr]]    upload file from PC to uController. For binary file (*.bin) with address offset (as hex). File '-' reads stdin\n");
+    printf("    -M/-merge-files                 load all files (-w) in parallel and upload merged image at first -w. Overlaps must match\n");
     printf("    -W/-write-byte [addr value]     change value at given address (as dec or hex)\n");
+    printf("    -D/-delta-base [file]           image on device, identified by its checksum (-k). Following uploads (-w) only write changed 128B blocks\n");
+    printf("    -o/-option-file [file]          set option bytes from file. Only differing bytes are written, complements are added\n");
     printf("    -r/-read [start stop output]    read memory range (as hex) and save to file or print (output=console)\n");
     printf("    -e/-erase-sector [addr]         erase flash sector containing given address. Use carefully!\n");
     printf("    -E/-erase-full                  mass erase complete flash. Use carefully!\n");
+    printf("    -f/-fill [start stop value]     fill gaps in range with value (as hex) for subsequent -w\n");
+    printf("    -c/-clip [start stop]           clip data to range (as hex) for subsequent -w\n");
+    printf("    -x/-cut [start stop]            remove data in range (as hex) for subsequent -w\n");
+    printf("    -C/-copy [start stop dest]      copy data in range to address (as hex) for subsequent -w\n");
+    printf("    -m/-move [start stop dest]      move data in range to address (as hex) for subsequent -w\n");
+    printf("    -k/-checksum [type start stop addr]  store CRC over range at address (as hex) for subsequent -w.\n");
+    printf("                                    type: crc16 or crc32, optional '-le' and ':poly:init:xorout:reflect'\n");
     printf("\n");
     printf("Supported import formats:\n");
     printf("  - Motorola S19 (*.s19), see https://en.wikipedia.org/wiki/SREC_(file_format)\n");
     printf("  - Intel Hex (*.hex, *.ihx), see https://en.wikipedia.org/wiki/Intel_HEX\n");
     printf("  - ASCII table (*.txt) consisting of lines with 'addr  value' (dec or hex). Lines starting with '#' are ignored\n");
     printf("  - Binary data (*.bin) with an additional starting address\n");
+    printf("  - ELF32 executable (*.elf, *.sm8), loadable segments only\n");
+    printf("  - format can be forced by prefix 'fmt:', e.g. 's19:-' or 'bin:- 0x8000' for stdin (default: from extension)\n");
+    printf("  - gzip (*.gz) or xz (*.xz) compressed files, if built with USE_ZLIB or USE_LZMA\n");
     printf("\n");
     printf("Supported export formats:\n");
     printf("  - print to stdout (console)\n");
@@ -421,11 +1075,47 @@ int main(int argc, char ** argv) {
     printf("Data is uploaded and exported in the specified order, i.e. later uploads may\n");
     printf("overwrite previous uploads. Also exports only contain the previous uploads, i.e.\n");
     printf("intermediate exports only contain the memory content up to that point in time.\n");
+    printf("Image operations (-f, -c, -x, -C, -m, -k) form a pipeline, which is applied in the\n");
+    printf("specified order to all files imported afterwards, before upload.\n");
     printf("\n");
     Exit(0,0);
   }
 
 
+  ////////
+  // compile recipe to binary plan, then exit
+  ////////
+  if (recipeFile[0] != '\0') {
+    if (verbose != MUTE)
+      printf("\n%s (v%s)\n", appname, version);
+    plan_compile(recipeFile, planFile, verbose);
+    if (verbose != MUTE)
+      printf("done with program\n");
+    Exit(0, g_pauseOnExit);
+  }
+
+
+  ////////
+  // device farm: run jobs in separate processes with remaining options, then exit
+  ////////
+  if (farmFile[0] != '\0') {
+    if (!(common = calloc(argc, sizeof(*common))))
+      Error("Cannot allocate farm options");
+    numCommon = 0;
+    for (i=1; i<argc; i++) {
+      if ((!strcmp(argv[i], "-a")) || (!strcmp(argv[i], "-farm")))
+        i += 2;
+      else
+        common[numCommon++] = argv[i];
+    }
+    if (verbose != MUTE)
+      printf("\n%s (v%s)\n", appname, version);
+    j = farm_run(argv[0], numCommon, common, farmFile, farmWorkers, verbose);
+    free(common);
+    Exit((j == 0) ? 0 : 1, g_pauseOnExit);
+  }
+
+
   ////////
   // perform some misc tasks
   ////////
@@ -439,155 +1129,118 @@ int main(int argc, char ** argv) {
       verifyUpload = false;
   #endif
 
+  // open machine-readable progress channel
+  if (progressFd >= 0)
+    log_event_open(progressFd, progressRate);
+
+  // application output can only be captured via UART
+  if ((monitorPort) && (physInterface != UART))
+    Error("monitor only supported for UART interface");
+  if ((bootTime) && (physInterface != UART))
+    Error("boot time measurement only supported for UART interface");
+  if ((bootTime) && (jumpAddr == 0xFFFFFFFF))
+    Error("boot time measurement requires jump to application");
+
+  // asynchronous session only supports a single device via UART
+  if ((asyncUpload) && ((physInterface != UART) || (numGang > 0)))
+    Error("async upload (-A) only supported for UART interface and single device");
+
+  // memory budget relies on sparse buffers, which contradicts locked memory
+  if ((realTime) && (mem_sparse()))
+    Error("real-time mode (-t) not supported with memory budget (-Z)");
+
   // for background operation avoid prompt on exit
   if (g_backgroundOperation)
     g_pauseOnExit = false;
 
   if (g_backgroundOperation) {
     sprintf(tmp, "%s (v%s)", appname, version);
-    setConsoleTitle(tmp);
-  }
-
-  // reset console color (needs to be called once for Win32)
-  setConsoleColor(PRM_COLOR_DEFAULT);
-
-  // allocate and init global RAM image (>1MByte requires dynamic allocation)
-  if (!(imageBuf = malloc((LENIMAGEBUF + 1) * sizeof(*imageBuf))))
-    Error("Cannot allocate image buffer, try reducing LENIMAGEBUF");
-  memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
-
-
-  /////////////////
-  // initiate communication with STM8 bootloader
-  /////////////////
-
-  // print message
-  if (verbose != MUTE)
-    printf("\n%s (v%s)\n", appname, version);
-
-
-  ////////
-  // if no port name is given, list all available ports and query
-  ////////
-  if (strlen(portname) == 0) {
-    if (!g_backgroundOperation) {
-      printf("  enter comm port name ( ");
-      list_ports();
-      printf(" ): ");
-      scanf("%s", portname);
-      getchar();
-    }
-    else {
-      printf("  available comm ports ( ");
-      list_ports();
-      printf(" ), exit!");
-      Exit(1, 0);
-    }
-  } // if no comm port name
-
-
-  ////////
-  // reset STM8
-  // Note: prior to opening port to avoid flushing issue under Linux, see https://stackoverflow.com/questions/13013387/clearing-the-serial-ports-buffer
-  ////////
-
-  // skip reset of STM8
-  if (resetSTM8 == 0) {
-
-  }
-
-  // manually reset STM8
-  else if (resetSTM8 == 1) {
-    if (!g_backgroundOperation) {
-      printf("  reset STM8 and press <return>");
-      fflush(stdout);
-      fflush(stdin);
-      getchar();
-    }
-    else {
-      printf("  reset STM8 now\n");
-      fflush(stdout);
-    }
-  }
-
-  // HW reset STM8 using DTR line (USB/RS232)
-  else if (resetSTM8 == 2) {
-    if (verbose != MUTE)
-      printf("  reset via DTR ... ");
-    fflush(stdout);
-    ptrPort = init_port(portname, 115200, 100, 8, 0, 1, 0, 0);
-    pulse_DTR(ptrPort, 10);
-    close_port(&ptrPort);
-    if (verbose != MUTE)
-      printf("ok\n");
-    fflush(stdout);
-    SLEEP(20);                        // allow BSL to initialize
-  }
-
-  // SW reset STM8 via command 'Re5eT!' at 115.2kBaud with (8,0,1) (requires respective STM8 SW)
-  else if (resetSTM8 == 3) {
-    char buf[10] = "Re5eT!";          // reset command (same as in STM8 SW!)
-    if (verbose != MUTE)
-      printf("  reset via UART command ... ");
-    fflush(stdout);
-    ptrPort = init_port(portname, 115200, 100, 8, 0, 1, 0, 0);
-    for (i=0; i<6; i++) {
-      send_port(ptrPort, 0, 1, buf+i);   // send reset command bytewise to account for possible slow handling on STM8 side
-      SLEEP(10);
-    }
-    close_port(&ptrPort);
-    if (verbose != MUTE)
-      printf("ok\n");
-    fflush(stdout);
-    SLEEP(20);                        // allow BSL to initialize
+    setConsoleTitle(tmp);
   }
 
-  // HW reset STM8 using Arduino pin 8 -> delay until Arduino port is open
-  else if (resetSTM8 == 4) {
+  // reset console color (needs to be called once for Win32)
+  setConsoleColor(PRM_COLOR_DEFAULT);
 
-    // dummy
+  // for real-time mode lock protocol working set, before the large buffers are allocated
+  if (realTime)
+    timing_lock();
 
+  // allocate and init global RAM image (>1MByte requires dynamic allocation)
+  imageBuf = mem_alloc(MEM_IMAGE, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+
+  // load first input file (or all files for -M) in background, overlapping with reset and sync of STM8
+  preloadBuf  = NULL;
+  baseBuf     = NULL;
+  preloadTask = NULL;
+  if (numMerge > 0) {
+    preloadBuf = mem_alloc(MEM_IMAGE, (LENIMAGEBUF + 1) * sizeof(*preloadBuf));
+    preloadTask = import_files_start((mergeFiles ? numMerge : 1), mergeNames, mergeFormats, mergeAddr, preloadBuf);
   }
 
-  // HW reset STM8 using header pin 12 (only Raspberry Pi!)
-  #if defined(__ARMEL__) && defined(USE_WIRING)
-    else if (resetSTM8 == 5) {
-      if (verbose != MUTE)
-        printf("  reset via Raspi pin 12 ... ");
-      fflush(stdout);
-      pulse_GPIO(12, 20);
-      if (verbose != MUTE)
-        printf("ok\n");
-      fflush(stdout);
-      SLEEP(20);                      // allow BSL to initialize
-    }
-  #endif // __ARMEL__ && USE_WIRING
 
-  // HW reset STM8 using RTS line (USB/RS232)
-    else if(resetSTM8 == 6)
-    {
-        if(verbose != MUTE)
-            printf("  reset via RTS ... ");
-        fflush(stdout);
-        ptrPort = init_port(portname, 115200, 100, 8, 0, 1, 0, 0);
-        pulse_RTS(ptrPort, 10);
-        close_port(&ptrPort);
-        if(verbose != MUTE)
-            printf("ok\n");
-        fflush(stdout);
-        SLEEP(20); // allow BSL to initialize
+  /////////////////
+  // initiate communication with STM8 bootloader
+  /////////////////
+
+  // print message
+  if (verbose != MUTE)
+    printf("\n%s (v%s)\n", appname, version);
+
+
+  ////////
+  // if no port name is given, list all available ports and query
+  ////////
+  if (strlen(portname) == 0) {
+    if ((!g_backgroundOperation) && (!useStdin)) {
+      printf("  enter comm port name ( ");
+      list_ports();
+      printf(" ): ");
+      scanf("%s", portname);
+      getchar();
+    }
+    else {
+      printf("  available comm ports ( ");
+      list_ports();
+      printf(" ), exit!");
+      Exit(1, 0);
     }
+  } // if no comm port name
 
-  // unknown reset method -> error
-  else {
-    #ifdef __ARMEL__
-      Error("reset method %d not supported (0=skip, 1=manual, 2=DTR line (RS232), 3=send 'Re5eT!' @ 115.2kBaud, 4=Arduino pin 8, 5=Raspi pin 12, 6=RTS line (RS232))", resetSTM8);
-    #else
-      Error("reset method %d not supported (0=skip, 1=manual, 2=DTR line (RS232), 3=send 'Re5eT!' @ 115.2kBaud, 4=Arduino pin 8, 6=RTS line (RS232))", resetSTM8);
-    #endif
+
+  ////////
+  // reset STM8
+  // Note: prior to opening port to avoid flushing issue under Linux, see https://stackoverflow.com/questions/13013387/clearing-the-serial-ports-buffer
+  ////////
+
+  ////////
+  // optionally run protocol with real-time priority. After port query to avoid blocking on input
+  ////////
+  if (realTime)
+    timing_realtime(verbose);
+
+
+  ////////
+  // load timing for port from profile, if available. Only port settings (baudrate, port delay) are
+  // required before identification. The device timing is applied after the device was checked
+  ////////
+  if (!tuneTiming) {
+    profileLoaded = timing_load(profile, portname, &profileTiming, deviceId, verbose);
+    if (profileLoaded) {
+      g_timing.portDelay = profileTiming.portDelay;
+      if ((physInterface == UART) && (!baudrateSet) && (profileTiming.baudrate != 0))
+        baudrate = profileTiming.baudrate;
+    }
   }
 
 
+  ////////
+  // reset STM8
+  ////////
+
+  // reset STM8 via selected method
+  reset_STM8(portname, resetSTM8, verbose, (!g_backgroundOperation) && (!useStdin));
+
+
   ////////
   // open port with given properties
   ////////
@@ -600,11 +1253,34 @@ int main(int argc, char ** argv) {
     else if (verbose == CHATTY)
       printf("  open serial port '%s' with %gkBaud ... ", portname, (float) baudrate / 1000.0);
     fflush(stdout);
-    ptrPort = init_port(portname, baudrate, TIMEOUT, 8, 0, 1, 0, 0);   // start without parity, may be changed in bsl_sync()
+    ptrPort = init_port(portname, baudrate, g_timing.timeout, 8, 0, 1, 0, 0);   // start without parity, may be changed in bsl_sync()
     if ((verbose == INFORM) || (verbose == CHATTY))
       printf("done\n");
     fflush(stdout);
 
+    // gang programming: open RX ports of further devices with same properties
+    if (numGang > 0) {
+      if (tuneTiming)
+        Error("timing calibration not supported for gang programming");
+      if ((uartMode == 1) || (uartMode == 2))
+        Error("gang programming requires UART duplex mode (-u 0)");
+      uartMode = 0;           // shared TX line -> no echo or reply
+      strncpy(gangNames[0], portname, STRLEN-1);
+      gangPorts[0] = ptrPort;
+      for (i=1; i<numGang; i++) {
+        if (verbose == INFORM)
+          printf("  open gang RX port '%s' ... ", gangNames[i]);
+        else if (verbose == CHATTY)
+          printf("  open gang RX port '%s' with %gkBaud ... ", gangNames[i], (float) baudrate / 1000.0);
+        fflush(stdout);
+        gangPorts[i] = init_port(gangNames[i], baudrate, g_timing.timeout, 8, 0, 1, 0, 0);
+        if ((verbose == INFORM) || (verbose == CHATTY))
+          printf("done\n");
+        fflush(stdout);
+      }
+      bsl_gangSetup(numGang, gangPorts);
+    }
+
   } // UART
 
   // SPI via Arduino
@@ -655,7 +1331,7 @@ int main(int argc, char ** argv) {
       if ((verbose == INFORM) || (verbose == CHATTY))
         printf("ok\n");
       fflush(stdout);
-      SLEEP(20);                      // allow BSL to initialize
+      SLEEP(g_timing.resetDelay);     // allow BSL to initialize
     }
 
   } // SPI via Arduino
@@ -710,8 +1386,10 @@ int main(int argc, char ** argv) {
   ////////
 
   // required to make flush work, for some reason
-  SLEEP(200);
+  SLEEP(g_timing.portDelay);
   flush_port(ptrPort);
+  for (i=1; i<numGang; i++)
+    flush_port(gangPorts[i]);
 
   // synchronize with bootloader. For UART also sync baudrate
   bsl_sync(ptrPort, physInterface, verbose);
@@ -720,6 +1398,8 @@ int main(int argc, char ** argv) {
   if (physInterface == UART) {
     if (uartMode == 0) {
       set_parity(ptrPort, 2);
+      for (i=1; i<numGang; i++)
+        set_parity(gangPorts[i], 2);
       if (verbose != MUTE)
         printf("  set UART mode: duplex\n");
     }
@@ -740,9 +1420,109 @@ int main(int argc, char ** argv) {
   } // UART interface
   fflush(stdout);
 
+  // asynchronous session requires duplex mode, e.g. no 1-wire echo
+  if ((asyncUpload) && (uartMode != 0))
+    Error("async upload (-A) requires UART duplex mode");
+
   // get bootloader info for selecting RAM w/e routines for flash
   bsl_getInfo(ptrPort, physInterface, uartMode, &flashsize, &versBSL, &family, verbose);
 
+  // apply timing profile only if it was measured with this device, else keep default timing
+  if (profileLoaded) {
+    char  id[STRLEN];
+    timing_device_id(family, flashsize, versBSL, id);
+    if (strcmp(id, deviceId) == 0) {
+      memcpy(&g_timing, &profileTiming, sizeof(g_timing));
+      if (physInterface == UART)
+        set_timeout(ptrPort, g_timing.timeout);
+    }
+    else {
+      if (verbose >= INFORM)
+        printf("  timing profile is for %s, use default timing\n", deviceId);
+      fflush(stdout);
+      timing_init();
+    }
+  }
+
+
+  ////////
+  // calibrate timing of fixture, store to profile and exit
+  ////////
+  if (tuneTiming) {
+
+    // only supported for UART
+    if (physInterface != UART)
+      Error("timing calibration only supported for UART interface");
+
+    // measure response timeout, purge delay and sync interval
+    timing_calibrate(ptrPort, uartMode, verbose);
+    close_port(&ptrPort);
+
+    // with automatic hardware reset also find max. baudrate and min. port/reset delays. Each check requires a reset.
+    // Reset via 'Re5eT!' (-R 3) requires the application, which isn't running after a check -> skip
+    if (resetSTM8 == 3) {
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("  skip baudrate and delay calibration, reset via 'Re5eT!' requires running application\n");
+      fflush(stdout);
+    }
+    if ((resetSTM8 == 2) || (resetSTM8 == 5) || (resetSTM8 == 6)) {
+
+      const uint32_t  baudrates[] = {230400, 115200, 57600, 38400, 19200, 9600};   // tested baudrates, descending
+      const uint32_t  delays[]    = {2, 5, 10, 20, 50, 100, 200};                  // tested delays [ms], ascending
+      int             numBaud  = sizeof(baudrates)/sizeof(baudrates[0]);
+      int             numDelay = sizeof(delays)/sizeof(delays[0]);
+
+      // find max. baudrate with default delays
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("  calibrate baudrate ... ");
+      fflush(stdout);
+      for (j=0; j<numBaud; j++) {
+        if (probe_fixture(portname, resetSTM8, uartMode, baudrates[j], 3))
+          break;
+      }
+      if (j == numBaud)
+        Error("no reliable baudrate found");
+      g_timing.baudrate = baudrates[j];
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("done (%d Baud)\n", (int) g_timing.baudrate);
+      fflush(stdout);
+
+      // find min. delays after reset and after opening port, with 2x margin
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("  calibrate reset delay ... ");
+      fflush(stdout);
+      for (j=0; j<numDelay; j++) {
+        g_timing.portDelay  = delays[j];
+        g_timing.resetDelay = delays[j];
+        if (probe_fixture(portname, resetSTM8, uartMode, g_timing.baudrate, 3))
+          break;
+      }
+      if (j < numDelay) {
+        g_timing.portDelay  = (2*delays[j] < 200) ? 2*delays[j] : 200;
+        g_timing.resetDelay = (2*delays[j] < 20)  ? 2*delays[j] : 20;
+      }
+      else {
+        g_timing.portDelay  = 200;
+        g_timing.resetDelay = 20;
+      }
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("done (port %dms, reset %dms)\n", (int) g_timing.portDelay, (int) g_timing.resetDelay);
+      fflush(stdout);
+
+    } // automatic reset
+
+    // store timing for port and device
+    timing_device_id(family, flashsize, versBSL, deviceId);
+    timing_save(profile, portname, deviceId, verbose);
+
+    // terminate program
+    if (verbose != MUTE)
+      printf("done with program\n");
+    mem_free(imageBuf);
+    Exit(0, g_pauseOnExit);
+
+  } // tune timing
+
   // for STM8S and 8kB STM8L upload RAM routines, else skip
   if ((family == STM8S) || (flashsize==8)) {
 
@@ -834,7 +1614,7 @@ int main(int argc, char ** argv) {
 
 
     // clear image buffer
-    memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+    imageBuf = mem_clear(imageBuf);
 
     // convert correct array containing s19 file to RAM image
     convert_s19(ptrRAM, lenRAM, imageBuf, MUTE);
@@ -852,7 +1632,7 @@ int main(int argc, char ** argv) {
     fflush(stdout);
 
     // clear memory image again
-    memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+    imageBuf = mem_clear(imageBuf);
 
   } // if STM8S or low-density STM8L -> upload RAM code
 
@@ -932,61 +1712,256 @@ int main(int argc, char ** argv) {
     }
 
 
+    // skip timing calibration flag w/o parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-T")) || (!strcmp(argv[i], "-tune-timing"))) {
+      i += 0;   // dummy
+    }
+
+
+    // skip real-time flag w/o parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-t")) || (!strcmp(argv[i], "-realtime"))) {
+      i += 0;   // dummy
+    }
+
+
+    // skip async flag w/o parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-A")) || (!strcmp(argv[i], "-async"))) {
+      i += 0;   // dummy
+    }
+
+
+    // skip gang RX port with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-G")) || (!strcmp(argv[i], "-gang-rx"))) {
+      i += 1;
+    }
+
+
+    // skip monitor with 2 parameters, is handled in 1st run
+    else if ((!strcmp(argv[i], "-L")) || (!strcmp(argv[i], "-monitor"))) {
+      i += 2;
+    }
+
+
+    // skip monitor patterns with 2 parameters, is handled in 1st run
+    else if ((!strcmp(argv[i], "-X")) || (!strcmp(argv[i], "-match"))) {
+      i += 2;
+    }
+
+
+    // skip fault injection with 1 parameter, is handled in 1st run
+    #if defined(USE_FAULT)
+      else if ((!strcmp(argv[i], "-I")) || (!strcmp(argv[i], "-inject-faults"))) {
+        i += 1;
+      }
+    #endif // USE_FAULT
+
+
+    // skip memory budget with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-Z")) || (!strcmp(argv[i], "-mem-budget"))) {
+      i += 1;
+    }
+
+
+    // skip progress channel with 2 parameters, is handled in 1st run
+    else if ((!strcmp(argv[i], "-F")) || (!strcmp(argv[i], "-progress-fd"))) {
+      i += 2;
+    }
+
+
+    // skip boot time with 2 parameters, is handled in 1st run
+    else if ((!strcmp(argv[i], "-g")) || (!strcmp(argv[i], "-boot-time"))) {
+      i += 2;
+    }
+
+
+    // skip timing profile with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-P")) || (!strcmp(argv[i], "-profile"))) {
+      i += 1;
+    }
+
+
+    // skip recipe compilation with 2 parameters, is handled in 1st run
+    else if ((!strcmp(argv[i], "-y")) || (!strcmp(argv[i], "-compile-plan"))) {
+      i += 2;
+    }
+
+
+    // skip device farm with 2 parameters, is handled in 1st run
+    else if ((!strcmp(argv[i], "-a")) || (!strcmp(argv[i], "-farm"))) {
+      i += 2;
+    }
+
+
+    // skip merge flag w/o parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-M")) || (!strcmp(argv[i], "-merge-files"))) {
+      i += 0;   // dummy
+    }
+
+
+    // upload merged image of all files at first occurence -> perform here
+    else if (mergeFiles && ((!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "-write-file")))) {
+
+      // skip file name and optional address, files are known from 1st pass
+      if (get_file_format(argv[++i], tmp) == FORMAT_BIN)
+        i++;
+
+      // only upload once
+      if (numMerge == 0)
+        continue;
+
+      // get merged image of all files from background import (started before reset)
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("  load and merge %d files ... ", numMerge);
+      fflush(stdout);
+      import_files_wait(preloadTask);
+      preloadTask = NULL;
+      swapBuf    = imageBuf;              // use preloaded image, old buffer is released on exit
+      imageBuf   = preloadBuf;
+      preloadBuf = swapBuf;
+      numMerge = 0;
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("done (preloaded)\n");
+      fflush(stdout);
+
+      // apply pipeline of image operations
+      transform_image(imageBuf, numOps, imageOps, verbose);
+
+      // for delta upload only keep blocks which differ from image on device
+      if (baseBuf != NULL)
+        diff_image(imageBuf, baseBuf, WRITE_BLOCKSIZE, verbose);
+
+      // get image size
+      get_image_size(imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+
+      // upload merged memory image to STM8 in single pass
+      if ((numData > 0) && (asyncUpload))
+        bsl_async_upload(ptrPort, uartMode, imageBuf, addrStart, addrStop, verifyUpload, verbose);
+      else if (numData > 0)
+        bsl_memWrite(ptrPort, physInterface, uartMode, imageBuf, addrStart, addrStop, verbose);
+
+      // optionally verify upload
+      if ((verifyUpload) && (numData > 0) && (!asyncUpload))
+        bsl_memVerify(ptrPort, physInterface, uartMode, imageBuf, addrStart, addrStop, verbose);
+
+      // clear memory image again
+      imageBuf = mem_clear(imageBuf);
+
+    } // write merged
+
+
     // upload file -> perform here
     else if ((!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "-write-file"))) {
 
       // intermediate variables
-      char      infile[STRLEN]="";     // name of input file
-      char      *fileBuf;              // RAM buffer for input file
-      uint64_t  lenFile;               // length of file in fileBuf
+      char          infile[STRLEN]="";     // name of input file
+      fileFormat_t  format;                // file format from prefix or extension
 
-      // allocate intermediate buffers (>1MByte requires dynamic allocation)
-      if (!(fileBuf = malloc(LENFILEBUF * sizeof(*fileBuf))))
-        Error("Cannot allocate file buffer, try reducing LENFILEBUF");
-
-      // get file name
-      strncpy(infile, argv[++i], STRLEN-1);
+      // get file name and format. Name "-" reads from stdin
+      format = get_file_format(argv[++i], infile);
 
       // for binary file also get starting address
-      if (strstr(infile, ".bin") != NULL) {
+      if (format == FORMAT_BIN) {
         strncpy(tmp, argv[++i], STRLEN-1);
         sscanf(tmp, "%" SCNx64, &addrStart);
       }
 
-      // import file into string buffer (no interpretation, yet)
-      load_file(infile, fileBuf, &lenFile, verbose);
+      // first file was imported in background (started before reset) -> get image
+      if (preloadTask != NULL) {
+        if ((verbose == INFORM) || (verbose == CHATTY))
+          printf("  load '%s' ... ", infile);
+        fflush(stdout);
+        import_files_wait(preloadTask);
+        preloadTask = NULL;
+        swapBuf    = imageBuf;            // use preloaded image, old buffer is released on exit
+        imageBuf   = preloadBuf;
+        preloadBuf = swapBuf;
+        if ((verbose == INFORM) || (verbose == CHATTY))
+          printf("done (preloaded)\n");
+        fflush(stdout);
+      }
+
+      // import file and convert to memory image, depending on file type
+      else {
+        imageBuf = mem_clear(imageBuf);
+        import_file(infile, format, addrStart, imageBuf, verbose);
+      }
+
+      // apply pipeline of image operations. Images of a plan are already transformed
+      if (format != FORMAT_PLAN)
+        transform_image(imageBuf, numOps, imageOps, verbose);
 
-      // clear image buffer
-      memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
-
-      // convert to memory image, depending on file type
-      if (strstr(infile, ".s19") != NULL)   // Motorola S-record format
-        convert_s19(fileBuf, lenFile, imageBuf, verbose);
-      else if ((strstr(infile, ".hex") != NULL) || (strstr(infile, ".ihx") != NULL))   // Intel HEX-format
-        convert_ihx(fileBuf, lenFile, imageBuf, verbose);
-      else if (strstr(infile, ".txt") != NULL)   // text table (Addr / Data)
-        convert_txt(fileBuf, lenFile, imageBuf, verbose);
-      else if (strstr(infile, ".bin") != NULL)   // binary file
-        convert_bin(fileBuf, lenFile, addrStart, imageBuf, verbose);
-      else
-        Error("Input file %s has unsupported format (*.s19, *.hex, *.ihx, *.txt, *.bin)", infile);
+      // for delta upload only keep blocks which differ from image on device
+      if (baseBuf != NULL)
+        diff_image(imageBuf, baseBuf, WRITE_BLOCKSIZE, verbose);
 
       // get image size
       get_image_size(imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
 
       // upload memory image to STM8
-      bsl_memWrite(ptrPort, physInterface, uartMode, imageBuf, addrStart, addrStop, verbose);
+      if ((numData > 0) && (asyncUpload))
+        bsl_async_upload(ptrPort, uartMode, imageBuf, addrStart, addrStop, verifyUpload, verbose);
+      else if (numData > 0)
+        bsl_memWrite(ptrPort, physInterface, uartMode, imageBuf, addrStart, addrStop, verbose);
 
       // optionally verify upload
-      if (verifyUpload)
+      if ((verifyUpload) && (numData > 0) && (!asyncUpload))
         bsl_memVerify(ptrPort, physInterface, uartMode, imageBuf, addrStart, addrStop, verbose);
 
       // clear memory image again
-      memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+      imageBuf = mem_clear(imageBuf);
 
     } // write
 
 
+    // set base image for delta upload -> perform here
+    else if ((!strcmp(argv[i], "-D")) || (!strcmp(argv[i], "-delta-base"))) {
+
+      // intermediate variables
+      char          infile[STRLEN]="";     // name of input file
+      fileFormat_t  format;                // file format from prefix or extension
+
+      // import base image and apply same operations as for uploads. Images of a plan are already transformed
+      format = get_file_format(argv[++i], infile);
+      if (baseBuf == NULL)
+        baseBuf = mem_alloc(MEM_IMAGE, (LENIMAGEBUF + 1) * sizeof(*baseBuf));
+      else
+        baseBuf = mem_clear(baseBuf);
+      import_file(infile, format, 0, baseBuf, verbose);
+      if (format != FORMAT_PLAN)
+        transform_image(baseBuf, numOps, imageOps, verbose);
+
+      // check base image on device, else upload full image
+      if (!check_base(ptrPort, physInterface, uartMode, baseBuf, numOps, imageOps, verbose)) {
+        mem_free(baseBuf);
+        baseBuf = NULL;
+      }
+
+    } // delta-base
+
+
+    // set option bytes with minimal write cycles -> perform here
+    else if ((!strcmp(argv[i], "-o")) || (!strcmp(argv[i], "-option-file"))) {
+
+      // intermediate variables
+      char          infile[STRLEN]="";     // name of input file
+      fileFormat_t  format;                // file format from prefix or extension
+
+      // get file name and format. Binary file starts at option area
+      format = get_file_format(argv[++i], infile);
+
+      // import option bytes
+      imageBuf = mem_clear(imageBuf);
+      import_file(infile, format, OPT_START, imageBuf, verbose);
+
+      // read option area, write differing bytes and verify
+      bsl_optionWrite(ptrPort, physInterface, uartMode, imageBuf, family, verifyUpload, verbose);
+
+      // clear memory image again
+      imageBuf = mem_clear(imageBuf);
+
+    } // option-file
+
+
     // set value at given address -> perform here
     else if ((!strcmp(argv[i], "-W")) || (!strcmp(argv[i], "-write-byte"))) {
 
@@ -995,7 +1970,7 @@ int main(int argc, char ** argv) {
       int       val;
 
       // clear image buffer
-      memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+      imageBuf = mem_clear(imageBuf);
 
       // get address and value and store to parameters for bsl_memWrite
       sscanf(argv[++i], "%" SCNx64, &addr);
@@ -1013,7 +1988,7 @@ int main(int argc, char ** argv) {
         bsl_memVerify(ptrPort, physInterface, uartMode, imageBuf, addrStart, addrStop, verbose);
 
       // clear memory image again
-      memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+      imageBuf = mem_clear(imageBuf);
 
     } // set
 
@@ -1031,7 +2006,7 @@ int main(int argc, char ** argv) {
       strncpy(outfile, argv[++i], STRLEN-1);
 
       // clear image buffer
-      memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+      imageBuf = mem_clear(imageBuf);
 
       // read memory
       bsl_memRead(ptrPort, physInterface, uartMode, addrStart, addrStop, imageBuf, verbose);
@@ -1049,7 +2024,7 @@ int main(int argc, char ** argv) {
         export_txt("console", imageBuf, verbose);
 
       // clear image buffer
-      memset(imageBuf, 0, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+      imageBuf = mem_clear(imageBuf);
 
     } // read
 
@@ -1067,6 +2042,13 @@ int main(int argc, char ** argv) {
     } // sector_erase
 
 
+    // add operation to image pipeline (fill, clip, cut, copy, move, CRC), is applied to subsequent file uploads
+    else if ((j = get_image_op(argv+i, &(imageOps[numOps]))) > 0) {
+      i += j;
+      numOps++;
+    } // image operation
+
+
     // mass erase flash -> perform here
     else if ((!strcmp(argv[i], "-E")) || (!strcmp(argv[i], "-erase-full"))) {
 
@@ -1100,19 +2082,100 @@ int main(int argc, char ** argv) {
     #endif
 
     // jumpt to application
-    bsl_jumpTo(ptrPort, physInterface, uartMode, jumpAddr, verbose);
+    bsl_jumpTo(ptrPort, physInterface, uartMode, jumpAddr, &timeJump, verbose);
 
   } // jump to STM8 address
 
 
+  ////////
+  // measure boot time of application, for gang programming over all active devices
+  ////////
+  if (bootTime) {
+    int  numOk, numActive;
+
+    if (numGang > 0) {
+      numActive = bsl_gangStatus(gangActive);
+      numOk = monitor_boot(numGang, gangPorts, gangActive, monitorBaud, timeJump, bootSign, lenBootSign, bootTimeout, verbose);
+    }
+    else {
+      numActive = 1;
+      numOk = monitor_boot(1, &ptrPort, NULL, monitorBaud, timeJump, bootSign, lenBootSign, bootTimeout, verbose);
+    }
+    if (numOk < numActive) {
+      if (verbose != MUTE)
+        printf("  boot time: signature not received from %d device(s)\n", numActive - numOk);
+      for (i=1; i<numGang; i++)
+        close_port(&(gangPorts[i]));
+      close_port(&ptrPort);
+      Exit(1, g_pauseOnExit);
+    }
+
+  } // boot time
+
+
+  ////////
+  // capture application output, e.g. self-test result. Only UART, for gang only 1st device
+  ////////
+  if (monitorPort) {
+    monitorResult_t  result;
+
+    result = monitor_port(ptrPort, monitorBaud, 1000*monitorTime, matchPass, matchFail, verbose);
+    if ((result == MONITOR_FAIL) || ((result == MONITOR_TIMEOUT) && (matchPass[0] != '\0'))) {
+      if (verbose != MUTE)
+        printf("  monitor: %s\n", (result == MONITOR_FAIL) ? "fail pattern received" : "pass pattern not received");
+      for (i=1; i<numGang; i++)
+        close_port(&(gangPorts[i]));
+      close_port(&ptrPort);
+      Exit(1, g_pauseOnExit);
+    }
+
+  } // monitor port
+
+
+  // gang programming: report dropped devices
+  if ((numGang > 0) && (bsl_gangStatus(gangActive) < numGang)) {
+    if (verbose != MUTE) {
+      printf("  gang: %d of %d devices ok, failed:", bsl_gangStatus(NULL), numGang);
+      for (i=0; i<numGang; i++) {
+        if (!gangActive[i])
+          printf(" '%s'", gangNames[i]);
+      }
+      printf("\n");
+    }
+    for (i=1; i<numGang; i++)
+      close_port(&(gangPorts[i]));
+    close_port(&ptrPort);
+    Exit(1, g_pauseOnExit);
+  }
+  else if ((numGang > 0) && (verbose != MUTE))
+    printf("  gang: %d of %d devices ok\n", numGang, numGang);
+
+  // report injected faults and time lost
+  fault_report(verbose);
+
+  // report peak memory and allocations per subsystem
+  mem_report(verbose);
+
   // print message
   if (verbose != MUTE)
     printf("done with program\n");
 
-  // release global buffer
-  free(imageBuf);
-
-  // close communication port
+  // release global buffers
+  mem_free(imageBuf);
+  mem_free(preloadBuf);
+  mem_free(baseBuf);
+
+  // release list of input files
+  for (i=0; i<argc; i++)
+    free(mergeNames[i]);
+  free(mergeNames);
+  free(mergeFormats);
+  free(mergeAddr);
+  free(imageOps);
+
+  // close communication port(s)
+  for (i=1; i<numGang; i++)
+    close_port(&(gangPorts[i]));
   close_port(&ptrPort);
 
   // terminate program
@@ -33,7 +33,7 @@
 /// max length of strings, e.g. filenames
 #define  STRLEN   1000
 
-/// UART communication timeout
+/// UART communication timeout (default, may be tuned via timing profile)
 #define  TIMEOUT  1000
 
 /// max. number of bootloader synchronization attempts
@@ -58,6 +58,18 @@ typedef enum {MUTE=0, SILENT, INFORM, CHATTY} verbose_t;
 #endif
 
 
+/// timing parameters. Defaults are worst-case values, which may be tuned per fixture via profile (see timing.c)
+typedef struct {
+  uint32_t  timeout;              ///< UART response timeout [ms]
+  uint32_t  syncRetry;            ///< max. number of bootloader synchronization attempts
+  uint32_t  syncDelay;            ///< delay between synchronization attempts [ms]
+  uint32_t  flushDelay;           ///< delay after purging port buffers [ms]
+  uint32_t  portDelay;            ///< delay after opening port before synchronization [ms]
+  uint32_t  resetDelay;           ///< delay after reset for bootloader initialization [ms]
+  uint32_t  baudrate;             ///< max. reliable UART baudrate [Baud] (0=not calibrated)
+} timing_t;
+
+
 /*******
   global variables
 *******/
@@ -75,6 +87,9 @@ global bool           g_pauseOnExit;
 /// optimize for background operation, e.g. skip prompts and console colors
 global bool           g_backgroundOperation;
 
+/// timing parameters for bootloader communication
+global timing_t       g_timing;
+
 // undefine global keyword
 #undef global
 
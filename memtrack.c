@@ -0,0 +1,344 @@
+/**
+  \file memtrack.c
+
+  \author G. Icking-Konert
+  \date 2019-02-23
+  \version 0.1
+
+  \brief implementation of memory accounting and budget routines
+
+  implementation of routines for allocating large buffers with per-subsystem
+  accounting, for reporting the peak resident memory of the process, and for
+  keeping a run within a memory budget.
+  Buffers are allocated with calloc(), i.e. only pages actually used become
+  resident. Without budget buffers are cleared by overwriting, which touches all
+  pages. With budget they are cleared by re-allocation instead, and callers use
+  buffers only as large as required. The memory estimated for a step, e.g. from the
+  decompressed size of an input file, is checked against the budget before its
+  buffers are allocated, and the resident memory after each step, to fail fast
+  instead of swapping.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#if defined(WIN32)
+  #include <windows.h>        // for critical section
+  #include <psapi.h>          // for GetProcessMemoryInfo()
+  #if defined(_MSC_VER)
+    #pragma comment(lib, "psapi.lib")
+  #endif
+#else
+  #include <pthread.h>        // for mutex
+  #include <unistd.h>         // for sysconf()
+  #include <sys/resource.h>   // for getrusage()
+#endif
+#include "memtrack.h"
+#include "main.h"
+#include "misc.h"
+
+
+/// header in front of each buffer, keeps 16B alignment of data
+typedef struct {
+  uint64_t    numBytes;       //< size of data [B]
+  uint64_t    pool;           //< subsystem for accounting
+} memHeader_t;
+
+
+// system specific mutex. Buffers are also allocated by import threads
+#if defined(WIN32)
+  typedef CRITICAL_SECTION    memMutex_t;
+  #define MUTEX_INIT(m)       InitializeCriticalSection(m)
+  #define MUTEX_LOCK(m)       EnterCriticalSection(m)
+  #define MUTEX_UNLOCK(m)     LeaveCriticalSection(m)
+#else
+  typedef pthread_mutex_t     memMutex_t;
+  #define MUTEX_INIT(m)       pthread_mutex_init(m, NULL)
+  #define MUTEX_LOCK(m)       pthread_mutex_lock(m)
+  #define MUTEX_UNLOCK(m)     pthread_mutex_unlock(m)
+#endif
+
+
+// global variables
+static const char *s_memName[MEM_NUM] = {"image", "file", "verify"};
+static uint64_t    s_memBudget = 0;            //< memory budget [B] (0=none)
+static bool        s_memInit = false;          //< mutex is initialized
+static memMutex_t  s_memMutex;                 //< protects below counters
+static uint64_t    s_memNow[MEM_NUM];          //< currently allocated per subsystem [B]
+static uint64_t    s_memPeak[MEM_NUM];         //< peak allocated per subsystem [B]
+static uint32_t    s_memCount[MEM_NUM];        //< number of allocations per subsystem
+
+
+
+/**
+  \fn void mem_budget(uint64_t budget)
+
+  \param[in] budget   memory budget [B], or 0 for none
+
+  set memory budget and select sparse strategies. Terminates if the budget is
+  already exceeded, e.g. by the executable itself.
+*/
+void mem_budget(uint64_t budget) {
+
+  s_memBudget = budget;
+  mem_check("start");
+
+} // mem_budget
+
+
+
+/**
+  \fn bool mem_sparse(void)
+
+  \return true if sparse strategies are selected
+
+  check if sparse strategies are selected, i.e. a memory budget is set.
+*/
+bool mem_sparse(void) {
+
+  return(s_memBudget != 0);
+
+} // mem_sparse
+
+
+
+/**
+  \fn void *mem_alloc(memPool_t pool, uint64_t numBytes)
+
+  \param[in] pool       subsystem for accounting
+  \param[in] numBytes   size of buffer [B]
+
+  \return pointer to zero-initialized buffer
+
+  allocate zero-initialized buffer and account it to subsystem. Only pages actually
+  used are mapped by the OS. Terminates on failure. Is first called by main thread, which initializes the mutex.
+*/
+void *mem_alloc(memPool_t pool, uint64_t numBytes) {
+
+  memHeader_t  *header;
+
+  // allocate buffer incl. header
+  if (!(header = calloc(1, sizeof(memHeader_t) + numBytes)))
+    Error("Cannot allocate %s buffer (%1.1fMB)", s_memName[pool], (float) numBytes / 1024.0 / 1024.0);
+  header->numBytes = numBytes;
+  header->pool     = pool;
+
+  // account buffer to subsystem
+  if (!s_memInit) {
+    MUTEX_INIT(&s_memMutex);
+    s_memInit = true;
+  }
+  MUTEX_LOCK(&s_memMutex);
+  s_memNow[pool] += numBytes;
+  if (s_memNow[pool] > s_memPeak[pool])
+    s_memPeak[pool] = s_memNow[pool];
+  s_memCount[pool]++;
+  MUTEX_UNLOCK(&s_memMutex);
+
+  // return data area
+  return((void*) (header + 1));
+
+} // mem_alloc
+
+
+
+/**
+  \fn void mem_free(void *ptr)
+
+  \param[in] ptr    buffer allocated with mem_alloc() or mem_clear(), or NULL
+
+  release buffer and remove it from accounting.
+*/
+void mem_free(void *ptr) {
+
+  memHeader_t  *header;
+
+  if (ptr == NULL)
+    return;
+
+  header = ((memHeader_t*) ptr) - 1;
+  MUTEX_LOCK(&s_memMutex);
+  s_memNow[header->pool] -= header->numBytes;
+  MUTEX_UNLOCK(&s_memMutex);
+  free(header);
+
+} // mem_free
+
+
+
+/**
+  \fn void *mem_clear(void *ptr)
+
+  \param[in] ptr    buffer allocated with mem_alloc() or mem_clear()
+
+  \return new address of buffer
+
+  clear buffer. Without budget the buffer is overwritten, with budget it is
+  re-allocated, which releases the used pages to the OS.
+*/
+void *mem_clear(void *ptr) {
+
+  memHeader_t  *header = ((memHeader_t*) ptr) - 1;
+  uint64_t     numBytes = header->numBytes;
+  memPool_t    pool = (memPool_t) header->pool;
+
+  // no budget -> overwrite
+  if (s_memBudget == 0) {
+    memset(ptr, 0, numBytes);
+    return(ptr);
+  }
+
+  // budget -> release and allocate again. Keep allocation count
+  mem_free(ptr);
+  ptr = mem_alloc(pool, numBytes);
+  MUTEX_LOCK(&s_memMutex);
+  s_memCount[pool]--;
+  MUTEX_UNLOCK(&s_memMutex);
+  return(ptr);
+
+} // mem_clear
+
+
+
+/**
+  \fn void mem_check_need(const char *step, uint64_t need)
+
+  \param[in] step   name of next step for error message
+  \param[in] need   estimated memory becoming resident in next step [B]
+
+  terminate before a step, e.g. file import or verify, if its estimated memory
+  exceeds the remaining budget. Called before the buffers are allocated.
+*/
+void mem_check_need(const char *step, uint64_t need) {
+
+  uint64_t     rss, avail;
+
+  if (s_memBudget == 0)
+    return;
+
+  // estimated vs. available memory
+  rss   = mem_rss(false);
+  avail = (rss < s_memBudget) ? (s_memBudget - rss) : 0;
+  if (need > avail)
+    Error("%s requires approx. %1.1fMB, exceeds memory budget (%1.1fMB available)", step,
+      (float) need / 1024.0 / 1024.0, (float) avail / 1024.0 / 1024.0);
+
+} // mem_check_need
+
+
+
+/**
+  \fn void mem_check(const char *step)
+
+  \param[in] step   name of last step for error message
+
+  terminate if resident memory exceeds memory budget.
+*/
+void mem_check(const char *step) {
+
+  uint64_t  rss;
+
+  if (s_memBudget == 0)
+    return;
+
+  rss = mem_rss(false);
+  if (rss > s_memBudget)
+    Error("memory budget exceeded after %s (%1.1fMB > %1.1fMB)", step,
+      (float) rss / 1024.0 / 1024.0, (float) s_memBudget / 1024.0 / 1024.0);
+
+} // mem_check
+
+
+
+/**
+  \fn uint64_t mem_rss(bool peak)
+
+  \param[in] peak   get peak (true) or current (false) value
+
+  \return resident memory [B], or 0 if not available
+
+  get current or peak resident memory (working set) of process. If the current
+  value is not available, the peak value is returned instead.
+*/
+uint64_t mem_rss(bool peak) {
+
+  #if defined(WIN32)
+
+    PROCESS_MEMORY_COUNTERS  counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      return(0);
+    return(peak ? (uint64_t) counters.PeakWorkingSetSize : (uint64_t) counters.WorkingSetSize);
+
+  #else
+
+    struct rusage  usage;
+    uint64_t       rssPeak = 0;
+
+    // peak resident memory (Linux in kB, macOS in B)
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+      #if defined(__APPLE__)
+        rssPeak = (uint64_t) usage.ru_maxrss;
+      #else
+        rssPeak = (uint64_t) usage.ru_maxrss * 1024;
+      #endif
+    }
+
+    // current resident memory (Linux only)
+    #if defined(__linux__)
+      if (!peak) {
+        FILE      *fp;
+        uint64_t  numPages, numResident;
+        if ((fp = fopen("/proc/self/statm", "r")) != NULL) {
+          if (fscanf(fp, "%" SCNu64 " %" SCNu64, &numPages, &numResident) == 2) {
+            fclose(fp);
+            return(numResident * (uint64_t) sysconf(_SC_PAGESIZE));
+          }
+          fclose(fp);
+        }
+      }
+    #endif
+
+    return(rssPeak);
+
+  #endif
+
+} // mem_rss
+
+
+
+/**
+  \fn void mem_report(uint8_t verbose)
+
+  \param[in] verbose    verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  print peak resident memory and peak allocations per subsystem. With budget for
+  verbose>=INFORM, else only for verbose==CHATTY. Allocations include pages
+  never touched, which for sparse buffers are not resident.
+*/
+void mem_report(uint8_t verbose) {
+
+  int  k;
+
+  if (!((verbose == CHATTY) || ((s_memBudget != 0) && (verbose == INFORM))))
+    return;
+
+  printf("  memory: peak %1.1fMB resident", (float) mem_rss(true) / 1024.0 / 1024.0);
+  if (s_memBudget != 0)
+    printf(" (budget %1.1fMB)", (float) s_memBudget / 1024.0 / 1024.0);
+  printf("\n");
+  for (k=0; k<MEM_NUM; k++) {
+    if (s_memCount[k] == 0)
+      continue;
+    printf("    %-8s peak %8.1fMB allocated, %3d buffers\n", s_memName[k],
+      (float) s_memPeak[k] / 1024.0 / 1024.0, (int) s_memCount[k]);
+  }
+  fflush(stdout);
+
+} // mem_report
+
+
+// end of file
@@ -0,0 +1,63 @@
+/**
+  \file memtrack.h
+
+  \author G. Icking-Konert
+  \date 2019-02-23
+  \version 0.1
+
+  \brief declaration of memory accounting and budget routines
+
+  declaration of routines for allocating large buffers with per-subsystem
+  accounting, for reporting the peak resident memory of the process, and for
+  keeping a run within a memory budget by using sparse buffers.
+*/
+
+// for including file only once
+#ifndef _MEMTRACK_H_
+#define _MEMTRACK_H_
+
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/// subsystems for memory accounting
+typedef enum {
+  MEM_IMAGE = 0,            ///< memory images of files and device
+  MEM_FILE,                 ///< intermediate buffers for file import
+  MEM_VERIFY,               ///< read-back buffers for verify
+  MEM_NUM                   ///< number of subsystems
+} memPool_t;
+
+
+/// set memory budget [B] and select sparse strategies (0=no budget)
+void      mem_budget(uint64_t budget);
+
+/// check if sparse strategies are selected
+bool      mem_sparse(void);
+
+/// allocate zero-initialized buffer for subsystem. Terminates on failure
+void     *mem_alloc(memPool_t pool, uint64_t numBytes);
+
+/// release buffer allocated with mem_alloc() or mem_clear()
+void      mem_free(void *ptr);
+
+/// clear buffer allocated with mem_alloc(). Returns new buffer address
+void     *mem_clear(void *ptr);
+
+/// terminate if estimated memory of next step exceeds memory budget
+void      mem_check_need(const char *step, uint64_t need);
+
+/// terminate if resident memory exceeds memory budget
+void      mem_check(const char *step);
+
+/// get current or peak resident memory of process [B]
+uint64_t  mem_rss(bool peak);
+
+/// print peak resident memory and allocations per subsystem
+void      mem_report(uint8_t verbose);
+
+#endif // _MEMTRACK_H_
+
+// end of file
@@ -13,6 +13,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 #if !defined(_MSC_VER)
   #include <unistd.h>
@@ -23,6 +24,7 @@
 #include "misc.h"
 #include "main.h"
 #include "version.h"
+#include "logger.h"
 
 
 // WIN32 specific
@@ -85,6 +87,7 @@
 void Error(const char *format, ...)
 {
   va_list vargs;
+  log_flush();
   va_start(vargs, format);
   setConsoleColor(PRM_COLOR_RED);
   fprintf(stderr, "Error: ");
@@ -107,6 +110,10 @@ void Error(const char *format, ...)
 */
 void Exit(uint8_t code, uint8_t pause) {
 
+  // print pending messages and progress events
+  log_flush();
+  log_event_close();
+
   // on error code !=0 ring bell
   if (code) {
     printf("\a");
@@ -494,4 +501,53 @@ uint64_t micros() {
 
 } // micros
 
+
+
+/**
+  \fn int split_args(char *line, char **token, int maxToken)
+
+  \param[in,out] line       line of text, is modified
+  \param[out]    token      pointers to arguments in line
+  \param[in]     maxToken   max. number of arguments
+
+  \return number of arguments
+
+  split line into whitespace separated arguments, e.g. for job or recipe files.
+  Arguments with spaces are enclosed in double quotes, '#' starts a comment.
+*/
+int split_args(char *line, char **token, int maxToken) {
+
+  int   num = 0;
+  char  *p = line, *start;
+
+  while (*p) {
+
+    // skip whitespace and stop at comment
+    while (isspace((unsigned char) *p))
+      p++;
+    if ((*p == '\0') || (*p == '#'))
+      break;
+
+    // quoted or plain argument
+    if (*p == '"') {
+      start = ++p;
+      while ((*p) && (*p != '"'))
+        p++;
+    }
+    else {
+      start = p;
+      while ((*p) && (!isspace((unsigned char) *p)))
+        p++;
+    }
+    if (*p)
+      *(p++) = '\0';
+    if (num < maxToken)
+      token[num++] = start;
+
+  } // while line
+
+  return(num);
+
+} // split_args
+
 // end of file
@@ -72,6 +72,9 @@ uint64_t millis(void);
 /// get microseconds since start of program (as Arduino)
 uint64_t micros(void);
 
+/// split line into whitespace separated arguments, supports quotes and '#' comments
+int split_args(char *line, char **token, int maxToken);
+
 #endif // _MISC_H_
 
 // end of file
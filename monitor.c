@@ -0,0 +1,519 @@
+/**
+  \file monitor.c
+
+  \author G. Icking-Konert
+  \date 2019-02-02
+  \version 0.1
+
+  \brief implementation of serial monitor routines
+
+  implementation of routines for capturing the application output after upload,
+  e.g. self-test results, with timestamps and optional pass/fail patterns.
+  The port is read by the calling thread into a lock-free single-producer /
+  single-consumer ring buffer, which is drained by a writer thread. This way
+  printing and pattern matching never block reception. If the writer can't
+  keep up and the ring is full, the port is still drained and the data is
+  dropped and reported, instead of relying on the small buffer of the OS.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <ctype.h>
+#if defined(WIN32)
+  #include <windows.h>        // for CreateThread()
+#else
+  #include <pthread.h>        // for writer thread
+#endif
+#include "monitor.h"
+#include "serial_comm.h"
+#include "bootloader.h"
+#include "main.h"
+#include "misc.h"
+
+
+/// number of ring buffer slots (power of 2)
+#define MONITOR_SLOTS     1024
+
+/// max. number of bytes per slot
+#define MONITOR_SLOTLEN   256
+
+/// max. time to wait for data per read [ms]
+#define MONITOR_POLL      10
+
+/// max. time to fill a slot after its first byte [ms], i.e. resolution of timestamps
+#define MONITOR_FILL      2
+
+// access ring indices with acquire/release semantics (lock-free SPSC)
+#if defined(_MSC_VER)
+  #define LOAD_ACQUIRE(p)       (*(volatile uint32_t*)(p))    // MSVC volatile has acquire/release semantics
+  #define STORE_RELEASE(p, v)   (*(volatile uint32_t*)(p) = (v))
+#else
+  #define LOAD_ACQUIRE(p)       __atomic_load_n((p), __ATOMIC_ACQUIRE)
+  #define STORE_RELEASE(p, v)   __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+
+/// one chunk of received data with timestamp
+typedef struct {
+  uint64_t  time;                       // time of reception of first byte [us]
+  uint32_t  len;                        // number of bytes
+  uint32_t  dropped;                    // bytes dropped before this slot due to full ring
+  char      data[MONITOR_SLOTLEN];      // received data
+} monitorSlot_t;
+
+
+/// ring buffer and state shared between reader and writer thread
+typedef struct {
+  monitorSlot_t  slot[MONITOR_SLOTS];   // ring buffer
+  uint32_t       head;                  // next slot to fill, written only by reader
+  uint32_t       tail;                  // next slot to drain, written only by writer
+  uint32_t       stop;                  // reader has finished -> drain and exit
+  uint32_t       result;                // pattern result, written only by writer
+  const char     *pass;                 // pass pattern (NULL=none)
+  const char     *fail;                 // fail pattern (NULL=none)
+  uint64_t       tStart;                // start of monitor [us]
+  bool           print;                 // print received data
+} monitorRing_t;
+
+
+
+/**
+  \fn int monitor_unescape(const char *in, char *out)
+
+  \param[in]  in           string with optional escape sequences
+  \param[out] out          resulting bytes, zero terminated. Size >= strlen(in)+1
+
+  \return number of bytes in out w/o terminating zero
+
+  convert C escape sequences \\n, \\r, \\t, \\\\ and \\xHH to bytes, e.g. for patterns ending with newline.
+  Other characters, incl. unknown escapes, are copied unchanged
+*/
+int monitor_unescape(const char *in, char *out) {
+
+  int           len = 0;
+  unsigned int  value;
+
+  while (*in != '\0') {
+    if ((in[0] == '\\') && (in[1] == 'n'))       { out[len++] = '\n'; in += 2; }
+    else if ((in[0] == '\\') && (in[1] == 'r'))  { out[len++] = '\r'; in += 2; }
+    else if ((in[0] == '\\') && (in[1] == 't'))  { out[len++] = '\t'; in += 2; }
+    else if ((in[0] == '\\') && (in[1] == '\\')) { out[len++] = '\\'; in += 2; }
+    else if ((in[0] == '\\') && (in[1] == 'x') && (isxdigit((int) in[2])) && (isxdigit((int) in[3]))) {
+      sscanf(in+2, "%2x", &value);
+      out[len++] = (char) value;
+      in += 4;
+    }
+    else
+      out[len++] = *(in++);
+  }
+  out[len] = '\0';
+
+  return(len);
+
+} // monitor_unescape
+
+
+
+/**
+  \fn uint32_t monitor_setup(HANDLE ptrPort, uint32_t baudrate)
+
+  \param[in]  ptrPort      handle to communication port
+  \param[in]  baudrate     baudrate of application (0=keep)
+
+  \return resulting baudrate
+
+  switch port from bootloader settings to application baudrate and 8N1 in one step
+*/
+static uint32_t monitor_setup(HANDLE ptrPort, uint32_t baudrate) {
+
+  uint32_t  baudOld, timeout;
+  uint8_t   numBits, parity, numStop, RTS, DTR;
+
+  get_port_attribute(ptrPort, &baudOld, &timeout, &numBits, &parity, &numStop, &RTS, &DTR);
+  if (baudrate == 0)
+    baudrate = baudOld;
+  if ((baudrate != baudOld) || (numBits != 8) || (parity != 0) || (numStop != 1))
+    set_port_attribute(ptrPort, baudrate, timeout, 8, 0, 1, RTS, DTR);
+
+  return(baudrate);
+
+} // monitor_setup
+
+
+
+/**
+  \fn bool match_pattern(const char *window, int lenWindow, const char *pattern)
+
+  \param[in]  window       last received bytes
+  \param[in]  lenWindow    number of bytes in window
+  \param[in]  pattern      pattern to check (NULL=none)
+
+  \return true if window ends with pattern
+*/
+static bool match_pattern(const char *window, int lenWindow, const char *pattern) {
+
+  int  len;
+
+  if (pattern == NULL)
+    return(false);
+  len = strlen(pattern);
+  return((len > 0) && (lenWindow >= len) && (!memcmp(window+lenWindow-len, pattern, len)));
+
+} // match_pattern
+
+
+
+/**
+  \fn void *monitor_writer(void *arg)
+
+  \param[in]  arg          pointer to ring buffer (monitorRing_t)
+
+  \return always NULL
+
+  writer thread: drain ring buffer, print data with timestamp at start of each line and check
+  for pass/fail pattern
+*/
+static void *monitor_writer(void *arg) {
+
+  monitorRing_t  *ring = (monitorRing_t*) arg;
+  monitorSlot_t  *slot;
+  char           window[2*STRLEN];        // last received bytes for pattern matching
+  int            lenWindow = 0;
+  bool           lineStart = true;
+  uint32_t       tail, i;
+
+  while (1) {
+
+    // ring empty -> exit if reader is done, else wait
+    tail = ring->tail;
+    if (tail == LOAD_ACQUIRE(&(ring->head))) {
+      if (LOAD_ACQUIRE(&(ring->stop)))
+        break;
+      SLEEP(1);
+      continue;
+    }
+
+    // mark data lost due to full ring. Don't match patterns across the gap
+    slot = &(ring->slot[tail % MONITOR_SLOTS]);
+    if (slot->dropped > 0) {
+      if (ring->print)
+        printf("%s[overrun: %" PRIu32 "B dropped]\n", (lineStart) ? "" : "\n", slot->dropped);
+      lineStart = true;
+      lenWindow = 0;
+    }
+
+    // print slot and check patterns byte by byte
+    for (i=0; i<slot->len; i++) {
+      if (ring->print) {
+        if (lineStart)
+          printf("[%4" PRIu64 ".%06" PRIu64 "] ", (slot->time - ring->tStart) / 1000000, (slot->time - ring->tStart) % 1000000);
+        putchar(slot->data[i]);
+        lineStart = (slot->data[i] == '\n');
+      }
+      if (lenWindow == sizeof(window)) {
+        memmove(window, window+STRLEN, sizeof(window)-STRLEN);
+        lenWindow -= STRLEN;
+      }
+      window[lenWindow++] = slot->data[i];
+      if ((ring->result == MONITOR_TIMEOUT) && match_pattern(window, lenWindow, ring->fail))
+        STORE_RELEASE(&(ring->result), MONITOR_FAIL);
+      else if ((ring->result == MONITOR_TIMEOUT) && match_pattern(window, lenWindow, ring->pass))
+        STORE_RELEASE(&(ring->result), MONITOR_PASS);
+    }
+    fflush(stdout);
+
+    // release slot
+    STORE_RELEASE(&(ring->tail), tail+1);
+
+  } // while
+
+  // terminate last line
+  if ((ring->print) && (!lineStart))
+    printf("\n");
+  fflush(stdout);
+
+  return(NULL);
+
+} // monitor_writer
+
+
+#if defined(WIN32)
+/// wrapper for thread function with Windows thread signature
+static DWORD WINAPI monitor_writer_win(LPVOID arg) {
+  monitor_writer(arg);
+  return(0);
+}
+#endif
+
+
+
+/**
+  \fn monitorResult_t monitor_port(HANDLE ptrPort, uint32_t baudrate, uint32_t duration, const char *passPattern, const char *failPattern, uint8_t verbose)
+
+  \param[in]  ptrPort      handle to communication port
+  \param[in]  baudrate     baudrate of application (0=keep)
+  \param[in]  duration     max. monitor time [ms] (0=until pattern received)
+  \param[in]  passPattern  string indicating pass (NULL or ""=none)
+  \param[in]  failPattern  string indicating fail (NULL or ""=none)
+  \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  \return result of monitor, see monitorResult_t
+
+  capture application output after upload. Port is switched to application baudrate and 8N1.
+  Received data is printed with timestamp relative to start of monitor, which is directly after
+  jump to application. Monitor stops after duration or when a pass/fail pattern is received.
+  Each slot is filled until full or MONITOR_FILL after its first byte, so a slow sender doesn't use
+  up the ring with 1-byte slots. If the ring is still full, the port is drained and the data dropped,
+  as the buffer of the OS is only a few kB. Dropped data is marked in the output and reported.
+*/
+monitorResult_t monitor_port(HANDLE ptrPort, uint32_t baudrate, uint32_t duration, const char *passPattern, const char *failPattern, uint8_t verbose) {
+
+  monitorRing_t  *ring;
+  monitorSlot_t  *slot;
+  monitorResult_t  result;
+  uint32_t       head, len, got, numOverrun = 0;
+  uint32_t       numPending = 0;        // dropped bytes, not yet reported via slot
+  uint64_t       numBytes = 0, numDropped = 0;
+  char           drop[MONITOR_SLOTLEN]; // sink for data received while ring is full
+  #if defined(WIN32)
+    HANDLE       thread;
+  #else
+    pthread_t    thread;
+  #endif
+
+  // allocate and init ring buffer
+  if (!(ring = calloc(1, sizeof(*ring))))
+    Error("in 'monitor_port()': cannot allocate ring buffer");
+  ring->tStart = micros();
+  ring->pass   = ((passPattern != NULL) && (strlen(passPattern) > 0)) ? passPattern : NULL;
+  ring->fail   = ((failPattern != NULL) && (strlen(failPattern) > 0)) ? failPattern : NULL;
+  ring->print  = (verbose != MUTE);
+
+  // switch to application baudrate and 8N1
+  baudrate = monitor_setup(ptrPort, baudrate);
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  monitor port with %gkBaud ...\n", (float) baudrate / 1000.0);
+  fflush(stdout);
+
+  // start writer thread
+  #if defined(WIN32)
+    if ((thread = CreateThread(NULL, 0, monitor_writer_win, ring, 0, NULL)) == NULL)
+      Error("in 'monitor_port()': cannot start writer thread");
+  #else
+    if (pthread_create(&thread, NULL, monitor_writer, ring) != 0)
+      Error("in 'monitor_port()': cannot start writer thread");
+  #endif
+
+  // read port into ring until time elapsed or pattern received
+  while (LOAD_ACQUIRE(&(ring->result)) == MONITOR_TIMEOUT) {
+
+    // check monitor time
+    if ((duration != 0) && ((micros() - ring->tStart) >= 1000L * (uint64_t) duration))
+      break;
+
+    // ring full -> keep draining port, drop and count data
+    head = ring->head;
+    if ((head - LOAD_ACQUIRE(&(ring->tail))) >= MONITOR_SLOTS) {
+      len = read_port(ptrPort, sizeof(drop), drop, 1);
+      if ((len > 0) && (numPending == 0))
+        numOverrun++;
+      numPending += len;
+      numDropped += len;
+      continue;
+    }
+
+    // receive directly into next slot until full or fill time elapsed, then publish it
+    slot = &(ring->slot[head % MONITOR_SLOTS]);
+    len = read_port(ptrPort, MONITOR_SLOTLEN, slot->data, MONITOR_POLL);
+    if (len == 0)
+      continue;
+    slot->time = micros();
+    while ((len < MONITOR_SLOTLEN) && ((micros() - slot->time) < 1000L * MONITOR_FILL)) {
+      got = read_port(ptrPort, MONITOR_SLOTLEN - len, slot->data + len, 1);
+      len += got;
+    }
+    slot->len     = len;
+    slot->dropped = numPending;
+    numPending    = 0;
+    numBytes     += len;
+    STORE_RELEASE(&(ring->head), head+1);
+
+  } // while
+
+  // stop and wait for writer thread
+  STORE_RELEASE(&(ring->stop), 1);
+  #if defined(WIN32)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+  #else
+    pthread_join(thread, NULL);
+  #endif
+  result = (monitorResult_t) ring->result;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    printf("  monitor port ... done (%" PRIu64 "B in %1.3fs", numBytes, (float) (micros() - ring->tStart) / 1e6);
+    if (result == MONITOR_PASS)
+      printf(", pass pattern");
+    else if (result == MONITOR_FAIL)
+      printf(", fail pattern");
+    if (numDropped > 0)
+      printf(", overrun %d times, %" PRIu64 "B dropped", (int) numOverrun, numDropped);
+    printf(")\n");
+  }
+  else if ((verbose == SILENT) && (numDropped > 0))
+    printf("  monitor overrun %d times, %" PRIu64 "B dropped\n", (int) numOverrun, numDropped);
+  fflush(stdout);
+
+  // release ring buffer
+  free(ring);
+
+  return(result);
+
+} // monitor_port
+
+
+
+/**
+  \fn int monitor_boot(int numPorts, HANDLE *ptrPorts, bool *active, uint32_t baudrate, uint64_t timeJump, const char *signature, int lenSignature, uint32_t timeout, uint8_t verbose)
+
+  \param[in]  numPorts     number of ports, i.e. 1 or number of gang devices
+  \param[in]  ptrPorts     handles to RX ports of devices
+  \param[in]  active       device is active (NULL=all)
+  \param[in]  baudrate     baudrate of application (0=keep)
+  \param[in]  timeJump     time of jump to application from micros(), see bsl_jumpTo() [us]
+  \param[in]  signature    byte string sent by application when ready, e.g. after init
+  \param[in]  lenSignature length of signature
+  \param[in]  timeout      max. time after jump to wait for signature [ms]
+  \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  \return number of devices which sent signature within timeout
+
+  measure startup time of application after upload, i.e. time from final ACK of GO command until
+  first byte and until signature is received. Ports are polled w/o pause for microsecond resolution.
+  Reading a port stops after its signature, so following data is available for monitor_port().
+  For gang programming min/avg/max over all devices are printed.
+*/
+int monitor_boot(int numPorts, HANDLE *ptrPorts, bool *active, uint32_t baudrate, uint64_t timeJump, const char *signature, int lenSignature, uint32_t timeout, uint8_t verbose) {
+
+  uint64_t  tFirst[GANG_MAX];         // time to first byte per device [us] (0=none yet)
+  uint64_t  tSign[GANG_MAX];          // time to signature per device [us] (0=none yet)
+  char      window[GANG_MAX][STRLEN]; // last received bytes per device for signature matching
+  int       lenWindow[GANG_MAX];
+  char      Rx[STRLEN];
+  uint64_t  tNow, minFirst, maxFirst, sumFirst, minSign, maxSign, sumSign;
+  int       numActive, numFirst, numSign, numDone;
+  uint32_t  len, i;
+  int       k;
+
+  // check parameters
+  if ((numPorts < 1) || (numPorts > GANG_MAX))
+    Error("in 'monitor_boot()': invalid number of ports (%d)", numPorts);
+  if ((lenSignature < 1) || (lenSignature >= STRLEN))
+    Error("in 'monitor_boot()': invalid signature length (%d)", lenSignature);
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  measure boot time ... ");
+  fflush(stdout);
+
+  // switch to application baudrate and 8N1
+  numActive = 0;
+  for (k=0; k<numPorts; k++) {
+    tFirst[k] = tSign[k] = 0;
+    lenWindow[k] = 0;
+    if ((active == NULL) || (active[k])) {
+      monitor_setup(ptrPorts[k], baudrate);
+      numActive++;
+    }
+  }
+
+  // poll ports until all devices sent signature or timeout. For single device wait in OS for resolution w/o load
+  numDone = 0;
+  while ((numDone < numActive) && ((tNow = micros()) - timeJump < 1000L * (uint64_t) timeout)) {
+    for (k=0; k<numPorts; k++) {
+
+      // skip inactive or finished devices
+      if (((active != NULL) && (!active[k])) || (tSign[k] != 0))
+        continue;
+
+      // read available data
+      len = read_port(ptrPorts[k], sizeof(Rx), Rx, (numPorts == 1) ? 1 : 0);
+      if (len == 0)
+        continue;
+      tNow = micros();
+      if (tFirst[k] == 0)
+        tFirst[k] = tNow - timeJump;
+
+      // check for signature
+      for (i=0; (i<len) && (tSign[k] == 0); i++) {
+        if (lenWindow[k] == lenSignature) {
+          memmove(window[k], window[k]+1, lenSignature-1);
+          lenWindow[k]--;
+        }
+        window[k][lenWindow[k]++] = Rx[i];
+        if ((lenWindow[k] == lenSignature) && (!memcmp(window[k], signature, lenSignature))) {
+          tSign[k] = tNow - timeJump;
+          numDone++;
+        }
+      }
+
+    } // loop k over ports
+  } // while
+
+  // get statistics over devices
+  numFirst = numSign = 0;
+  minFirst = minSign = UINT64_MAX;
+  maxFirst = sumFirst = maxSign = sumSign = 0;
+  for (k=0; k<numPorts; k++) {
+    if (tFirst[k] != 0) {
+      numFirst++;
+      sumFirst += tFirst[k];
+      minFirst = (tFirst[k] < minFirst) ? tFirst[k] : minFirst;
+      maxFirst = (tFirst[k] > maxFirst) ? tFirst[k] : maxFirst;
+    }
+    if (tSign[k] != 0) {
+      numSign++;
+      sumSign += tSign[k];
+      minSign = (tSign[k] < minSign) ? tSign[k] : minSign;
+      maxSign = (tSign[k] > maxSign) ? tSign[k] : maxSign;
+    }
+  }
+
+  // print result
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    if (numPorts == 1) {
+      printf("done (first byte ");
+      if (numFirst) printf("%" PRIu64 "us", tFirst[0]); else printf("none");
+      printf(", signature ");
+      if (numSign) printf("%" PRIu64 "us", tSign[0]); else printf("timeout");
+      printf(")\n");
+    }
+    else {
+      printf("done (%d of %d devices)\n", numSign, numActive);
+      if (numFirst)
+        printf("    first byte: min %" PRIu64 "us, avg %" PRIu64 "us, max %" PRIu64 "us\n", minFirst, sumFirst/numFirst, maxFirst);
+      if (numSign)
+        printf("    signature:  min %" PRIu64 "us, avg %" PRIu64 "us, max %" PRIu64 "us\n", minSign, sumSign/numSign, maxSign);
+      if (verbose == CHATTY) {
+        for (k=0; k<numPorts; k++) {
+          if ((active == NULL) || (active[k]))
+            printf("    device %d: first byte %" PRIu64 "us, signature %" PRIu64 "us\n", k, tFirst[k], tSign[k]);
+        }
+      }
+    }
+  }
+  fflush(stdout);
+
+  return(numSign);
+
+} // monitor_boot
+
+
+// end of file
@@ -0,0 +1,44 @@
+/**
+  \file monitor.h
+
+  \author G. Icking-Konert
+  \date 2019-02-02
+  \version 0.1
+
+  \brief declaration of serial monitor routines
+
+  declaration of routines for capturing the application output after upload,
+  e.g. self-test results, with timestamps and optional pass/fail patterns.
+*/
+
+// for including file only once
+#ifndef _MONITOR_H_
+#define _MONITOR_H_
+
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_comm.h"
+
+
+/// result of serial monitor
+typedef enum {
+  MONITOR_TIMEOUT = 0,      ///< monitor time elapsed w/o matching pattern
+  MONITOR_PASS,             ///< pass pattern was received
+  MONITOR_FAIL              ///< fail pattern was received
+} monitorResult_t;
+
+
+/// convert C escape sequences (\n, \r, \t, \\, \xHH) in pattern to bytes. Returns length
+int              monitor_unescape(const char *in, char *out);
+
+/// capture application output from port with timestamps until time elapsed or pattern received
+monitorResult_t  monitor_port(HANDLE ptrPort, uint32_t baudrate, uint32_t duration, const char *passPattern, const char *failPattern, uint8_t verbose);
+
+/// measure time from jump to first byte and to signature for each (gang) device. Returns number of devices which sent signature
+int              monitor_boot(int numPorts, HANDLE *ptrPorts, bool *active, uint32_t baudrate, uint64_t timeJump, const char *signature, int lenSignature, uint32_t timeout, uint8_t verbose);
+
+#endif // _MONITOR_H_
+
+// end of file
@@ -0,0 +1,890 @@
+/**
+  \file net_comm.c
+
+  \author G. Icking-Konert
+  \date 2019-03-02
+  \version 0.1
+
+  \brief implementation of network serial port routines
+
+  implementation of routines for accessing a serial port via a serial device
+  server (e.g. ser2net or socat), using a raw TCP connection or Telnet with
+  RFC 2217 (COM-PORT-OPTION). Nagle's algorithm is disabled and (under Linux)
+  delayed ACKs are suppressed, so each sent buffer is transmitted as one segment
+  without delay.
+  Serial settings can't be changed via raw TCP and must match the server
+  configuration. They are only stored for get_port_attribute(). Via RFC 2217
+  baudrate, data bits, parity, stop bits and DTR/RTS are set remotely. For
+  RFC 2217 received data is read in blocks into a port buffer and Telnet
+  commands are removed there, i.e. w/o a system call per byte. Sent data is
+  escaped into a local buffer and sent with a single call.
+*/
+
+// include files. Winsock must be included before windows.h
+#if defined(WIN32)
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #if defined(_MSC_VER)
+    #pragma comment(lib, "ws2_32.lib")
+  #endif
+#else
+  #include <sys/types.h>
+  #include <sys/socket.h>
+  #include <sys/select.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <netdb.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <errno.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "net_comm.h"
+#include "main.h"
+#include "misc.h"
+
+
+// system specific socket type
+#if defined(WIN32)
+  typedef SOCKET              netSocket_t;
+  #define NET_INVALID         INVALID_SOCKET
+  #define CLOSESOCKET(s)      closesocket(s)
+  #define SOCK(h)             ((SOCKET) (uintptr_t) (h))
+  #define HNDL(s)             ((HANDLE) (uintptr_t) (s))
+#else
+  typedef int                 netSocket_t;
+  #define NET_INVALID         (-1)
+  #define CLOSESOCKET(s)      close(s)
+  #define SOCK(h)             (h)
+  #define HNDL(s)             (s)
+#endif
+
+// avoid SIGPIPE on closed connection, if supported
+#if !defined(MSG_NOSIGNAL)
+  #define MSG_NOSIGNAL        0
+#endif
+
+
+// Telnet commands and options (RFC 854, 856, 858)
+#define TN_SE                 240     //< end of subnegotiation
+#define TN_SB                 250     //< start of subnegotiation
+#define TN_WILL               251
+#define TN_WONT               252
+#define TN_DO                 253
+#define TN_DONT               254
+#define TN_IAC                255     //< interpret as command
+#define TN_BINARY             0       //< 8-bit data path
+#define TN_SGA                3       //< suppress go ahead
+#define TN_COMPORT            44      //< COM-PORT-OPTION (RFC 2217)
+
+// COM-PORT-OPTION client commands (RFC 2217). Server replies with +100
+#define CPO_SET_BAUDRATE      1
+#define CPO_SET_DATASIZE      2
+#define CPO_SET_PARITY        3       //< 1=none, 2=odd, 3=even
+#define CPO_SET_STOPSIZE      4       //< 1=1, 2=2, 3=1.5
+#define CPO_SET_CONTROL       5       //< 1=no flow control, 8/9=DTR on/off, 11/12=RTS on/off
+#define CPO_PURGE_DATA        12      //< 1=receive, 2=transmit, 3=both
+
+// states of Telnet receive parser
+typedef enum {
+  TN_STATE_DATA = 0,          //< data byte
+  TN_STATE_IAC,               //< after IAC
+  TN_STATE_OPT,               //< after IAC WILL/WONT/DO/DONT
+  TN_STATE_SB,                //< in subnegotiation
+  TN_STATE_SB_IAC             //< after IAC in subnegotiation
+} tnState_t;
+
+/// size of receive buffer for RFC 2217 [B]
+#define NET_BUFSIZE           4096
+
+
+/// state of an open network port
+typedef struct {
+  bool        used;           //< entry is in use
+  HANDLE      handle;         //< socket as port handle
+  bool        pipeline;       //< BSL frames may be pipelined
+  bool        rfc2217;        //< Telnet with COM-PORT-OPTION, else raw TCP
+  int         comPort;        //< COM-PORT-OPTION accepted by server (-1=pending, 0=no, 1=yes)
+  tnState_t   tnState;        //< state of Telnet receive parser
+  uint8_t     tnCmd;          //< pending WILL/WONT/DO/DONT
+  char        rxBuf[NET_BUFSIZE];   //< received data w/o Telnet commands (RFC 2217)
+  uint32_t    rxHead;         //< write index of rxBuf
+  uint32_t    rxTail;         //< read index of rxBuf
+  bool        configured;     //< below settings were sent to server
+  uint32_t    baudrate;       //< stored port settings, see net_set_attribute()
+  uint32_t    timeout;
+  uint8_t     numBits;
+  uint8_t     parity;
+  uint8_t     numStop;
+  uint8_t     RTS;
+  uint8_t     DTR;
+} netPort_t;
+
+
+// global variables
+static netPort_t   s_netPort[NET_MAXPORT];     //< open network ports
+#if defined(WIN32)
+  static bool      s_netInit = false;          //< Winsock is initialized
+#endif
+
+
+
+/**
+  \fn netPort_t *net_find(HANDLE fpCom)
+
+  \param[in] fpCom    port handle
+
+  \return port state, or NULL if handle is no network port
+
+  find state of open network port.
+*/
+static netPort_t *net_find(HANDLE fpCom) {
+
+  int  i;
+
+  for (i=0; i<NET_MAXPORT; i++) {
+    if ((s_netPort[i].used) && (s_netPort[i].handle == fpCom))
+      return(&(s_netPort[i]));
+  }
+  return(NULL);
+
+} // net_find
+
+
+
+/**
+  \fn void net_quickack(netSocket_t sock)
+
+  \param[in] sock     socket
+
+  acknowledge received data immediately. Under Linux the option is reset by the
+  stack and has to be set again after each receive. Not supported on other systems.
+*/
+static void net_quickack(netSocket_t sock) {
+
+  #if defined(TCP_QUICKACK)
+    int  flag = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_QUICKACK, (const char*) &flag, sizeof(flag));
+  #else
+    (void) sock;
+  #endif
+
+} // net_quickack
+
+
+
+/**
+  \fn bool net_wait(netSocket_t sock, bool write, uint32_t timeout)
+
+  \param[in] sock     socket
+  \param[in] write    wait for writable (true) or readable (false)
+  \param[in] timeout  max. time to wait [ms]
+
+  \return true if socket is ready, false on timeout or error
+
+  wait until socket is ready for reading or writing.
+*/
+static bool net_wait(netSocket_t sock, bool write, uint32_t timeout) {
+
+  struct timeval  tv;
+  fd_set          fds;
+
+  tv.tv_sec  = (timeout / 1000L);
+  tv.tv_usec = (timeout % 1000L) * 1000L;
+  FD_ZERO(&fds);
+  FD_SET(sock, &fds);
+  if (write)
+    return(select((int) sock + 1, NULL, &fds, NULL, &tv) == 1);
+  return(select((int) sock + 1, &fds, NULL, NULL, &tv) == 1);
+
+} // net_wait
+
+
+
+/**
+  \fn void net_sendRaw(HANDLE fpCom, uint32_t lenTx, const uint8_t *Tx)
+
+  \param[in] fpCom      port handle
+  \param[in] lenTx      number of bytes to send
+  \param[in] Tx         array of bytes to send
+
+  \return number of sent bytes
+
+  send bytes w/o Telnet escaping.
+*/
+static uint32_t net_sendRaw(HANDLE fpCom, uint32_t lenTx, const uint8_t *Tx) {
+
+  uint32_t  numSent = 0;
+  int       len;
+
+  while (numSent < lenTx) {
+    len = send(SOCK(fpCom), (const char*) Tx + numSent, (int) (lenTx - numSent), MSG_NOSIGNAL);
+    if (len <= 0)
+      break;
+    numSent += len;
+  }
+  return(numSent);
+
+} // net_sendRaw
+
+
+
+/**
+  \fn uint32_t net_comport(uint8_t *buf, uint32_t len, uint8_t cmd, uint32_t value, int lenValue)
+
+  \param[out] buf       buffer to append command to (>= 16B free)
+  \param[in]  len       current length of buffer
+  \param[in]  cmd       COM-PORT-OPTION command
+  \param[in]  value     parameter (big endian)
+  \param[in]  lenValue  number of parameter bytes (1 or 4)
+
+  \return new length of buffer
+
+  append COM-PORT-OPTION subnegotiation "IAC SB 44 cmd value IAC SE" to buffer.
+*/
+static uint32_t net_comport(uint8_t *buf, uint32_t len, uint8_t cmd, uint32_t value, int lenValue) {
+
+  int  i;
+
+  buf[len++] = TN_IAC;
+  buf[len++] = TN_SB;
+  buf[len++] = TN_COMPORT;
+  buf[len++] = cmd;
+  for (i=lenValue-1; i>=0; i--) {
+    buf[len] = (uint8_t) (value >> (8*i));
+    if (buf[len++] == TN_IAC)
+      buf[len++] = TN_IAC;
+  }
+  buf[len++] = TN_IAC;
+  buf[len++] = TN_SE;
+  return(len);
+
+} // net_comport
+
+
+
+/**
+  \fn int net_fill(netPort_t *entry, uint32_t timeout)
+
+  \param[in] entry      network port
+  \param[in] timeout    max. time to wait for data [ms]
+
+  \return number of data bytes added to port buffer, or -1 on timeout or error
+
+  receive a block from server and process Telnet commands. Data is appended to
+  the port buffer, option requests are answered with a single send.
+*/
+static int net_fill(netPort_t *entry, uint32_t timeout) {
+
+  uint8_t   raw[NET_BUFSIZE], reply[64];
+  uint32_t  lenReply = 0, numData = 0;
+  int       got, i;
+  uint8_t   c;
+
+  // move pending data to start of buffer
+  if (entry->rxTail == entry->rxHead)
+    entry->rxTail = entry->rxHead = 0;
+  else if (entry->rxTail > 0) {
+    memmove(entry->rxBuf, entry->rxBuf + entry->rxTail, entry->rxHead - entry->rxTail);
+    entry->rxHead -= entry->rxTail;
+    entry->rxTail = 0;
+  }
+
+  // receive block, data part is never longer than raw data
+  if (entry->rxHead == NET_BUFSIZE)
+    return(0);
+  if (!net_wait(SOCK(entry->handle), false, timeout))
+    return(-1);
+  got = recv(SOCK(entry->handle), (char*) raw, (int) (NET_BUFSIZE - entry->rxHead), 0);
+  if (got <= 0)
+    return(-1);
+  net_quickack(SOCK(entry->handle));
+
+  // remove Telnet commands
+  for (i=0; i<got; i++) {
+    c = raw[i];
+    switch (entry->tnState) {
+
+      case TN_STATE_DATA:
+        if (c == TN_IAC)
+          entry->tnState = TN_STATE_IAC;
+        else {
+          entry->rxBuf[entry->rxHead++] = (char) c;
+          numData++;
+        }
+        break;
+
+      case TN_STATE_IAC:
+        if (c == TN_IAC) {                      // escaped 0xFF
+          entry->rxBuf[entry->rxHead++] = (char) c;
+          numData++;
+          entry->tnState = TN_STATE_DATA;
+        }
+        else if ((c == TN_WILL) || (c == TN_WONT) || (c == TN_DO) || (c == TN_DONT)) {
+          entry->tnCmd   = c;
+          entry->tnState = TN_STATE_OPT;
+        }
+        else if (c == TN_SB)
+          entry->tnState = TN_STATE_SB;
+        else                                    // e.g. NOP or GA
+          entry->tnState = TN_STATE_DATA;
+        break;
+
+      case TN_STATE_OPT:
+        // server accepts or refuses options requested in net_open(). Refuse all others
+        if (c == TN_COMPORT) {
+          if (entry->tnCmd == TN_DO)
+            entry->comPort = 1;
+          else if (entry->tnCmd == TN_DONT)
+            entry->comPort = 0;
+        }
+        else if ((entry->tnCmd == TN_DO) && (c != TN_BINARY) && (c != TN_SGA) && (lenReply < sizeof(reply)-3)) {
+          reply[lenReply++] = TN_IAC;
+          reply[lenReply++] = TN_WONT;
+          reply[lenReply++] = c;
+        }
+        else if ((entry->tnCmd == TN_WILL) && (c != TN_BINARY) && (c != TN_SGA) && (lenReply < sizeof(reply)-3)) {
+          reply[lenReply++] = TN_IAC;
+          reply[lenReply++] = TN_DONT;
+          reply[lenReply++] = c;
+        }
+        entry->tnState = TN_STATE_DATA;
+        break;
+
+      // ignore subnegotiations, i.e. acknowledges and line/modem state notifications
+      case TN_STATE_SB:
+        if (c == TN_IAC)
+          entry->tnState = TN_STATE_SB_IAC;
+        break;
+
+      case TN_STATE_SB_IAC:
+        entry->tnState = (c == TN_SE) ? TN_STATE_DATA : TN_STATE_SB;
+        break;
+
+    } // switch state
+
+  } // loop over received bytes
+
+  // answer option requests
+  if (lenReply > 0)
+    net_sendRaw(entry->handle, lenReply, reply);
+
+  // return number of received data bytes
+  return((int) numData);
+
+} // net_fill
+
+
+
+/**
+  \fn bool net_is_name(const char *port)
+
+  \param[in] port     name of port
+
+  \return true if name refers to a network port
+
+  check if port name refers to a network port, i.e. has prefix "tcp://" or "rfc2217://".
+*/
+bool net_is_name(const char *port) {
+
+  return((strncmp(port, NET_PREFIX_TCP, strlen(NET_PREFIX_TCP)) == 0) || (strncmp(port, NET_PREFIX_RFC2217, strlen(NET_PREFIX_RFC2217)) == 0));
+
+} // net_is_name
+
+
+
+/**
+  \fn HANDLE net_open(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR)
+
+  \param[in] port       name of port, e.g. "tcp://host:port", "rfc2217://[::1]:port" or "tcp://host:port?pipe"
+  \param[in] baudrate   comm port speed in Baud (must match server)
+  \param[in] timeout    timeout between chars in ms
+  \param[in] numBits    number of data bits per byte (7 or 8)
+  \param[in] parity     parity control by HW (0=none, 1=odd, 2=even)
+  \param[in] numStop    number of stop bits (1=1; 2=2; other=1.5)
+  \param[in] RTS        Request To Send
+  \param[in] DTR        Data Terminal Ready
+
+  \return handle to network port
+
+  connect to serial device server, disable Nagle's algorithm and delayed ACKs.
+  For RFC 2217 negotiate binary mode and COM-PORT-OPTION, and set serial settings.
+*/
+HANDLE net_open(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR) {
+
+  char             host[STRLEN], service[STRLEN], *ptr;
+  struct addrinfo  hints, *res, *ai;
+  netSocket_t      sock = NET_INVALID;
+  netPort_t        *entry = NULL;
+  int              i, flag, err;
+  socklen_t        lenErr;
+  uint64_t         tStart;
+  const uint8_t    request[] = {TN_IAC, TN_WILL, TN_BINARY, TN_IAC, TN_DO, TN_BINARY, TN_IAC, TN_WILL, TN_SGA,
+                                TN_IAC, TN_DO, TN_SGA, TN_IAC, TN_WILL, TN_COMPORT};
+
+  // find free entry in port table
+  for (i=0; i<NET_MAXPORT; i++) {
+    if (!s_netPort[i].used) {
+      entry = &(s_netPort[i]);
+      break;
+    }
+  }
+  if (entry == NULL)
+    Error("in 'net_open(%s)': too many network ports (max. %d)", port, NET_MAXPORT);
+  memset(entry, 0, sizeof(*entry));
+  entry->pipeline = false;
+  entry->rfc2217  = (strncmp(port, NET_PREFIX_RFC2217, strlen(NET_PREFIX_RFC2217)) == 0);
+  entry->comPort  = -1;
+  entry->tnState  = TN_STATE_DATA;
+
+  // split "tcp://host:port[?option]". IPv6 addresses in brackets
+  strncpy(host, strstr(port, "://") + 3, STRLEN-1);
+  host[STRLEN-1] = '\0';
+  if ((ptr = strchr(host, '?')) != NULL) {
+    if (strcmp(ptr, "?pipe") == 0)
+      entry->pipeline = true;
+    else if (strcmp(ptr, "?nopipe") != 0)
+      Error("in 'net_open(%s)': unknown option '%s'", port, ptr);
+    *ptr = '\0';
+  }
+  if (host[0] == '[') {
+    if (!(ptr = strchr(host, ']')) || (ptr[1] != ':'))
+      Error("in 'net_open(%s)': invalid address, expect '[addr]:port'", port);
+    memmove(host, host+1, strlen(host));
+    ptr--;
+    *ptr = '\0';
+    ptr++;
+  }
+  else if (!(ptr = strrchr(host, ':')))
+    Error("in 'net_open(%s)': missing port number, expect 'host:port'", port);
+  *ptr = '\0';
+  strncpy(service, ptr+1, STRLEN-1);
+  service[STRLEN-1] = '\0';
+
+  // initialize Winsock once
+  #if defined(WIN32)
+    if (!s_netInit) {
+      WSADATA  wsaData;
+      if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        Error("in 'net_open(%s)': Winsock initialization failed", port);
+      s_netInit = true;
+    }
+  #endif
+
+  // resolve host name
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  if (getaddrinfo(host, service, &hints, &res) != 0)
+    Error("in 'net_open(%s)': cannot resolve host '%s'", port, host);
+
+  // try all addresses. Connect non-blocking for timeout
+  for (ai=res; ai!=NULL; ai=ai->ai_next) {
+    sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (sock == NET_INVALID)
+      continue;
+    #if defined(WIN32)
+      u_long  mode = 1;
+      ioctlsocket(sock, FIONBIO, &mode);
+      err = connect(sock, ai->ai_addr, (int) ai->ai_addrlen);
+      if ((err != 0) && (WSAGetLastError() == WSAEWOULDBLOCK))
+        err = 1;
+    #else
+      fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+      err = connect(sock, ai->ai_addr, ai->ai_addrlen);
+      if ((err != 0) && (errno == EINPROGRESS))
+        err = 1;
+    #endif
+    if ((err == 1) && (net_wait(sock, true, NET_CONNECT_TIMEOUT))) {
+      lenErr = sizeof(err);
+      if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*) &err, &lenErr) != 0)
+        err = -1;
+    }
+    if (err == 0)
+      break;
+    CLOSESOCKET(sock);
+    sock = NET_INVALID;
+  }
+  freeaddrinfo(res);
+  if (sock == NET_INVALID)
+    Error("in 'net_open(%s)': connection failed", port);
+
+  // back to blocking mode, timeouts are handled via select()
+  #if defined(WIN32)
+    u_long  mode = 0;
+    ioctlsocket(sock, FIONBIO, &mode);
+  #else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+  #endif
+
+  // send each buffer immediately as one segment, and acknowledge responses immediately
+  flag = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*) &flag, sizeof(flag));
+  net_quickack(sock);
+
+  entry->used   = true;
+  entry->handle = HNDL(sock);
+
+  // RFC 2217: request binary mode and COM-PORT-OPTION, wait for answer of server
+  if (entry->rfc2217) {
+    net_sendRaw(entry->handle, sizeof(request), request);
+    tStart = millis();
+    while ((entry->comPort == -1) && (millis() - tStart < NET_CONNECT_TIMEOUT))
+      net_fill(entry, 10);
+    if (entry->comPort != 1) {
+      net_close(entry->handle);
+      Error("in 'net_open(%s)': server doesn't support RFC 2217", port);
+    }
+  }
+
+  // store port settings, for RFC 2217 set them remotely
+  net_set_attribute(entry->handle, baudrate, timeout, numBits, parity, numStop, RTS, DTR);
+
+  // return port handle
+  return(entry->handle);
+
+} // net_open
+
+
+
+/**
+  \fn bool net_is_port(HANDLE fpCom)
+
+  \param[in] fpCom    port handle
+
+  \return true if handle refers to an open network port
+
+  check if handle refers to an open network port.
+*/
+bool net_is_port(HANDLE fpCom) {
+
+  return(net_find(fpCom) != NULL);
+
+} // net_is_port
+
+
+
+/**
+  \fn bool net_pipelined(HANDLE fpCom)
+
+  \param[in] fpCom    port handle
+
+  \return true if BSL frames may be pipelined
+
+  check if BSL READ frames may be pipelined, i.e. command, address and number of bytes
+  are sent in one segment and the ACKs are received afterwards. Saves network round-trips
+  per frame. WRITE is never pipelined. Is enabled by port name suffix "?pipe".
+*/
+bool net_pipelined(HANDLE fpCom) {
+
+  netPort_t  *entry = net_find(fpCom);
+
+  return((entry != NULL) && (entry->pipeline));
+
+} // net_pipelined
+
+
+
+/**
+  \fn void net_close(HANDLE fpCom)
+
+  \param[in] fpCom    port handle
+
+  close network connection and release entry in port table.
+*/
+void net_close(HANDLE fpCom) {
+
+  netPort_t  *entry = net_find(fpCom);
+
+  if (entry == NULL)
+    return;
+  if (CLOSESOCKET(SOCK(fpCom)) != 0)
+    Error("in 'net_close()': close port failed");
+  entry->used = false;
+
+} // net_close
+
+
+
+/**
+  \fn void net_get_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uint8_t *numBits, uint8_t *parity, uint8_t *numStop, uint8_t *RTS, uint8_t *DTR)
+
+  \param[in]  fpCom      port handle
+  \param[out] baudrate   comm port speed in Baud
+  \param[out] timeout    timeout between chars in ms
+  \param[out] numBits    number of data bits per byte
+  \param[out] parity     parity control (0=none, 1=odd, 2=even)
+  \param[out] numStop    number of stop bits
+  \param[out] RTS        Request To Send
+  \param[out] DTR        Data Terminal Ready
+
+  get stored settings of network port.
+*/
+void net_get_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uint8_t *numBits, uint8_t *parity, uint8_t *numStop, uint8_t *RTS, uint8_t *DTR) {
+
+  netPort_t  *entry = net_find(fpCom);
+
+  if (entry == NULL)
+    Error("in 'net_get_attribute()': no network port");
+  *baudrate = entry->baudrate;
+  *timeout  = entry->timeout;
+  *numBits  = entry->numBits;
+  *parity   = entry->parity;
+  *numStop  = entry->numStop;
+  *RTS      = entry->RTS;
+  *DTR      = entry->DTR;
+
+} // net_get_attribute
+
+
+
+/**
+  \fn void net_set_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR)
+
+  \param[in] fpCom      port handle
+  \param[in] baudrate   comm port speed in Baud
+  \param[in] timeout    timeout between chars in ms
+  \param[in] numBits    number of data bits per byte
+  \param[in] parity     parity control (0=none, 1=odd, 2=even)
+  \param[in] numStop    number of stop bits
+  \param[in] RTS        Request To Send
+  \param[in] DTR        Data Terminal Ready
+
+  change settings of network port. The timeout is used locally. For RFC 2217 changed
+  serial settings are sent to server in a single segment, for raw TCP they are only stored.
+*/
+void net_set_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR) {
+
+  netPort_t  *entry = net_find(fpCom);
+  uint8_t    buf[128];
+  uint32_t   len = 0;
+
+  if (entry == NULL)
+    Error("in 'net_set_attribute()': no network port");
+
+  // RFC 2217: send changed settings. Parity and stop bits are coded differently
+  if (entry->rfc2217) {
+    if ((!entry->configured) || (baudrate != entry->baudrate))
+      len = net_comport(buf, len, CPO_SET_BAUDRATE, baudrate, 4);
+    if ((!entry->configured) || (numBits != entry->numBits))
+      len = net_comport(buf, len, CPO_SET_DATASIZE, numBits, 1);
+    if ((!entry->configured) || (parity != entry->parity))
+      len = net_comport(buf, len, CPO_SET_PARITY, (parity == 1) ? 2 : ((parity == 2) ? 3 : 1), 1);
+    if ((!entry->configured) || (numStop != entry->numStop))
+      len = net_comport(buf, len, CPO_SET_STOPSIZE, (numStop == 1) ? 1 : ((numStop == 2) ? 2 : 3), 1);
+    if (!entry->configured)
+      len = net_comport(buf, len, CPO_SET_CONTROL, 1, 1);
+    if ((!entry->configured) || (DTR != entry->DTR))
+      len = net_comport(buf, len, CPO_SET_CONTROL, DTR ? 8 : 9, 1);
+    if ((!entry->configured) || (RTS != entry->RTS))
+      len = net_comport(buf, len, CPO_SET_CONTROL, RTS ? 11 : 12, 1);
+    if ((len > 0) && (net_sendRaw(fpCom, len, buf) != len))
+      Error("in 'net_set_attribute()': sending port settings failed");
+    entry->configured = true;
+  }
+
+  // store settings
+  entry->baudrate = baudrate;
+  entry->timeout  = timeout;
+  entry->numBits  = numBits;
+  entry->parity   = parity;
+  entry->numStop  = numStop;
+  entry->RTS      = RTS;
+  entry->DTR      = DTR;
+
+} // net_set_attribute
+
+
+
+/**
+  \fn void net_pulse(HANDLE fpCom, uint8_t line, uint32_t duration)
+
+  \param[in] fpCom      port handle
+  \param[in] line       modem control line (0=DTR, 1=RTS)
+  \param[in] duration   duration of low pulse in ms
+
+  pulse modem control line for reset, like pulse_DTR() and pulse_RTS(). Is only
+  supported via RFC 2217, not via raw TCP. Pulse duration is subject to network jitter.
+*/
+void net_pulse(HANDLE fpCom, uint8_t line, uint32_t duration) {
+
+  netPort_t  *entry = net_find(fpCom);
+  uint8_t    buf[16];
+
+  if ((entry == NULL) || (!entry->rfc2217))
+    Error("in 'net_pulse()': %s reset not supported for raw TCP port, use rfc2217:// or other reset method", (line == 0) ? "DTR" : "RTS");
+
+  // set line, wait, clear line
+  net_sendRaw(fpCom, net_comport(buf, 0, CPO_SET_CONTROL, (line == 0) ? 8 : 11, 1), buf);
+  SLEEP(duration);
+  net_sendRaw(fpCom, net_comport(buf, 0, CPO_SET_CONTROL, (line == 0) ? 9 : 12, 1), buf);
+
+} // net_pulse
+
+
+
+/**
+  \fn uint32_t net_send(HANDLE fpCom, uint32_t lenTx, char *Tx)
+
+  \param[in] fpCom      port handle
+  \param[in] lenTx      number of bytes to send
+  \param[in] Tx         array of bytes to send
+
+  \return number of sent bytes
+
+  send data. With Nagle's algorithm disabled, a buffer up to the MSS is sent as one segment.
+  For RFC 2217 0xFF is escaped in blocks.
+*/
+uint32_t net_send(HANDLE fpCom, uint32_t lenTx, char *Tx) {
+
+  netPort_t  *entry = net_find(fpCom);
+  uint8_t    buf[2*NET_BUFSIZE];
+  uint32_t   numSent, lenBlock, lenBuf, i;
+
+  // raw TCP -> send as is
+  if ((entry == NULL) || (!entry->rfc2217))
+    return(net_sendRaw(fpCom, lenTx, (const uint8_t*) Tx));
+
+  // RFC 2217 -> escape IAC
+  for (numSent=0; numSent<lenTx; numSent+=lenBlock) {
+    lenBlock = ((lenTx - numSent) > NET_BUFSIZE) ? NET_BUFSIZE : (lenTx - numSent);
+    lenBuf = 0;
+    for (i=0; i<lenBlock; i++) {
+      buf[lenBuf++] = (uint8_t) Tx[numSent+i];
+      if ((uint8_t) Tx[numSent+i] == TN_IAC)
+        buf[lenBuf++] = TN_IAC;
+    }
+    if (net_sendRaw(fpCom, lenBuf, buf) != lenBuf)
+      break;
+  }
+  return(numSent);
+
+} // net_send
+
+
+
+/**
+  \fn uint32_t net_receive(HANDLE fpCom, uint32_t lenRx, char *Rx)
+
+  \param[in]  fpCom     port handle
+  \param[in]  lenRx     number of bytes to receive
+  \param[out] Rx        array containing bytes received
+
+  \return number of received bytes
+
+  receive data. Return if all bytes are received, or if no data is received
+  within the port timeout (between bytes, like for a local port).
+*/
+uint32_t net_receive(HANDLE fpCom, uint32_t lenRx, char *Rx) {
+
+  netPort_t  *entry = net_find(fpCom);
+  uint32_t   received = 0;
+  int        got;
+
+  if (entry == NULL)
+    Error("in 'net_receive()': no network port");
+
+  // RFC 2217 -> copy from port buffer, refill with Telnet commands removed
+  if (entry->rfc2217) {
+    while (received < lenRx) {
+      if (entry->rxTail == entry->rxHead) {
+        if (net_fill(entry, entry->timeout) < 0)
+          break;
+        continue;
+      }
+      got = entry->rxHead - entry->rxTail;
+      if ((uint32_t) got > lenRx - received)
+        got = lenRx - received;
+      memcpy(Rx + received, entry->rxBuf + entry->rxTail, got);
+      entry->rxTail += got;
+      received += got;
+    }
+    return(received);
+  }
+
+  // raw TCP -> receive directly to buffer
+  while (received < lenRx) {
+    if (!net_wait(SOCK(fpCom), false, entry->timeout))
+      break;
+    got = recv(SOCK(fpCom), Rx + received, (int) (lenRx - received), 0);
+    if (got <= 0)
+      break;
+    received += got;
+    net_quickack(SOCK(fpCom));
+  }
+  return(received);
+
+} // net_receive
+
+
+
+/**
+  \fn uint32_t net_read(HANDLE fpCom, uint32_t maxRx, char *Rx, uint32_t timeout)
+
+  \param[in]  fpCom      port handle
+  \param[in]  maxRx      max. number of bytes to receive
+  \param[out] Rx         array containing bytes received
+  \param[in]  timeout    max. time to wait for first byte [ms]
+
+  \return number of received bytes
+
+  receive available data, i.e. return as soon as data is received or after timeout.
+*/
+uint32_t net_read(HANDLE fpCom, uint32_t maxRx, char *Rx, uint32_t timeout) {
+
+  netPort_t  *entry = net_find(fpCom);
+  uint64_t   tStart;
+  int        got;
+
+  // RFC 2217 -> wait for data in port buffer. Telnet commands may arrive w/o data
+  if ((entry != NULL) && (entry->rfc2217)) {
+    tStart = millis();
+    while ((entry->rxTail == entry->rxHead) && (net_fill(entry, timeout) >= 0) && (millis() - tStart < timeout));
+    got = entry->rxHead - entry->rxTail;
+    if ((uint32_t) got > maxRx)
+      got = maxRx;
+    memcpy(Rx, entry->rxBuf + entry->rxTail, got);
+    entry->rxTail += got;
+    return((uint32_t) got);
+  }
+
+  // raw TCP -> receive directly to buffer
+  if (!net_wait(SOCK(fpCom), false, timeout))
+    return(0);
+  got = recv(SOCK(fpCom), Rx, (int) maxRx, 0);
+  if (got <= 0)
+    return(0);
+  net_quickack(SOCK(fpCom));
+  return((uint32_t) got);
+
+} // net_read
+
+
+
+/**
+  \fn void net_flush(HANDLE fpCom)
+
+  \param[in]  fpCom   port handle
+
+  discard received data which was not yet read. Data in transit is not affected.
+  For RFC 2217 also the buffers of the server are purged.
+*/
+void net_flush(HANDLE fpCom) {
+
+  netPort_t  *entry = net_find(fpCom);
+  uint8_t    cmd[16];
+  char       buf[256];
+
+  if ((entry != NULL) && (entry->rfc2217))
+    net_sendRaw(fpCom, net_comport(cmd, 0, CPO_PURGE_DATA, 3, 1), cmd);
+  while (net_read(fpCom, sizeof(buf), buf, 0) > 0);
+
+} // net_flush
+
+
+// end of file
@@ -0,0 +1,79 @@
+/**
+  \file net_comm.h
+
+  \author G. Icking-Konert
+  \date 2019-03-02
+  \version 0.1
+
+  \brief declaration of network serial port routines
+
+  declaration of routines for accessing a serial port via a serial device
+  server (e.g. ser2net or socat), using a raw TCP connection or Telnet with
+  RFC 2217 for remote port settings and modem lines. Network ports are opened
+  via init_port() with a name "tcp://host:port" or "rfc2217://host:port" and
+  are then used via the serial_comm routines like a local port.
+*/
+
+// for including file only once
+#ifndef _NET_COMM_H_
+#define _NET_COMM_H_
+
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_comm.h"
+
+
+/// prefix of port name for raw TCP connection
+#define NET_PREFIX_TCP      "tcp://"
+
+/// prefix of port name for Telnet connection with RFC 2217
+#define NET_PREFIX_RFC2217  "rfc2217://"
+
+/// max. number of simultaneously open network ports
+#define NET_MAXPORT         16
+
+/// timeout for establishing connection [ms]
+#define NET_CONNECT_TIMEOUT 3000
+
+
+/// check if port name refers to a network port
+bool      net_is_name(const char *port);
+
+/// open network port, e.g. "tcp://host:port" or "rfc2217://host:port". Optional suffix "?pipe" enables pipelining
+HANDLE    net_open(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR);
+
+/// check if handle refers to an open network port
+bool      net_is_port(HANDLE fpCom);
+
+/// check if BSL frames may be pipelined, i.e. sent in one segment without waiting for each ACK
+bool      net_pipelined(HANDLE fpCom);
+
+/// close network port
+void      net_close(HANDLE fpCom);
+
+/// get port settings
+void      net_get_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uint8_t *numBits, uint8_t *parity, uint8_t *numStop, uint8_t *RTS, uint8_t *DTR);
+
+/// change port settings
+void      net_set_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR);
+
+/// pulse modem control line (0=DTR, 1=RTS) low for reset
+void      net_pulse(HANDLE fpCom, uint8_t line, uint32_t duration);
+
+/// send data in single segment
+uint32_t  net_send(HANDLE fpCom, uint32_t lenTx, char *Tx);
+
+/// receive data with port timeout between bytes
+uint32_t  net_receive(HANDLE fpCom, uint32_t lenRx, char *Rx);
+
+/// receive available data, wait up to timeout for first byte
+uint32_t  net_read(HANDLE fpCom, uint32_t maxRx, char *Rx, uint32_t timeout);
+
+/// discard pending received data
+void      net_flush(HANDLE fpCom);
+
+#endif // _NET_COMM_H_
+
+// end of file
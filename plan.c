@@ -0,0 +1,638 @@
+/**
+  \file plan.c
+
+  \author G. Icking-Konert
+  \date 2019-03-23
+  \version 0.1
+
+  \brief implementation of recipe compiler and plan loader
+
+  implementation of routines for compiling a recipe file once into a binary
+  plan, and for loading the plan for repeated production runs.
+  A recipe contains stm8gal options as on the commandline, distributed over
+  any number of lines. Input files (-w, -D, -o) are imported, merged (-M) and
+  transformed by the image pipeline (-f, -c, -x, -C, -m, -k) at compile time.
+  The plan stores the remaining options and the resolved images as lists of
+  contiguous blocks, protected by a CRC32. When running a plan, its options
+  replace '-n file' on the commandline and images are referenced as 'plan:n',
+  i.e. no files are parsed and no image operations are applied.
+  Operations depending on the device (block/sector size, option bytes, delta
+  check) are still resolved at runtime by the bootloader routines.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "plan.h"
+#include "hexfile.h"
+#include "checksum.h"
+#include "bootloader.h"
+#include "memtrack.h"
+#include "logger.h"
+#include "main.h"
+#include "misc.h"
+
+
+/// max. number of arguments per line of recipe
+#define PLAN_MAXARG     100
+
+
+/// option allowed in recipe with number of parameters
+typedef struct {
+  const char  *shortName;     //< short option name
+  const char  *longName;      //< long option name
+  int         numParam;       //< number of parameters (-w: w/o address of binary file)
+} planOption_t;
+
+/// byte buffer for assembling plan
+typedef struct {
+  uint8_t     *data;          //< content
+  uint64_t    len;            //< used length [B]
+  uint64_t    size;           //< allocated size [B]
+} planBuf_t;
+
+/// image of loaded plan
+typedef struct {
+  const uint8_t  *blocks;     //< list of blocks (address, length, data)
+  uint32_t    numBlocks;      //< number of blocks
+  uint32_t    crc;            //< CRC32 over block list
+} planImage_t;
+
+
+// options allowed in recipe. Image operations are applied at compile time, other options are copied to plan
+static const planOption_t s_planOption[] = {
+  {"-v", "-verbose",        1},
+  {"-B", "-background",     0},
+  {"-q", "-exit-prompt",    0},
+  {"-R", "-reset",          1},
+  {"-i", "-interface",      1},
+  {"-u", "-uart-mode",      1},
+  {"-p", "-port",           1},
+  {"-b", "-baudrate",       1},
+  {"-V", "-no-verify",      0},
+  {"-t", "-realtime",       0},
+  {"-A", "-async",          0},
+  {"-G", "-gang-rx",        1},
+  {"-P", "-profile",        1},
+  {"-j", "-jump-addr",      1},
+  {"-L", "-monitor",        2},
+  {"-X", "-match",          2},
+  #if defined(USE_FAULT)
+    {"-I", "-inject-faults",  1},
+  #endif
+  {"-Z", "-mem-budget",     1},
+  {"-F", "-progress-fd",    2},
+  {"-g", "-boot-time",      2},
+  {"-w", "-write-file",     1},
+  {"-M", "-merge-files",    0},
+  {"-W", "-write-byte",     2},
+  {"-D", "-delta-base",     1},
+  {"-o", "-option-file",    1},
+  {"-r", "-read",           3},
+  {"-e", "-erase-sector",   1},
+  {"-E", "-erase-full",     0},
+  {"-f", "-fill",           3},
+  {"-c", "-clip",           2},
+  {"-x", "-cut",            2},
+  {"-C", "-copy",           3},
+  {"-m", "-move",           3},
+  {"-k", "-checksum",       4},
+  {NULL, NULL,              0}
+};
+
+
+// global variables
+static uint8_t      *s_planData = NULL;       //< content of loaded plan
+static planImage_t  *s_planImage = NULL;      //< images of loaded plan
+static uint32_t     s_numPlanImage = 0;       //< number of images in loaded plan
+
+
+
+/**
+  \fn void plan_put(planBuf_t *buf, const void *data, uint64_t len)
+
+  \param      buf         buffer to append to
+  \param[in]  data        data to append
+  \param[in]  len         length of data [B]
+
+  append data to buffer, grow buffer if required.
+*/
+static void plan_put(planBuf_t *buf, const void *data, uint64_t len) {
+
+  if (buf->len + len > buf->size) {
+    buf->size = 2 * (buf->len + len) + 1024;
+    if (!(buf->data = realloc(buf->data, buf->size)))
+      Error("in 'plan_put()': cannot allocate %1.1fkB", (float) buf->size / 1024.0);
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+
+} // plan_put
+
+
+
+/**
+  \fn void plan_put32(planBuf_t *buf, uint32_t value)
+
+  \param      buf         buffer to append to
+  \param[in]  value       value to append (little-endian)
+
+  append 32-bit value to buffer.
+*/
+static void plan_put32(planBuf_t *buf, uint32_t value) {
+
+  uint8_t   tmp[4];
+
+  tmp[0] = (uint8_t) (value);
+  tmp[1] = (uint8_t) (value >> 8);
+  tmp[2] = (uint8_t) (value >> 16);
+  tmp[3] = (uint8_t) (value >> 24);
+  plan_put(buf, tmp, 4);
+
+} // plan_put32
+
+
+
+/**
+  \fn uint32_t plan_get32(const uint8_t *data)
+
+  \param[in]  data        pointer to value (little-endian)
+
+  \return value
+
+  read 32-bit value from plan.
+*/
+static uint32_t plan_get32(const uint8_t *data) {
+
+  return((uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24));
+
+} // plan_get32
+
+
+
+/**
+  \fn uint32_t plan_crc(const uint8_t *data, uint64_t len)
+
+  \param[in]  data        data to check
+  \param[in]  len         length of data [B]
+
+  \return CRC32 of data
+
+  calculate CRC32 (IEEE 802.3) for protecting plan and identifying images.
+*/
+static uint32_t plan_crc(const uint8_t *data, uint64_t len) {
+
+  crcConfig_t   config;
+
+  crc_get_config("crc32", &config);
+  return(crc_calc(&config, data, len));
+
+} // plan_crc
+
+
+
+/**
+  \fn void plan_put_image(planBuf_t *buf, uint16_t *imageBuf, int idx, uint8_t verbose)
+
+  \param      buf         buffer to append to
+  \param[in]  imageBuf    memory image. HB!=0 indicates content
+  \param[in]  idx         index of image in plan
+  \param[in]  verbose     verbosity level
+
+  append memory image as list of contiguous blocks. Number of blocks and CRC32 are
+  stored in front of list.
+*/
+static void plan_put_image(planBuf_t *buf, uint16_t *imageBuf, int idx, uint8_t verbose) {
+
+  uint64_t  addrStart, addrStop, numData, addr, lenBlock, posHead, posList, lenEnd;
+  uint32_t  numBlocks = 0, crc;
+  uint8_t   tmp[256];
+  int       lenTmp;
+
+  // reserve space for number of blocks and CRC
+  posHead = buf->len;
+  plan_put32(buf, 0);
+  plan_put32(buf, 0);
+  posList = buf->len;
+
+  // append contiguous blocks with address and length
+  get_image_size(imageBuf, 0, LENIMAGEBUF, &addrStart, &addrStop, &numData);
+  addr = addrStart;
+  while ((numData > 0) && (addr <= addrStop)) {
+    if (!(imageBuf[addr] & 0xFF00)) {
+      addr++;
+      continue;
+    }
+    for (lenBlock=0; (addr+lenBlock <= addrStop) && (imageBuf[addr+lenBlock] & 0xFF00); lenBlock++);
+    plan_put32(buf, (uint32_t) addr);
+    plan_put32(buf, (uint32_t) lenBlock);
+    for (lenTmp=0; lenBlock > 0; lenBlock--) {
+      tmp[lenTmp++] = (uint8_t) (imageBuf[addr++] & 0x00FF);
+      if ((lenTmp == sizeof(tmp)) || (lenBlock == 1)) {
+        plan_put(buf, tmp, lenTmp);
+        lenTmp = 0;
+      }
+    }
+    numBlocks++;
+  }
+
+  // store number of blocks and CRC over list in front of list
+  crc    = plan_crc(buf->data + posList, buf->len - posList);
+  lenEnd = buf->len;
+  buf->len = posHead;
+  plan_put32(buf, numBlocks);
+  plan_put32(buf, crc);
+  buf->len = lenEnd;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    if (numData == 0)
+      printf("  image %d: no data\n", idx);
+    else
+      printf("  image %d: %1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ", %d blocks, CRC32 0x%08x\n", idx, (float) numData / 1024.0, addrStart, addrStop, (int) numBlocks, (unsigned int) crc);
+  }
+  fflush(stdout);
+
+} // plan_put_image
+
+
+
+/**
+  \fn void plan_put_arg(planBuf_t *buf, uint32_t *numArgs, const char *arg)
+
+  \param      buf         buffer to append to
+  \param      numArgs     number of options in plan, is incremented
+  \param[in]  arg         option or parameter
+
+  append commandline argument with length.
+*/
+static void plan_put_arg(planBuf_t *buf, uint32_t *numArgs, const char *arg) {
+
+  plan_put32(buf, (uint32_t) strlen(arg));
+  plan_put(buf, arg, strlen(arg));
+  (*numArgs)++;
+
+} // plan_put_arg
+
+
+
+/**
+  \fn void plan_compile(const char *recipeFile, const char *planFile, uint8_t verbose)
+
+  \param[in]  recipeFile  name of recipe file with stm8gal options
+  \param[in]  planFile    name of binary plan to create
+  \param[in]  verbose     verbosity level
+
+  compile recipe to binary plan. Input files are imported, merged and transformed,
+  all other options are stored in the given order.
+*/
+void plan_compile(const char *recipeFile, const char *planFile, uint8_t verbose) {
+
+  FILE          *fp;
+  char          line[1000], name[STRLEN], ref[STRLEN];
+  char          *token[PLAN_MAXARG];
+  char          **args = NULL;            // all arguments of recipe
+  int           *lines = NULL;            // line of each argument
+  int           numArgs = 0, num, numLine = 0, i, j, k, numParam;
+  imageOp_t     *imageOps;
+  int           numOps = 0;
+  bool          mergeFiles = false, merged = false;
+  int           numMerge = 0;
+  char          **mergeNames;
+  fileFormat_t  *mergeFormats;
+  uint64_t      *mergeAddr;
+  fileFormat_t  format;
+  uint64_t      addrBin;
+  uint16_t      *imageBuf;
+  planBuf_t     bufArgs = {NULL, 0, 0}, bufImages = {NULL, 0, 0}, plan = {NULL, 0, 0};
+  uint32_t      numPlanArgs = 0, numImages = 0;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  compile recipe '%s'\n", recipeFile);
+  fflush(stdout);
+
+  // read arguments of all lines
+  if (!(fp = fopen(recipeFile, "r")))
+    Error("in 'plan_compile()': cannot open recipe '%s'", recipeFile);
+  while (fgets(line, sizeof(line), fp)) {
+    numLine++;
+    num = split_args(line, token, PLAN_MAXARG);
+    if (!(args = realloc(args, (numArgs + num + 1) * sizeof(*args))) || !(lines = realloc(lines, (numArgs + num + 1) * sizeof(*lines))))
+      Error("in 'plan_compile()': cannot allocate arguments");
+    for (i=0; i<num; i++) {
+      if (!(args[numArgs] = malloc(strlen(token[i])+1)))
+        Error("in 'plan_compile()': cannot allocate arguments");
+      strcpy(args[numArgs], token[i]);
+      lines[numArgs++] = numLine;
+    }
+  }
+  fclose(fp);
+
+  // allocate image pipeline, merge lists and image
+  imageOps     = calloc(numArgs + 1, sizeof(*imageOps));
+  mergeNames   = calloc(numArgs + 1, sizeof(*mergeNames));
+  mergeFormats = calloc(numArgs + 1, sizeof(*mergeFormats));
+  mergeAddr    = calloc(numArgs + 1, sizeof(*mergeAddr));
+  if ((imageOps == NULL) || (mergeNames == NULL) || (mergeFormats == NULL) || (mergeAddr == NULL))
+    Error("in 'plan_compile()': cannot allocate image lists");
+  imageBuf = mem_alloc(MEM_IMAGE, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+
+  // 1st pass: check options and collect input files for merging
+  for (i=0; i<numArgs; i++) {
+    for (k=0; s_planOption[k].shortName != NULL; k++) {
+      if ((!strcmp(args[i], s_planOption[k].shortName)) || (!strcmp(args[i], s_planOption[k].longName)))
+        break;
+    }
+    if (s_planOption[k].shortName == NULL)
+      Error("in 'plan_compile()': option '%s' not supported in recipe (line %d)", args[i], lines[i]);
+    numParam = s_planOption[k].numParam;
+    if (i + numParam >= numArgs)
+      Error("in 'plan_compile()': missing parameter for '%s' (line %d)", args[i], lines[i]);
+    if (!strcmp(s_planOption[k].shortName, "-M"))
+      mergeFiles = true;
+    if ((!strcmp(s_planOption[k].shortName, "-w")) || (!strcmp(s_planOption[k].shortName, "-D")) || (!strcmp(s_planOption[k].shortName, "-o"))) {
+      format = get_file_format(args[i+1], name);
+      if (!strcmp(name, "-"))
+        Error("in 'plan_compile()': stdin not supported in recipe (line %d)", lines[i]);
+      if ((format == FORMAT_BIN) && (!strcmp(s_planOption[k].shortName, "-w"))) {
+        if (i + 2 >= numArgs)
+          Error("in 'plan_compile()': missing address for binary file (line %d)", lines[i]);
+        sscanf(args[i+2], "%" SCNx64, &(mergeAddr[numMerge]));
+        numParam++;
+      }
+      if (!strcmp(s_planOption[k].shortName, "-w")) {
+        if (!(mergeNames[numMerge] = malloc(strlen(name)+1)))
+          Error("in 'plan_compile()': cannot allocate file list");
+        strcpy(mergeNames[numMerge], name);
+        mergeFormats[numMerge++] = format;
+      }
+    }
+    i += numParam;
+  }
+
+  // 2nd pass: resolve images and store other options in order
+  for (i=0; i<numArgs; i++) {
+
+    // get number of parameters (already checked)
+    for (k=0; s_planOption[k].shortName != NULL; k++) {
+      if ((!strcmp(args[i], s_planOption[k].shortName)) || (!strcmp(args[i], s_planOption[k].longName)))
+        break;
+    }
+    numParam = s_planOption[k].numParam;
+
+    // image operation is applied to subsequent images. Checksums are also kept in the plan,
+    // as they identify the base image of a delta upload on the device (see check_base())
+    if ((j = get_image_op(args+i, &(imageOps[numOps]))) > 0) {
+      if (imageOps[numOps].type == IMAGE_CRC) {
+        for (k=0; k<=j; k++)
+          plan_put_arg(&bufArgs, &numPlanArgs, args[i+k]);
+      }
+      numOps++;
+      i += j;
+      continue;
+    }
+
+    // merge flag is resolved here
+    if (!strcmp(s_planOption[k].shortName, "-M"))
+      continue;
+
+    // input files -> import, transform and store as image
+    if ((!strcmp(s_planOption[k].shortName, "-w")) || (!strcmp(s_planOption[k].shortName, "-D")) || (!strcmp(s_planOption[k].shortName, "-o"))) {
+      format  = get_file_format(args[i+1], name);
+      addrBin = 0;
+      if (!strcmp(s_planOption[k].shortName, "-o"))
+        addrBin = OPT_START;
+      else if ((format == FORMAT_BIN) && (!strcmp(s_planOption[k].shortName, "-w"))) {
+        sscanf(args[i+2], "%" SCNx64, &addrBin);
+        numParam++;
+      }
+      i += numParam;
+
+      // with merging upload all files at first -w
+      if ((mergeFiles) && (!strcmp(s_planOption[k].shortName, "-w"))) {
+        if (merged)
+          continue;
+        merged = true;
+        imageBuf = mem_clear(imageBuf);
+        import_files(numMerge, mergeNames, mergeFormats, mergeAddr, imageBuf, verbose);
+      }
+      else {
+        imageBuf = mem_clear(imageBuf);
+        import_file(name, format, addrBin, imageBuf, verbose);
+      }
+
+      // option bytes are not transformed, see main()
+      if (strcmp(s_planOption[k].shortName, "-o"))
+        transform_image(imageBuf, numOps, imageOps, verbose);
+
+      // store image and reference it
+      plan_put_image(&bufImages, imageBuf, (int) numImages, verbose);
+      snprintf(ref, sizeof(ref), "plan:%d", (int) numImages++);
+      plan_put_arg(&bufArgs, &numPlanArgs, s_planOption[k].shortName);
+      plan_put_arg(&bufArgs, &numPlanArgs, ref);
+      continue;
+    }
+
+    // other options are copied with parameters
+    for (j=0; j<=numParam; j++)
+      plan_put_arg(&bufArgs, &numPlanArgs, args[i+j]);
+    i += numParam;
+
+  } // 2nd pass
+
+  // assemble plan: header, options, images, CRC32
+  plan_put(&plan, PLAN_MAGIC, strlen(PLAN_MAGIC));
+  plan_put32(&plan, PLAN_VERSION);
+  plan_put32(&plan, numPlanArgs);
+  plan_put32(&plan, numImages);
+  if (bufArgs.len > 0)
+    plan_put(&plan, bufArgs.data, bufArgs.len);
+  if (bufImages.len > 0)
+    plan_put(&plan, bufImages.data, bufImages.len);
+  plan_put32(&plan, plan_crc(plan.data, plan.len));
+
+  // write plan
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  write plan '%s' ... ", planFile);
+  fflush(stdout);
+  if (!(fp = fopen(planFile, "wb")))
+    Error("in 'plan_compile()': cannot create plan '%s'", planFile);
+  if (fwrite(plan.data, 1, plan.len, fp) != plan.len)
+    Error("in 'plan_compile()': cannot write plan '%s'", planFile);
+  fclose(fp);
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (%d options, %d images, %1.1fkB)\n", (int) numPlanArgs, (int) numImages, (float) plan.len / 1024.0);
+  fflush(stdout);
+
+  // release memory
+  for (i=0; i<numArgs; i++)
+    free(args[i]);
+  for (i=0; i<numMerge; i++)
+    free(mergeNames[i]);
+  free(args);
+  free(lines);
+  free(imageOps);
+  free(mergeNames);
+  free(mergeFormats);
+  free(mergeAddr);
+  free(bufArgs.data);
+  free(bufImages.data);
+  free(plan.data);
+  mem_free(imageBuf);
+
+} // plan_compile
+
+
+
+/**
+  \fn void plan_load(const char *planFile, int idx, int *argc, char ***argv)
+
+  \param[in]  planFile    name of binary plan
+  \param[in]  idx         index of option (-n) in commandline
+  \param      argc        number of commandline arguments, is updated
+  \param      argv        commandline arguments, is replaced
+
+  load plan and check CRC32. Option at idx and plan name are replaced by the options of the plan,
+  i.e. subsequent options on the commandline take precedence. Images remain loaded for plan_image().
+*/
+void plan_load(const char *planFile, int idx, int *argc, char ***argv) {
+
+  FILE      *fp;
+  long      lenFile;
+  uint64_t  pos, len;
+  uint32_t  numArgs, numBlocks, i, j;
+  char      **args;
+  int       num = 0, k;
+
+  // read complete plan
+  if (!(fp = fopen(planFile, "rb")))
+    Error("in 'plan_load()': cannot open plan '%s'", planFile);
+  fseek(fp, 0, SEEK_END);
+  lenFile = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (lenFile < (long) (strlen(PLAN_MAGIC) + 16))
+    Error("in 'plan_load()': '%s' is no plan", planFile);
+  if (!(s_planData = malloc(lenFile)))
+    Error("in 'plan_load()': cannot allocate %1.1fkB", (float) lenFile / 1024.0);
+  if (fread(s_planData, 1, lenFile, fp) != (size_t) lenFile)
+    Error("in 'plan_load()': cannot read plan '%s'", planFile);
+  fclose(fp);
+
+  // check header and CRC32
+  len = (uint64_t) lenFile - 4;
+  if (memcmp(s_planData, PLAN_MAGIC, strlen(PLAN_MAGIC)))
+    Error("in 'plan_load()': '%s' is no plan", planFile);
+  pos = strlen(PLAN_MAGIC);
+  if (plan_get32(s_planData + pos) != PLAN_VERSION)
+    Error("in 'plan_load()': plan '%s' has version %d, expect %d. Please re-compile recipe", planFile, (int) plan_get32(s_planData + pos), PLAN_VERSION);
+  if (plan_crc(s_planData, len) != plan_get32(s_planData + len))
+    Error("in 'plan_load()': CRC error in plan '%s'", planFile);
+  numArgs        = plan_get32(s_planData + pos + 4);
+  s_numPlanImage = plan_get32(s_planData + pos + 8);
+  pos += 12;
+
+  // assemble new commandline: options before -n, options of plan, options after plan name
+  if (!(args = calloc(*argc + numArgs, sizeof(*args))))
+    Error("in 'plan_load()': cannot allocate arguments");
+  for (k=0; k<idx; k++)
+    args[num++] = (*argv)[k];
+  for (i=0; i<numArgs; i++) {
+    if ((pos + 4 > len) || (pos + 4 + plan_get32(s_planData + pos) > len))
+      Error("in 'plan_load()': plan '%s' is corrupt", planFile);
+    j = plan_get32(s_planData + pos);
+    if (!(args[num] = malloc(j+1)))
+      Error("in 'plan_load()': cannot allocate arguments");
+    memcpy(args[num], s_planData + pos + 4, j);
+    args[num++][j] = '\0';
+    pos += 4 + j;
+  }
+  for (k=idx+2; k<*argc; k++)
+    args[num++] = (*argv)[k];
+  args[num] = NULL;
+  *argc = num;
+  *argv = args;
+
+  // get block lists of images
+  if (!(s_planImage = calloc(s_numPlanImage + 1, sizeof(*s_planImage))))
+    Error("in 'plan_load()': cannot allocate image list");
+  for (i=0; i<s_numPlanImage; i++) {
+    if (pos + 8 > len)
+      Error("in 'plan_load()': plan '%s' is corrupt", planFile);
+    numBlocks = plan_get32(s_planData + pos);
+    s_planImage[i].numBlocks = numBlocks;
+    s_planImage[i].crc       = plan_get32(s_planData + pos + 4);
+    s_planImage[i].blocks    = s_planData + pos + 8;
+    pos += 8;
+    for (j=0; j<numBlocks; j++) {
+      if ((pos + 8 > len) || (pos + 8 + plan_get32(s_planData + pos + 4) > len) || (plan_get32(s_planData + pos) + (uint64_t) plan_get32(s_planData + pos + 4) > LENIMAGEBUF))
+        Error("in 'plan_load()': plan '%s' is corrupt", planFile);
+      pos += 8 + plan_get32(s_planData + pos + 4);
+    }
+  }
+
+} // plan_load
+
+
+
+/**
+  \fn void plan_image(const char *name, uint16_t *imageBuf, uint8_t verbose)
+
+  \param[in]  name        index of image as string, i.e. file name w/o prefix "plan:"
+  \param[out] imageBuf    memory image. HB!=0 indicates content
+  \param[in]  verbose     verbosity level
+
+  copy image of loaded plan to memory image. May be called from import threads.
+*/
+void plan_image(const char *name, uint16_t *imageBuf, uint8_t verbose) {
+
+  const uint8_t   *block;
+  uint64_t        addr, addrStart = 0, addrStop = 0, numData = 0;
+  uint32_t        len, i, j;
+  int             idx = -1;
+
+  // get image
+  sscanf(name, "%d", &idx);
+  if ((idx < 0) || (idx >= (int) s_numPlanImage))
+    Error("in 'plan_image()': image %s not in plan (%d images)", name, (int) s_numPlanImage);
+
+  // print message
+  if (verbose == INFORM)
+    log_printf("  convert plan image ... ");
+  else if (verbose == CHATTY)
+    log_printf("  convert plan image %d ... ", idx);
+
+  // copy blocks to memory image
+  block = s_planImage[idx].blocks;
+  for (i=0; i<s_planImage[idx].numBlocks; i++) {
+    addr = plan_get32(block);
+    len  = plan_get32(block + 4);
+    for (j=0; j<len; j++)
+      imageBuf[addr+j] = ((uint16_t) block[8+j]) | 0xFF00;
+    if ((numData == 0) || (addr < addrStart))
+      addrStart = addr;
+    if (addr + len - 1 > addrStop)
+      addrStop = addr + len - 1;
+    numData += len;
+    block += 8 + len;
+  }
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    if (numData == 0)
+      log_printf("done, no data\n");
+    else if (verbose == CHATTY)
+      log_printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ", CRC32 0x%08x)\n", (float) numData/1024.0, addrStart, addrStop, (unsigned int) s_planImage[idx].crc);
+    else
+      log_printf("done (%1.1fkB in 0x%" PRIx64 " - 0x%" PRIx64 ")\n", (float) numData/1024.0, addrStart, addrStop);
+  }
+  log_flush();        // keep order with following direct output
+
+} // plan_image
+
+
+// end of file
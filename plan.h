@@ -0,0 +1,42 @@
+/**
+  \file plan.h
+
+  \author G. Icking-Konert
+  \date 2019-03-23
+  \version 0.1
+
+  \brief declaration of recipe compiler and plan loader
+
+  declaration of routines for compiling a recipe file (stm8gal options, e.g.
+  reset, baudrate, uploads, erase, jump) once into a binary plan with resolved
+  memory images, and for loading the plan for repeated production runs.
+*/
+
+// for including file only once
+#ifndef _PLAN_H_
+#define _PLAN_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// identifier of binary plan file
+#define PLAN_MAGIC      "STM8PLAN"
+
+/// version of binary plan format
+#define PLAN_VERSION    1
+
+
+/// compile recipe file to binary plan
+void  plan_compile(const char *recipeFile, const char *planFile, uint8_t verbose);
+
+/// load plan and replace option at index (-n) and its file name by options of plan
+void  plan_load(const char *planFile, int idx, int *argc, char ***argv);
+
+/// copy image of loaded plan (index as string, see "plan:" prefix) to memory image
+void  plan_image(const char *name, uint16_t *imageBuf, uint8_t verbose);
+
+#endif // _PLAN_H_
+
+// end of file
@@ -8,12 +8,14 @@
   \brief implementation of RS232 comm port routines
    
   implementation of of routines for RS232 communication using the Win32 or Posix API.
+  Ports named "tcp://host:port" or "rfc2217://host:port" are forwarded to the network routines, see net_comm.c.
   For Win32, see e.g. http://msdn.microsoft.com/en-us/library/default.aspx
   For Posix see http://www.easysw.com/~mike/serial/serial.html
 */
 
 // include files
 #include "serial_comm.h"
+#include "net_comm.h"
 #include "main.h"
 #include "misc.h"
 #if defined(__ARMEL__) && defined(USE_WIRING)
@@ -144,6 +146,10 @@ void list_ports(void) {
 */
 HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR) {
 
+  // network port via serial device server
+  if (net_is_name(port))
+    return(net_open(port, baudrate, timeout, numBits, parity, numStop, RTS, DTR));
+
 /////////
 // Win32
 /////////
@@ -206,6 +212,13 @@ HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t
 */
 void close_port(HANDLE *fpCom) {
 
+  // network port
+  if (net_is_port(*fpCom)) {
+    net_close(*fpCom);
+    *fpCom = 0;
+    return;
+  }
+
 /////////
 // Win32
 /////////
@@ -250,6 +263,12 @@ void close_port(HANDLE *fpCom) {
   generate low pulse on DTR in [ms] to reset STM8.
 */
 void pulse_DTR(HANDLE fpCom, uint32_t duration) {
+
+  // network port
+  if (net_is_port(fpCom)) {
+    net_pulse(fpCom, 0, duration);
+    return;
+  }
   
 /////////
 // Win32 (see https://msdn.microsoft.com/en-us/library/windows/desktop/aa363254(v=vs.85).aspx)
@@ -307,6 +326,12 @@ void pulse_DTR(HANDLE fpCom, uint32_t duration) {
 void pulse_RTS(HANDLE fpCom, uint32_t duration)
 {
 
+    // network port
+    if (net_is_port(fpCom)) {
+        net_pulse(fpCom, 1, duration);
+        return;
+    }
+
 /////////
 // Win32 (see https://msdn.microsoft.com/en-us/library/windows/desktop/aa363254(v=vs.85).aspx)
 /////////
@@ -399,6 +424,12 @@ void pulse_GPIO(int pin, uint32_t duration) {
 */
 void get_port_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uint8_t *numBits, uint8_t *parity, uint8_t *numStop, uint8_t *RTS, uint8_t *DTR) {
 
+  // network port
+  if (net_is_port(fpCom)) {
+    net_get_attribute(fpCom, baudrate, timeout, numBits, parity, numStop, RTS, DTR);
+    return;
+  }
+
 /////////
 // Win32
 /////////
@@ -477,6 +508,30 @@ void get_port_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uin
 #endif
 #ifdef B230400
     case B230400:  *baudrate = 230400;  break;
+#endif
+#ifdef B460800
+    case B460800:   *baudrate = 460800;   break;
+#endif
+#ifdef B500000
+    case B500000:   *baudrate = 500000;   break;
+#endif
+#ifdef B576000
+    case B576000:   *baudrate = 576000;   break;
+#endif
+#ifdef B921600
+    case B921600:   *baudrate = 921600;   break;
+#endif
+#ifdef B1000000
+    case B1000000:  *baudrate = 1000000;  break;
+#endif
+#ifdef B1152000
+    case B1152000:  *baudrate = 1152000;  break;
+#endif
+#ifdef B1500000
+    case B1500000:  *baudrate = 1500000;  break;
+#endif
+#ifdef B2000000
+    case B2000000:  *baudrate = 2000000;  break;
 #endif
     default: *baudrate = UINT32_MAX;
   } // switch (brate)
@@ -541,6 +596,12 @@ void get_port_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uin
   change attributes of an already open comm port.
 */
 void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR) {
+
+  // network port
+  if (net_is_port(fpCom)) {
+    net_set_attribute(fpCom, baudrate, timeout, numBits, parity, numStop, RTS, DTR);
+    return;
+  }
   
 /////////
 // Win32
@@ -644,6 +705,30 @@ void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8
 #endif
 #ifdef B230400
     case 230400: brate=B230400; break;
+#endif
+#ifdef B460800
+    case 460800:  brate=B460800;  break;
+#endif
+#ifdef B500000
+    case 500000:  brate=B500000;  break;
+#endif
+#ifdef B576000
+    case 576000:  brate=B576000;  break;
+#endif
+#ifdef B921600
+    case 921600:  brate=B921600;  break;
+#endif
+#ifdef B1000000
+    case 1000000: brate=B1000000; break;
+#endif
+#ifdef B1152000
+    case 1152000: brate=B1152000; break;
+#endif
+#ifdef B1500000
+    case 1500000: brate=B1500000; break;
+#endif
+#ifdef B2000000
+    case 2000000: brate=B2000000; break;
 #endif
     default: 
       Error("in 'set_port_attribute()': unsupported baudrate %d Baud", (int) baudrate);
@@ -816,6 +901,14 @@ uint32_t send_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenTx, char *Tx) {
   // for reading back LIN echo 
   char      Rx[1000];
   uint32_t  lenRx;
+
+  // network port -> send in single segment, then handle echo as below
+  if (net_is_port(fpCom)) {
+    uint32_t  numSent = net_send(fpCom, lenTx, Tx);
+    if ((uartMode == 1) && (receive_port(fpCom, uartMode, numSent, Rx) != numSent))
+      Error("in 'send_port()': read 1-wire echo failed");
+    return(numSent);
+  }
   
   
 /////////
@@ -876,6 +969,19 @@ uint32_t send_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenTx, char *Tx) {
 */
 uint32_t receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx) {
 
+  // network port. For UART reply mode with 2-wire interface echo each received byte
+  if (net_is_port(fpCom)) {
+    uint32_t  numRx;
+    if (uartMode != 2)
+      return(net_receive(fpCom, lenRx, Rx));
+    for (numRx=0; numRx<lenRx; numRx++) {
+      if (net_receive(fpCom, 1, Rx+numRx) != 1)
+        break;
+      net_send(fpCom, 1, Rx+numRx);
+    }
+    return(numRx);
+  }
+
   
 /////////
 // Win32
@@ -983,6 +1089,80 @@ uint32_t receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx)
 
 
 
+/**
+  \fn uint32_t read_port(HANDLE fpCom, uint32_t maxRx, char *Rx, uint32_t timeout)
+   
+  \param[in]  fpCom      handle to comm port
+  \param[in]  maxRx      max. number of bytes to receive
+  \param[out] Rx         array containing bytes received
+  \param[in]  timeout    max. time to wait for first byte [ms]
+  
+  \return number of received bytes
+  
+  receive available data, i.e. return as soon as data is received or after timeout. Used for
+  continuous capture, in contrast to receive_port() which waits for the specified number of bytes.
+  Note: under Win32 port timeouts are changed.
+*/
+uint32_t read_port(HANDLE fpCom, uint32_t maxRx, char *Rx, uint32_t timeout) {
+
+  // network port
+  if (net_is_port(fpCom))
+    return(net_read(fpCom, maxRx, Rx, timeout));
+
+/////////
+// Win32
+/////////
+#ifdef WIN32
+
+  COMMTIMEOUTS  timeouts;
+  DWORD         numChars = 0;
+
+  // return immediately if data is available, else wait for first byte up to timeout
+  timeouts.ReadIntervalTimeout         = MAXDWORD;
+  timeouts.ReadTotalTimeoutMultiplier  = MAXDWORD;
+  timeouts.ReadTotalTimeoutConstant    = timeout;
+  timeouts.WriteTotalTimeoutMultiplier = 0;
+  timeouts.WriteTotalTimeoutConstant   = 0;
+  SetCommTimeouts(fpCom, &timeouts);
+  ReadFile(fpCom, Rx, maxRx, &numChars, NULL);
+
+  // return number of bytes received
+  return((uint32_t) numChars);
+
+#endif // WIN32
+
+
+/////////
+// Posix
+/////////
+#if defined(__APPLE__) || defined(__unix__) 
+
+  struct timeval  tv;
+  fd_set          fdr;
+  ssize_t         got;
+
+  // wait for data using select
+  tv.tv_sec  = (timeout / 1000L);
+  tv.tv_usec = (timeout % 1000L) * 1000L;
+  FD_ZERO(&fdr);
+  FD_SET(fpCom, &fdr);
+  if (select(fpCom + 1, &fdr, NULL, NULL, &tv) != 1)
+    return(0);
+
+  // read all available data
+  got = read(fpCom, Rx, maxRx);
+  if (got < 0)
+    return(0);
+
+  // return number of bytes received
+  return((uint32_t) got);
+
+#endif // __APPLE__ || __unix__
+
+} // read_port
+
+
+
 /**
   \fn void flush_port(HANDLE fpCom)
    
@@ -993,6 +1173,12 @@ uint32_t receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx)
 */
 void flush_port(HANDLE fpCom) {
 
+  // network port
+  if (net_is_port(fpCom)) {
+    net_flush(fpCom);
+    return;
+  }
+
 /////////
 // Win32
 /////////
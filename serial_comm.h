@@ -85,6 +85,9 @@ uint32_t    send_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenTx, char *Tx);
 /// receive data
 uint32_t    receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx);
 
+/// receive available data
+uint32_t    read_port(HANDLE fpCom, uint32_t maxRx, char *Rx, uint32_t timeout);
+
 /// flush port buffers
 void        flush_port(HANDLE fpCom);
 
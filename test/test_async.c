@@ -0,0 +1,355 @@
+/**
+  \file test_async.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of asynchronous bootloader API
+
+  test of bsl_async.h against a minimal BSL model on the other end of a
+  socket pair. The model answers WRITE and READ frames like the UART
+  bootloader in duplex mode, and can NACK or ignore a frame at a given
+  address. Checks completion order of chained operations, immediate
+  completion of empty ranges, and the status and address reported by the
+  callback for NACK, verify mismatch, timeout and abort. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include "main.h"
+#include "misc.h"
+#include "serial_comm.h"
+#include "bootloader.h"
+#include "bsl_async.h"
+
+
+/// size of BSL memory model [B]
+#define MEM_SIZE      0x20000
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+/// state of BSL model, i.e. bytes it waits for
+typedef enum {
+  BSL_CMD = 0,                //< command + checksum
+  BSL_ADDR,                   //< address + checksum
+  BSL_LEN,                    //< number of bytes + checksum (READ)
+  BSL_DATA                    //< number of bytes + data + checksum (WRITE)
+} bslState_t;
+
+/// minimal BSL model (UART duplex mode)
+typedef struct {
+  int         fd;             //< socket of BSL side
+  bslState_t  state;          //< protocol state
+  uint8_t     cmd;            //< current command
+  uint32_t    addr;           //< address of current frame
+  uint8_t     buf[300];       //< received bytes of current step
+  int         len;            //< number of received bytes
+  uint8_t     mem[MEM_SIZE];  //< memory content
+  uint32_t    nackAddr;       //< NACK address of frame with this address (0=none)
+  uint32_t    muteAddr;       //< don't respond to address of frame with this address (0=none)
+} bslModel_t;
+
+/// record of one callback
+typedef struct {
+  int               op;       //< operation: 'W'=write, 'V'=verify, 'R'=read
+  bslAsyncStatus_t  status;   //< reported status
+  uint64_t          addr;     //< reported address
+} callRecord_t;
+
+// global variables
+static bslModel_t     s_bsl;              //< BSL model
+static callRecord_t   s_call[10];         //< callbacks in order of completion
+static int            s_numCall = 0;      //< number of callbacks
+static int            s_numFail = 0;      //< number of failed checks
+static uint16_t       s_image[MEM_SIZE];  //< image to write and verify
+static uint16_t       s_read[MEM_SIZE];   //< image read from BSL model
+
+
+
+/**
+  \fn void bsl_model_send(uint8_t *data, int len)
+
+  \param[in] data     bytes to send
+  \param[in] len      number of bytes
+
+  send response of BSL model.
+*/
+static void bsl_model_send(uint8_t *data, int len) {
+
+  if (write(s_bsl.fd, data, len) != len)
+    printf("  BSL model: send failed\n");
+
+} // bsl_model_send
+
+
+
+/**
+  \fn void bsl_model_serve(void)
+
+  read available bytes and respond like the UART bootloader. Only WRITE and READ are supported.
+*/
+static void bsl_model_serve(void) {
+
+  uint8_t   c, chk, resp[260];
+  int       i, need;
+
+  while (read(s_bsl.fd, &c, 1) == 1) {
+    s_bsl.buf[s_bsl.len++] = c;
+
+    // number of bytes of current step
+    if (s_bsl.state == BSL_CMD)
+      need = 2;
+    else if (s_bsl.state == BSL_ADDR)
+      need = 5;
+    else if (s_bsl.state == BSL_LEN)
+      need = 2;
+    else
+      need = s_bsl.buf[0] + 3;
+    if (s_bsl.len < need)
+      continue;
+    s_bsl.len = 0;
+
+    switch (s_bsl.state) {
+
+      // command -> ACK, wait for address
+      case BSL_CMD:
+        s_bsl.cmd = s_bsl.buf[0];
+        resp[0] = ((s_bsl.cmd == WRITE) || (s_bsl.cmd == READ)) ? ACK : NACK;
+        bsl_model_send(resp, 1);
+        if (resp[0] == ACK)
+          s_bsl.state = BSL_ADDR;
+        break;
+
+      // address -> ACK, NACK or no response
+      case BSL_ADDR:
+        s_bsl.addr  = ((uint32_t) s_bsl.buf[0] << 24) | ((uint32_t) s_bsl.buf[1] << 16) | ((uint32_t) s_bsl.buf[2] << 8) | s_bsl.buf[3];
+        s_bsl.state = BSL_CMD;
+        if ((s_bsl.addr != 0) && (s_bsl.addr == s_bsl.muteAddr))
+          break;
+        resp[0] = ((s_bsl.addr < MEM_SIZE) && (s_bsl.addr != s_bsl.nackAddr)) ? ACK : NACK;
+        bsl_model_send(resp, 1);
+        if (resp[0] == ACK)
+          s_bsl.state = (s_bsl.cmd == WRITE) ? BSL_DATA : BSL_LEN;
+        break;
+
+      // READ: number of bytes -> ACK + data
+      case BSL_LEN:
+        s_bsl.state = BSL_CMD;
+        resp[0] = ACK;
+        for (i=0; i<=s_bsl.buf[0]; i++)
+          resp[1+i] = s_bsl.mem[(s_bsl.addr + i) % MEM_SIZE];
+        bsl_model_send(resp, s_bsl.buf[0] + 2);
+        break;
+
+      // WRITE: check data and store
+      case BSL_DATA:
+        s_bsl.state = BSL_CMD;
+        chk = 0;
+        for (i=0; i<need-1; i++)
+          chk ^= s_bsl.buf[i];
+        resp[0] = (chk == s_bsl.buf[need-1]) ? ACK : NACK;
+        if (resp[0] == ACK) {
+          for (i=0; i<=s_bsl.buf[0]; i++)
+            s_bsl.mem[(s_bsl.addr + i) % MEM_SIZE] = s_bsl.buf[1+i];
+        }
+        bsl_model_send(resp, 1);
+        break;
+
+    } // switch (state)
+
+  } // while data available
+
+} // bsl_model_serve
+
+
+
+/**
+  \fn void run(bslSession_t *session)
+
+  \param[in] session    session
+
+  event loop. Serve BSL model and session until the session is idle.
+*/
+static void run(bslSession_t *session) {
+
+  struct pollfd   fds[2];
+  int32_t         timeout;
+
+  while ((timeout = bsl_async_process(session)) >= 0) {
+    fds[0].fd     = bsl_async_fd(session);
+    fds[0].events = POLLIN;
+    fds[1].fd     = s_bsl.fd;
+    fds[1].events = POLLIN;
+    poll(fds, 2, (int) timeout);
+    bsl_model_serve();
+  }
+
+} // run
+
+
+
+/**
+  \fn void record(int op, bslAsyncStatus_t status, uint64_t addr)
+
+  \param[in] op       operation: 'W'=write, 'V'=verify, 'R'=read
+  \param[in] status   reported status
+  \param[in] addr     reported address
+
+  record callback in order of completion.
+*/
+static void record(int op, bslAsyncStatus_t status, uint64_t addr) {
+
+  if (s_numCall < (int) (sizeof(s_call)/sizeof(s_call[0]))) {
+    s_call[s_numCall].op     = op;
+    s_call[s_numCall].status = status;
+    s_call[s_numCall].addr   = addr;
+  }
+  s_numCall++;
+
+} // record
+
+
+
+// callbacks. Write and verify chain the next operation on success
+static void cb_read(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr, void *user) {
+  (void) user;
+  CHECK(!bsl_async_busy(session));
+  record('R', status, addr);
+}
+
+static void cb_verify(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr, void *user) {
+  record('V', status, addr);
+  if ((status == BSL_ASYNC_OK) && (user != NULL))
+    CHECK(bsl_async_start_read(session, 0x8000, 0x82FF, s_read, cb_read, NULL));
+}
+
+static void cb_write(bslSession_t *session, bslAsyncStatus_t status, uint64_t addr, void *user) {
+  record('W', status, addr);
+  if ((status == BSL_ASYNC_OK) && (user != NULL))
+    CHECK(bsl_async_start_verify(session, s_image, 0x8000, 0x82FF, cb_verify, user));
+}
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of asynchronous API.
+*/
+int main(void) {
+
+  bslSession_t    *session;
+  eepromLayout_t  eeprom = {0, 0, 0};
+  int             sv[2], i, chained = 1;
+  uint64_t        done, total;
+
+  printf("test_async\n");
+
+  // connect session and BSL model via socket pair. Responses must be read w/o blocking
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+    printf("  cannot create socket pair\n");
+    return(1);
+  }
+  fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL) | O_NONBLOCK);
+  memset(&s_bsl, 0, sizeof(s_bsl));
+  s_bsl.fd = sv[1];
+  g_timing.timeout = 100;
+
+  // only UART duplex mode is supported
+  CHECK(bsl_async_open(sv[0], 1, &eeprom) == NULL);
+  CHECK((session = bsl_async_open(sv[0], 0, &eeprom)) != NULL);
+  if (session == NULL)
+    return(1);
+
+  // image with gap, partial last block
+  memset(s_image, 0, sizeof(s_image));
+  for (i=0x8000; i<0x82FF; i++)
+    s_image[i] = ((i & 0x1FF) < 0x1C0) ? (0xFF00 | (uint8_t) (i * 7)) : 0;
+
+  // write -> verify -> read, each started from the callback of the previous one
+  printf("  completion order\n");
+  s_numCall = 0;
+  CHECK(bsl_async_start_write(session, s_image, 0x8000, 0x82FF, cb_write, &chained));
+  CHECK(bsl_async_busy(session));
+  CHECK(!bsl_async_start_read(session, 0x8000, 0x80FF, s_read, cb_read, NULL));
+  run(session);
+  CHECK(s_numCall == 3);
+  CHECK((s_call[0].op == 'W') && (s_call[0].status == BSL_ASYNC_OK));
+  CHECK((s_call[1].op == 'V') && (s_call[1].status == BSL_ASYNC_OK));
+  CHECK((s_call[2].op == 'R') && (s_call[2].status == BSL_ASYNC_OK));
+  for (i=0x8000; i<0x82FF; i++) {
+    if ((s_image[i] & 0xFF00) && ((s_bsl.mem[i] != (uint8_t) s_image[i]) || (s_read[i] != s_image[i])))
+      break;
+  }
+  CHECK(i == 0x82FF);
+  bsl_async_progress(session, &done, &total);
+  CHECK((done == total) && (total == 0x300));
+
+  // range w/o defined bytes completes from start call
+  printf("  empty range\n");
+  s_numCall = 0;
+  CHECK(bsl_async_start_write(session, s_image, 0x81C0, 0x81FF, cb_write, NULL));
+  CHECK((s_numCall == 1) && (s_call[0].status == BSL_ASYNC_OK) && (!bsl_async_busy(session)));
+
+  // NACK of second block. First block is written
+  printf("  NACK\n");
+  memset(s_bsl.mem, 0, sizeof(s_bsl.mem));
+  s_bsl.nackAddr = 0x8080;
+  s_numCall = 0;
+  CHECK(bsl_async_start_write(session, s_image, 0x8000, 0x82FF, cb_write, &chained));
+  run(session);
+  s_bsl.nackAddr = 0;
+  CHECK((s_numCall == 1) && (s_call[0].op == 'W') && (s_call[0].status == BSL_ASYNC_NACK) && (s_call[0].addr == 0x8080));
+  CHECK((s_bsl.mem[0x807F] == (uint8_t) s_image[0x807F]) && (s_bsl.mem[0x8080] == 0));
+
+  // verify mismatch reports first differing address
+  printf("  verify mismatch\n");
+  CHECK(bsl_async_start_write(session, s_image, 0x8000, 0x82FF, cb_write, NULL));
+  run(session);
+  s_bsl.mem[0x8123] ^= 0x55;
+  s_numCall = 0;
+  CHECK(bsl_async_start_verify(session, s_image, 0x8000, 0x82FF, cb_verify, NULL));
+  run(session);
+  CHECK((s_numCall == 1) && (s_call[0].op == 'V') && (s_call[0].status == BSL_ASYNC_VERIFY) && (s_call[0].addr == 0x8123));
+
+  // no response -> timeout after g_timing.timeout
+  printf("  timeout\n");
+  s_bsl.muteAddr = 0x8200;
+  s_numCall = 0;
+  CHECK(bsl_async_start_read(session, 0x8100, 0x82FF, s_read, cb_read, NULL));
+  run(session);
+  s_bsl.muteAddr = 0;
+  CHECK((s_numCall == 1) && (s_call[0].op == 'R') && (s_call[0].status == BSL_ASYNC_TIMEOUT) && (s_call[0].addr == 0x8200));
+
+  // close during operation -> abort
+  printf("  abort\n");
+  s_numCall = 0;
+  CHECK(bsl_async_start_read(session, 0x8000, 0x82FF, s_read, cb_read, NULL));
+  bsl_async_close(session);
+  CHECK((s_numCall == 1) && (s_call[0].op == 'R') && (s_call[0].status == BSL_ASYNC_ABORT) && (s_call[0].addr == 0x8000));
+
+  close(sv[0]);
+  close(sv[1]);
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
@@ -0,0 +1,220 @@
+/**
+  \file test_events.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of machine-readable progress events
+
+  test of the progress channel of logger.h (option -F). Events are read
+  from a pipe and each line is checked against the documented JSON format,
+  i.e. key order, event names, ETA per event type and monotonic time stamps.
+  Also checks the rate limit of progress events, that a reader which
+  doesn't read never blocks the writer nor receives broken lines, and that
+  a closed reader only disables the channel. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "main.h"
+#include "misc.h"
+#include "logger.h"
+
+
+/// max. number of bytes read from pipe
+#define MAX_READ      (512*1024)
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+/// parsed progress event
+typedef struct {
+  double    t;                //< time stamp [s]
+  char      phase[20];        //< name of phase
+  char      event[20];        //< start, progress or end
+  uint64_t  done;             //< bytes done
+  uint64_t  total;            //< total bytes
+  uint64_t  addr;             //< current address
+  char      eta[20];          //< remaining time [s], or null
+  uint32_t  retries;          //< number of retries
+} event_t;
+
+// global variables
+static int      s_numFail = 0;        //< number of failed checks
+static char     s_buf[MAX_READ+1];    //< data read from pipe
+
+
+
+/**
+  \fn int drain(int fd, char *buf, int len)
+
+  \param[in]  fd      read end of pipe (non-blocking)
+  \param[out] buf     buffer for data
+  \param[in]  len     number of bytes already in buffer
+
+  \return number of bytes in buffer
+
+  read all available data from pipe and append to buffer.
+*/
+static int drain(int fd, char *buf, int len) {
+
+  ssize_t   got;
+
+  while ((len < MAX_READ) && ((got = read(fd, buf + len, MAX_READ - len)) > 0))
+    len += (int) got;
+  buf[len] = '\0';
+  return(len);
+
+} // drain
+
+
+
+/**
+  \fn int parse(char *buf, event_t *ev, int maxEv)
+
+  \param[in]  buf     JSON lines
+  \param[out] ev      parsed events
+  \param[in]  maxEv   size of ev
+
+  \return number of events, or -1 on format error
+
+  parse and check progress events. Each line must match the documented format exactly.
+*/
+static int parse(char *buf, event_t *ev, int maxEv) {
+
+  char      *line = buf, *end;
+  int       num = 0, n;
+  double    tLast = 0;
+  event_t   e;
+
+  while (*line != '\0') {
+
+    // each event is a complete line
+    if (!(end = strchr(line, '\n'))) {
+      printf("  incomplete line '%s'\n", line);
+      return(-1);
+    }
+    *end = '\0';
+
+    // keys in documented order, no additional content
+    n = -1;
+    memset(&e, 0, sizeof(e));
+    sscanf(line, "{\"t\":%lf,\"phase\":\"%19[a-z]\",\"event\":\"%19[a-z]\",\"done\":%" SCNu64 ",\"total\":%" SCNu64 ",\"addr\":%" SCNu64 ",\"eta\":%19[0-9.nul],\"retries\":%" SCNu32 "}%n",
+      &e.t, e.phase, e.event, &e.done, &e.total, &e.addr, e.eta, &e.retries, &n);
+    if (n != (int) strlen(line)) {
+      printf("  invalid event '%s'\n", line);
+      return(-1);
+    }
+
+    // event names, ETA per event type, time stamps
+    if ((strcmp(e.event, "start") != 0) && (strcmp(e.event, "progress") != 0) && (strcmp(e.event, "end") != 0)) {
+      printf("  invalid event type '%s'\n", line);
+      return(-1);
+    }
+    if ((!strcmp(e.event, "start") && strcmp(e.eta, "null")) || (!strcmp(e.event, "end") && strcmp(e.eta, "0")) ||
+        (!strcmp(e.event, "progress") && (strtod(e.eta, NULL) < 0))) {
+      printf("  invalid ETA '%s'\n", line);
+      return(-1);
+    }
+    if ((e.t < tLast) || (e.done > e.total)) {
+      printf("  inconsistent event '%s'\n", line);
+      return(-1);
+    }
+    tLast = e.t;
+
+    if (num < maxEv)
+      ev[num] = e;
+    num++;
+    line = end + 1;
+  }
+  return(num);
+
+} // parse
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of progress events.
+*/
+int main(void) {
+
+  int       fd[2], len, num, i;
+  event_t   ev[10];
+  uint64_t  tStart;
+
+  printf("test_events\n");
+
+  // events of a write and a verify phase. Read end is non-blocking
+  printf("  format and rate limit\n");
+  if (pipe(fd) != 0) {
+    printf("  cannot create pipe\n");
+    return(1);
+  }
+  fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
+  log_event_open(fd[1], 10);
+  log_event("write", LOG_START, 0, 4096, 0x8000, 0);
+  usleep(150000);
+  log_event("write", LOG_PROGRESS, 1024, 4096, 0x8400, 0);
+  log_event("write", LOG_PROGRESS, 2048, 4096, 0x8800, 0);      // skipped, within 100ms
+  usleep(150000);
+  log_event("write", LOG_PROGRESS, 3072, 4096, 0x8C00, 2);
+  log_event("write", LOG_END, 4096, 4096, 0x9000, 2);
+  log_event("verify", LOG_START, 0, 4096, 0x8000, 0);
+  log_event("verify", LOG_END, 4096, 4096, 0x9000, 0);
+  len = drain(fd[0], s_buf, 0);
+  num = parse(s_buf, ev, 10);
+  CHECK(num == 6);
+  if (num == 6) {
+    CHECK(!strcmp(ev[0].phase, "write") && !strcmp(ev[0].event, "start") && (ev[0].total == 4096) && (ev[0].addr == 0x8000));
+    CHECK(!strcmp(ev[1].event, "progress") && (ev[1].done == 1024) && (ev[1].addr == 0x8400) && (strtod(ev[1].eta, NULL) > 0));
+    CHECK(!strcmp(ev[2].event, "progress") && (ev[2].done == 3072) && (ev[2].retries == 2));
+    CHECK(!strcmp(ev[3].event, "end") && (ev[3].done == 4096) && (ev[3].retries == 2));
+    CHECK(!strcmp(ev[4].phase, "verify") && !strcmp(ev[4].event, "start"));
+    CHECK(!strcmp(ev[5].phase, "verify") && !strcmp(ev[5].event, "end"));
+  }
+
+  // reader doesn't read -> writer never blocks and reader gets only complete lines
+  printf("  slow reader\n");
+  tStart = millis();
+  for (i=0; i<5000; i++) {
+    log_event("write", LOG_START, 0, 4096, 0x8000, 0);
+    log_event("write", LOG_PROGRESS, i, 5000, 0x8000 + i, 0);
+  }
+  CHECK((millis() - tStart) < 1000);
+  len = drain(fd[0], s_buf, 0);
+  log_event_close();
+  len = drain(fd[0], s_buf, len);
+  CHECK((len > 0) && (len < MAX_READ));
+  CHECK(parse(s_buf, ev, 10) > 0);
+
+  // closed reader -> channel is disabled w/o termination
+  printf("  closed reader\n");
+  log_event_open(fd[1], 0);
+  close(fd[0]);
+  log_event("write", LOG_START, 0, 4096, 0x8000, 0);
+  log_event("write", LOG_END, 4096, 4096, 0x9000, 0);
+  log_event_close();
+
+  close(fd[1]);
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
@@ -0,0 +1,354 @@
+/**
+  \file test_gang.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of gang programming
+
+  test of gang programming via bootloader.h on pseudo terminals. A thread
+  plays several devices: it reads the shared TX line and feeds it to one
+  BSL model per device, each responding on its own RX port. Devices can
+  be dead, NACK a frame once or always, or stop responding from an
+  address on. Checks that sync drops dead devices within the common
+  deadline, that a failed write frame is repeated for devices failing
+  once, that devices failing repeatedly are dropped w/o a timeout per
+  device, and that the remaining devices hold the image. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// for pseudo terminal and cfmakeraw()
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <pthread.h>
+#include "main.h"
+#include "misc.h"
+#include "serial_comm.h"
+#include "bootloader.h"
+#include "timing.h"
+
+
+/// number of gang devices
+#define NUM_DEV       5
+
+/// idle time of TX line after which a new step starts [ms]
+#define IDLE_GAP      3
+
+/// size of BSL memory model [B]
+#define MEM_SIZE      0x10000
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+/// state of BSL model, i.e. bytes it waits for
+typedef enum {
+  BSL_CMD = 0,                //< command + checksum, or SYNCH
+  BSL_ADDR,                   //< address + checksum
+  BSL_LEN,                    //< number of bytes + checksum (READ)
+  BSL_DATA                    //< number of bytes + data + checksum (WRITE)
+} bslState_t;
+
+/// minimal BSL model (UART duplex mode) with faults
+typedef struct {
+  int         fd;             //< RX port of device (master side of pseudo terminal)
+  bool        synced;         //< SYNCH was received
+  bslState_t  state;          //< protocol state
+  uint8_t     cmd;            //< current command
+  uint32_t    addr;           //< address of current frame
+  uint8_t     buf[300];       //< received bytes of current step
+  int         len;            //< number of received bytes
+  uint8_t     mem[MEM_SIZE];  //< memory content
+  bool        dead;           //< never respond
+  uint32_t    nackOnce;       //< NACK address of this frame once (0=none)
+  uint32_t    muteFrom;       //< stop responding from frame with this address on (0=never)
+  bool        skip;           //< ignore bytes until TX line is idle, e.g. data after NACK
+} bslModel_t;
+
+// global variables
+static bslModel_t     s_dev[NUM_DEV];       //< device models
+static volatile bool  s_stop = false;       //< terminate device thread
+static int            s_numFail = 0;        //< number of failed checks
+
+
+
+/**
+  \fn bool open_pty(int *master, HANDLE *slave)
+
+  \param[out] master    master side, i.e. device
+  \param[out] slave     slave side, i.e. port of stm8gal
+
+  \return true on success
+
+  open pseudo terminal in raw mode.
+*/
+static bool open_pty(int *master, HANDLE *slave) {
+
+  struct termios  toptions;
+
+  if ((*master = posix_openpt(O_RDWR | O_NOCTTY)) < 0)
+    return(false);
+  if ((grantpt(*master) != 0) || (unlockpt(*master) != 0))
+    return(false);
+  if ((*slave = open(ptsname(*master), O_RDWR | O_NOCTTY)) < 0)
+    return(false);
+  tcgetattr(*slave, &toptions);
+  cfmakeraw(&toptions);
+  tcsetattr(*slave, TCSANOW, &toptions);
+  return(true);
+
+} // open_pty
+
+
+
+/**
+  \fn void bsl_model_byte(bslModel_t *dev, uint8_t c)
+
+  \param[in]  dev     device model
+  \param[in]  c       byte received via shared TX line
+
+  process byte like the UART bootloader and respond on RX port of device. Only SYNCH, WRITE and READ are supported.
+*/
+static void bsl_model_byte(bslModel_t *dev, uint8_t c) {
+
+  uint8_t   chk, resp[260];
+  int       i, need, lenResp = 0;
+
+  if ((dev->dead) || (dev->skip))
+    return;
+
+  // SYNCH outside of frame
+  if ((dev->state == BSL_CMD) && (dev->len == 0) && (c == SYNCH)) {
+    resp[0] = (dev->synced) ? NACK : ACK;
+    dev->synced = true;
+    if (write(dev->fd, resp, 1) != 1)
+      printf("  device: send failed\n");
+    return;
+  }
+  dev->buf[dev->len++] = c;
+
+  // number of bytes of current step
+  if (dev->state == BSL_CMD)
+    need = 2;
+  else if (dev->state == BSL_ADDR)
+    need = 5;
+  else if (dev->state == BSL_LEN)
+    need = 2;
+  else
+    need = dev->buf[0] + 3;
+  if (dev->len < need)
+    return;
+  dev->len = 0;
+
+  switch (dev->state) {
+
+    // command -> ACK, wait for address
+    case BSL_CMD:
+      dev->cmd = dev->buf[0];
+      resp[lenResp++] = ((dev->cmd == WRITE) || (dev->cmd == READ)) ? ACK : NACK;
+      if (resp[0] == ACK)
+        dev->state = BSL_ADDR;
+      break;
+
+    // address -> ACK or NACK, optionally stop responding
+    case BSL_ADDR:
+      dev->addr  = ((uint32_t) dev->buf[0] << 24) | ((uint32_t) dev->buf[1] << 16) | ((uint32_t) dev->buf[2] << 8) | dev->buf[3];
+      dev->state = BSL_CMD;
+      if ((dev->muteFrom != 0) && (dev->addr >= dev->muteFrom)) {
+        dev->dead = true;
+        return;
+      }
+      resp[lenResp++] = ((dev->addr < MEM_SIZE) && (dev->addr != dev->nackOnce)) ? ACK : NACK;
+      if (dev->addr == dev->nackOnce)
+        dev->nackOnce = 0;
+      if (resp[0] == ACK)
+        dev->state = (dev->cmd == WRITE) ? BSL_DATA : BSL_LEN;
+      break;
+
+    // READ: number of bytes -> ACK + data
+    case BSL_LEN:
+      dev->state = BSL_CMD;
+      resp[lenResp++] = ACK;
+      for (i=0; i<=dev->buf[0]; i++)
+        resp[lenResp++] = dev->mem[(dev->addr + i) % MEM_SIZE];
+      break;
+
+    // WRITE: check data and store
+    case BSL_DATA:
+      dev->state = BSL_CMD;
+      chk = 0;
+      for (i=0; i<need-1; i++)
+        chk ^= dev->buf[i];
+      resp[lenResp++] = (chk == dev->buf[need-1]) ? ACK : NACK;
+      if (resp[0] == ACK) {
+        for (i=0; i<=dev->buf[0]; i++)
+          dev->mem[(dev->addr + i) % MEM_SIZE] = dev->buf[1+i];
+      }
+      break;
+
+  } // switch (state)
+
+  // after NACK ignore rest of frame
+  dev->skip = (resp[0] == NACK);
+  if (write(dev->fd, resp, lenResp) != lenResp)
+    printf("  device: send failed\n");
+
+} // bsl_model_byte
+
+
+
+/**
+  \fn void *devices(void *arg)
+
+  \param[in]  arg     not used
+
+  \return always NULL
+
+  device thread: feed bytes of shared TX line (RX of device 0) to all device models. The host
+  sends each step at once and waits for the responses, so an idle TX line starts a new step.
+*/
+static void *devices(void *arg) {
+
+  struct pollfd   fds;
+  uint8_t         buf[300];
+  uint64_t        tLast = 0;
+  int             len, i, k;
+
+  (void) arg;
+  fds.fd     = s_dev[0].fd;
+  fds.events = POLLIN;
+  while (!s_stop) {
+    if (poll(&fds, 1, 10) <= 0)
+      continue;
+    if ((len = read(s_dev[0].fd, buf, sizeof(buf))) <= 0)
+      continue;
+    if (millis() - tLast > IDLE_GAP) {
+      for (k=0; k<NUM_DEV; k++) {
+        s_dev[k].skip = false;
+        s_dev[k].len  = 0;
+      }
+    }
+    tLast = millis();
+    for (i=0; i<len; i++) {
+      for (k=0; k<NUM_DEV; k++)
+        bsl_model_byte(&(s_dev[k]), buf[i]);
+    }
+  }
+  return(NULL);
+
+} // devices
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of gang programming.
+*/
+int main(void) {
+
+  HANDLE      ports[NUM_DEV];
+  bool        active[NUM_DEV];
+  pthread_t   thread;
+  uint16_t    *image, *readBuf;
+  uint64_t    tStart, tFrame, i;
+  int         k;
+
+  printf("test_gang\n");
+  g_backgroundOperation = true;
+  timing_init();
+  g_timing.timeout    = 200;
+  g_timing.syncRetry  = 10;
+  g_timing.syncDelay  = 10;
+  g_timing.flushDelay = 10;
+
+  // devices: 0 ok, 1 NACKs a frame once, 2 and 4 stop responding, 3 is dead
+  memset(s_dev, 0, sizeof(s_dev));
+  for (k=0; k<NUM_DEV; k++) {
+    if (!open_pty(&(s_dev[k].fd), &(ports[k]))) {
+      printf("  cannot open pseudo terminal\n");
+      return(1);
+    }
+  }
+  s_dev[1].nackOnce = 0x8080;
+  s_dev[2].muteFrom = 0x8200;
+  s_dev[3].dead     = true;
+  s_dev[4].muteFrom = 0x8200;
+  pthread_create(&thread, NULL, devices, NULL);
+  bsl_gangSetup(NUM_DEV, ports);
+
+  // sync: dead device is dropped, costs max. one common deadline per attempt
+  printf("  sync\n");
+  fflush(stdout);
+  tStart = millis();
+  bsl_sync(ports[0], UART, MUTE);
+  tFrame = millis() - tStart;
+  CHECK(bsl_gangStatus(active) == NUM_DEV-1);
+  CHECK(active[0] && active[1] && active[2] && (!active[3]) && active[4]);
+  CHECK(tFrame < g_timing.syncRetry * (GANG_SYNC_TIMEOUT + g_timing.syncDelay) + 2*g_timing.flushDelay + 200);
+
+  // image with 8 blocks
+  image   = calloc(MEM_SIZE, sizeof(*image));
+  readBuf = calloc(MEM_SIZE, sizeof(*readBuf));
+  if ((image == NULL) || (readBuf == NULL))
+    return(1);
+  for (i=0x8000; i<0x8400; i++)
+    image[i] = 0xFF00 | (uint8_t) (i * 5 + 1);
+
+  // write: device 1 is retried, devices 2 and 4 fail repeatedly in the same frames and are dropped.
+  // Each attempt waits for 3 responses with one common deadline, independent of number of failing devices
+  printf("  write\n");
+  fflush(stdout);
+  tStart = millis();
+  bsl_memWrite(ports[0], UART, 0, image, 0x8000, 0x83FF, MUTE);
+  tFrame = millis() - tStart;
+  CHECK(bsl_gangStatus(active) == 2);
+  CHECK(active[0] && active[1] && (!active[2]) && (!active[3]) && (!active[4]));
+  CHECK(tFrame < 4 * 3 * g_timing.timeout + 4 * g_timing.flushDelay + 500);
+  for (k=0; k<2; k++) {
+    for (i=0x8000; (i<0x8400) && (s_dev[k].mem[i] == (uint8_t) image[i]); i++);
+    CHECK(i == 0x8400);
+  }
+  CHECK(s_dev[1].nackOnce == 0);
+  CHECK(s_dev[2].mem[0x8200] == 0);
+
+  // read back from remaining devices
+  printf("  read\n");
+  fflush(stdout);
+  bsl_memRead(ports[0], UART, 0, 0x8000, 0x83FF, readBuf, MUTE);
+  for (i=0x8000; (i<0x8400) && (readBuf[i] == image[i]); i++);
+  CHECK(i == 0x8400);
+  CHECK(bsl_gangStatus(NULL) == 2);
+
+  // stop devices
+  s_stop = true;
+  pthread_join(thread, NULL);
+  for (k=0; k<NUM_DEV; k++) {
+    close(ports[k]);
+    close(s_dev[k].fd);
+  }
+  free(image);
+  free(readBuf);
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
@@ -0,0 +1,222 @@
+/**
+  \file test_logger.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of asynchronous console logger
+
+  test of logger.h with stdout redirected. Checks that messages of several
+  threads are printed complete and in order per thread across many wraps
+  of the ring buffer, that log_flush() keeps order with direct output, that
+  a console which doesn't read doesn't stall the caller, and the rate limit
+  of progress messages. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "main.h"
+#include "misc.h"
+#include "logger.h"
+
+
+/// number of threads printing concurrently
+#define NUM_THREADS   4
+
+/// number of messages per thread
+#define NUM_LINES     2000
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { fprintf(stderr, "  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+// global variables
+static int      s_numFail = 0;        //< number of failed checks
+static char     s_fill[101];          //< padding of messages
+
+
+
+/**
+  \fn void *printer(void *arg)
+
+  \param[in]  arg     index of thread
+
+  \return always NULL
+
+  print numbered messages via logger.
+*/
+static void *printer(void *arg) {
+
+  int   i, k = (int) (intptr_t) arg;
+
+  for (i=0; i<NUM_LINES; i++)
+    log_printf("T%d %05d %s\n", k, i, s_fill);
+  return(NULL);
+
+} // printer
+
+
+
+/**
+  \fn int redirect(const char *name)
+
+  \param[in]  name    file for stdout (NULL=restore)
+
+  \return always 0
+
+  redirect stdout to file or restore it.
+*/
+static int redirect(const char *name) {
+
+  static int  s_stdout = -1;
+  int         fd;
+
+  fflush(stdout);
+  if (name != NULL) {
+    s_stdout = dup(1);
+    if ((fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0) {
+      dup2(fd, 1);
+      close(fd);
+    }
+  }
+  else {
+    dup2(s_stdout, 1);
+    close(s_stdout);
+  }
+  return(0);
+
+} // redirect
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of console logger.
+*/
+int main(void) {
+
+  char        name[] = "/tmp/test_logger_XXXXXX", line[200];
+  pthread_t   thread[NUM_THREADS];
+  int         next[NUM_THREADS], fd[2], k, i, num, numLines;
+  bool        direct;
+  uint64_t    tStart;
+  pid_t       pid;
+  FILE        *fp;
+
+  printf("test_logger\n");
+  fflush(stdout);
+  memset(s_fill, 'x', sizeof(s_fill)-1);
+  if ((k = mkstemp(name)) < 0) {
+    printf("  cannot create file\n");
+    return(1);
+  }
+  close(k);
+  log_init();
+
+  // concurrent messages of several threads, then direct output after flush
+  fprintf(stderr, "  concurrent messages\n");
+  redirect(name);
+  for (k=0; k<NUM_THREADS; k++)
+    pthread_create(&(thread[k]), NULL, printer, (void*) (intptr_t) k);
+  for (k=0; k<NUM_THREADS; k++)
+    pthread_join(thread[k], NULL);
+  log_printf("last message\n");
+  log_flush();
+  printf("direct output\n");
+  redirect(NULL);
+
+  // each message complete and in order per thread, direct output at end
+  numLines = 0;
+  direct   = false;
+  memset(next, 0, sizeof(next));
+  if ((fp = fopen(name, "r"))) {
+    while (fgets(line, sizeof(line), fp)) {
+      CHECK(!direct);
+      if (!strcmp(line, "direct output\n"))
+        direct = true;
+      else if (strcmp(line, "last message\n")) {
+        CHECK((sscanf(line, "T%d %d", &k, &num) == 2) && (k >= 0) && (k < NUM_THREADS) && (strlen(line) == 10 + strlen(s_fill)));
+        if ((k >= 0) && (k < NUM_THREADS)) {
+          CHECK(num == next[k]);
+          next[k] = num + 1;
+        }
+      }
+      numLines++;
+    }
+    fclose(fp);
+  }
+  CHECK(direct && (numLines == NUM_THREADS*NUM_LINES + 2));
+  remove(name);
+
+  // console doesn't read -> caller isn't stalled until ring buffer is full.
+  // Child reads after 300ms and returns number of lines
+  fprintf(stderr, "  slow console\n");
+  if (pipe(fd) != 0) {
+    fprintf(stderr, "  cannot create pipe\n");
+    return(1);
+  }
+  fflush(stdout);
+  if ((pid = fork()) == 0) {
+    close(fd[1]);
+    usleep(300000);
+    num = 0;
+    fp = fdopen(fd[0], "r");
+    while (fgets(line, sizeof(line), fp))
+      num++;
+    _exit(num == 1000);
+  }
+  close(fd[0]);
+  fflush(stdout);
+  k = dup(1);
+  dup2(fd[1], 1);
+  close(fd[1]);
+  tStart = millis();
+  for (i=0; i<1000; i++)
+    log_printf("%05d %s\n", i, s_fill);
+  CHECK((millis() - tStart) < 200);
+  log_flush();
+  CHECK((millis() - tStart) >= 250);
+  dup2(k, 1);
+  close(k);
+  waitpid(pid, &num, 0);
+  CHECK(WIFEXITED(num) && (WEXITSTATUS(num) == 1));
+
+  // progress messages are limited to one per LOG_PROGRESS_INTERVAL
+  fprintf(stderr, "  progress rate\n");
+  redirect(name);
+  tStart = millis();
+  for (i=0; (millis() - tStart) < 3 * LOG_PROGRESS_INTERVAL + LOG_PROGRESS_INTERVAL/2; i++)
+    log_progress("progress %d\n", i);
+  log_flush();
+  redirect(NULL);
+  numLines = 0;
+  if ((fp = fopen(name, "r"))) {
+    while (fgets(line, sizeof(line), fp))
+      numLines++;
+    fclose(fp);
+  }
+  CHECK((i > 100) && (numLines >= 3) && (numLines <= 5));
+  remove(name);
+
+  fprintf(stderr, "  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
@@ -0,0 +1,194 @@
+/**
+  \file test_memtrack.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of memory accounting and budget
+
+  test of memtrack.h. Checks the peak allocation and buffer count per
+  subsystem in the report, that untouched buffers don't become resident,
+  that clearing a buffer with budget releases its pages, and that steps
+  exceeding the budget are rejected. Rejection terminates the process via
+  Error(), so it is checked in a child process. Resident memory is only
+  checked on Linux. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "main.h"
+#include "misc.h"
+#include "memtrack.h"
+
+
+/// 1MB
+#define MB            (1024L*1024L)
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+// global variables
+static int      s_numFail = 0;        //< number of failed checks
+
+
+
+/**
+  \fn bool terminates(uint64_t budget, uint64_t need)
+
+  \param[in]  budget    memory budget [B]
+  \param[in]  need      estimated memory of next step [B] (0=none)
+
+  \return true if mem_budget() or mem_check_need() terminates with error
+
+  set budget and check step in child process, because Error() terminates the process.
+*/
+static bool terminates(uint64_t budget, uint64_t need) {
+
+  pid_t   pid;
+  int     status, fd;
+
+  fflush(stdout);
+  if ((pid = fork()) == 0) {
+    if ((fd = open("/dev/null", O_WRONLY)) >= 0) {
+      dup2(fd, 1);
+      dup2(fd, 2);
+    }
+    mem_budget(budget);
+    if (need > 0)
+      mem_check_need("import", need);
+    _exit(0);
+  }
+  if ((pid < 0) || (waitpid(pid, &status, 0) != pid))
+    return(false);
+  return(WIFEXITED(status) && (WEXITSTATUS(status) != 0));
+
+} // terminates
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of memory accounting and budget.
+*/
+int main(void) {
+
+  char      name[] = "/tmp/test_memtrack_XXXXXX", line[200], pool[20];
+  uint8_t   *image, *file1, *file2, *verify, *big;
+  uint64_t  rss, i;
+  float     peak;
+  int       fd, count, numPools;
+  FILE      *fp;
+
+  printf("test_memtrack\n");
+  g_backgroundOperation = true;
+
+  // accounting per subsystem: peak and number of buffers
+  printf("  accounting\n");
+  image  = mem_alloc(MEM_IMAGE, 32*MB);
+  file1  = mem_alloc(MEM_FILE, 8*MB);
+  file2  = mem_alloc(MEM_FILE, 8*MB);
+  mem_free(file1);
+  file1  = mem_alloc(MEM_FILE, 4*MB);
+  verify = mem_alloc(MEM_VERIFY, 1*MB);
+  CHECK((image[0] == 0) && (image[32*MB-1] == 0) && (verify[MB-1] == 0));
+  CHECK(((uintptr_t) image % 16) == 0);
+
+  // report to file and parse it
+  if ((fd = mkstemp(name)) < 0) {
+    printf("  cannot create file\n");
+    return(1);
+  }
+  fflush(stdout);
+  count = dup(1);
+  dup2(fd, 1);
+  close(fd);
+  mem_report(INFORM);         // no output w/o budget
+  mem_report(CHATTY);
+  fflush(stdout);
+  dup2(count, 1);
+  close(count);
+  numPools = 0;
+  if ((fp = fopen(name, "r"))) {
+    CHECK(fgets(line, sizeof(line), fp) && (!strncmp(line, "  memory: peak ", 15)));
+    while (fgets(line, sizeof(line), fp)) {
+      CHECK(sscanf(line, "%19s peak %f MB allocated, %d buffers", pool, &peak, &count) == 3);
+      if (!strcmp(pool, "image"))
+        CHECK((peak == 32.0) && (count == 1));
+      else if (!strcmp(pool, "file"))
+        CHECK((peak == 16.0) && (count == 3));
+      else if (!strcmp(pool, "verify"))
+        CHECK((peak == 1.0) && (count == 1));
+      numPools++;
+    }
+    fclose(fp);
+  }
+  CHECK(numPools == 3);
+  remove(name);
+  mem_free(file1);
+  mem_free(file2);
+  mem_free(verify);
+
+  // clear w/o budget overwrites in place
+  printf("  clear\n");
+  memset(image, 0x55, 32*MB);
+  CHECK(mem_clear(image) == image);
+  CHECK((image[0] == 0) && (image[32*MB-1] == 0));
+  CHECK(!mem_sparse());
+
+  #if defined(__linux__)
+
+    // untouched buffer doesn't become resident, touched pages do
+    printf("  sparse buffer\n");
+    rss = mem_rss(false);
+    big = mem_alloc(MEM_IMAGE, 256*MB);
+    CHECK(mem_rss(false) < rss + 8*MB);
+    for (i=0; i<64*MB; i+=4096)
+      big[i] = 1;
+    CHECK(mem_rss(false) >= rss + 56*MB);
+    CHECK(mem_rss(true) >= rss + 56*MB);
+
+    // clear with budget releases pages
+    mem_budget(mem_rss(false) + 512*MB);
+    CHECK(mem_sparse());
+    rss = mem_rss(false);
+    big = mem_clear(big);
+    CHECK(mem_rss(false) + 56*MB <= rss);
+    CHECK((big[0] == 0) && (big[256*MB-1] == 0));
+    mem_free(big);
+    mem_budget(0);
+
+  #else
+    (void) big;
+    (void) i;
+  #endif
+
+  // budget: steps exceeding the remaining budget or a budget below current use terminate
+  printf("  budget\n");
+  rss = mem_rss(false);
+  CHECK(!terminates(rss + 64*MB, 16*MB));
+  CHECK(terminates(rss + 64*MB, 128*MB));
+  CHECK(terminates(1*MB, 0));
+  mem_free(image);
+
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
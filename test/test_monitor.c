@@ -0,0 +1,242 @@
+/**
+  \file test_monitor.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of serial monitor
+
+  test of monitor.h on a pseudo terminal. A child process plays the
+  application and writes its output to the master side with pauses.
+  Checks unescaping of patterns, pass and fail patterns split over
+  several reads, the monitor time w/o pattern, and capturing a burst
+  larger than the OS buffer w/o loss. For the boot time measurement checks
+  the signature split over several reads, the timeout, and gang devices
+  of which only some send the signature. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// for pseudo terminal and cfmakeraw()
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include "main.h"
+#include "misc.h"
+#include "serial_comm.h"
+#include "monitor.h"
+
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+// global variables
+static int      s_numFail = 0;        //< number of failed checks
+
+
+
+/**
+  \fn bool open_pty(int *master, HANDLE *slave)
+
+  \param[out] master    master side, i.e. application
+  \param[out] slave     slave side, i.e. port of stm8gal
+
+  \return true on success
+
+  open pseudo terminal in raw mode.
+*/
+static bool open_pty(int *master, HANDLE *slave) {
+
+  struct termios  toptions;
+
+  if ((*master = posix_openpt(O_RDWR | O_NOCTTY)) < 0)
+    return(false);
+  if ((grantpt(*master) != 0) || (unlockpt(*master) != 0))
+    return(false);
+  if ((*slave = open(ptsname(*master), O_RDWR | O_NOCTTY)) < 0)
+    return(false);
+  tcgetattr(*slave, &toptions);
+  cfmakeraw(&toptions);
+  tcsetattr(*slave, TCSANOW, &toptions);
+  return(true);
+
+} // open_pty
+
+
+
+/**
+  \fn pid_t application(int master, const char **parts, int delay)
+
+  \param[in]  master    master side of pseudo terminal
+  \param[in]  parts     output of application, NULL terminated
+  \param[in]  delay     pause before each part [ms]
+
+  \return pid of child process
+
+  start child process, which writes output parts with pauses.
+*/
+static pid_t application(int master, const char **parts, int delay) {
+
+  pid_t   pid;
+  int     i;
+
+  fflush(stdout);
+  if ((pid = fork()) == 0) {
+    for (i=0; parts[i] != NULL; i++) {
+      usleep(1000L * delay);
+      if (write(master, parts[i], strlen(parts[i])) < 0)
+        _exit(1);
+    }
+    _exit(0);
+  }
+  return(pid);
+
+} // application
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of serial monitor.
+*/
+int main(void) {
+
+  int             master, master2, len, i;
+  HANDLE          port, port2, ports[2];
+  bool            active[2] = {true, true};
+  pid_t           pid;
+  char            pattern[100];
+  uint64_t        tStart;
+  monitorResult_t result;
+  static char     burst[100000];
+
+  printf("test_monitor\n");
+  g_backgroundOperation = true;
+  if ((!open_pty(&master, &port)) || (!open_pty(&master2, &port2))) {
+    printf("  cannot open pseudo terminal\n");
+    return(1);
+  }
+
+  // C escape sequences in patterns
+  printf("  unescape pattern\n");
+  len = monitor_unescape("PASS\\r\\n", pattern);
+  CHECK((len == 6) && (!memcmp(pattern, "PASS\r\n", 6)));
+  len = monitor_unescape("\\x41\\t\\\\", pattern);
+  CHECK((len == 3) && (!memcmp(pattern, "A\t\\", 3)));
+
+  // pass pattern split over several reads
+  printf("  pass pattern\n");
+  {
+    const char *parts[] = {"self test ... ", "RAM ok, PA", "SS\r\n", NULL};
+    pid = application(master, parts, 30);
+    tStart = millis();
+    result = monitor_port(port, 0, 2000, "PASS\r\n", "ERR", MUTE);
+    CHECK((result == MONITOR_PASS) && ((millis() - tStart) < 1000));
+    waitpid(pid, NULL, 0);
+  }
+
+  // fail pattern
+  printf("  fail pattern\n");
+  tcflush(port, TCIOFLUSH);
+  {
+    const char *parts[] = {"self test ... ", "ER", "R 3\r\n", "PASS\r\n", NULL};
+    pid = application(master, parts, 30);
+    result = monitor_port(port, 0, 2000, "PASS", "ERR", MUTE);
+    CHECK(result == MONITOR_FAIL);
+    waitpid(pid, NULL, 0);
+  }
+
+  // no pattern -> monitor time
+  printf("  monitor time\n");
+  tcflush(port, TCIOFLUSH);
+  {
+    const char *parts[] = {"self test ... ", "running\r\n", NULL};
+    pid = application(master, parts, 30);
+    tStart = millis();
+    result = monitor_port(port, 0, 300, "PASS", NULL, MUTE);
+    CHECK((result == MONITOR_TIMEOUT) && ((millis() - tStart) >= 300) && ((millis() - tStart) < 1000));
+    waitpid(pid, NULL, 0);
+  }
+
+  // burst larger than OS buffer is captured completely, i.e. pattern at end is found
+  printf("  burst\n");
+  tcflush(port, TCIOFLUSH);
+  for (i=0; i<(int) sizeof(burst)-1; i++)
+    burst[i] = (i % 64 == 63) ? '\n' : ('a' + (i % 26));
+  memcpy(burst + sizeof(burst) - 6, "DONE\n", 6);
+  {
+    const char *parts[] = {burst, NULL};
+    pid = application(master, parts, 10);
+    result = monitor_port(port, 0, 3000, "DONE\n", NULL, MUTE);
+    CHECK(result == MONITOR_PASS);
+    waitpid(pid, NULL, 0);
+  }
+
+  // boot time: signature split over several reads, after other output
+  printf("  boot time\n");
+  tcflush(port, TCIOFLUSH);
+  {
+    const char *parts[] = {"\x00boot", " v1.2 RE", "ADY\n", NULL};
+    pid = application(master, parts, 30);
+    tStart = micros();
+    CHECK(monitor_boot(1, &port, NULL, 0, tStart, "READY", 5, 2000, MUTE) == 1);
+    CHECK((micros() - tStart) < 1000000L);
+    waitpid(pid, NULL, 0);
+  }
+
+  // boot time: no signature -> timeout after jump
+  printf("  boot timeout\n");
+  tcflush(port, TCIOFLUSH);
+  {
+    const char *parts[] = {"boot v1.2\n", NULL};
+    pid = application(master, parts, 30);
+    tStart = micros();
+    CHECK(monitor_boot(1, &port, NULL, 0, tStart, "READY", 5, 300, MUTE) == 0);
+    CHECK(((micros() - tStart) >= 300000L) && ((micros() - tStart) < 1000000L));
+    waitpid(pid, NULL, 0);
+  }
+
+  // boot time of gang devices: only active devices which sent signature are counted
+  printf("  boot time gang\n");
+  tcflush(port, TCIOFLUSH);
+  tcflush(port2, TCIOFLUSH);
+  ports[0] = port;
+  ports[1] = port2;
+  {
+    const char *parts[] = {"READY", NULL};
+    pid = application(master, parts, 30);
+    CHECK(monitor_boot(2, ports, active, 0, micros(), "READY", 5, 300, MUTE) == 1);
+    waitpid(pid, NULL, 0);
+    pid = application(master2, parts, 30);
+    active[0] = false;
+    CHECK(monitor_boot(2, ports, active, 0, micros(), "READY", 5, 300, MUTE) == 1);
+    waitpid(pid, NULL, 0);
+  }
+
+  close(port);
+  close(port2);
+  close(master);
+  close(master2);
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
@@ -0,0 +1,552 @@
+/**
+  \file test_net.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of network serial ports
+
+  test of net_comm.h via the serial_comm routines. A thread plays a local
+  serial device server with a BSL model behind it, either via raw TCP or
+  via Telnet with RFC 2217. For raw TCP checks write and read of an image,
+  that only READ frames are pipelined with "?pipe", and that modem line
+  reset is rejected. For RFC 2217 checks the option negotiation incl.
+  refusal of unknown options, the initial and changed port settings, DTR
+  pulses, 0xFF data and Telnet notifications within data, and that a
+  server refusing COM-PORT-OPTION is rejected. Rejection terminates the
+  process via Error(), so it is checked in a child process. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "main.h"
+#include "misc.h"
+#include "serial_comm.h"
+#include "net_comm.h"
+#include "bootloader.h"
+#include "timing.h"
+
+
+/// size of BSL memory model [B]
+#define MEM_SIZE      0x10000
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+// Telnet commands and options (RFC 854, 2217)
+#define TN_SE         240
+#define TN_NOP        241
+#define TN_SB         250
+#define TN_WILL       251
+#define TN_WONT       252
+#define TN_DO         253
+#define TN_DONT       254
+#define TN_IAC        255
+#define TN_TTYPE      24            //< terminal type, unknown to client
+#define TN_COMPORT    44
+
+
+/// state of BSL model, i.e. bytes it waits for
+typedef enum {
+  BSL_CMD = 0,                //< command + checksum
+  BSL_ADDR,                   //< address + checksum
+  BSL_LEN,                    //< number of bytes + checksum (READ)
+  BSL_DATA                    //< number of bytes + data + checksum (WRITE)
+} bslState_t;
+
+/// state of Telnet parser of server
+typedef enum {
+  TN_STATE_DATA = 0,          //< data byte
+  TN_STATE_IAC,               //< after IAC
+  TN_STATE_OPT,               //< after IAC WILL/WONT/DO/DONT
+  TN_STATE_SB,                //< in subnegotiation
+  TN_STATE_SB_IAC             //< after IAC in subnegotiation
+} tnState_t;
+
+/// serial device server with BSL model
+typedef struct {
+  int         sock;           //< connection to client
+  bool        rfc2217;        //< Telnet with RFC 2217, else raw TCP
+  bool        refuse;         //< refuse COM-PORT-OPTION
+  bslState_t  state;          //< BSL protocol state
+  uint8_t     cmd;            //< current BSL command
+  uint32_t    addr;           //< address of current frame
+  uint8_t     buf[300];       //< received bytes of current step
+  int         len;            //< number of received bytes
+  uint8_t     mem[MEM_SIZE];  //< memory content
+  int         aheadRead;      //< READ steps followed by further bytes in same segment
+  int         aheadWrite;     //< WRITE steps followed by further bytes in same segment
+  tnState_t   tnState;        //< Telnet parser state
+  uint8_t     tnCmd;          //< pending WILL/WONT/DO/DONT
+  uint8_t     sb[20];         //< current subnegotiation
+  int         lenSb;          //< length of subnegotiation
+  bool        wontTtype;      //< client refused unknown option
+  int         numSettings;    //< number of received COM-PORT-OPTION commands
+  uint32_t    baudrate;       //< last SET-BAUDRATE
+  uint8_t     dataSize;       //< last SET-DATASIZE
+  uint8_t     parity;         //< last SET-PARITY
+  uint8_t     stopSize;       //< last SET-STOPSIZE
+  uint8_t     control[20];    //< SET-CONTROL values
+  int         numControl;     //< number of SET-CONTROL
+} server_t;
+
+// global variables
+static server_t       s_srv;                //< serial device server
+static int            s_listen;             //< listening socket
+static int            s_numFail = 0;        //< number of failed checks
+
+
+
+/**
+  \fn void server_send(const uint8_t *data, int len, bool notify)
+
+  \param[in]  data      BSL response
+  \param[in]  len       length of response
+  \param[in]  notify    precede response with a Telnet notification (RFC 2217)
+
+  send BSL response to client, for RFC 2217 with 0xFF escaped.
+*/
+static void server_send(const uint8_t *data, int len, bool notify) {
+
+  uint8_t   buf[600];
+  int       i, lenBuf = 0;
+  const uint8_t modemState[] = {TN_IAC, TN_SB, TN_COMPORT, 107, TN_IAC, TN_IAC, TN_IAC, TN_SE, TN_IAC, TN_NOP};
+
+  if ((s_srv.rfc2217) && (notify)) {
+    memcpy(buf, modemState, sizeof(modemState));
+    lenBuf = sizeof(modemState);
+  }
+  for (i=0; i<len; i++) {
+    buf[lenBuf++] = data[i];
+    if ((s_srv.rfc2217) && (data[i] == TN_IAC))
+      buf[lenBuf++] = TN_IAC;
+  }
+  if (send(s_srv.sock, buf, lenBuf, MSG_NOSIGNAL) != lenBuf)
+    printf("  server: send failed\n");
+
+} // server_send
+
+
+
+/**
+  \fn void server_bsl(uint8_t c, bool ahead)
+
+  \param[in]  c       data byte received from client
+  \param[in]  ahead   further data bytes follow in same segment
+
+  process data byte like the UART bootloader. Only WRITE and READ are supported.
+*/
+static void server_bsl(uint8_t c, bool ahead) {
+
+  uint8_t   chk, resp[260];
+  int       i, need, lenResp = 0;
+
+  s_srv.buf[s_srv.len++] = c;
+
+  // number of bytes of current step
+  if (s_srv.state == BSL_CMD)
+    need = 2;
+  else if (s_srv.state == BSL_ADDR)
+    need = 5;
+  else if (s_srv.state == BSL_LEN)
+    need = 2;
+  else
+    need = s_srv.buf[0] + 3;
+  if (s_srv.len < need)
+    return;
+  s_srv.len = 0;
+
+  // count steps with further bytes sent ahead, i.e. w/o waiting for response
+  if ((ahead) && (s_srv.cmd == WRITE))
+    s_srv.aheadWrite++;
+  else if ((ahead) && (s_srv.state == BSL_CMD) && (s_srv.buf[0] == WRITE))
+    s_srv.aheadWrite++;
+  else if (ahead)
+    s_srv.aheadRead++;
+
+  switch (s_srv.state) {
+
+    case BSL_CMD:
+      s_srv.cmd = s_srv.buf[0];
+      resp[lenResp++] = ((s_srv.cmd == WRITE) || (s_srv.cmd == READ)) ? ACK : NACK;
+      if (resp[0] == ACK)
+        s_srv.state = BSL_ADDR;
+      break;
+
+    case BSL_ADDR:
+      s_srv.addr  = ((uint32_t) s_srv.buf[0] << 24) | ((uint32_t) s_srv.buf[1] << 16) | ((uint32_t) s_srv.buf[2] << 8) | s_srv.buf[3];
+      resp[lenResp++] = (s_srv.addr < MEM_SIZE) ? ACK : NACK;
+      s_srv.state = (resp[0] != ACK) ? BSL_CMD : ((s_srv.cmd == WRITE) ? BSL_DATA : BSL_LEN);
+      break;
+
+    case BSL_LEN:
+      s_srv.state = BSL_CMD;
+      resp[lenResp++] = ACK;
+      for (i=0; i<=s_srv.buf[0]; i++)
+        resp[lenResp++] = s_srv.mem[(s_srv.addr + i) % MEM_SIZE];
+      break;
+
+    case BSL_DATA:
+      s_srv.state = BSL_CMD;
+      chk = 0;
+      for (i=0; i<need-1; i++)
+        chk ^= s_srv.buf[i];
+      resp[lenResp++] = (chk == s_srv.buf[need-1]) ? ACK : NACK;
+      if (resp[0] == ACK) {
+        for (i=0; i<=s_srv.buf[0]; i++)
+          s_srv.mem[(s_srv.addr + i) % MEM_SIZE] = s_srv.buf[1+i];
+      }
+      s_srv.cmd = 0;
+      break;
+
+  } // switch (state)
+
+  // READ data is preceded by a notification
+  server_send(resp, lenResp, (lenResp > 1));
+
+} // server_bsl
+
+
+
+/**
+  \fn void server_option(void)
+
+  answer option request of client, or store COM-PORT-OPTION command.
+*/
+static void server_option(void) {
+
+  uint8_t   reply[3] = {TN_IAC, 0, 0}, ack[10];
+  int       i;
+
+  // subnegotiation: store setting and acknowledge with command + 100
+  if (s_srv.tnState == TN_STATE_SB_IAC) {
+    if ((s_srv.lenSb < 2) || (s_srv.sb[0] != TN_COMPORT))
+      return;
+    s_srv.numSettings++;
+    if (s_srv.sb[1] == 1)
+      s_srv.baudrate = ((uint32_t) s_srv.sb[2] << 24) | ((uint32_t) s_srv.sb[3] << 16) | ((uint32_t) s_srv.sb[4] << 8) | s_srv.sb[5];
+    else if (s_srv.sb[1] == 2)
+      s_srv.dataSize = s_srv.sb[2];
+    else if (s_srv.sb[1] == 3)
+      s_srv.parity = s_srv.sb[2];
+    else if (s_srv.sb[1] == 4)
+      s_srv.stopSize = s_srv.sb[2];
+    else if ((s_srv.sb[1] == 5) && (s_srv.numControl < (int) sizeof(s_srv.control)))
+      s_srv.control[s_srv.numControl++] = s_srv.sb[2];
+    ack[0] = TN_IAC;
+    ack[1] = TN_SB;
+    for (i=0; i<3; i++)
+      ack[2+i] = s_srv.sb[i];
+    ack[3] += 100;
+    ack[5] = TN_IAC;
+    ack[6] = TN_SE;
+    if (send(s_srv.sock, ack, 7, MSG_NOSIGNAL) != 7)
+      printf("  server: send failed\n");
+    return;
+  }
+
+  // client refuses unknown option
+  if ((s_srv.tnCmd == TN_WONT) && (s_srv.sb[0] == TN_TTYPE))
+    s_srv.wontTtype = true;
+
+  // accept binary mode and SGA, COM-PORT-OPTION unless refused
+  if (s_srv.tnCmd == TN_WILL)
+    reply[1] = ((s_srv.sb[0] == TN_COMPORT) && (s_srv.refuse)) ? TN_DONT : TN_DO;
+  else if (s_srv.tnCmd == TN_DO)
+    reply[1] = TN_WILL;
+  else
+    return;
+  reply[2] = s_srv.sb[0];
+  if (send(s_srv.sock, reply, 3, MSG_NOSIGNAL) != 3)
+    printf("  server: send failed\n");
+
+} // server_option
+
+
+
+/**
+  \fn void *server(void *arg)
+
+  \param[in]  arg     not used
+
+  \return always NULL
+
+  serial device server thread: accept connections one after another. For RFC 2217 remove
+  and answer Telnet commands, pass data to BSL model.
+*/
+static void *server(void *arg) {
+
+  uint8_t   raw[1000], c;
+  int       got, i, k, numData;
+  const uint8_t request[] = {TN_IAC, TN_DO, TN_TTYPE};
+
+  (void) arg;
+  while ((s_srv.sock = accept(s_listen, NULL, NULL)) >= 0) {
+    s_srv.state   = BSL_CMD;
+    s_srv.len     = 0;
+    s_srv.tnState = TN_STATE_DATA;
+
+    // request option unknown to client
+    if ((s_srv.rfc2217) && (send(s_srv.sock, request, sizeof(request), MSG_NOSIGNAL) != sizeof(request)))
+      printf("  server: send failed\n");
+
+    while ((got = recv(s_srv.sock, raw, sizeof(raw), 0)) > 0) {
+
+      // raw TCP: all bytes are data
+      if (!s_srv.rfc2217) {
+        for (i=0; i<got; i++)
+          server_bsl(raw[i], (i < got-1));
+        continue;
+      }
+
+      // RFC 2217: remove Telnet commands, then pass data to BSL
+      numData = 0;
+      for (i=0; i<got; i++) {
+        c = raw[i];
+        switch (s_srv.tnState) {
+          case TN_STATE_DATA:
+            if (c == TN_IAC)
+              s_srv.tnState = TN_STATE_IAC;
+            else
+              raw[numData++] = c;
+            break;
+          case TN_STATE_IAC:
+            if (c == TN_IAC) {
+              raw[numData++] = c;
+              s_srv.tnState = TN_STATE_DATA;
+            }
+            else if (c == TN_SB) {
+              s_srv.lenSb   = 0;
+              s_srv.tnState = TN_STATE_SB;
+            }
+            else if ((c == TN_WILL) || (c == TN_WONT) || (c == TN_DO) || (c == TN_DONT)) {
+              s_srv.tnCmd   = c;
+              s_srv.tnState = TN_STATE_OPT;
+            }
+            else
+              s_srv.tnState = TN_STATE_DATA;
+            break;
+          case TN_STATE_OPT:
+            s_srv.sb[0] = c;
+            server_option();
+            s_srv.tnState = TN_STATE_DATA;
+            break;
+          case TN_STATE_SB:
+            if (c == TN_IAC)
+              s_srv.tnState = TN_STATE_SB_IAC;
+            else if (s_srv.lenSb < (int) sizeof(s_srv.sb))
+              s_srv.sb[s_srv.lenSb++] = c;
+            break;
+          case TN_STATE_SB_IAC:
+            if (c == TN_SE)
+              server_option();
+            else if ((c == TN_IAC) && (s_srv.lenSb < (int) sizeof(s_srv.sb)))
+              s_srv.sb[s_srv.lenSb++] = c;
+            s_srv.tnState = (c == TN_SE) ? TN_STATE_DATA : TN_STATE_SB;
+            break;
+        } // switch state
+      }
+      for (k=0; k<numData; k++)
+        server_bsl(raw[k], (k < numData-1));
+
+    } // receive loop
+    close(s_srv.sock);
+
+  } // accept loop
+  return(NULL);
+
+} // server
+
+
+
+/**
+  \fn bool open_fails(const char *name, bool pulse)
+
+  \param[in]  name    network port
+  \param[in]  pulse   pulse DTR after opening port
+
+  \return true if init_port() or pulse_DTR() terminates with error
+
+  open port in child process, because Error() terminates the process.
+*/
+static bool open_fails(const char *name, bool pulse) {
+
+  pid_t   pid;
+  int     status, fd;
+  HANDLE  port;
+
+  fflush(stdout);
+  if ((pid = fork()) == 0) {
+    if ((fd = open("/dev/null", O_WRONLY)) >= 0) {
+      dup2(fd, 1);
+      dup2(fd, 2);
+    }
+    port = init_port(name, 115200, 200, 8, 0, 1, 0, 0);
+    if (pulse)
+      pulse_DTR(port, 10);
+    close_port(&port);
+    _exit(0);
+  }
+  if ((pid < 0) || (waitpid(pid, &status, 0) != pid))
+    return(false);
+  return(WIFEXITED(status) && (WEXITSTATUS(status) != 0));
+
+} // open_fails
+
+
+
+/**
+  \fn bool write_read(HANDLE port, uint16_t *image, uint16_t *readBuf)
+
+  \param[in]  port      network port
+  \param[in]  image     image to write
+  \param[out] readBuf   buffer for read back
+
+  \return true if BSL model and read back equal image
+
+  write image to BSL model and read it back.
+*/
+static bool write_read(HANDLE port, uint16_t *image, uint16_t *readBuf) {
+
+  uint32_t  i;
+
+  memset(s_srv.mem, 0, sizeof(s_srv.mem));
+  memset(readBuf, 0, MEM_SIZE * sizeof(*readBuf));
+  bsl_memWrite(port, UART, 0, image, 0x8000, 0x83FF, MUTE);
+  bsl_memRead(port, UART, 0, 0x8000, 0x83FF, readBuf, MUTE);
+  for (i=0x8000; (i<0x8400) && (s_srv.mem[i] == (uint8_t) image[i]) && (readBuf[i] == image[i]); i++);
+  return(i == 0x8400);
+
+} // write_read
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of network serial ports.
+*/
+int main(void) {
+
+  struct sockaddr_in  addr;
+  socklen_t           lenAddr = sizeof(addr);
+  pthread_t           thread;
+  HANDLE              port;
+  uint16_t            *image, *readBuf;
+  char                name[100];
+  int                 numSettings, i;
+
+  printf("test_net\n");
+  g_backgroundOperation = true;
+  timing_init();
+  g_timing.timeout = 200;
+
+  // serial device server on local port
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port        = 0;
+  if (((s_listen = socket(AF_INET, SOCK_STREAM, 0)) < 0) || (bind(s_listen, (struct sockaddr*) &addr, sizeof(addr)) != 0) ||
+      (listen(s_listen, 1) != 0) || (getsockname(s_listen, (struct sockaddr*) &addr, &lenAddr) != 0)) {
+    printf("  cannot open server socket\n");
+    return(1);
+  }
+  pthread_create(&thread, NULL, server, NULL);
+
+  // image with 8 blocks incl. 0xFF (Telnet IAC)
+  image   = calloc(MEM_SIZE, sizeof(*image));
+  readBuf = calloc(MEM_SIZE, sizeof(*readBuf));
+  if ((image == NULL) || (readBuf == NULL))
+    return(1);
+  for (i=0x8000; i<0x8400; i++)
+    image[i] = 0xFF00 | ((i % 7) ? (uint8_t) (i * 5 + 1) : 0xFF);
+
+  // raw TCP w/o pipelining
+  printf("  raw TCP\n");
+  fflush(stdout);
+  sprintf(name, "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+  port = init_port(name, 115200, 200, 8, 0, 1, 0, 0);
+  CHECK(net_is_port(port) && (!net_pipelined(port)));
+  CHECK(write_read(port, image, readBuf));
+  CHECK((s_srv.aheadRead == 0) && (s_srv.aheadWrite == 0));
+  close_port(&port);
+
+  // raw TCP with pipelining: READ frames in one segment, WRITE step by step
+  printf("  raw TCP pipelined\n");
+  fflush(stdout);
+  sprintf(name, "tcp://127.0.0.1:%d?pipe", ntohs(addr.sin_port));
+  port = init_port(name, 115200, 200, 8, 0, 1, 0, 0);
+  CHECK(net_pipelined(port));
+  CHECK(write_read(port, image, readBuf));
+  CHECK((s_srv.aheadRead >= 4) && (s_srv.aheadWrite == 0));
+  close_port(&port);
+
+  // raw TCP can't pulse modem lines
+  printf("  raw TCP reset\n");
+  sprintf(name, "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+  CHECK(!open_fails(name, false));
+  CHECK(open_fails(name, true));
+
+  // RFC 2217: negotiation and initial settings
+  printf("  RFC 2217 settings\n");
+  fflush(stdout);
+  s_srv.rfc2217 = true;
+  sprintf(name, "rfc2217://127.0.0.1:%d", ntohs(addr.sin_port));
+  port = init_port(name, 115200, 200, 8, 0, 1, 0, 0);
+  SLEEP(50);
+  CHECK(s_srv.wontTtype);
+  CHECK((s_srv.baudrate == 115200) && (s_srv.dataSize == 8) && (s_srv.parity == 1) && (s_srv.stopSize == 1));
+  CHECK((s_srv.numControl == 3) && (s_srv.control[0] == 1) && (s_srv.control[1] == 9) && (s_srv.control[2] == 12));
+
+  // only changed settings are sent
+  numSettings = s_srv.numSettings;
+  set_port_attribute(port, 230400, 200, 8, 2, 1, 0, 0);
+  SLEEP(50);
+  CHECK((s_srv.numSettings == numSettings + 2) && (s_srv.baudrate == 230400) && (s_srv.parity == 3));
+
+  // DTR pulse
+  pulse_DTR(port, 10);
+  SLEEP(50);
+  CHECK((s_srv.numControl == 5) && (s_srv.control[3] == 8) && (s_srv.control[4] == 9));
+
+  // data with 0xFF and Telnet notifications in responses
+  printf("  RFC 2217 data\n");
+  fflush(stdout);
+  CHECK(write_read(port, image, readBuf));
+  close_port(&port);
+
+  // server refusing COM-PORT-OPTION is rejected
+  printf("  RFC 2217 refused\n");
+  s_srv.refuse = true;
+  CHECK(open_fails(name, false));
+
+  // stop server
+  shutdown(s_listen, SHUT_RDWR);
+  close(s_listen);
+  pthread_join(thread, NULL);
+  free(image);
+  free(readBuf);
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
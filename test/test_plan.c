@@ -0,0 +1,322 @@
+/**
+  \file test_plan.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of recipe compiler and plan format
+
+  test of plan.h. A recipe with comments, merged binary files, a checksum
+  and device options is compiled, and the plan is parsed independently
+  against the documented format: header, options with length, images as
+  block lists with CRC32, CRC32 over the plan. Then the plan is loaded,
+  and the resulting commandline and image are checked. Corrupted plans
+  must be rejected, which terminates the process via Error(), so they
+  are loaded in a child process. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "main.h"
+#include "misc.h"
+#include "hexfile.h"
+#include "checksum.h"
+#include "memtrack.h"
+#include "plan.h"
+
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+// global variables
+static int      s_numFail = 0;        //< number of failed checks
+static char     s_dir[] = "/tmp/test_plan_XXXXXX";   //< folder for recipe, input files and plans
+
+/// expected options of plan. Image operations except checksum are resolved, merged files become one image
+static const char *s_expectArgs[] = {"-R", "2", "-b", "230400", "-k", "crc32", "8000", "80ff", "8100", "-w", "plan:0", "-W", "0x4000", "0x01", "-j", "0x8000"};
+
+
+
+/**
+  \fn uint32_t get32(const uint8_t *data)
+
+  \param[in]  data    pointer to value (little-endian)
+
+  \return value
+
+  read 32-bit value from plan.
+*/
+static uint32_t get32(const uint8_t *data) {
+
+  return((uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24));
+
+} // get32
+
+
+
+/**
+  \fn uint32_t crc32(const uint8_t *data, uint64_t len)
+
+  \param[in]  data    data to check
+  \param[in]  len     length of data [B]
+
+  \return CRC32 (IEEE 802.3) of data
+*/
+static uint32_t crc32(const uint8_t *data, uint64_t len) {
+
+  crcConfig_t   config;
+
+  crc_get_config("crc32", &config);
+  return(crc_calc(&config, data, len));
+
+} // crc32
+
+
+
+/**
+  \fn long read_file(const char *name, uint8_t **data)
+
+  \param[in]  name    file name
+  \param[out] data    allocated content
+
+  \return length of file, or -1 on error
+*/
+static long read_file(const char *name, uint8_t **data) {
+
+  FILE  *fp;
+  long  len;
+
+  if (!(fp = fopen(name, "rb")))
+    return(-1);
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if ((*data = malloc(len + 1)) && (fread(*data, 1, len, fp) != (size_t) len))
+    len = -1;
+  fclose(fp);
+  return(len);
+
+} // read_file
+
+
+
+/**
+  \fn void write_file(const char *name, const void *data, long len)
+
+  \param[in]  name    file name
+  \param[in]  data    content
+  \param[in]  len     length of content
+*/
+static void write_file(const char *name, const void *data, long len) {
+
+  FILE  *fp;
+
+  if ((fp = fopen(name, "wb"))) {
+    fwrite(data, 1, len, fp);
+    fclose(fp);
+  }
+
+} // write_file
+
+
+
+/**
+  \fn bool load_fails(const char *name)
+
+  \param[in]  name    plan file
+
+  \return true if plan_load() terminates with error
+
+  load plan in child process, because Error() terminates the process.
+*/
+static bool load_fails(const char *name) {
+
+  pid_t   pid;
+  int     status, argc = 3, fd;
+  char    *args[] = {"stm8gal", "-n", (char*) name, NULL};
+  char    **argv = args;
+
+  fflush(stdout);
+  if ((pid = fork()) == 0) {
+    if ((fd = open("/dev/null", O_WRONLY)) >= 0) {
+      dup2(fd, 1);
+      dup2(fd, 2);
+    }
+    plan_load(name, 1, &argc, &argv);
+    _exit(0);
+  }
+  if ((pid < 0) || (waitpid(pid, &status, 0) != pid))
+    return(false);
+  return(WIFEXITED(status) && (WEXITSTATUS(status) != 0));
+
+} // load_fails
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of recipe compiler and plan loader.
+*/
+int main(void) {
+
+  char        recipe[100], plan[100], bad[100], fileA[100], fileB[100], text[1000];
+  uint8_t     dataA[256], dataB[16], *data = NULL, *tmp;
+  uint16_t    *imageBuf;
+  long        lenFile;
+  uint64_t    pos;
+  uint32_t    numArgs = 0, numImages = 0, numBlocks = 0, lenBlock, i, j;
+  int         argc = 5;
+  char        *args[] = {"stm8gal", "-n", plan, "-v", "0", NULL};
+  char        **argv = args;
+
+  printf("test_plan\n");
+  g_backgroundOperation = true;
+  if (!mkdtemp(s_dir)) {
+    printf("  cannot create folder\n");
+    return(1);
+  }
+  snprintf(recipe, sizeof(recipe), "%s/job.txt", s_dir);
+  snprintf(plan,   sizeof(plan),   "%s/job.plan", s_dir);
+  snprintf(bad,    sizeof(bad),    "%s/bad.plan", s_dir);
+  snprintf(fileA,  sizeof(fileA),  "%s/a.bin", s_dir);
+  snprintf(fileB,  sizeof(fileB),  "%s/b.bin", s_dir);
+
+  // input files and recipe with comments
+  for (i=0; i<sizeof(dataA); i++)
+    dataA[i] = (uint8_t) (i * 3);
+  for (i=0; i<sizeof(dataB); i++)
+    dataB[i] = (uint8_t) (0xA0 + i);
+  write_file(fileA, dataA, sizeof(dataA));
+  write_file(fileB, dataB, sizeof(dataB));
+  snprintf(text, sizeof(text), "# test recipe\n-R 2 -b 230400     # reset via DTR\n-k crc32 8000 80ff 8100\n-M\n-w %s 8000\n-w %s 8200\n-W 0x4000 0x01\n-j 0x8000\n", fileA, fileB);
+  write_file(recipe, text, strlen(text));
+
+  // compile recipe
+  printf("  compile recipe\n");
+  fflush(stdout);
+  plan_compile(recipe, plan, SILENT);
+  lenFile = read_file(plan, &data);
+  CHECK(lenFile > 0);
+  if (lenFile <= 0)
+    return(1);
+
+  // header: identifier, version, number of options and images
+  printf("  plan format\n");
+  CHECK(!memcmp(data, PLAN_MAGIC, strlen(PLAN_MAGIC)));
+  pos = strlen(PLAN_MAGIC);
+  CHECK(get32(data + pos) == PLAN_VERSION);
+  numArgs   = get32(data + pos + 4);
+  numImages = get32(data + pos + 8);
+  CHECK(numArgs == sizeof(s_expectArgs)/sizeof(s_expectArgs[0]));
+  CHECK(numImages == 1);
+  pos += 12;
+
+  // options with length
+  for (i=0; (i<numArgs) && (pos + 4 <= (uint64_t) lenFile); i++) {
+    j = get32(data + pos);
+    CHECK((i >= sizeof(s_expectArgs)/sizeof(s_expectArgs[0])) || ((j == strlen(s_expectArgs[i])) && (!memcmp(data + pos + 4, s_expectArgs[i], j))));
+    pos += 4 + j;
+  }
+
+  // image: number of blocks, CRC32 over block list, blocks with address, length and data
+  if (numImages == 1) {
+    numBlocks = get32(data + pos);
+    CHECK(numBlocks == 2);
+    tmp = data + pos + 8;
+    for (i=0; i<numBlocks; i++)
+      tmp += 8 + get32(tmp + 4);
+    CHECK(get32(data + pos + 4) == crc32(data + pos + 8, tmp - (data + pos + 8)));
+    pos += 8;
+    CHECK((get32(data + pos) == 0x8000) && (get32(data + pos + 4) == 0x104));
+    CHECK(!memcmp(data + pos + 8, dataA, sizeof(dataA)));
+    lenBlock = get32(data + pos + 4);
+    pos += 8 + lenBlock;
+    CHECK((get32(data + pos) == 0x8200) && (get32(data + pos + 4) == sizeof(dataB)));
+    CHECK(!memcmp(data + pos + 8, dataB, sizeof(dataB)));
+    pos += 8 + sizeof(dataB);
+  }
+
+  // CRC32 over complete plan at end
+  CHECK(pos + 4 == (uint64_t) lenFile);
+  CHECK(get32(data + lenFile - 4) == crc32(data, lenFile - 4));
+
+  // load plan: options of plan replace '-n file', following options are kept
+  printf("  load plan\n");
+  plan_load(plan, 1, &argc, &argv);
+  CHECK(argc == (int) (1 + numArgs + 2));
+  CHECK(!strcmp(argv[0], "stm8gal"));
+  for (i=0; (i<numArgs) && (i<sizeof(s_expectArgs)/sizeof(s_expectArgs[0])); i++)
+    CHECK(!strcmp(argv[1+i], s_expectArgs[i]));
+  CHECK(!strcmp(argv[argc-2], "-v") && !strcmp(argv[argc-1], "0") && (argv[argc] == NULL));
+
+  // image of plan equals input files incl. checksum
+  imageBuf = mem_alloc(MEM_IMAGE, (LENIMAGEBUF + 1) * sizeof(*imageBuf));
+  plan_image("0", imageBuf, SILENT);
+  for (i=0x7F00; i<0x8300; i++) {
+    if ((i >= 0x8000) && (i < 0x8100))
+      CHECK(imageBuf[i] == (0xFF00 | dataA[i-0x8000]));
+    else if ((i >= 0x8200) && (i < 0x8210))
+      CHECK(imageBuf[i] == (0xFF00 | dataB[i-0x8200]));
+    else if ((i >= 0x8100) && (i < 0x8104))
+      CHECK(imageBuf[i] & 0xFF00);
+    else
+      CHECK(imageBuf[i] == 0);
+  }
+  mem_free(imageBuf);
+
+  // valid plan is accepted in child process, i.e. checks below fail due to the corruption
+  printf("  reject corrupted plans\n");
+  CHECK(!load_fails(plan));
+
+  // wrong identifier
+  data[0] ^= 0x01;
+  write_file(bad, data, lenFile);
+  CHECK(load_fails(bad));
+  data[0] ^= 0x01;
+
+  // other version
+  data[strlen(PLAN_MAGIC)] ^= 0x01;
+  write_file(bad, data, lenFile);
+  CHECK(load_fails(bad));
+  data[strlen(PLAN_MAGIC)] ^= 0x01;
+
+  // modified image data
+  data[lenFile - 10] ^= 0x01;
+  write_file(bad, data, lenFile);
+  CHECK(load_fails(bad));
+  data[lenFile - 10] ^= 0x01;
+
+  // truncated plan
+  write_file(bad, data, lenFile - 1);
+  CHECK(load_fails(bad));
+
+  // clean up
+  free(data);
+  remove(recipe);
+  remove(plan);
+  remove(bad);
+  remove(fileA);
+  remove(fileB);
+  rmdir(s_dir);
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
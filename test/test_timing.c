@@ -0,0 +1,275 @@
+/**
+  \file test_timing.c
+
+  \author G. Icking-Konert
+  \date 2019-03-24
+  \version 0.1
+
+  \brief test of timing calibration and profiles
+
+  test of timing.h. A thread plays a UART bootloader with configurable
+  response time behind a local raw TCP port, which supports changing the
+  port timeout unlike a pseudo terminal. Checks that the sync probe only
+  accepts a freshly reset BSL, that the read probe rejects differing data
+  and NACK, that the calibrated timeout covers the measured response time
+  plus the block programming time, and saving and loading of profiles
+  with several ports. Posix only.
+*/
+
+// define globals of main.h here
+#define _MAIN_
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "main.h"
+#include "misc.h"
+#include "serial_comm.h"
+#include "bootloader.h"
+#include "timing.h"
+
+
+/// check condition and count failures
+#define CHECK(cond)   do { if (!(cond)) { printf("  failed line %d: %s\n", __LINE__, #cond); s_numFail++; } } while (0)
+
+
+/// state of BSL model, i.e. bytes it waits for
+typedef enum {
+  BSL_CMD = 0,                //< command + checksum, or SYNCH
+  BSL_ADDR,                   //< address + checksum
+  BSL_LEN                     //< number of bytes + checksum (READ)
+} bslState_t;
+
+/// UART bootloader model with faults
+typedef struct {
+  int         sock;           //< connection to client
+  bslState_t  state;          //< protocol state
+  uint32_t    addr;           //< address of current READ
+  uint8_t     buf[10];        //< received bytes of current step
+  int         len;            //< number of received bytes
+  bool        synced;         //< SYNCH was received, i.e. next SYNCH gets NACK
+  uint32_t    delayGet;       //< response time of GET [ms]
+  bool        nackRead;       //< NACK READ command
+  bool        toggle;         //< change data of every 2nd READ
+  int         numRead;        //< number of READs
+} bslModel_t;
+
+// global variables
+static bslModel_t     s_bsl;                //< bootloader model
+static int            s_listen;             //< listening socket
+static int            s_numFail = 0;        //< number of failed checks
+
+
+
+/**
+  \fn void bsl_model_byte(uint8_t c)
+
+  \param[in]  c       byte received from client
+
+  process byte like the UART bootloader in duplex mode. Only SYNCH, GET and READ are supported.
+*/
+static void bsl_model_byte(uint8_t c) {
+
+  uint8_t   resp[300];
+  int       i, need, lenResp = 0;
+  const uint8_t get[] = {ACK, 5, 0x13, GET, READ, GO, WRITE, ERASE, ACK};
+
+  // SYNCH outside of frame: ACK after reset, then NACK
+  if ((s_bsl.state == BSL_CMD) && (s_bsl.len == 0) && (c == SYNCH)) {
+    resp[lenResp++] = (s_bsl.synced) ? NACK : ACK;
+    s_bsl.synced = true;
+  }
+
+  // collect bytes of current step
+  else {
+    s_bsl.buf[s_bsl.len++] = c;
+    need = (s_bsl.state == BSL_ADDR) ? 5 : 2;
+    if (s_bsl.len < need)
+      return;
+    s_bsl.len = 0;
+
+    switch (s_bsl.state) {
+
+      // GET -> delayed response, READ -> ACK or NACK
+      case BSL_CMD:
+        if (s_bsl.buf[0] == GET) {
+          SLEEP(s_bsl.delayGet);
+          memcpy(resp, get, sizeof(get));
+          lenResp = sizeof(get);
+        }
+        else if ((s_bsl.buf[0] == READ) && (!s_bsl.nackRead)) {
+          resp[lenResp++] = ACK;
+          s_bsl.state = BSL_ADDR;
+        }
+        else
+          resp[lenResp++] = NACK;
+        break;
+
+      case BSL_ADDR:
+        s_bsl.addr = ((uint32_t) s_bsl.buf[0] << 24) | ((uint32_t) s_bsl.buf[1] << 16) | ((uint32_t) s_bsl.buf[2] << 8) | s_bsl.buf[3];
+        resp[lenResp++] = ACK;
+        s_bsl.state = BSL_LEN;
+        break;
+
+      // data depends on address, optionally on number of READ
+      case BSL_LEN:
+        s_bsl.state = BSL_CMD;
+        s_bsl.numRead++;
+        resp[lenResp++] = ACK;
+        for (i=0; i<=s_bsl.buf[0]; i++)
+          resp[lenResp++] = (uint8_t) (s_bsl.addr + i) ^ (((s_bsl.toggle) && (s_bsl.numRead % 2 == 0)) ? 0x01 : 0x00);
+        break;
+
+    } // switch (state)
+  }
+
+  if (send(s_bsl.sock, resp, lenResp, MSG_NOSIGNAL) != lenResp)
+    printf("  device: send failed\n");
+
+} // bsl_model_byte
+
+
+
+/**
+  \fn void *server(void *arg)
+
+  \param[in]  arg     not used
+
+  \return always NULL
+
+  thread: accept connections one after another and pass data to bootloader model.
+*/
+static void *server(void *arg) {
+
+  uint8_t   raw[1000];
+  int       got, i;
+
+  (void) arg;
+  while ((s_bsl.sock = accept(s_listen, NULL, NULL)) >= 0) {
+    while ((got = recv(s_bsl.sock, raw, sizeof(raw), 0)) > 0) {
+      for (i=0; i<got; i++)
+        bsl_model_byte(raw[i]);
+    }
+    close(s_bsl.sock);
+  }
+  return(NULL);
+
+} // server
+
+
+
+/**
+  \fn int main(void)
+
+  \return number of failed checks
+
+  run tests of timing calibration and profiles.
+*/
+int main(void) {
+
+  struct sockaddr_in  addr;
+  socklen_t           lenAddr = sizeof(addr);
+  pthread_t           thread;
+  HANDLE              port;
+  char                name[100], profile[] = "/tmp/test_timing_XXXXXX", deviceId[STRLEN], line[STRLEN];
+  timing_t            timing;
+  int                 fd, numLines;
+  FILE                *fp;
+
+  printf("test_timing\n");
+  g_backgroundOperation = true;
+  timing_init();
+
+  // bootloader behind local port
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port        = 0;
+  if (((s_listen = socket(AF_INET, SOCK_STREAM, 0)) < 0) || (bind(s_listen, (struct sockaddr*) &addr, sizeof(addr)) != 0) ||
+      (listen(s_listen, 1) != 0) || (getsockname(s_listen, (struct sockaddr*) &addr, &lenAddr) != 0)) {
+    printf("  cannot open server socket\n");
+    return(1);
+  }
+  pthread_create(&thread, NULL, server, NULL);
+  sprintf(name, "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+  port = init_port(name, 115200, g_timing.timeout, 8, 0, 1, 0, 0);
+
+  // sync probe: ACK of freshly reset BSL only
+  printf("  probe sync\n");
+  CHECK(timing_probe_sync(port));
+  CHECK(!timing_probe_sync(port));
+
+  // read probe: identical data of 2 READs
+  printf("  probe read\n");
+  CHECK(timing_probe_read(port, 0));
+  CHECK(s_bsl.numRead == 2);
+  s_bsl.toggle = true;
+  CHECK(!timing_probe_read(port, 0));
+  s_bsl.toggle   = false;
+  s_bsl.nackRead = true;
+  CHECK(!timing_probe_read(port, 0));
+  s_bsl.nackRead = false;
+
+  // calibration: timeout covers 2x response time plus programming time of block, in 100ms steps.
+  // W/o programming time the timeout would be 100ms. Sync interval is only reduced, i.e. default is kept
+  printf("  calibrate\n");
+  fflush(stdout);
+  s_bsl.delayGet = 32;
+  timing_calibrate(port, 0, MUTE);
+  CHECK((g_timing.timeout >= 2 * s_bsl.delayGet + 20 + TPROG_BLOCK) && (g_timing.timeout < TIMEOUT) && ((g_timing.timeout % 100) == 0));
+  CHECK(g_timing.syncDelay == 10);
+  CHECK(g_timing.flushDelay == 1);
+  close_port(&port);
+
+  // profile: entry of a port is replaced, other ports and comments are kept
+  printf("  profile\n");
+  if ((fd = mkstemp(profile)) < 0) {
+    printf("  cannot create file\n");
+    return(1);
+  }
+  close(fd);
+  timing_device_id(STM8S, 32, 0x13, deviceId);
+  CHECK(!strcmp(deviceId, "STM8S-32kB-BSL1.3"));
+  g_timing.timeout  = 300;
+  g_timing.baudrate = 230400;
+  timing_save(profile, "/dev/ttyUSB0", deviceId, MUTE);
+  g_timing.timeout  = 400;
+  timing_save(profile, "/dev/ttyUSB1", "STM8L-64kB-BSL1.1", MUTE);
+  g_timing.timeout  = 500;
+  timing_save(profile, "/dev/ttyUSB0", deviceId, MUTE);
+  numLines = 0;
+  if ((fp = fopen(profile, "r"))) {
+    while (fgets(line, sizeof(line), fp))
+      numLines++;
+    fclose(fp);
+  }
+  CHECK(numLines == 4);
+  timing_init();
+  CHECK(timing_load(profile, "/dev/ttyUSB0", &timing, deviceId, MUTE));
+  CHECK((timing.timeout == 500) && (timing.baudrate == 230400) && (!strcmp(deviceId, "STM8S-32kB-BSL1.3")));
+  CHECK(timing_load(profile, "/dev/ttyUSB1", &timing, deviceId, MUTE));
+  CHECK((timing.timeout == 400) && (!strcmp(deviceId, "STM8L-64kB-BSL1.1")));
+  CHECK(!timing_load(profile, "/dev/ttyUSB2", &timing, deviceId, MUTE));
+  CHECK(g_timing.timeout == TIMEOUT);
+  remove(profile);
+  CHECK(!timing_load(profile, "/dev/ttyUSB0", &timing, deviceId, MUTE));
+
+  // stop server
+  shutdown(s_listen, SHUT_RDWR);
+  close(s_listen);
+  pthread_join(thread, NULL);
+  printf("  %s\n", (s_numFail == 0) ? "passed" : "FAILED");
+  return(s_numFail);
+
+} // main
+
+// end of file
@@ -0,0 +1,543 @@
+/**
+  \file timing.c
+
+  \author G. Icking-Konert
+  \date 2019-01-14
+  \version 0.1
+
+  \brief implementation of timing calibration and profile routines
+
+  implementation of routines for measuring the fastest reliable timing of a
+  fixture (port + device) and for storing/loading it to/from a profile file.
+  Profile file contains one line per fixture with port, device and timing.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "timing.h"
+#include "bootloader.h"
+#include "serial_comm.h"
+#include "main.h"
+#include "misc.h"
+#if defined(WIN32)
+  #include <windows.h>
+#elif defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/mman.h>
+#endif
+
+
+/// number of transactions per tested delay during calibration
+#define CALIB_CYCLES    20
+
+/// number of bytes read per READ for validating baudrate and delays
+#define PROBE_READ      128
+
+/// number of 1ms sleeps for measuring wake-up latency
+#define RT_LATENCY_CYCLES  200
+
+/// SCHED_FIFO priority of protocol thread (1..99), below kernel IRQ threads (50)
+#define RT_PRIORITY        40
+
+/// size of pre-faulted stack [B]
+#define RT_STACK_PREFAULT  (256*1024)
+
+
+// global variables
+static bool s_memLocked = false;      //< working set is locked, see timing_lock()
+
+
+
+/**
+  \fn void timing_init(void)
+
+  set worst-case default timing, which works for all tested fixtures
+*/
+void timing_init(void) {
+
+  g_timing.timeout    = TIMEOUT;      // UART response timeout [ms]
+  g_timing.syncRetry  = 50;           // max. number of sync attempts
+  g_timing.syncDelay  = 10;           // avoid flooding the STM8 during sync [ms]
+  g_timing.flushDelay = 50;           // delay after purging port, seems to be required for some reason [ms]
+  g_timing.portDelay  = 200;          // required to make flush work after opening port [ms]
+  g_timing.resetDelay = 20;           // allow BSL to initialize after reset [ms]
+  g_timing.baudrate   = 0;            // not calibrated
+
+} // timing_init
+
+
+
+/**
+  \fn void timing_default_file(char *filename)
+
+  \param[out] filename     default path of profile (size STRLEN)
+
+  get default path of timing profile, i.e. in home directory of user
+*/
+void timing_default_file(char *filename) {
+
+  char  *home;
+
+  // get home directory
+  home = getenv("HOME");
+  #if defined(WIN32)
+    if (home == NULL)
+      home = getenv("USERPROFILE");
+  #endif
+
+  // path of profile. Without home directory use current folder
+  if (home != NULL)
+    snprintf(filename, STRLEN, "%s/%s", home, TIMING_PROFILE);
+  else
+    snprintf(filename, STRLEN, "%s", TIMING_PROFILE);
+
+} // timing_default_file
+
+
+
+/**
+  \fn bool timing_load(const char *filename, const char *port, timing_t *timing, char *deviceId, uint8_t verbose)
+
+  \param[in]  filename     name of profile file
+  \param[in]  port         name of communication port
+  \param[out] timing       timing of port and device
+  \param[out] deviceId     device the timing was measured with (size STRLEN)
+  \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  \return true if timing for port was found, else false
+
+  load timing for port from profile. g_timing is not changed, as the device is not known
+  before synchronization. The caller applies the timing after checking the device.
+*/
+bool timing_load(const char *filename, const char *port, timing_t *timing, char *deviceId, uint8_t verbose) {
+
+  FILE      *fp;
+  char      line[STRLEN], name[STRLEN], device[STRLEN];
+  timing_t  entry;
+  bool      found = false;
+
+  // no profile -> keep defaults
+  if (!(fp = fopen(filename, "r")))
+    return(false);
+
+  // find entry for port. Lines: port device timeout syncRetry syncDelay flushDelay portDelay resetDelay baudrate
+  while (fgets(line, STRLEN, fp) != NULL) {
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%999s %999s %" SCNu32 " %" SCNu32 " %" SCNu32 " %" SCNu32 " %" SCNu32 " %" SCNu32 " %" SCNu32, name, device,
+      &entry.timeout, &entry.syncRetry, &entry.syncDelay, &entry.flushDelay, &entry.portDelay, &entry.resetDelay, &entry.baudrate) != 9)
+      continue;
+    if (!strcmp(name, port)) {
+      memcpy(timing, &entry, sizeof(entry));
+      strncpy(deviceId, device, STRLEN-1);
+      deviceId[STRLEN-1] = '\0';
+      found = true;
+    }
+  }
+  fclose(fp);
+
+  // print message
+  if (found && (verbose == CHATTY))
+    printf("  load timing profile for '%s' (%s) ... done\n", port, deviceId);
+  fflush(stdout);
+
+  return(found);
+
+} // timing_load
+
+
+
+/**
+  \fn void timing_save(const char *filename, const char *port, const char *deviceId, uint8_t verbose)
+
+  \param[in]  filename     name of profile file
+  \param[in]  port         name of communication port
+  \param[in]  deviceId     device the timing was measured with
+  \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  store g_timing for port and device to profile. An existing entry for the port is replaced,
+  entries for other ports are kept.
+*/
+void timing_save(const char *filename, const char *port, const char *deviceId, uint8_t verbose) {
+
+  FILE      *fp;
+  char      *buf, line[STRLEN], name[STRLEN];
+  size_t    lenBuf = 0, sizeBuf = 0;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  save timing profile '%s' ... ", filename);
+  fflush(stdout);
+
+  // keep entries of other ports
+  buf = NULL;
+  if ((fp = fopen(filename, "r")) != NULL) {
+    while (fgets(line, STRLEN, fp) != NULL) {
+      if ((line[0] == '#') || ((sscanf(line, "%999s", name) == 1) && (!strcmp(name, port))))
+        continue;
+      if (lenBuf + strlen(line) + 1 > sizeBuf) {
+        sizeBuf = 2*sizeBuf + STRLEN;
+        if (!(buf = realloc(buf, sizeBuf)))
+          Error("Cannot allocate profile buffer");
+      }
+      strcpy(buf+lenBuf, line);
+      lenBuf += strlen(line);
+    }
+    fclose(fp);
+  }
+
+  // write profile with new entry for port
+  if (!(fp = fopen(filename, "w")))
+    Error("Failed to create timing profile %s", filename);
+  fprintf(fp, "# stm8gal timing profile\n");
+  fprintf(fp, "# port  device  timeout syncRetry syncDelay flushDelay portDelay resetDelay [ms]  baudrate\n");
+  if (buf != NULL)
+    fputs(buf, fp);
+  fprintf(fp, "%s %s %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 "\n", port, deviceId,
+    g_timing.timeout, g_timing.syncRetry, g_timing.syncDelay, g_timing.flushDelay, g_timing.portDelay, g_timing.resetDelay, g_timing.baudrate);
+  fclose(fp);
+  free(buf);
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done\n");
+  fflush(stdout);
+
+} // timing_save
+
+
+
+/**
+  \fn void timing_device_id(uint8_t family, int flashsize, uint8_t versBSL, char *deviceId)
+
+  \param[in]  family       STM8 family (STM8S=1, STM8L=2)
+  \param[in]  flashsize    size of flash in kB
+  \param[in]  versBSL      BSL version
+  \param[out] deviceId     device identifier (size STRLEN)
+
+  get device identifier for profile from bootloader info, e.g. "STM8S-32kB-BSL1.3"
+*/
+void timing_device_id(uint8_t family, int flashsize, uint8_t versBSL, char *deviceId) {
+
+  snprintf(deviceId, STRLEN, "STM8%c-%dkB-BSL%x.%x", ((family == STM8L) ? 'L' : 'S'), flashsize, (versBSL >> 4) & 0x0F, versBSL & 0x0F);
+
+} // timing_device_id
+
+
+
+/**
+  \fn bool timing_probe_sync(HANDLE ptrPort)
+
+  \param[in]  ptrPort      handle to communication port
+
+  \return true if bootloader responded with ACK, else false
+
+  synchronize with UART bootloader like bsl_sync(), but return status instead of
+  terminating. Used for checking baudrates and delays during calibration. Only ACK
+  is accepted, as a NACK means the BSL was already synchronized, i.e. the reset didn't
+  take effect and the probe would not test the delays after reset.
+*/
+bool timing_probe_sync(HANDLE ptrPort) {
+
+  char      Tx[1], Rx[1];
+  uint32_t  count, len;
+
+  Tx[0] = SYNCH;
+  for (count=0; count<g_timing.syncRetry; count++) {
+
+    // send sync byte and get response. Skip 1-wire echo
+    send_port(ptrPort, 0, 1, Tx);
+    len = receive_port(ptrPort, 0, 1, Rx);
+    if ((len == 1) && (Rx[0] == Tx[0]))
+      len = receive_port(ptrPort, 0, 1, Rx);
+
+    // ACK -> ok. NACK -> BSL was not reset
+    if ((len == 1) && (Rx[0] == ACK)) {
+      flush_port(ptrPort);
+      return(true);
+    }
+    if ((len == 1) && (Rx[0] == NACK))
+      return(false);
+
+    // avoid flooding the STM8
+    SLEEP(g_timing.syncDelay);
+
+  } // loop over attempts
+
+  return(false);
+
+} // timing_probe_sync
+
+
+
+/**
+  \fn bool timing_probe_read(HANDLE ptrPort, uint8_t uartMode)
+
+  \param[in]  ptrPort      handle to synchronized communication port
+  \param[in]  uartMode     UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+
+  \return true if both READs succeeded with identical data, else false
+
+  set UART mode like after bsl_sync(), then read the start of flash twice and compare,
+  w/o terminating on failure. Unlike the 1-byte SYNC this transfers full frames, i.e.
+  checks the baudrate within the tolerance of the UART. Fails for read-out protected devices.
+*/
+bool timing_probe_read(HANDLE ptrPort, uint8_t uartMode) {
+
+  char      Tx[5], Rx[2][PROBE_READ+1];
+  uint64_t  addr = PFLASH_START;
+  int       i;
+
+  // set parity of UART mode. 2-wire reply requires ACK first to revert bootloader
+  if (uartMode == 0)
+    set_parity(ptrPort, 2);
+  else {
+    set_parity(ptrPort, 0);
+    if (uartMode == 2) {
+      Tx[0] = ACK;
+      send_port(ptrPort, 0, 1, Tx);
+    }
+  }
+
+  // read start of flash twice
+  for (i=0; i<2; i++) {
+
+    // send READ command
+    Tx[0] = READ;
+    Tx[1] = (Tx[0] ^ 0xFF);
+    if ((send_port(ptrPort, uartMode, 2, Tx) != 2) || (receive_port(ptrPort, uartMode, 1, Rx[i]) != 1) || (Rx[i][0] != ACK))
+      return(false);
+
+    // send address
+    Tx[0] = (char) (addr >> 24);
+    Tx[1] = (char) (addr >> 16);
+    Tx[2] = (char) (addr >> 8);
+    Tx[3] = (char) (addr);
+    Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
+    if ((send_port(ptrPort, uartMode, 5, Tx) != 5) || (receive_port(ptrPort, uartMode, 1, Rx[i]) != 1) || (Rx[i][0] != ACK))
+      return(false);
+
+    // send number of bytes and receive ACK + data
+    Tx[0] = PROBE_READ - 1;
+    Tx[1] = (Tx[0] ^ 0xFF);
+    if ((send_port(ptrPort, uartMode, 2, Tx) != 2) || (receive_port(ptrPort, uartMode, PROBE_READ+1, Rx[i]) != PROBE_READ+1) || (Rx[i][0] != ACK))
+      return(false);
+
+  } // loop over READs
+
+  // data must be identical
+  return(memcmp(Rx[0], Rx[1], PROBE_READ+1) == 0);
+
+} // timing_probe_read
+
+
+
+/**
+  \fn bool timing_probe_get(HANDLE ptrPort, uint8_t uartMode, uint64_t *duration)
+
+  \param[in]  ptrPort      handle to communication port
+  \param[in]  uartMode     UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[out] duration     duration of transaction [us]
+
+  \return true if bootloader responded correctly, else false
+
+  send GET command and check response w/o terminating on failure
+*/
+static bool timing_probe_get(HANDLE ptrPort, uint8_t uartMode, uint64_t *duration) {
+
+  char      Tx[2], Rx[9];
+  uint64_t  tStart;
+  uint32_t  len;
+
+  // send GET command and receive response
+  Tx[0] = GET;
+  Tx[1] = (Tx[0] ^ 0xFF);
+  tStart = micros();
+  if (send_port(ptrPort, uartMode, 2, Tx) != 2)
+    return(false);
+  len = receive_port(ptrPort, uartMode, 9, Rx);
+  *duration = micros() - tStart;
+
+  // check response
+  return((len == 9) && (Rx[0] == ACK) && (Rx[8] == ACK) && (Rx[3] == GET));
+
+} // timing_probe_get
+
+
+
+/**
+  \fn void timing_calibrate(HANDLE ptrPort, uint8_t uartMode, uint8_t verbose)
+
+  \param[in]  ptrPort      handle to communication port
+  \param[in]  uartMode     UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  measure fastest reliable response timeout, purge delay and sync interval of synchronized UART
+  bootloader and store them in g_timing. Timeout and sync interval are derived from the measured
+  response time, the purge delay is the shortest tested delay w/o failures. All with a safety
+  margin of 2x. The timeout covers the programming time of an aligned block. Baudrate, port and reset delays require a device reset and are tuned by the
+  caller via timing_probe_sync() and timing_probe_read().
+*/
+void timing_calibrate(HANDLE ptrPort, uint8_t uartMode, uint8_t verbose) {
+
+  const uint32_t  delays[] = {0, 1, 2, 5, 10, 20, 50};   // tested delays [ms], ascending
+  uint64_t  duration, maxDuration;
+  uint32_t  timeout, syncDelay;
+  int       i, j, numDelays = sizeof(delays)/sizeof(delays[0]);
+  bool      ok;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  calibrate timing ... ");
+  fflush(stdout);
+
+  // measure max. response time of GET command with default timing
+  maxDuration = 0;
+  for (i=0; i<CALIB_CYCLES; i++) {
+    flush_port(ptrPort);
+    SLEEP(g_timing.flushDelay);
+    if (!timing_probe_get(ptrPort, uartMode, &duration))
+      Error("in 'timing_calibrate()': no response from BSL");
+    if (duration > maxDuration)
+      maxDuration = duration;
+  }
+
+  // sync interval with 2x margin of response time, i.e. BSL has replied before next attempt
+  syncDelay = (uint32_t) (2 * ((maxDuration + 999) / 1000L));
+  if (syncDelay < g_timing.syncDelay)
+    g_timing.syncDelay = syncDelay;
+
+  // timeout with 2x margin plus programming time of an aligned block, which the BSL requires before
+  // replying to a WRITE. Longer byte-wise programming is added per WRITE via bsl_progTime().
+  // Posix timeout resolution is 0.1s
+  timeout = (uint32_t) (2 * (maxDuration / 1000L) + 20 + TPROG_BLOCK);
+  timeout = ((timeout + 99) / 100) * 100;
+  if (timeout < g_timing.timeout)
+    g_timing.timeout = timeout;
+  set_timeout(ptrPort, g_timing.timeout);
+
+  // find min. delay after purging port buffers
+  for (j=0; j<numDelays; j++) {
+    ok = true;
+    for (i=0; (i<CALIB_CYCLES) && ok; i++) {
+      flush_port(ptrPort);
+      SLEEP(delays[j]);
+      ok = timing_probe_get(ptrPort, uartMode, &duration);
+    }
+    if (ok)
+      break;
+  }
+  if (j < numDelays)
+    g_timing.flushDelay = 2*delays[j] + 1;
+  flush_port(ptrPort);
+  SLEEP(g_timing.flushDelay);
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (timeout %dms, purge %dms, sync %dms)\n", (int) g_timing.timeout, (int) g_timing.flushDelay, (int) g_timing.syncDelay);
+  fflush(stdout);
+
+} // timing_calibrate
+
+
+/**
+  \fn void timing_lock(void)
+
+  lock protocol working set in RAM to avoid page faults in the select()/SLEEP() based protocol
+  loop. Stack is pre-faulted, then the pages mapped so far (code, libraries, static data and small
+  heap buffers) are locked. Must be called before the large image buffers are allocated, which are
+  not locked (no MCL_FUTURE), as locking would make all of them resident. Missing privilege
+  (root or CAP_IPC_LOCK) is reported by timing_realtime(). No locking under Windows and MacOS.
+*/
+void timing_lock(void) {
+
+#if defined(__unix__) && !defined(__APPLE__)
+
+  volatile char   stack[RT_STACK_PREFAULT];
+  int             i;
+
+  // pre-fault stack, then lock current pages only
+  for (i=0; i<RT_STACK_PREFAULT; i+=256)
+    stack[i] = 0;
+  (void) stack[0];
+  s_memLocked = (mlockall(MCL_CURRENT) == 0);
+
+#endif // OS
+
+} // timing_lock
+
+
+
+/**
+  \fn void timing_realtime(uint8_t verbose)
+
+  \param[in]  verbose      verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  run calling (protocol) thread with real-time priority to avoid scheduler jitter in the
+  select()/SLEEP() based protocol loop. Afterwards measure and report the observed wake-up
+  latency of SLEEP(), and if the working set was locked by timing_lock(). Missing privileges
+  (root or CAP_SYS_NICE / CAP_IPC_LOCK) are reported but not fatal.
+  Under Windows use highest thread priority w/o memory locking.
+*/
+void timing_realtime(uint8_t verbose) {
+
+  uint64_t  tStart, latency, latMin, latMax, latSum;
+  int       i;
+  bool      okSched, okLock;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  set real-time mode ... ");
+  fflush(stdout);
+
+#if defined(WIN32)
+
+  okSched = SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS) &&
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+#elif defined(__APPLE__) || defined(__unix__)
+
+  struct sched_param  param;
+
+  // FIFO scheduling with fixed priority for protocol thread. Background threads keep normal policy
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = RT_PRIORITY;
+  okSched = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+
+#endif // OS
+
+  // working set is locked before allocation of image buffers
+  okLock = s_memLocked;
+
+  // measure wake-up latency of 1ms sleep
+  latMin = UINT64_MAX;
+  latMax = 0;
+  latSum = 0;
+  for (i=0; i<RT_LATENCY_CYCLES; i++) {
+    tStart = micros();
+    SLEEP(1);
+    latency = micros() - tStart;
+    latency = (latency > 1000) ? (latency - 1000) : 0;
+    latSum += latency;
+    if (latency < latMin)
+      latMin = latency;
+    if (latency > latMax)
+      latMax = latency;
+  }
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY)) {
+    printf("done (%s, %s, wake-up latency min/avg/max %d/%d/%dus)\n", (okSched ? "real-time priority" : "normal priority"),
+      (okLock ? "memory locked" : "memory not locked"), (int) latMin, (int) (latSum/RT_LATENCY_CYCLES), (int) latMax);
+  }
+  fflush(stdout);
+
+} // timing_realtime
+
+
+// end of file
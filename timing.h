@@ -0,0 +1,62 @@
+/**
+  \file timing.h
+
+  \author G. Icking-Konert
+  \date 2019-01-14
+  \version 0.1
+
+  \brief declaration of timing calibration and profile routines
+
+  declaration of routines for measuring the fastest reliable timing of a
+  fixture (port + device) and for storing/loading it to/from a profile file.
+*/
+
+// for including file only once
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_comm.h"
+#include "main.h"
+
+
+/// default name of timing profile file (in home directory)
+#define TIMING_PROFILE    ".stm8gal_timing"
+
+
+/// set worst-case default timing
+void  timing_init(void);
+
+/// get default path of timing profile
+void  timing_default_file(char *filename);
+
+/// load timing for port from profile w/o applying it. Returns true if an entry was found
+bool  timing_load(const char *filename, const char *port, timing_t *timing, char *deviceId, uint8_t verbose);
+
+/// store timing for port and device to profile
+void  timing_save(const char *filename, const char *port, const char *deviceId, uint8_t verbose);
+
+/// get device identifier for profile from bootloader info
+void  timing_device_id(uint8_t family, int flashsize, uint8_t versBSL, char *deviceId);
+
+/// check synchronization with freshly reset bootloader w/o terminating on failure
+bool  timing_probe_sync(HANDLE ptrPort);
+
+/// check READ of synchronized bootloader w/o terminating on failure
+bool  timing_probe_read(HANDLE ptrPort, uint8_t uartMode);
+
+/// measure fastest reliable timing of synchronized UART bootloader
+void  timing_calibrate(HANDLE ptrPort, uint8_t uartMode, uint8_t verbose);
+
+/// lock current pages (protocol working set) in RAM. Call before allocating large buffers
+void  timing_lock(void);
+
+/// run protocol thread with real-time priority, report wake-up latency and locked memory
+void  timing_realtime(uint8_t verbose);
+
+#endif // _TIMING_H_
+
+// end of file